@@ -30,10 +30,15 @@
 #pragma comment(lib, "Comctl32.lib")
 
 extern INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam);
+extern HWND CreateDaemonWindow(HINSTANCE hInstance);
 extern void CollectPaths();
+extern void ReadOptionsFile();
 extern int  ReadDlgConfigFile();
-extern void WriteDlgConfigFile();
-extern int ProcessQirxXMLFile(char* szInOutNodeContent, const char* nodeNeedle, int configReadWrite);
+extern int ProcessCommandLine();
+extern int StartScheduler();
+extern void StopScheduler();
+extern void StopEngine();
+extern void DaemonStartError(const char* szMsg);
 
 
 int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
@@ -51,6 +56,13 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int n
         return 2;
 
     CollectPaths();
+    ReadOptionsFile();
+
+// Commands like "-etiindex" run without the dialog
+    if (ProcessCommandLine()) {
+        VFREE(pPTM);
+        return 0;
+    }
 
     if (pPTM->haveQirxConfig) {
         _strupr_s(pPTM->szQirxVersion, 16);
@@ -65,15 +77,17 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int n
             // Backup the current config
             CopyFile(pPTM->szQirxFullConfigFileName, pPTM->szQirxFullConfigBackupFileName, 0);
 
-// Event for stopping the disc_space_thread at the top of its loop
-            pPTM->hWaitPathSwitch = CreateEvent( NULL,  // default security attributes
-                                                 true,  // manual-reset event
-                                                 true,  // initial state is signaled (no blocking)
-                                                 NULL);	// object name
-
+            // the timers of the dialog, see scheduler.cpp
+            StartScheduler();
 
-            pPTM->hWndDialog = CreateDialog(hInstance,
-                MAKEINTRESOURCE(IDD_MAIN), 0, MainDlgProc);
+            // "-daemon": the engine without the dialog, see daemon.cpp
+            if (pPTM->headless)
+                pPTM->hWndDialog = CreateDaemonWindow(hInstance);
+            else
+                pPTM->hWndDialog = CreateDialog(hInstance,
+                    MAKEINTRESOURCE(IDD_MAIN), 0, MainDlgProc);
+            if (!pPTM->hWndDialog)
+                goto err;
 
             while ((retval = GetMessage(&msg, 0, 0, 0)) != 0) {
                 if (retval == -1)
@@ -86,30 +100,15 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int n
             }
 
 err:
-            if (pPTM->hDiskSpaceThread) {
-                pPTM->finishThread = 1;
-                WaitForSingleObject(pPTM->hDiskSpaceThread, 2000);
-                CloseHandle(pPTM->hDiskSpaceThread);
-            }
-
-            CloseHandle(pPTM->hWaitPathSwitch);
-
-// restore the default paths, if other paths are set
-            if (pPTM->flagRawDriveSet)
-                ProcessQirxXMLFile(pPTM->szOriginalRawPath, needleRawOut, CONFIG_WRITE);
-
-            if (pPTM->flagAudDriveSet)
-                ProcessQirxXMLFile(pPTM->szOriginalAudPath, needleAudOut, CONFIG_WRITE);
-            
-            if (pPTM->flagTiiDriveSet)
-                ProcessQirxXMLFile(pPTM->szOriginalTiiPath, needleTiiLog, CONFIG_WRITE);
-            
-            if (pPTM->flagEtiDriveSet)
-                ProcessQirxXMLFile(pPTM->szOriginalEtiPath, needleEtiOut, CONFIG_WRITE);
-
-            WriteDlgConfigFile();
+            StopEngine();
+            StopScheduler();
         }
     }
+    else if (pPTM->headless) { // no desktop, nobody to click
+        DaemonStartError(szMsgNotFound);
+        VFREE(pPTM);
+        return 3;
+    }
     else // No qirx.bat, no fun.
         MessageBox(0, szMsgNotFound, szAppName, MB_ICONSTOP | MB_SETFOREGROUND); 
 
@@ -39,6 +39,14 @@
 #define VFREE(x) VirtualFree(x, 0, MEM_RELEASE);
 #define MAX_PATH_BUFFER_SIZE (272)  // rounded up to the next multiple of 16
 
+// clang-cl (x64 builds) refuses intrinsics beyond SSE2 in functions which
+// are not marked for the instruction set. MSVC does not need this.
+#if defined(__clang__) || defined(__GNUC__)
+#define PT_TARGET(isa) __attribute__((target(isa)))
+#else
+#define PT_TARGET(isa)
+#endif
+
 #define CONFIG_READ  0
 #define CONFIG_WRITE 1
 
@@ -47,15 +55,101 @@
 #define NODE_TII 2
 #define NODE_ETI 3 // New setting for QIRX version 5
 
+#define IQ_HIST_BINS 100 // power histogram of the IQ scanner, 1 dB each
+
+#define REC_MAX_FOLDERS 4 // current, previous, original and external path of a node
+
+#define DEDUP_REPORT 0 // actions of the duplicate finder
+#define DEDUP_LINK   1
+#define DEDUP_DELETE 2
+
 // Some private messages
 #define PTMSG_FOLDER_SELECTION_READY   WM_APP
 #define PTMSG_FOLDER_SELECTION_CANCEL (WM_APP + 1)
 #define PTMSG_FOLDER_SELECTION_ERROR  (WM_APP + 2)
+#define PTMSG_FOLDER_ROLLOVER         (WM_APP + 3) // wParam: node
+#define PTMSG_BLINK                   (WM_APP + 4)
+#define PTMSG_PATH_PLAN               (WM_APP + 5) // wParam: node, lParam: target
+#define PTMSG_PROBE_RESULT            (WM_APP + 6) // wParam: node, lParam: PROBE_...
+#define PTMSG_IDENTITY_ANSWER         (WM_APP + 7) // wParam: node, lParam: 1 for yes
+#define PTMSG_DRIVES_CHANGED          (WM_APP + 8) // wParam: the drive letters (GetLogicalDrives())
+#define PTMSG_CONTROL                 (WM_APP + 9) // wParam: node, lParam: target, sent: 1 if done
+#define PTMSG_FRAG_CHECKED            (WM_APP + 10) // wParam: node, lParam: see TakeFragCheck()
+
+#define PROBE_OFFLINE  0 // startup probes of the stored paths, see drive_probe.cpp
+#define PROBE_ONLINE   1
+#define PROBE_MISMATCH 2 // another serial number
+#define PROBE_TIMEOUT  3
+
+#define IDP_ASK    0 // identity policies of the nodes, see drive_identity.cpp
+#define IDP_TRUST  1
+#define IDP_LABEL  2
+#define IDP_STRICT 3
+
+#define IDV_REJECT 0 // verdicts on a drive
+#define IDV_MATCH  1
+#define IDV_ACCEPT 2 // not the stored drive, but the policy takes it
+#define IDV_ASK    3
+
+#define SCHED_MAX_TIMERS (32 * STATION_MAX) // see scheduler.cpp
+#define SPACE_STALL_MS   500 // a drive this slow to tell its free space stalls, see disk_space_thread.cpp
+#define SPACE_AVG_INTERVAL 20 // s, one speed measurement each, see disk_space_thread.cpp
+#define SPACE_AVG_SPEEDS   20 // measurements averaged for the recording time left
+#define SPACE_AVG_DISPLAY  3  // and for the write speed shown
+#define SCHED_NONE       (-1)
+
+#define PLAN_MAX         16 // path plans, see path_plans.cpp
+
+#define LAYOUT_WARNING_SIZE 160 // see GetLayoutWarning() in drive_layout.cpp
+
+#define CONFIG_OPEN_RETRIES 10  // QIRX's config-file is in use, see configparser.cpp
+#define CONFIG_RETRY_MS     50
+#define CONFIG_SETTLE_MS    100 // QIRX reads the file again after a change
+
+#define HEADLESS_DAEMON  1  // "-daemon", see daemon.cpp
+#define HEADLESS_STATION 2  // a station of "-stations", see stations.cpp
+#define STATION_MAX      8  // QIRX versions, see stations.cpp
+#define PLAN_TO_EXTERNAL 0
+#define PLAN_TO_ORIGINAL 1
+
+#define LAT_ARRIVAL      0  // phases of a path switch, see latency.cpp
+#define LAT_REMOVAL      1
+#define LAT_VALIDATE     2
+#define LAT_SERIAL       3
+#define LAT_OPEN         4
+#define LAT_READ         5
+#define LAT_REWRITE      6
+#define LAT_SETTLE       7
+#define LAT_PHASES       8
+#define LAT_BUCKETS      464 // 16 per power of two up to 2^32 us
 
 inline const char
 szAppName[] = "PathTweaker",
 qirx[] = "qirx.exe",
 szDlgConfigFile[] = "dlg.dat",
+szOptionsFile[] = "options.ini",
+szTiiStoreFile[] = "tii.tcs",
+szDedupReportFile[] = "dedup.txt",
+szSpinupReportFile[] = "spinup.txt",
+szDaemonLogFile[] = "daemon.txt",
+szSampleRingFile[] = "samples.ring",
+szTraceFile[] = "trace.json",
+szDaemonClass[] = "PathTweakerDaemon",
+szStationsLogFile[] = "stations.txt",
+szStationsEvent[] = "Local\\PathTweakerStations",
+szControlPipe[] = "\\\\.\\pipe\\PathTweaker-",
+szOptSecPostRec[] = "PostRecording",
+szOptSecPlayback[] = "Playback",
+szOptSecReserve[] = "Reserve",
+szOptSecLayout[] = "Layout",
+szOptSecSubfolders[] = "Subfolders",
+szOptSecPrewarm[] = "Prewarm",
+szOptSecIdentity[] = "Identity",
+szOptSecMetrics[] = "Metrics",
+szOptSecQirxConfig[] = "QirxConfig",
+szReserveFile[] = "PathTweaker.%s.reserve", // per node
+szOldReserveFile[] = "PathTweaker.reserve", // shared by the nodes before
+szProbeFile[] = "PathTweaker.%s.probe",
 szQirxConfigExt[] = ".config",
 needleRawOut[] = "<rawOut value",
 needleAudOut[] = "<DAB value",
@@ -64,11 +158,19 @@ needleEtiOut[] = "<ETI value",
 needleQm = '"',
 szPathNotSet[] = "SELECT A PATH AT FIRST",
 szPathNotAvailable[] = "PATH NOT AVAILABLE",
+szPathProbing[] = "LOOKING FOR THE DRIVE...",
+szPathPending[] = "IS THIS THE RIGHT DRIVE?",
 chDriveBase = 'A',
 szRaw[] = "RAW",
 szAudio[] = "AUDIO",
 szTii[] = "TII",
 szEti[] = "ETI",
+szEtiExt[] = ".eti",
+szRawExt[] = ".raw",
+szIndexExt[] = ".idx",
+szReportExt[] = ".txt",
+szIqSummaryExt[] = ".iqs",
+szPackExt[] = ".rawz",
 szGroupBoxLabel[] = "rec. path && drive info ",
 
 szMsgSelectFolder[] =
@@ -86,9 +188,184 @@ szMsgSerialCheck[] =
 szMsgNotFound[] = 
 "QIRX not found. Copy the program into the program-directory of QIRX version 2, 3, 4 or 5!",
 
+szMsgFragCheck[] =
+"The drive may not keep up with a recording. Defragment it, format it with "
+"larger clusters or use another drive.\n\n"
+"Use it anyway?",
+
 szMsgQuit[] = 
 "Do you really want to quit?\n\n"
-"All recording paths will be set to their defaults.";
+"All recording paths will be set to their defaults.",
+
+szMsgUsage[] =
+"Usage: PathTweaker [command]\n"
+"Without a command the dialog starts. Commands:\n"
+"  -etiindex [file|folder]  check eti-recordings and write the frame index,\n"
+"                           the current ETI path is used if nothing is given\n"
+"  -etibench [MB]           throughput of the eti-checker (default 256 MB)\n"
+"  -iqscan [file|folder]    check raw-recordings and write the IQ summary,\n"
+"                           the current RAW path is used if nothing is given\n"
+"  -iqbench [MB]            throughput of the IQ scanner (default 1024 MB)\n"
+"  -rawpack [file|folder]   compress raw-recordings to \".rawz\" files\n"
+"  -rawunpack file.rawz     restore the raw-recording from a \".rawz\" file\n"
+"  -packbench [MB]          throughput and ratio of the compressor (default 256 MB)\n"
+"  -cfgbench [runs]         read and rewrite generated config-files of QIRX, with\n"
+"                           and without a competing reader, results as CSV\n"
+"  -fakeqirx file [delay=ms] [hold=ms] [log=file]\n"
+"                           stand in for QIRX: read the file after each change\n"
+"                           and log each open which fails\n"
+"  -qirxsim [switches=n] [delay=ms,...] [hold=ms,...] [settle=ms,...] [retry=ms]\n"
+"                           switch the paths against -fakeqirx, collisions and\n"
+"                           times as CSV\n"
+"  -tiiingest [folder]      take new lines of the TII-Logger files into the TII store,\n"
+"                           the current TII path is used if nothing is given\n"
+"  -tiiquery [key=value]    query the TII store, keys: from, to (YYYY-MM-DD[THH:MM]),\n"
+"                           freq (kHz, MHz or channel), eid, main, sub, limit and\n"
+"                           group (tx, eid, freq, day or none)\n"
+"  -dedup [link|delete] [folder ...]\n"
+"                           find duplicate recordings in all known recording\n"
+"                           folders (and the given ones), optionally replace\n"
+"                           them by hard links or delete them\n"
+"  -fragcheck [raw|aud|tii|eti|folder ...]\n"
+"                           fragmentation of the recording folders per file and\n"
+"                           per drive, all known folders if nothing is given\n"
+"  -plan [add raw|aud|tii|eti HH:MM external|original [days] | del n]\n"
+"                           list, add or delete the time-based path switches,\n"
+"                           days like 1-5 or 67 (Monday is 1), every day if not given\n"
+"  -daemon [qirxN|stop]     run without the dialog, e.g. on a recording station\n"
+"                           nobody looks at, or end the running daemon\n"
+"  -stations [stop]         one process running all QIRX versions found without\n"
+"                           the dialog, sharing one watch on the drives, or end it\n"
+"  -ctl [qirxN] \"command; ...\"\n"
+"                           ask the running dialog or daemon through its control\n"
+"                           pipe: get [raw|aud|tii|eti], set node, reset node, lat,\n"
+"                           trace, ping\n"
+"  -samples [from=date[Ttime]] [to=...] [node=raw|aud|tii|eti] [file=name]\n"
+"                           export the disk space samples of the ring file as CSV\n"
+"  -spacereplay [trace=steady|burst|delete|switch|eti|ring] [speed=n] [file=name]\n"
+"               [bench=n]   replay traces through the disk space estimator, check\n"
+"                           its errors and time it, results as CSV\n"
+"  -hotplug [events=n] [seed=n] [settle=ms]\n"
+"                           plug and pull simulated drives at random, check the\n"
+"                           paths after each event, rewrites and times as CSV\n"
+"  -snapstress [seconds]    stress test of the path hand-over to the disk space\n"
+"                           display (default 10 s)\n";
+
+
+// MAPPEDFILE is a read-only sliding window over a (large) recording,
+// see mapped_file.cpp
+struct MAPPEDFILE {
+    HANDLE hFile;
+    HANDLE hMapping;
+    BYTE* pView;
+    ULONGLONG fileSize;
+    ULONGLONG viewOffset;
+    SIZE_T viewSize;
+    DWORD granularity;
+};
+
+// Called by the timer wheel or the worker of the station, see scheduler.cpp
+typedef void (*PFNSCHEDPROC)(void* param);
+
+// Called for each recording found in a folder, see ForEachRecording()
+typedef int (*PFNRECORDINGPROC)(const char* szFileName, ULONGLONG fileSize, volatile int* pCancel);
+
+// ETIINDEXHEADER starts the index file written next to an eti-recording,
+// followed by numSegments ETIINDEXSEGMENTs, see eti_indexer.cpp
+struct ETIINDEXHEADER {
+    char magic[4];            // "ETIX"
+    DWORD version;
+    ULONGLONG fileSize;       // of the recording, for checking the index is up to date
+    DWORD numFrames;          // frames found in the file
+    DWORD numLogicalFrames;   // numFrames plus the dropped ones, 24 ms each
+    DWORD numSegments;
+    DWORD numCorrupted;       // CRC errors
+    DWORD numErrFlagged;      // ERR byte != 0xFF, reported by the receiver
+    DWORD numGaps;            // FCT jumps and garbage between frames
+    ULONGLONG numGapBytes;    // garbage between frames and a truncated tail
+};
+
+// IQSUMMARYHEADER starts the summary file written next to a raw-recording,
+// followed by numBlocks IQBLOCKSTATS, see iq_scanner.cpp
+struct IQSUMMARYHEADER {
+    char magic[4];            // "IQSM"
+    DWORD version;
+    ULONGLONG fileSize;       // of the recording, for checking the summary is up to date
+    DWORD blockSize;
+    DWORD numBlocks;
+    ULONGLONG numClipped;     // samples (bytes) at 0 or 255
+    ULONGLONG numZeroBytes;   // in zero-filled stretches
+    DWORD numDropouts;        // runs of blocks with zero-filled stretches
+    DWORD numSilent;          // blocks far below the median power
+    float dcI;                // relative to full scale
+    float dcQ;
+    float powerDb;            // mean power, dBFS
+    float medianPowerDb;
+    DWORD histogram[IQ_HIST_BINS]; // blocks per dB, 0 dBFS first
+};
+
+
+// RAWZHEADER starts a compressed raw-recording. The chunks follow, the
+// chunk index is at the end of the file, see raw_packer.cpp
+struct RAWZHEADER {
+    char magic[4];            // "RAWZ"
+    DWORD version;
+    ULONGLONG rawSize;        // of the original recording
+    DWORD chunkSize;
+    DWORD numChunks;
+    DWORD algorithm;          // of the Windows compression API
+    DWORD transform;          // the one used for most chunks
+    ULONGLONG indexOffset;    // 0 until the file is complete
+};
+
+
+// QIRXATTRIBUTE is one attribute of a node in QIRX's config-file, see
+// ProcessQirxXMLNode()
+struct QIRXATTRIBUTE {
+    const char* szName;       // NULL: the first one after the needle
+    char szValue[MAX_PATH_BUFFER_SIZE];
+    int found;
+};
+
+// FRAGREPORT sums up the extents of the files in one or more folders on a
+// drive, see fragmentation.cpp
+struct FRAGREPORT {
+    DWORD numFiles;
+    DWORD numFragmentedFiles; // more than one extent
+    ULONGLONG numExtents;
+    ULONGLONG bytes;
+    DWORD worstExtents;
+    char szWorstFile[MAX_PATH_BUFFER_SIZE];
+    DWORD clusterSize;        // 0: the free regions were not looked up yet
+    ULONGLONG largestFreeRun; // bytes, 0: unknown (needs administrator rights)
+    ULONGLONG numFreeRuns;
+};
+
+
+// PTOPTIONS holds the settings from "options.ini", next to "dlg.dat".
+// There is no dialog for them, the file is written with the defaults on
+// the first run.
+struct PTOPTIONS {
+    int compressRaw;          // pack finished raw-recordings
+    int deleteRawAfterPack;   // delete the recording after the packed file was verified
+    int packThreads;          // 0: one per core
+    int readAhead;            // read replayed recordings ahead of QIRX
+    int readAheadSeconds;
+    int reserveRawGB;         // placeholder in the external path, 0: none
+    int reserveAudGB;
+    int reserveEtiGB;
+    int tuneMaxSize;          // split raw-recordings on FAT drives
+    int fat32MaxSize;         // QIRX's maxSize there
+    char szSubfolders[4][64]; // per node, date template below the external path
+    int prewarm;              // spin the drive up when its path becomes current
+    int keepAwakeSeconds;     // 0: let the drive sleep
+    int identityPolicy[4];    // per node, IDP_...
+    int metricsPort;          // on 127.0.0.1, 0: no metrics
+    int traceSwitches;        // keep the phases of the path switches for trace.json
+    int configOpenRetries;    // opening QIRX's config-file
+    int configRetryMs;
+    int configSettleMs;       // the pause after each access
+};
 
 
 // MAINDLGSETTINGS contains the user-selected options for the dialog.
@@ -111,6 +388,178 @@ struct MAINDLGSETTINGS {
     char szExtEtiPath[MAX_PATH_BUFFER_SIZE];
 };
 
+// PATHPLAN switches a node to its external or original path at a time of
+// the day. The plans go to the config-file behind MAINDLGSETTINGS.
+struct PATHPLAN {
+    BYTE node;
+    BYTE target;              // PLAN_TO_EXTERNAL or PLAN_TO_ORIGINAL
+    BYTE days;                // bit 0: Sunday, 0: every day
+    BYTE enabled;
+    WORD minute;              // of the day, local time
+    WORD reserved;
+};
+
+struct PATHPLANS {
+    char magic[4];            // "PLAN"
+    DWORD numPlans;
+    PATHPLAN plans[PLAN_MAX];
+};
+
+// DRIVEIDENTITY tells the drive of an external path from others, see
+// drive_identity.cpp. The identities go to the config-file behind the
+// path plans.
+struct DRIVEIDENTITY {
+    DWORD serial;             // of the file system, the same as in MAINDLGSETTINGS
+    ULONGLONG serial64;       // NTFS and ReFS, 0: none
+    char szVolumeGuid[52];    // "\\?\Volume{...}\"
+    char szLabel[36];
+};
+
+struct DRIVEIDENTITIES {
+    char magic[4];            // "DRID"
+    DRIVEIDENTITY ids[4];     // per node
+};
+
+// VOLUMESOURCE is where ReadDriveIdentity() (drive_identity.cpp) looks:
+// the system, or the simulated drives of "-hotplug" (hotplug_sim.cpp).
+typedef int (*PFNVOLUMEIDENTITY)(void* param, const char* szPath, DRIVEIDENTITY* pId);
+
+struct VOLUMESOURCE {
+    PFNVOLUMEIDENTITY pfnIdentity; // returns 0 if the drive doesn't answer
+    void* param;
+};
+
+// SPACESNAPSHOT is what the other threads need to know about the current
+// paths. The dialog publishes it through SPACESEQLOCK, see snapshot.cpp.
+struct SPACESNAPSHOT {
+    DWORD generation;         // counts the path switches
+    int node;                 // selected in the dialog
+    DWORD changed[4];         // per node, the generation of its last new path
+    BYTE online[4];           // per node, the external drive is there
+    BYTE external[4];         // per node, the external path is the current one
+    char szPaths[4][MAX_PATH_BUFFER_SIZE]; // current, by NODE_...
+};
+
+struct SPACESEQLOCK {
+    volatile LONG sequence;   // odd while the dialog writes
+    SPACESNAPSHOT snap;
+};
+
+// NODESPACE is what DiskSpaceTick() found on the current path of a node.
+// The tick publishes them through SPACESTATUSLOCK.
+struct NODESPACE {
+    DWORD generation;         // of the snapshot sampled, 0: the drive didn't answer
+    ULONGLONG freeBytes;      // free for QIRX, with our placeholder
+    ULONGLONG totalBytes;
+    double writeSpeed;        // bytes per second, as shown in the dialog
+    double rate;              // bytes per second since the last tick, < 0: space was freed
+    ULONGLONG remSeconds;     // recording time left
+    DWORD volumeSerial;       // of the drive of the path
+    DWORD sampleMicros;       // GetDiskFreeSpaceEx() took
+};
+
+struct SPACESTATUS {
+    DWORD numTicks;
+    NODESPACE nodes[4];
+};
+
+struct SPACESTATUSLOCK {
+    volatile LONG sequence;   // odd while the tick writes
+    SPACESTATUS status;
+};
+
+// SPACEINPUT is where the estimator of the disk space display takes its
+// time and free space from: the system for DiskSpaceTick(), a trace for
+// "-spacereplay" (space_replay.cpp).
+typedef void (*PFNSPACECLOCK)(void* param, LARGE_INTEGER* pNow);
+typedef BOOL (*PFNSPACEQUERY)(void* param, const char* szPath, ULARGE_INTEGER* pFree, ULARGE_INTEGER* pTotal);
+typedef DWORD (*PFNSPACESERIAL)(void* param, char* szPath);
+
+struct SPACEINPUT {
+    double tickPeriod;        // seconds per tick of the clock
+    PFNSPACECLOCK pfnClock;
+    PFNSPACEQUERY pfnQuery;   // free for QIRX, with our placeholder
+    PFNSPACESERIAL pfnSerial;
+    void* param;
+};
+
+struct MOVINGAVERAGEARRAY {
+    double* pArrayValues;
+    unsigned int arrayInsertIndex;
+    unsigned int numElements;
+};
+
+// NODESAMPLER is the state of the estimator for the current path of a
+// node, see SampleNode()
+struct NODESAMPLER {
+    char szPath[MAX_PATH_BUFFER_SIZE]; // sampled last time
+    int displayCounter;
+    LARGE_INTEGER liOldTime;
+    ULARGE_INTEGER ullOldSpace;
+    MOVINGAVERAGEARRAY speedAvgArr, displaySpeedAvgArr;
+    LARGE_INTEGER liLastTick;
+    ULARGE_INTEGER ullLastSpace;
+    DWORD volumeSerial;
+    DWORD changed;            // SPACESNAPSHOT.changed of the path sampled
+};
+
+// SAMPLERECORD is a sample of the disk space in the ring file, see
+// sample_ring.cpp
+#define SAMPLE_EXTERNAL 1         // the external path was the current one
+#define SAMPLE_STALL    2         // the drive took SPACE_STALL_MS or more
+
+struct SAMPLERECORD {             // 64 bytes
+    volatile LONG64 sequence;     // n + 1, 0: being written
+    ULONGLONG time;               // FILETIME, UTC
+    ULONGLONG freeBytes;
+    ULONGLONG totalBytes;
+    double rate;                  // bytes per second since the last sample
+    double avgRate;               // the write speed of the dialog
+    DWORD volumeSerial;
+    DWORD sampleMicros;
+    BYTE node;
+    BYTE flags;                   // SAMPLE_...
+    WORD reserved;
+    DWORD reserved2;
+};
+
+// Called by WalkSampleRing() with NULL once the file is found good, then
+// for each record. Returns 1 if it took the record.
+typedef int (*PFNSAMPLEPROC)(const SAMPLERECORD* pRec, void* param);
+
+// PTCOUNTERS count what happens, where it happens. The metrics exporter
+// renders them once a second, see metrics.cpp.
+struct PTCOUNTERS {
+    volatile LONG64 configWrites;       // ProcessQirxXMLFile(), on the dialog's thread
+    volatile LONG64 configWriteFailures;
+    volatile LONG64 configWriteMicros;  // the sum
+    volatile LONG64 configWriteMaxMicros;
+    volatile LONG64 configOpenRetries;  // QIRX's config-file was in use
+    volatile LONG64 pathSwitches;       // current paths changed, see PublishSpaceSnapshot()
+    volatile LONG64 lockReads;          // SeqRead() of the snapshots
+    volatile LONG64 lockRetries;
+    volatile LONG64 driveArrivals;      // device events
+    volatile LONG64 driveRemovals;
+    volatile LONG64 spaceStalls;        // a drive took SPACE_STALL_MS or more for its free space
+    volatile LONG64 spaceFailures;      // or didn't answer at all
+};
+
+// LATENCYHISTO counts the times of one phase of the path switches in
+// buckets of about 6 percent, without a lock, see latency.cpp.
+struct LATENCYHISTO {
+    volatile LONG64 count;
+    volatile LONG64 sumMicros;
+    volatile LONG64 maxMicros;
+    volatile LONG buckets[LAT_BUCKETS];
+};
+
+struct LATENCYSUMMARY {
+    LONG64 count;
+    LONG64 sumMicros;
+    LONG64 maxMicros;
+    LONG64 p50, p90, p99;     // upper end of the bucket
+};
+
 struct PATHTWEAKERMEM {
     char szOriginalRawPath[MAX_PATH_BUFFER_SIZE];
     char szOriginalAudPath[MAX_PATH_BUFFER_SIZE];
@@ -120,25 +569,48 @@ struct PATHTWEAKERMEM {
     char szCurrentAudPath[MAX_PATH_BUFFER_SIZE];
     char szCurrentTiiPath[MAX_PATH_BUFFER_SIZE];
     char szCurrentEtiPath[MAX_PATH_BUFFER_SIZE];
+    char szOriginalRawMaxSize[16];
     char szLocalAppDataBasePath[MAX_PATH_BUFFER_SIZE];
     char szDlgFullConfigFileName[MAX_PATH_BUFFER_SIZE];
     char szQirxFullConfigFileName[MAX_PATH_BUFFER_SIZE];
     char szQirxFullConfigBackupFileName[MAX_PATH_BUFFER_SIZE];
+    char szOptionsFileName[MAX_PATH_BUFFER_SIZE];
+    char szTiiStoreFileName[MAX_PATH_BUFFER_SIZE];
+    char szDedupReportFileName[MAX_PATH_BUFFER_SIZE];
+    char szSpinupReportFileName[MAX_PATH_BUFFER_SIZE];
+    char szDaemonLogFileName[MAX_PATH_BUFFER_SIZE];
+    char szSampleRingFileName[MAX_PATH_BUFFER_SIZE];
+    char szTraceFileName[MAX_PATH_BUFFER_SIZE];
     char szQirxVersion[16];
     char szMyWindowTitle[16]; 
     int  haveAppDataBasePath;
     int  haveDlgConfig;
     int  haveQirxConfig;
+    int  headless;            // HEADLESS_..., 0 for the dialog
+    int  station;             // index of the module state, see stations.cpp
     int  labelWidth;
 
     HWND hWndDialog;
     HWND hWndLbRemRecTime;
     HWND hWndLbWriteSpeed;
     HWND hWndCbNodeSel;
-    HANDLE hWaitPathSwitch;
-    HANDLE hDiskSpaceThread;
+    HANDLE hPostRecordingThread;
+    HANDLE hPrefetchThread;
+    HANDLE hReserveThread;
+    HANDLE hPrewarmThread;
+    HANDLE hControlThread;
+    HANDLE hMetricsThread;
+    volatile LONG numEngineThreads; // still running, see CreateEngineThread()
     MAINDLGSETTINGS mDlgSet;
+    PATHPLANS plans;
+    DRIVEIDENTITIES driveIds;
+    SPACESEQLOCK spaceSnap;
+    SPACESTATUSLOCK spaceStatus;
+    PTCOUNTERS counters;
+    LATENCYHISTO latency[LAT_PHASES];
+    PTOPTIONS opt;
     int finishThread;
+    int postRecordingBusy;
     int currentNodeSelection;
     int flagRawDriveOnline;
     int flagAudDriveOnline;
@@ -148,7 +620,13 @@ struct PATHTWEAKERMEM {
     int flagAudDriveSet;
     int flagTiiDriveSet;
     int flagEtiDriveSet;
-    int flagNewPath;
     int flagIsQ5;
+    int nodeProbing[4];       // the startup probe is still out
+    int nodePending[4];       // the user is asked about the drive
 };
-inline PATHTWEAKERMEM* pPTM;
+
+// The memory of the station (the QIRX config) the thread works for. There
+// is only station 0 without "-stations" (stations.cpp). A thread from
+// CreateEngineThread() (engine.cpp) works for the station of its creator,
+// the SchedulerThread sets it for each timer, a worker has its station's.
+inline thread_local PATHTWEAKERMEM* pPTM;
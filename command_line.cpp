@@ -0,0 +1,453 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+extern int ProcessQirxXMLFile(char* szInOutNodeContent, const char* nodeNeedle, int configReadWrite);
+extern int CheckPathExists(char* path);
+extern int EtiIndexFile(const char* szFileName, ETIINDEXHEADER* pHdr, volatile int* pCancel);
+extern int EtiIndexFolder(const char* szFolder, volatile int* pCancel);
+extern void EtiBenchmark(int megaBytes);
+extern int IqScanFile(const char* szFileName, IQSUMMARYHEADER* pHdr, volatile int* pCancel, int background);
+extern int IqScanFolder(const char* szFolder, volatile int* pCancel);
+extern void IqBenchmark(int megaBytes);
+extern int RawPackFile(const char* szFileName, RAWZHEADER* pHdr, volatile int* pCancel, int background,
+    int numThreads, int deleteRaw);
+extern int RawUnpackFile(const char* szPacked, const char* szOut);
+extern void RawPackBenchmark(int megaBytes);
+extern void ConfigBenchmark(int runs);
+extern int CmdFakeQirx(int argc, char** argv);
+extern int CmdQirxSim(int argc, char** argv);
+extern int TiiIngestFolders(const char (*szFolders)[MAX_PATH_BUFFER_SIZE], int numFolders, volatile int* pCancel);
+extern int CmdTiiQuery(int argc, char** argv);
+extern int DedupCollection(const char (*szFolders)[MAX_PATH_BUFFER_SIZE], int numFolders, int action,
+    volatile int* pCancel);
+extern int FragAnalyzeFolder(const char* szFolder, FRAGREPORT* pRep, int listFiles, volatile int* pCancel);
+extern void FragFormatReport(const char* szName, const FRAGREPORT* pRep, char* szOut);
+extern int FragIsBad(const FRAGREPORT* pRep);
+extern int GetLayoutWarning(const char* szPath, char* szWarning);
+extern int ReadDlgConfigFile();
+extern int CmdPathPlan(int argc, char** argv);
+extern void SnapshotStress(int seconds);
+extern void CmdDaemon(const char* szArg);
+extern int IsQirxVersionArg(const char* szArg);
+extern void CmdStations(const char* szArg);
+extern void CmdControl(int argc, char** argv);
+extern int CmdSamples(int argc, char** argv);
+extern int CmdSpaceReplay(int argc, char** argv);
+extern int CmdHotplug(int argc, char** argv);
+extern int ForEachRecording(const char* szFolder, const char* szExt, PFNRECORDINGPROC pfnRecording,
+    volatile int* pCancel);
+
+static volatile int neverCancel;
+
+
+// PathTweaker is a GUI program without a console. If started from a command
+// prompt, we print into the console of the caller. Use "start /wait" there,
+// otherwise the prompt comes back before we are done.
+// Output to a file or a pipe ("> samples.csv") stays there
+void AttachParentConsole() {
+    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    int redirected = hOut && INVALID_HANDLE_VALUE != hOut && FILE_TYPE_CHAR != GetFileType(hOut);
+
+    if (AttachConsole(ATTACH_PARENT_PROCESS)) {
+        if (!redirected) {
+            freopen("CONOUT$", "w", stdout);
+            printf("\n");
+        }
+        freopen("CONOUT$", "w", stderr);
+    }
+}
+
+void CmdEtiIndex(char* szArg) {
+    char szPath[MAX_PATH_BUFFER_SIZE]{};
+    ETIINDEXHEADER hdr;
+    int count;
+
+    if (szArg) {
+        if (lstrlen(szArg) >= MAX_PATH_BUFFER_SIZE) {
+            printf("Path too long.\n");
+            return;
+        }
+        lstrcpyn(szPath, szArg, MAX_PATH_BUFFER_SIZE);
+    }
+    else if (!pPTM->haveQirxConfig || !pPTM->flagIsQ5 ||
+        !ProcessQirxXMLFile(szPath, needleEtiOut, CONFIG_READ)) {
+        printf("No ETI path found in QIRX's config-file.\n");
+        return;
+    }
+
+    if (CheckPathExists(szPath)) {
+        count = EtiIndexFolder(szPath, &neverCancel);
+        printf("%s: %d new index file(s) written.\n", szPath, count);
+    }
+    else if (EtiIndexFile(szPath, &hdr, &neverCancel)) {
+        printf("%s\n%lu frames (%.1f s), %lu dropped, %lu gaps, %lu CRC errors, %lu flagged by the receiver\n",
+            szPath, hdr.numFrames, hdr.numLogicalFrames * 0.024,
+            hdr.numLogicalFrames - hdr.numFrames, hdr.numGaps,
+            hdr.numCorrupted, hdr.numErrFlagged);
+    }
+    else
+        printf("%s: not found, empty or still in use.\n", szPath);
+}
+
+void CmdIqScan(char* szArg) {
+    char szPath[MAX_PATH_BUFFER_SIZE]{};
+    IQSUMMARYHEADER hdr;
+    int count;
+
+    if (szArg) {
+        if (lstrlen(szArg) >= MAX_PATH_BUFFER_SIZE) {
+            printf("Path too long.\n");
+            return;
+        }
+        lstrcpyn(szPath, szArg, MAX_PATH_BUFFER_SIZE);
+    }
+    else if (!pPTM->haveQirxConfig || !ProcessQirxXMLFile(szPath, needleRawOut, CONFIG_READ)) {
+        printf("No RAW path found in QIRX's config-file.\n");
+        return;
+    }
+
+    if (CheckPathExists(szPath)) {
+        count = IqScanFolder(szPath, &neverCancel);
+        printf("%s: %d new summary file(s) written.\n", szPath, count);
+    }
+    else if (IqScanFile(szPath, &hdr, &neverCancel, 0)) {
+        printf("%s\nDC offset I %+.4f, Q %+.4f, power %.1f dBFS (median %.1f), %lu silent blocks\n"
+            "%llu clipped samples, %lu dropouts with %llu zero bytes\n",
+            szPath, hdr.dcI, hdr.dcQ, hdr.powerDb, hdr.medianPowerDb, hdr.numSilent,
+            hdr.numClipped, hdr.numDropouts, hdr.numZeroBytes);
+    }
+    else
+        printf("%s: not found, empty or still in use.\n", szPath);
+}
+
+// The originals are never deleted from here, whatever "options.ini" says
+int PackNoDelete(const char* szFileName, ULONGLONG fileSize, volatile int* pCancel) {
+    RAWZHEADER hdr;
+
+    if (!RawPackFile(szFileName, &hdr, pCancel, 0, pPTM->opt.packThreads, 0))
+        return 0;
+    printf("%s: %llu bytes, ratio %.3f\n", szFileName, hdr.rawSize,
+        (double)hdr.rawSize / hdr.indexOffset); // the index is just 16 bytes per chunk
+    return 1;
+}
+
+void CmdRawPack(char* szArg) {
+    char szPath[MAX_PATH_BUFFER_SIZE]{};
+    int count;
+
+    if (szArg) {
+        if (lstrlen(szArg) >= MAX_PATH_BUFFER_SIZE) {
+            printf("Path too long.\n");
+            return;
+        }
+        lstrcpyn(szPath, szArg, MAX_PATH_BUFFER_SIZE);
+    }
+    else if (!pPTM->haveQirxConfig || !ProcessQirxXMLFile(szPath, needleRawOut, CONFIG_READ)) {
+        printf("No RAW path found in QIRX's config-file.\n");
+        return;
+    }
+
+    if (CheckPathExists(szPath)) {
+        count = ForEachRecording(szPath, szRawExt, PackNoDelete, &neverCancel);
+        printf("%s: %d file(s) packed.\n", szPath, count);
+    }
+    else if (!PackNoDelete(szPath, 0, &neverCancel))
+        printf("%s: not found, empty, still in use or no space left.\n", szPath);
+}
+
+void CmdRawUnpack(char* szArg) {
+    char szOut[MAX_PATH_BUFFER_SIZE];
+    int len;
+
+    len = szArg ? lstrlen(szArg) : 0;
+    if (len <= 5 || len >= MAX_PATH_BUFFER_SIZE || lstrcmpi(szArg + len - 5, szPackExt)) {
+        printf("%s", szMsgUsage);
+        return;
+    }
+    lstrcpyn(szOut, szArg, MAX_PATH_BUFFER_SIZE);
+    lstrcpy(szOut + len - 5, szRawExt);
+
+    if (RawUnpackFile(szArg, szOut))
+        printf("%s written.\n", szOut);
+    else
+        printf("%s: damaged or %s exists already.\n", szArg, szOut);
+}
+
+void CmdTiiIngest(char* szArg) {
+    char szPath[1][MAX_PATH_BUFFER_SIZE]{};
+    int count;
+
+    if (szArg) {
+        if (lstrlen(szArg) >= MAX_PATH_BUFFER_SIZE) {
+            printf("Path too long.\n");
+            return;
+        }
+        lstrcpyn(szPath[0], szArg, MAX_PATH_BUFFER_SIZE);
+    }
+    else if (!pPTM->haveQirxConfig || !ProcessQirxXMLFile(szPath[0], needleTiiLog, CONFIG_READ)) {
+        printf("No TII path found in QIRX's config-file.\n");
+        return;
+    }
+
+    if (!CheckPathExists(szPath[0])) {
+        printf("%s: folder not found.\n", szPath[0]);
+        return;
+    }
+    count = TiiIngestFolders(szPath, 1, &neverCancel);
+    if (count < 0)
+        printf("%s: can't write.\n", pPTM->szTiiStoreFileName);
+    else
+        printf("%s: %d new row(s).\n", szPath[0], count);
+}
+
+#define DEDUP_MAX_FOLDERS 24
+
+int AddDedupFolder(char (*szFolders)[MAX_PATH_BUFFER_SIZE], int num, char* szFolder) {
+    if (num >= DEDUP_MAX_FOLDERS || lstrlen(szFolder) >= MAX_PATH_BUFFER_SIZE || !CheckPathExists(szFolder))
+        return num;
+    for (int i = 0; i < num; i++)
+        if (!lstrcmpi(szFolders[i], szFolder))
+            return num;
+    lstrcpyn(szFolders[num], szFolder, MAX_PATH_BUFFER_SIZE);
+    return num + 1;
+}
+
+// The paths in QIRX's config-file, our external paths and the folders
+// given on the command line
+void CmdDedup(int argc, char** argv) {
+    static char szFolders[DEDUP_MAX_FOLDERS][MAX_PATH_BUFFER_SIZE];
+    char szPath[MAX_PATH_BUFFER_SIZE];
+    const char* needles[4] = { needleRawOut, needleAudOut, needleTiiLog, needleEtiOut };
+    int action = DEDUP_REPORT, num = 0;
+
+    if (argc && !lstrcmpi(argv[0], "link")) {
+        action = DEDUP_LINK;
+        argc--;
+        argv++;
+    }
+    else if (argc && !lstrcmpi(argv[0], "delete")) {
+        action = DEDUP_DELETE;
+        argc--;
+        argv++;
+    }
+
+    for (int i = 0; i < 4 && pPTM->haveQirxConfig; i++) {
+        if (NODE_ETI == i && !pPTM->flagIsQ5)
+            break;
+        szPath[0] = 0;
+        if (ProcessQirxXMLFile(szPath, needles[i], CONFIG_READ))
+            num = AddDedupFolder(szFolders, num, szPath);
+    }
+    if (ReadDlgConfigFile()) {
+        num = AddDedupFolder(szFolders, num, pPTM->mDlgSet.szExtRawPath);
+        num = AddDedupFolder(szFolders, num, pPTM->mDlgSet.szExtAudPath);
+        num = AddDedupFolder(szFolders, num, pPTM->mDlgSet.szExtTiiPath);
+        num = AddDedupFolder(szFolders, num, pPTM->mDlgSet.szExtEtiPath);
+    }
+    for (int i = 0; i < argc; i++)
+        num = AddDedupFolder(szFolders, num, argv[i]);
+
+    if (!num)
+        printf("No recording folders found.\n");
+    else
+        DedupCollection(szFolders, num, action, &neverCancel);
+}
+
+// The folders are given by node name or path, without any the paths in
+// QIRX's config-file and our external paths. One report per drive.
+void CmdFragCheck(int argc, char** argv) {
+    static char szFolders[DEDUP_MAX_FOLDERS][MAX_PATH_BUFFER_SIZE];
+    static FRAGREPORT reps[26];
+    const char* needles[4] = { needleRawOut, needleAudOut, needleTiiLog, needleEtiOut };
+    const char* nodeNames[4] = { "raw", "aud", "tii", "eti" };
+    char szPath[MAX_PATH_BUFFER_SIZE], szName[8], buff[MAX_PATH_BUFFER_SIZE + 384];
+    char szWarning[LAYOUT_WARNING_SIZE];
+    int node, letter, num = 0;
+
+    for (int i = 0; i < argc; i++) {
+        for (node = 0; node < 4; node++)
+            if (!lstrcmpi(argv[i], nodeNames[node]))
+                break;
+        if (node < 4) {
+            szPath[0] = 0;
+            if (pPTM->haveQirxConfig && ProcessQirxXMLFile(szPath, needles[node], CONFIG_READ))
+                num = AddDedupFolder(szFolders, num, szPath);
+        }
+        else
+            num = AddDedupFolder(szFolders, num, argv[i]);
+    }
+
+    if (!argc) {
+        for (node = 0; node < 4 && pPTM->haveQirxConfig; node++) {
+            if (NODE_ETI == node && !pPTM->flagIsQ5)
+                break;
+            szPath[0] = 0;
+            if (ProcessQirxXMLFile(szPath, needles[node], CONFIG_READ))
+                num = AddDedupFolder(szFolders, num, szPath);
+        }
+        if (ReadDlgConfigFile()) {
+            num = AddDedupFolder(szFolders, num, pPTM->mDlgSet.szExtRawPath);
+            num = AddDedupFolder(szFolders, num, pPTM->mDlgSet.szExtAudPath);
+            num = AddDedupFolder(szFolders, num, pPTM->mDlgSet.szExtTiiPath);
+            num = AddDedupFolder(szFolders, num, pPTM->mDlgSet.szExtEtiPath);
+        }
+    }
+
+    if (!num) {
+        printf("No recording folders found.\n");
+        return;
+    }
+
+    // the fragmented files, then the drives
+    for (int i = 0; i < num; i++) {
+        letter = (szFolders[i][0] | 0x20) - 'a';
+        if (szFolders[i][1] != ':' || letter < 0 || letter >= 26)
+            continue;
+        FragAnalyzeFolder(szFolders[i], &reps[letter], 1, &neverCancel);
+    }
+    for (letter = 0; letter < 26; letter++) {
+        if (!reps[letter].clusterSize)
+            continue;
+        sprintf(szName, "\n%c:", 'A' + letter);
+        FragFormatReport(szName, &reps[letter], buff);
+        printf("%s", buff);
+        if (reps[letter].worstExtents > 1)
+            printf("most extents: %lu in %s\n", reps[letter].worstExtents, reps[letter].szWorstFile);
+        if (FragIsBad(&reps[letter]))
+            printf("Too fragmented for recordings, defragment it.\n");
+        sprintf(szName, "%c:\\", 'A' + letter);
+        if (GetLayoutWarning(szName, szWarning))
+            printf("%s\n", szWarning);
+    }
+}
+
+
+// Returns 1 if there was a command on the command line. The dialog does
+// not start in this case.
+int ProcessCommandLine() {
+    int ret = 0;
+
+    if (__argc < 2)
+        return ret;
+
+    // WinMain runs the engine without the dialog, see daemon.cpp. The
+    // version of "-daemon qirxN" was taken by GetQirxVersionString().
+    if (!lstrcmpi(__argv[1], "-daemon") && (__argc == 2 || IsQirxVersionArg(__argv[2]))) {
+        pPTM->headless = HEADLESS_DAEMON;
+        return ret;
+    }
+
+    AttachParentConsole();
+    ret++;
+
+    if (!lstrcmpi(__argv[1], "-etiindex"))
+        CmdEtiIndex(__argc > 2 ? __argv[2] : NULL);
+
+    else if (!lstrcmpi(__argv[1], "-etibench"))
+        EtiBenchmark(__argc > 2 ? atoi(__argv[2]) : 256);
+
+    else if (!lstrcmpi(__argv[1], "-iqscan"))
+        CmdIqScan(__argc > 2 ? __argv[2] : NULL);
+
+    else if (!lstrcmpi(__argv[1], "-iqbench"))
+        IqBenchmark(__argc > 2 ? atoi(__argv[2]) : 1024);
+
+    else if (!lstrcmpi(__argv[1], "-rawpack"))
+        CmdRawPack(__argc > 2 ? __argv[2] : NULL);
+
+    else if (!lstrcmpi(__argv[1], "-rawunpack"))
+        CmdRawUnpack(__argc > 2 ? __argv[2] : NULL);
+
+    else if (!lstrcmpi(__argv[1], "-packbench"))
+        RawPackBenchmark(__argc > 2 ? atoi(__argv[2]) : 256);
+
+    else if (!lstrcmpi(__argv[1], "-cfgbench"))
+        ConfigBenchmark(__argc > 2 ? atoi(__argv[2]) : 0);
+
+    else if (!lstrcmpi(__argv[1], "-fakeqirx")) {
+        if (!CmdFakeQirx(__argc - 2, __argv + 2))
+            printf("%s", szMsgUsage);
+    }
+
+    else if (!lstrcmpi(__argv[1], "-qirxsim")) {
+        if (!CmdQirxSim(__argc - 2, __argv + 2))
+            printf("%s", szMsgUsage);
+    }
+
+    else if (!lstrcmpi(__argv[1], "-tiiingest"))
+        CmdTiiIngest(__argc > 2 ? __argv[2] : NULL);
+
+    else if (!lstrcmpi(__argv[1], "-tiiquery")) {
+        if (!CmdTiiQuery(__argc - 2, __argv + 2))
+            printf("%s", szMsgUsage);
+    }
+
+    else if (!lstrcmpi(__argv[1], "-dedup"))
+        CmdDedup(__argc - 2, __argv + 2);
+
+    else if (!lstrcmpi(__argv[1], "-fragcheck"))
+        CmdFragCheck(__argc - 2, __argv + 2);
+
+    else if (!lstrcmpi(__argv[1], "-plan")) {
+        if (!CmdPathPlan(__argc - 2, __argv + 2))
+            printf("%s", szMsgUsage);
+    }
+
+    else if (!lstrcmpi(__argv[1], "-daemon"))
+        CmdDaemon(__argv[2]);
+
+    else if (!lstrcmpi(__argv[1], "-stations"))
+        CmdStations(__argv[2]);
+
+    else if (!lstrcmpi(__argv[1], "-ctl"))
+        CmdControl(__argc - 2, __argv + 2);
+
+    else if (!lstrcmpi(__argv[1], "-samples")) {
+        if (!CmdSamples(__argc - 2, __argv + 2))
+            printf("%s", szMsgUsage);
+    }
+
+    else if (!lstrcmpi(__argv[1], "-spacereplay")) {
+        if (!CmdSpaceReplay(__argc - 2, __argv + 2))
+            printf("%s", szMsgUsage);
+    }
+
+    else if (!lstrcmpi(__argv[1], "-hotplug")) {
+        if (!CmdHotplug(__argc - 2, __argv + 2))
+            printf("%s", szMsgUsage);
+    }
+
+    else if (!lstrcmpi(__argv[1], "-snapstress"))
+        SnapshotStress(__argc > 2 ? atoi(__argv[2]) : 10);
+
+    else
+        printf("%s", szMsgUsage);
+
+    fflush(stdout);
+    return ret;
+}
@@ -0,0 +1,368 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+// "-cfgbench [runs]" measures the rewrites of QIRX's config-file on
+// generated files in a folder for temporary files, never on QIRX's own one.
+// The files are of a typical size (24 KiB) and of pathological ones (1 and
+// 16 MiB), with the nodes of the paths near the start or near the end. The
+// paths written take turns between a short and a long one (250 characters),
+// so the rest of the file moves each time.
+//
+// "read" is ProcessQirxXMLNode() reading the raw-path, "write" one path and
+// "multi" all four of them, as for a drive carrying all the paths. The
+// writes run with three strategies:
+//   tail     ProcessQirxXMLNode(), the part from the first change on
+//   inplace  the whole file through the same handle
+//   atomic   a new file, renamed over the old one
+// The pause after each access ("SettleMs") is left out, it is the same for
+// all of them. Each case runs alone and with a competitor standing in for
+// QIRX: a thread which waits for a change of the file, opens it the way
+// QIRX does, reads it and keeps it open for CFGBENCH_HOLD_MS.
+//
+// The results go to stdout as CSV, a line per case, so they can be kept
+// and compared: the times in microseconds, the MB of the file per
+// second, the opens (and renames) of ours which found the file in use, the
+// opens of the competitor which failed (QIRX would give up there) and the
+// accesses which failed or left a wrong value.
+
+#define CFGBENCH_RUNS     200
+#define CFGBENCH_HOLD_MS  2
+#define CFGBENCH_POLL_MS  20   // the competitor reads now and then, too
+#define CFGBENCH_SHORT    "C:\\Users\\User\\AppData\\Local/qirx4/Raw/"
+
+#define STRATEGY_TAIL     0
+#define STRATEGY_INPLACE  1
+#define STRATEGY_ATOMIC   2
+
+extern int ProcessQirxXMLNode(const char* nodeNeedle, QIRXATTRIBUTE* pAttribs, int numAttribs, int configReadWrite);
+extern int ProcessConfigContent(char* pFileContent, SIZE_T* pLen, DWORD* pFirstChange, const char* nodeNeedle,
+    QIRXATTRIBUTE* pAttribs, int numAttribs, int configReadWrite);
+extern HANDLE CreateEngineThread(LPTHREAD_START_ROUTINE pfnThread, LPVOID param);
+
+struct BENCHCASE {
+    const char* szName;
+    DWORD size;
+    int nodesAtEnd;
+    int runsDivisor;          // fewer runs for the large files
+};
+
+static const BENCHCASE benchCases[] = {
+    { "typical", 24 * 1024, 0, 1 },
+    { "typical", 24 * 1024, 1, 1 },
+    { "large", 1024 * 1024, 0, 4 },
+    { "large", 1024 * 1024, 1, 4 },
+    { "huge", 16 * 1024 * 1024, 1, 40 },
+};
+
+static const char* needles[4] = { needleRawOut, needleAudOut, needleTiiLog, needleEtiOut };
+static const char* szStrategies[3] = { "tail", "inplace", "atomic" };
+
+static char szBenchFolder[MAX_PATH_BUFFER_SIZE];
+static char szBenchNew[MAX_PATH_BUFFER_SIZE + 8];
+static volatile LONG competitorStop;
+static volatile LONG64 competitorFailures;
+
+
+// Some thousand settings of QIRX, with the nodes of the paths in between
+int MakeBenchConfig(const char* szFile, DWORD size, int nodesAtEnd) {
+    char* pBuf;
+    DWORD len, dNumBytes, item = 0, nodesAt;
+    HANDLE hFile;
+    int ret = 0;
+
+    pBuf = (char*)VCALLOC(size + 1024);
+    if (!pBuf)
+        return ret;
+    len = sprintf(pBuf, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<configuration>\r\n  <settings>\r\n");
+    nodesAt = nodesAtEnd ? size - 600 : len + 200;
+    while (len < size - 40) {
+        if (len >= nodesAt && nodesAt) {
+            len += sprintf(pBuf + len,
+                "    <rawOut value=\"%s\" maxSize=\"0\" />\r\n"
+                "    <DAB value=\"%s\" />\r\n"
+                "    <TIILogger value=\"%s\" />\r\n"
+                "    <ETI value=\"%s\" />\r\n", CFGBENCH_SHORT, CFGBENCH_SHORT, CFGBENCH_SHORT, CFGBENCH_SHORT);
+            nodesAt = 0;
+        }
+        else
+            len += sprintf(pBuf + len, "    <setting name=\"Item%06lu\" value=\"%08lX\" />\r\n", item,
+                item * 2654435761u);
+        item++;
+    }
+    len += sprintf(pBuf + len, "  </settings>\r\n</configuration>\r\n");
+
+    hFile = CreateFile(szFile, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
+    if (INVALID_HANDLE_VALUE != hFile) {
+        if (WriteFile(hFile, pBuf, len, &dNumBytes, NULL) && dNumBytes == len)
+            ret++;
+        CloseHandle(hFile);
+    }
+    VFREE(pBuf);
+    return ret;
+}
+
+// Stands in for QIRX: reads the file after each change (and now and then)
+DWORD WINAPI CompetitorThread(LPVOID param) {
+    HANDLE hChange, hFile;
+    DWORD dNumBytes;
+    char* pBuf = (char*)param;
+
+    hChange = FindFirstChangeNotification(szBenchFolder, FALSE,
+        FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE);
+    if (INVALID_HANDLE_VALUE == hChange)
+        return 0;
+    while (!competitorStop) {
+        WaitForSingleObject(hChange, CFGBENCH_POLL_MS);
+        hFile = CreateFile(pPTM->szQirxFullConfigFileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN, 0);
+        if (INVALID_HANDLE_VALUE == hFile)
+            InterlockedIncrement64(&competitorFailures);
+        else {
+            ReadFile(hFile, pBuf, 16 * 1024 * 1024 + 65536, &dNumBytes, NULL);
+            Sleep(CFGBENCH_HOLD_MS);
+            CloseHandle(hFile);
+        }
+        FindNextChangeNotification(hChange);
+    }
+    FindCloseChangeNotification(hChange);
+    return 0;
+}
+
+// "inplace" and "atomic", with the same retries as ProcessQirxXMLNode()
+int BenchRewrite(int strategy, const char* nodeNeedle, QIRXATTRIBUTE* pAttrib) {
+    HANDLE hfi, hNew;
+    DWORD dNumBytes, dFirstChange;
+    LARGE_INTEGER liFileSize{};
+    SIZE_T len;
+    char* pFileContent;
+    int retryCount, ret = 0;
+
+    pAttrib->found = 0;
+    retryCount = pPTM->opt.configOpenRetries;
+    do {
+        hfi = CreateFile(pPTM->szQirxFullConfigFileName, GENERIC_READ | GENERIC_WRITE, 0, 0, OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN, 0);
+        retryCount--;
+        if (INVALID_HANDLE_VALUE == hfi) {
+            InterlockedIncrement64(&pPTM->counters.configOpenRetries);
+            Sleep(pPTM->opt.configRetryMs);
+        }
+    } while (INVALID_HANDLE_VALUE == hfi && retryCount > 0);
+    if (INVALID_HANDLE_VALUE == hfi)
+        return ret;
+
+    GetFileSizeEx(hfi, &liFileSize);
+    pFileContent = (char*)VCALLOC(liFileSize.LowPart + 1 + MAX_PATH_BUFFER_SIZE);
+    if (!pFileContent) {
+        CloseHandle(hfi);
+        return ret;
+    }
+    ReadFile(hfi, pFileContent, liFileSize.LowPart, &dNumBytes, NULL);
+    len = dNumBytes;
+    ret = ProcessConfigContent(pFileContent, &len, &dFirstChange, nodeNeedle, pAttrib, 1, CONFIG_WRITE);
+
+    if (STRATEGY_INPLACE == strategy) {
+        SetFilePointer(hfi, 0, NULL, FILE_BEGIN);
+        WriteFile(hfi, pFileContent, (DWORD)len, &dNumBytes, NULL);
+        SetEndOfFile(hfi);
+        CloseHandle(hfi);
+    }
+    else {
+        // atomic for the readers, not for a power cut (no flush)
+        CloseHandle(hfi);
+        hNew = CreateFile(szBenchNew, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+        if (INVALID_HANDLE_VALUE == hNew)
+            ret = 0;
+        else {
+            WriteFile(hNew, pFileContent, (DWORD)len, &dNumBytes, NULL);
+            CloseHandle(hNew);
+            retryCount = pPTM->opt.configOpenRetries;
+            while (!MoveFileEx(szBenchNew, pPTM->szQirxFullConfigFileName, MOVEFILE_REPLACE_EXISTING)) {
+                InterlockedIncrement64(&pPTM->counters.configOpenRetries);
+                if (--retryCount <= 0) {
+                    ret = 0;
+                    break;
+                }
+                Sleep(pPTM->opt.configRetryMs);
+            }
+        }
+    }
+    VFREE(pFileContent);
+    return ret;
+}
+
+int BenchWrite(int strategy, int node, const char* szValue) {
+    QIRXATTRIBUTE attrib{};
+
+    lstrcpyn(attrib.szValue, szValue, MAX_PATH_BUFFER_SIZE);
+    if (STRATEGY_TAIL == strategy)
+        return ProcessQirxXMLNode(needles[node], &attrib, 1, CONFIG_WRITE);
+    return BenchRewrite(strategy, needles[node], &attrib);
+}
+
+int CompareMicros(const void* a, const void* b) {
+    LONG64 x = *(const LONG64*)a, y = *(const LONG64*)b;
+    return x < y ? -1 : x > y;
+}
+
+// One line of results. op 0: read, 1: write, 2: multi.
+void RunBenchCase(const BENCHCASE* pCase, int contention, int op, int strategy, int runs,
+    const char* szLongPath, LONG64* pMicros) {
+    QIRXATTRIBUTE attrib{};
+    LARGE_INTEGER qpf, liStart, liEnd;
+    LONG64 sum = 0, retries, compFailures;
+    const char* szValue;
+    char szCheck[MAX_PATH_BUFFER_SIZE];
+    int bad = 0;
+    static const char* szOps[3] = { "read", "write", "multi" };
+
+    QueryPerformanceFrequency(&qpf);
+    retries = pPTM->counters.configOpenRetries;
+    compFailures = competitorFailures;
+
+    for (int run = 0; run < runs; run++) {
+        szValue = run & 1 ? szLongPath : CFGBENCH_SHORT;
+        QueryPerformanceCounter(&liStart);
+        if (0 == op) {
+            if (!ProcessQirxXMLNode(needleRawOut, &attrib, 1, CONFIG_READ))
+                bad++;
+        }
+        else if (1 == op) {
+            if (!BenchWrite(strategy, NODE_RAW, szValue))
+                bad++;
+        }
+        else {
+            for (int node = 0; node < 4; node++)
+                if (!BenchWrite(strategy, node, szValue))
+                    bad++;
+        }
+        QueryPerformanceCounter(&liEnd);
+        pMicros[run] = (liEnd.QuadPart - liStart.QuadPart) * 1000000 / qpf.QuadPart;
+        sum += pMicros[run];
+    }
+
+    // the last value written must be there
+    if (op) {
+        lstrcpyn(szCheck, (runs - 1) & 1 ? szLongPath : CFGBENCH_SHORT, MAX_PATH_BUFFER_SIZE);
+        for (int node = 0; node < (2 == op ? 4 : 1); node++) {
+            attrib.szName = NULL;
+            if (!ProcessQirxXMLNode(needles[node], &attrib, 1, CONFIG_READ) || lstrcmp(attrib.szValue, szCheck))
+                bad++;
+        }
+    }
+
+    qsort(pMicros, runs, sizeof(LONG64), CompareMicros);
+    printf("%s,%lu,%s,%s,%s,%s,%d,%.1f,%lld,%lld,%lld,%.1f,%lld,%lld,%d\n", pCase->szName,
+        pCase->size / 1024, pCase->nodesAtEnd ? "end" : "start", contention ? "qirx" : "none", szOps[op],
+        op ? szStrategies[strategy] : "-", runs, (double)sum / runs, pMicros[runs / 2],
+        pMicros[runs - 1 - runs / 100], pMicros[runs - 1],
+        sum ? (double)pCase->size * runs * (2 == op ? 4 : 1) / sum : 0.,
+        pPTM->counters.configOpenRetries - retries, competitorFailures - compFailures, bad);
+    fflush(stdout);
+}
+
+void ConfigBenchmark(int runs) {
+    char szSaveConfig[MAX_PATH_BUFFER_SIZE], szLongPath[MAX_PATH_BUFFER_SIZE], szFile[MAX_PATH_BUFFER_SIZE];
+    char* pCompetitorBuf;
+    LONG64* pMicros;
+    HANDLE hCompetitor;
+    int saveSettle, caseRuns;
+
+    if (runs < 10)
+        runs = CFGBENCH_RUNS;
+    if (!GetTempPath(MAX_PATH_BUFFER_SIZE - 32, szBenchFolder)) {
+        printf("No folder for temporary files.\n");
+        return;
+    }
+    lstrcat(szBenchFolder, "PathTweakerBench");
+    CreateDirectory(szBenchFolder, NULL);
+    sprintf(szFile, "%s\\qirx4%s", szBenchFolder, szQirxConfigExt);
+    sprintf(szBenchNew, "%s.new", szFile);
+
+    pMicros = (LONG64*)VCALLOC(runs * sizeof(LONG64));
+    pCompetitorBuf = (char*)VCALLOC(16 * 1024 * 1024 + 65536);
+    if (!pMicros || !pCompetitorBuf) {
+        printf("Not enough memory.\n");
+        goto out;
+    }
+
+    lstrcpy(szLongPath, "E:\\");
+    while (lstrlen(szLongPath) < 240)
+        lstrcat(szLongPath, "Recordings of the station\\");
+    szLongPath[250] = 0;
+
+    lstrcpy(szSaveConfig, pPTM->szQirxFullConfigFileName);
+    lstrcpy(pPTM->szQirxFullConfigFileName, szFile);
+    saveSettle = pPTM->opt.configSettleMs;
+    pPTM->opt.configSettleMs = 0;
+
+    fprintf(stderr, "Config-file benchmark in %s, %d runs, retries %d x %d ms\n", szBenchFolder, runs,
+        pPTM->opt.configOpenRetries, pPTM->opt.configRetryMs);
+    printf("file,size_kib,nodes,competitor,op,strategy,runs,mean_us,p50_us,p99_us,max_us,mb_per_s,"
+        "open_retries,competitor_failures,bad\n");
+
+    for (int c = 0; c < sizeof(benchCases) / sizeof(benchCases[0]); c++) {
+        caseRuns = runs / benchCases[c].runsDivisor;
+        if (caseRuns < 5)
+            caseRuns = 5;
+        for (int contention = 0; contention < 2; contention++) {
+            if (!MakeBenchConfig(szFile, benchCases[c].size, benchCases[c].nodesAtEnd)) {
+                printf("%s could not be written.\n", szFile);
+                goto restore;
+            }
+            hCompetitor = NULL;
+            competitorStop = 0;
+            if (contention)
+                hCompetitor = CreateEngineThread(CompetitorThread, pCompetitorBuf);
+
+            RunBenchCase(&benchCases[c], contention, 0, 0, caseRuns, szLongPath, pMicros);
+            for (int strategy = 0; strategy < 3; strategy++)
+                RunBenchCase(&benchCases[c], contention, 1, strategy, caseRuns, szLongPath, pMicros);
+            for (int strategy = 0; strategy < 3; strategy++)
+                RunBenchCase(&benchCases[c], contention, 2, strategy, caseRuns, szLongPath, pMicros);
+
+            if (hCompetitor) {
+                competitorStop = 1;
+                WaitForSingleObject(hCompetitor, INFINITE);
+                CloseHandle(hCompetitor);
+            }
+        }
+    }
+
+restore:
+    lstrcpy(pPTM->szQirxFullConfigFileName, szSaveConfig);
+    pPTM->opt.configSettleMs = saveSettle;
+    DeleteFile(szFile);
+    DeleteFile(szBenchNew);
+    RemoveDirectory(szBenchFolder);
+out:
+    if (pMicros)
+        VFREE(pMicros);
+    if (pCompetitorBuf)
+        VFREE(pCompetitorBuf);
+}
@@ -31,67 +31,143 @@
 //    <rawOut value="C:\Users\User\AppData\Local/qirx4/Raw/" maxSize="0" />
 //    __________     _ <--- We need these two offsets ---> _
 //    nodeNeedle          from the beginnig of the file
-// This simple parser will do the job
+// This simple parser will do the job. ProcessQirxXMLNode() does the same
+// for named attributes, several at once, so QIRX sees only one change of
+// the file.
 
-int ProcessQirxXMLFile(char* szInOutNodeContent, const char* nodeNeedle, int configReadWrite) {
-    int retryCount = 10, ret = 0;
-    HANDLE hfi;
-    DWORD dNumBytesRead = 0;
-    char* pFileContent, *pLeft, *pRight;
-    LARGE_INTEGER liFileSize{};
+extern int GetRawMaxSize(const char* szPath, char* szMaxSize);
+extern void CountConfigWrite(const LARGE_INTEGER* pStart, int found);
+extern void RecordLatency(int phase, int node, const LARGE_INTEGER* pStart);
 
+// The quoted value of the attribute inside of the node at pNode, or the
+// first quoted value after the needle if szName is NULL.
+char* FindNodeValue(char* pNode, const char* szName, char** ppRight) {
+    char* pLeft, *pEnd;
+    int len;
 
-// Never write empty strings to the config-file
-    if (CONFIG_WRITE == configReadWrite && *szInOutNodeContent == 0)
-        return 0; 
+    if (!szName)
+        pLeft = strchr(pNode, needleQm);
+    else {
+        pEnd = strchr(pNode, '>'); // the end of the node
+        len = lstrlen(szName);
+        for (pLeft = strstr(pNode, szName); pLeft && (!pEnd || pLeft < pEnd); pLeft = strstr(pLeft + 1, szName))
+            if (pLeft[-1] == ' ' && pLeft[len] == '=' && pLeft[len + 1] == needleQm)
+                break;
+        if (pLeft && pEnd && pLeft > pEnd)
+            pLeft = NULL;
+        if (pLeft)
+            pLeft += len + 1;
+    }
+    if (!pLeft)
+        return NULL;
+
+    pLeft++;
+    *ppRight = strchr(pLeft, needleQm);
+    return *ppRight ? pLeft : NULL;
+}
+
+// Reads or replaces the attributes of one node in the content of the file
+// in memory, which has room for the new values. Attributes the node does
+// not have are skipped (older QIRX versions), returns the number found.
+// *pLen is the new length, *pFirstChange the first byte changed (*pLen if
+// none).
+int ProcessConfigContent(char* pFileContent, SIZE_T* pLen, DWORD* pFirstChange, const char* nodeNeedle,
+    QIRXATTRIBUTE* pAttribs, int numAttribs, int configReadWrite) {
+    char *pNode, *pLeft, *pRight;
+    SIZE_T len = *pLen, newLen;
+    int ret = 0;
+
+    *pFirstChange = (DWORD)len;
+    pNode = strstr(pFileContent, nodeNeedle);
+
+    for (int i = 0; pNode && i < numAttribs; i++) {
+        pLeft = FindNodeValue(pNode, pAttribs[i].szName, &pRight);
+        if (!pLeft)
+            continue;
+
+        if (CONFIG_WRITE == configReadWrite) {
+            // Never write empty strings to the config-file
+            if (!pAttribs[i].szValue[0])
+                continue;
+            newLen = lstrlen(pAttribs[i].szValue);
+            memmove(pLeft + newLen, pRight, pFileContent + len - pRight + 1);
+            memcpy(pLeft, pAttribs[i].szValue, newLen);
+            len += newLen - (pRight - pLeft);
+            if ((DWORD)(pLeft - pFileContent) < *pFirstChange)
+                *pFirstChange = (DWORD)(pLeft - pFileContent);
+        }
+        else {
+            memset(pAttribs[i].szValue, 0, MAX_PATH_BUFFER_SIZE);
+            if (pRight - pLeft < MAX_PATH_BUFFER_SIZE)
+                memcpy(pAttribs[i].szValue, pLeft, pRight - pLeft);
+        }
+        pAttribs[i].found = 1;
+        ret++;
+    }
+    *pLen = len;
+    return ret;
+}
+
+// Reads or writes the attributes of one node, returns the number found.
+// Only the part of the file from the first change on is written. The
+// phases of a write are timed, see latency.cpp.
+int ProcessQirxXMLNode(const char* nodeNeedle, QIRXATTRIBUTE* pAttribs, int numAttribs, int configReadWrite) {
+    int retryCount = pPTM->opt.configOpenRetries, ret = 0;
+    HANDLE hfi;
+    DWORD dNumBytesRead = 0, dFirstChange;
+    char* pFileContent;
+    LARGE_INTEGER liFileSize{}, liPhase;
+    SIZE_T len;
+
+    for (int i = 0; i < numAttribs; i++)
+        pAttribs[i].found = 0;
 
 // We are not urgent and can wait a little to get access to QIRX's
 // config-file. Normally, we'll get a file-handle without retry-stuff.
 // See "qirx4.config is in use" (#122) in qirx-issues @github.
+    QueryPerformanceCounter(&liPhase);
     do {
         hfi = CreateFile(pPTM->szQirxFullConfigFileName, 
             GENERIC_READ | GENERIC_WRITE, 0, 0, OPEN_EXISTING,
             FILE_FLAG_SEQUENTIAL_SCAN, 0);
         retryCount--;
 
-        if (INVALID_HANDLE_VALUE == hfi)
-            Sleep(50);
+        if (INVALID_HANDLE_VALUE == hfi) {
+            InterlockedIncrement64(&pPTM->counters.configOpenRetries);
+            Sleep(pPTM->opt.configRetryMs);
+        }
         
-    } while ((INVALID_HANDLE_VALUE == hfi) && (retryCount != 0));
+    } while ((INVALID_HANDLE_VALUE == hfi) && (retryCount > 0));
+    if (CONFIG_WRITE == configReadWrite)
+        RecordLatency(LAT_OPEN, -1, &liPhase);
 
     if (INVALID_HANDLE_VALUE != hfi) {
-        
+        QueryPerformanceCounter(&liPhase);
         GetFileSizeEx(hfi, &liFileSize);
-        pFileContent = (char*)VCALLOC(liFileSize.LowPart + 1);
+        // room for the new values
+        pFileContent = (char*)VCALLOC(liFileSize.LowPart + 1 + numAttribs * MAX_PATH_BUFFER_SIZE);
             
         if (pFileContent) {
             ReadFile(hfi, pFileContent, liFileSize.LowPart, &dNumBytesRead, NULL);
-                
-            pLeft = strstr(pFileContent, nodeNeedle);
-
-            if (pLeft) { // needle found, the two q-marks will follow...
-                pLeft = strchr(pLeft, needleQm) + 1;
-                pRight = strchr(pLeft, needleQm);
-
-                if (pLeft && pRight) {
-                    if (CONFIG_WRITE == configReadWrite) {
-                        SetFilePointer(hfi, pLeft - pFileContent, NULL, FILE_BEGIN);
-                        WriteFile(hfi, szInOutNodeContent,
-                            lstrlen(szInOutNodeContent), &dNumBytesRead, NULL);
-                        WriteFile(hfi, pRight,
-                            pFileContent + liFileSize.QuadPart - pRight, &dNumBytesRead, NULL);
-                        SetEndOfFile(hfi);
-                    }
-                    else {
-                        memset(szInOutNodeContent, 0, MAX_PATH_BUFFER_SIZE);
-                        memcpy(szInOutNodeContent, pLeft, pRight - pLeft);
-                    }
-                    ret++;
-                }
+            if (CONFIG_WRITE == configReadWrite) {
+                RecordLatency(LAT_READ, -1, &liPhase);
+                QueryPerformanceCounter(&liPhase);
+            }
+            len = dNumBytesRead;
+            ret = ProcessConfigContent(pFileContent, &len, &dFirstChange, nodeNeedle, pAttribs, numAttribs,
+                configReadWrite);
+
+            if (CONFIG_WRITE == configReadWrite && dFirstChange < len) {
+                SetFilePointer(hfi, dFirstChange, NULL, FILE_BEGIN);
+                WriteFile(hfi, pFileContent + dFirstChange,
+                    (DWORD)(len - dFirstChange), &dNumBytesRead, NULL);
+                SetEndOfFile(hfi);
             }
             VFREE(pFileContent);
         }
         CloseHandle(hfi);
+        if (CONFIG_WRITE == configReadWrite)
+            RecordLatency(LAT_REWRITE, -1, &liPhase);
 // It seems there is a filechange-notify active in QIRX, which means
 // QIRX tries to read the config-file immediately after it was changed
 // and closed by other QIRX-threads or PathTweaker. If we re-open the
@@ -99,7 +175,41 @@ int ProcessQirxXMLFile(char* szInOutNodeContent, const char* nodeNeedle, int con
 // gives up, shows a last MessageBox and quits.
 // Here is the best place for waiting, just to catch all calls to
 // this procedure at once. This little time-lag does not hurt us.
-        Sleep(100);
+// ("SettleMs" of "options.ini", 100 by default)
+        QueryPerformanceCounter(&liPhase);
+        Sleep(pPTM->opt.configSettleMs);
+        if (CONFIG_WRITE == configReadWrite)
+            RecordLatency(LAT_SETTLE, -1, &liPhase);
     }
     return ret;
 }
+
+// A new raw-path takes the split size matching its drive along, see
+// drive_layout.cpp
+int ProcessQirxXMLFile(char* szInOutNodeContent, const char* nodeNeedle, int configReadWrite) {
+    QIRXATTRIBUTE attribs[2]{};
+    LARGE_INTEGER liStart;
+    int numAttribs = 1;
+
+// Never write empty strings to the config-file
+    if (CONFIG_WRITE == configReadWrite && *szInOutNodeContent == 0)
+        return 0; 
+
+    if (CONFIG_WRITE == configReadWrite) {
+        lstrcpyn(attribs[0].szValue, szInOutNodeContent, MAX_PATH_BUFFER_SIZE);
+        if (!lstrcmp(nodeNeedle, needleRawOut) && GetRawMaxSize(szInOutNodeContent, attribs[1].szValue)) {
+            attribs[1].szName = "maxSize";
+            numAttribs++;
+        }
+    }
+
+    QueryPerformanceCounter(&liStart);
+    ProcessQirxXMLNode(nodeNeedle, attribs, numAttribs, configReadWrite);
+    if (CONFIG_WRITE == configReadWrite)
+        CountConfigWrite(&liStart, attribs[0].found); // see metrics.cpp
+    if (!attribs[0].found)
+        return 0;
+    if (CONFIG_READ == configReadWrite)
+        memcpy(szInOutNodeContent, attribs[0].szValue, MAX_PATH_BUFFER_SIZE);
+    return 1;
+}
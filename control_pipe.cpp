@@ -0,0 +1,297 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+// The control pipe lets scripts switch the paths and ask for the state of
+// the nodes without the dialog. "\\.\pipe\PathTweaker-QIRX4" (the version
+// of the dialog or the daemon) takes a request of one message and answers
+// with one message. The commands of a request are separated by ";" or new
+// lines, the answer has a line per node or command:
+//   get [raw|aud|tii|eti]  the node, all nodes if none is given
+//   set node               the external path becomes the current one
+//   reset node             QIRX's own path becomes the current one
+//   lat                    the times of the path switches, see latency.cpp
+//   trace                  writes "trace.json" (with "Trace=1")
+//   ping                   "pong"
+// A node line is
+//   raw ext 123456789012 4096000 30140 E:\Recordings\Raw
+// the node, its state (ext: the external path is current, orig: QIRX's own
+// path while the external drive is there, offline: the external drive is
+// not there), the free bytes, the write speed in bytes per second, the
+// recording time left in seconds and the current path. The three numbers
+// are "-" until the path was sampled (within a second after a switch).
+// A line of "lat" is
+//   lat arrival 12 104211 100863 120831 135167 135874
+// the phase, the number of times, the mean, 50th, 90th and 99th percentile
+// and the longest time in microseconds. Anything wrong gives a line
+// "err ...".
+//
+// "get" is answered from the snapshots of the paths and of the disk space
+// (see snapshot.cpp), it never waits for the dialog or a drive. "set" and
+// "reset" run on the dialog's thread like a path plan (PTMSG_CONTROL) and
+// answer with the new node line. One client at a time, no remote ones.
+// "-ctl" is a client for the command line.
+
+#define CTL_REQUEST_MAX  4096
+#define CTL_RESPONSE_MAX 32768
+#define CTL_LINE_MAX     (MAX_PATH_BUFFER_SIZE + 96)
+#define CTL_SEND_MS      5000
+#define CTL_STOP_TRIES   40
+
+extern int IsQirxVersionArg(const char* szArg);
+extern DWORD SeqRead(volatile LONG* pSequence, const void* pShared, void* pData, DWORD size);
+extern int FormatLatencyLines(char* pOut);
+extern int WriteLatencyTrace();
+extern HANDLE CreateEngineThread(LPTHREAD_START_ROUTINE pfnThread, LPVOID param);
+
+static const char* nodeNames[4] = { "raw", "aud", "tii", "eti" };
+
+
+void GetControlPipeName(char* szName, const char* szVersion) {
+    char szUpper[16];
+
+    lstrcpyn(szUpper, szVersion, 16);
+    _strupr_s(szUpper, 16);
+    sprintf(szName, "%s%s", szControlPipe, szUpper);
+}
+
+// -1 for unknown names
+int GetNodeOfName(const char* szName) {
+    for (int node = 0; node < 4; node++)
+        if (!lstrcmpi(szName, nodeNames[node]))
+            return NODE_ETI == node && !pPTM->flagIsQ5 ? -1 : node;
+    return -1;
+}
+
+void ReadControlSnapshots(SPACESNAPSHOT* pSnap, SPACESTATUS* pStatus) {
+    DWORD retries;
+
+    retries = SeqRead(&pPTM->spaceSnap.sequence, &pPTM->spaceSnap.snap, pSnap, sizeof(SPACESNAPSHOT));
+    retries += SeqRead(&pPTM->spaceStatus.sequence, &pPTM->spaceStatus.status, pStatus, sizeof(SPACESTATUS));
+    InterlockedAdd64(&pPTM->counters.lockReads, 2);
+    InterlockedAdd64(&pPTM->counters.lockRetries, retries);
+}
+
+// Returns the length of the line
+int FormatNodeLine(int node, const SPACESNAPSHOT* pSnap, const SPACESTATUS* pStatus, char* pOut) {
+    const NODESPACE* pSpace = &pStatus->nodes[node];
+    const char* szState;
+    char szSpace[80];
+
+    if (pSnap->external[node])
+        szState = "ext";
+    else if (pSnap->online[node])
+        szState = "orig";
+    else
+        szState = "offline";
+
+    // sampled since the last switch of the node?
+    if (pSpace->generation && pSpace->generation >= pSnap->changed[node])
+        sprintf(szSpace, "%llu %.0f %llu", pSpace->freeBytes, pSpace->writeSpeed, pSpace->remSeconds);
+    else
+        lstrcpy(szSpace, "- - -");
+    return sprintf(pOut, "%s %s %s %s\n", nodeNames[node], szState, szSpace, pSnap->szPaths[node]);
+}
+
+// One request in, one answer out. Returns the length of the answer.
+int RunControlRequest(char* szRequest, char* pOut) {
+    SPACESNAPSHOT snap;
+    SPACESTATUS status;
+    DWORD_PTR result;
+    char *pCmd, *pNextCmd, *szVerb, *szArg, *pNextWord;
+    int node, target, len = 0;
+
+    for (pCmd = strtok_s(szRequest, ";\r\n", &pNextCmd); pCmd; pCmd = strtok_s(NULL, ";\r\n", &pNextCmd)) {
+        szVerb = strtok_s(pCmd, " \t", &pNextWord);
+        if (!szVerb)
+            continue;
+        if (len > CTL_RESPONSE_MAX - 5 * CTL_LINE_MAX) {
+            len += sprintf(pOut + len, "err too many commands\n");
+            break;
+        }
+        szArg = strtok_s(NULL, " \t", &pNextWord);
+        node = szArg ? GetNodeOfName(szArg) : -1;
+
+        if (!lstrcmpi(szVerb, "ping"))
+            len += sprintf(pOut + len, "pong\n");
+
+        else if (!lstrcmpi(szVerb, "lat"))
+            len += FormatLatencyLines(pOut + len);
+
+        else if (!lstrcmpi(szVerb, "trace")) {
+            if (!pPTM->opt.traceSwitches)
+                len += sprintf(pOut + len, "err Trace=0\n");
+            else
+                len += sprintf(pOut + len, "trace %d %s\n", WriteLatencyTrace(), pPTM->szTraceFileName);
+        }
+
+        else if (szArg && node < 0)
+            len += sprintf(pOut + len, "err unknown node %.32s\n", szArg);
+
+        else if (!lstrcmpi(szVerb, "get")) {
+            ReadControlSnapshots(&snap, &status);
+            for (int i = 0; i < 4; i++) {
+                if (szArg ? i == node : NODE_ETI != i || pPTM->flagIsQ5)
+                    len += FormatNodeLine(i, &snap, &status, pOut + len);
+            }
+        }
+
+        else if (!lstrcmpi(szVerb, "set") || !lstrcmpi(szVerb, "reset")) {
+            if (!szArg) {
+                len += sprintf(pOut + len, "err %s needs a node\n", szVerb);
+                continue;
+            }
+            target = lstrcmpi(szVerb, "set") ? PLAN_TO_ORIGINAL : PLAN_TO_EXTERNAL;
+            if (!SendMessageTimeout(pPTM->hWndDialog, PTMSG_CONTROL, node, target,
+                SMTO_ABORTIFHUNG, CTL_SEND_MS, &result))
+                len += sprintf(pOut + len, "err %s busy\n", nodeNames[node]);
+            else if (!result)
+                len += sprintf(pOut + len, "err %s offline\n", nodeNames[node]);
+            else {
+                ReadControlSnapshots(&snap, &status);
+                len += FormatNodeLine(node, &snap, &status, pOut + len);
+            }
+        }
+
+        else
+            len += sprintf(pOut + len, "err unknown command %.32s\n", szVerb);
+    }
+    if (!len)
+        len = sprintf(pOut, "err empty request\n");
+    return len;
+}
+
+// Requests until the client goes away
+void ServeControlClient(HANDLE hPipe, char* pRequest, char* pResponse) {
+    DWORD numRead, numWritten;
+    int len;
+
+    while (!pPTM->finishThread) {
+        if (ReadFile(hPipe, pRequest, CTL_REQUEST_MAX - 1, &numRead, NULL)) {
+            pRequest[numRead] = 0;
+            len = RunControlRequest(pRequest, pResponse);
+        }
+        else if (ERROR_MORE_DATA == GetLastError()) {
+            while (!ReadFile(hPipe, pRequest, CTL_REQUEST_MAX - 1, &numRead, NULL) &&
+                ERROR_MORE_DATA == GetLastError())
+                ; // skip the rest of it
+            len = sprintf(pResponse, "err the request is longer than %d bytes\n", CTL_REQUEST_MAX - 1);
+        }
+        else
+            return;
+        if (!WriteFile(hPipe, pResponse, len, &numWritten, NULL))
+            return;
+    }
+}
+
+DWORD WINAPI ControlPipeThread(LPVOID param) {
+    char szName[64], *pRequest, *pResponse;
+    HANDLE hPipe;
+
+    pRequest = (char*)VCALLOC(CTL_REQUEST_MAX + CTL_RESPONSE_MAX);
+    if (!pRequest)
+        return 0;
+    pResponse = pRequest + CTL_REQUEST_MAX;
+
+    // nobody else may have made a pipe of this name before
+    GetControlPipeName(szName, pPTM->szQirxVersion);
+    hPipe = CreateNamedPipe(szName, PIPE_ACCESS_DUPLEX | FILE_FLAG_FIRST_PIPE_INSTANCE,
+        PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+        1, CTL_RESPONSE_MAX, CTL_REQUEST_MAX, 0, NULL);
+    if (INVALID_HANDLE_VALUE == hPipe) {
+        VFREE(pRequest);
+        return 0;
+    }
+
+    while (!pPTM->finishThread) {
+        if (ConnectNamedPipe(hPipe, NULL) || ERROR_PIPE_CONNECTED == GetLastError())
+            ServeControlClient(hPipe, pRequest, pResponse);
+        DisconnectNamedPipe(hPipe);
+    }
+    CloseHandle(hPipe);
+    VFREE(pRequest);
+    return 0;
+}
+
+void StartControlPipe() {
+    pPTM->hControlThread = CreateEngineThread(ControlPipeThread, NULL);
+}
+
+// The thread may wait for a client or a request, the wait is cancelled
+// until the thread has seen finishThread
+void StopControlPipe() {
+    if (!pPTM->hControlThread)
+        return;
+    pPTM->finishThread = 1;
+    for (int i = 0; i < CTL_STOP_TRIES; i++) {
+        CancelSynchronousIo(pPTM->hControlThread);
+        if (WAIT_OBJECT_0 == WaitForSingleObject(pPTM->hControlThread, 50))
+            break;
+    }
+    CloseHandle(pPTM->hControlThread);
+    pPTM->hControlThread = NULL;
+}
+
+
+// -ctl [qirxN] command; ...
+// The words of the command line make up the request, the answer goes to
+// stdout as it comes.
+void CmdControl(int argc, char** argv) {
+    char szName[64], szVersion[16], szRequest[CTL_REQUEST_MAX], *pResponse;
+    DWORD numRead;
+    int len = 0;
+
+    lstrcpyn(szVersion, pPTM->szQirxVersion, 16);
+    if (argc && IsQirxVersionArg(argv[0])) {
+        lstrcpyn(szVersion, argv[0], 16);
+        argc--;
+        argv++;
+    }
+    if (!argc || !szVersion[0]) {
+        printf("%s", szMsgUsage);
+        return;
+    }
+    for (int i = 0; i < argc; i++) {
+        if (len + lstrlen(argv[i]) + 2 > CTL_REQUEST_MAX) {
+            printf("The request is longer than %d bytes.\n", CTL_REQUEST_MAX - 1);
+            return;
+        }
+        len += sprintf(szRequest + len, "%s%s", i ? " " : "", argv[i]);
+    }
+
+    pResponse = (char*)VCALLOC(CTL_RESPONSE_MAX + 1);
+    if (!pResponse)
+        return;
+    GetControlPipeName(szName, szVersion);
+    if (CallNamedPipe(szName, szRequest, len, pResponse, CTL_RESPONSE_MAX, &numRead, CTL_SEND_MS + 1000)) {
+        pResponse[numRead] = 0;
+        printf("%s", pResponse);
+    }
+    else
+        printf("No dialog or daemon of PathTweaker answers for %s.\n", szName + lstrlen(szControlPipe));
+    VFREE(pResponse);
+}
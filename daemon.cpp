@@ -0,0 +1,242 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+#include <Dbt.h>
+#include <stdarg.h>
+
+// "-daemon" runs the engine (engine.cpp) without the dialog, for recording
+// stations nobody looks at. A window which is never shown takes the
+// messages of the threads and timers, so the whole engine runs on the one
+// message loop of WinMain, as it does for the dialog. The window has the
+// title of the dialog, there is only one of them per QIRX version.
+//
+// Volume broadcasts don't reach a window outside of the desktop of the
+// user, so the drives are looked at every DAEMON_SCAN_MS instead: a new or
+// a lost drive letter is handled like DBT_DEVICEARRIVAL and
+// DBT_DEVICEREMOVECOMPLETE in the dialog. The stations of "-stations"
+// (stations.cpp) run the same window each, on threads of their own, and
+// get the drive letters from there. Nobody can answer a question
+// about the identity of a drive, so the node keeps waiting for its own
+// drive (see QueueIdentityPrompt()).
+//
+// What happens goes to "daemon.txt" next to "dlg.dat". "-daemon qirxN"
+// runs for that QIRX version without a qirx.bat. "-daemon stop" ends a
+// running daemon, the recording paths are set back to QIRX's own ones.
+
+#define DAEMON_SCAN_MS 2000
+
+extern int SchedAdd(PFNSCHEDPROC pfn, void* param, DWORD dueMs, DWORD periodMs);
+extern void StartDriveProbes();
+extern void ReadOriginalPaths();
+extern void StartEngine();
+extern void TakeArrivedDrive(_DEV_BROADCAST_VOLUME* dbv);
+extern void ReleaseRemovedDrive(_DEV_BROADCAST_VOLUME* dbv);
+extern void RollOverFolder(int node);
+extern int RunPathPlan(int node, int target);
+extern void TakeProbeResult(int node, int result);
+
+static char szLoggedPaths[STATION_MAX][4][MAX_PATH_BUFFER_SIZE];
+static DWORD driveMasks[STATION_MAX]; // on the window's thread
+static DWORD scanMask;  // on the SchedulerThread, "-daemon" only
+static const char* nodeNames[4] = { "raw", "aud", "tii", "eti" };
+
+
+void DaemonLog(const char* szFormat, ...) {
+    char line[MAX_PATH_BUFFER_SIZE + 128];
+    SYSTEMTIME st;
+    va_list args;
+    DWORD dNumBytes;
+    HANDLE hLog;
+    int len;
+
+    hLog = CreateFile(pPTM->szDaemonLogFileName, FILE_APPEND_DATA, FILE_SHARE_READ, 0, OPEN_ALWAYS, 0, 0);
+    if (INVALID_HANDLE_VALUE == hLog)
+        return;
+    GetLocalTime(&st);
+    len = sprintf(line, "%04u-%02u-%02u %02u:%02u:%02u  ",
+        st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+    va_start(args, szFormat);
+    _vsnprintf_s(line + len, sizeof(line) - len - 2, _TRUNCATE, szFormat, args);
+    va_end(args);
+    len = lstrlen(line);
+    lstrcpy(line + len, "\r\n");
+    WriteFile(hLog, line, len + 2, &dNumBytes, NULL);
+    CloseHandle(hLog);
+}
+
+// An error before the daemon runs. Nobody would close a MessageBox, so it
+// goes to "daemon.txt" ("%LOCALAPPDATA%\PathTweaker" if QIRX wasn't
+// found) and to the error output.
+void DaemonStartError(const char* szMsg) {
+    char szFolder[MAX_PATH_BUFFER_SIZE];
+
+    if (!pPTM->szDaemonLogFileName[0] && pPTM->haveAppDataBasePath) {
+        sprintf(szFolder, "%s\\%s", pPTM->szLocalAppDataBasePath, szAppName);
+        CreateDirectory(szFolder, NULL);
+        sprintf(pPTM->szDaemonLogFileName, "%s\\%s", szFolder, szDaemonLogFile);
+    }
+    if (pPTM->szDaemonLogFileName[0])
+        DaemonLog("%s", szMsg);
+    fprintf(stderr, "%s\n", szMsg);
+}
+
+// Each current path which is not the one logged last time
+void LogCurrentPaths(const char* szWhy) {
+    const char* szCurrent[4] = { pPTM->szCurrentRawPath, pPTM->szCurrentAudPath,
+        pPTM->szCurrentTiiPath, pPTM->szCurrentEtiPath };
+
+    for (int node = 0; node < 4; node++) {
+        if (NODE_ETI == node && !pPTM->flagIsQ5)
+            break;
+        if (!lstrcmp(szLoggedPaths[pPTM->station][node], szCurrent[node]))
+            continue;
+        lstrcpyn(szLoggedPaths[pPTM->station][node], szCurrent[node], MAX_PATH_BUFFER_SIZE);
+        DaemonLog("%s  %-9s %s", nodeNames[node], szWhy, szCurrent[node]);
+    }
+}
+
+// On the SchedulerThread
+void DriveScanTick(void* param) {
+    DWORD mask;
+
+    mask = GetLogicalDrives();
+    if (mask != scanMask) {
+        scanMask = mask;
+        PostMessage(pPTM->hWndDialog, PTMSG_DRIVES_CHANGED, mask, 0);
+    }
+}
+
+LRESULT CALLBACK DaemonWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
+    _DEV_BROADCAST_VOLUME dbv{};
+    DWORD* pDriveMask = &driveMasks[pPTM->station];
+    DWORD arrived, removed;
+
+    switch (message) {
+    case PTMSG_DRIVES_CHANGED: { // the same letters again change nothing
+        arrived = (DWORD)wParam & ~*pDriveMask;
+        removed = *pDriveMask & ~(DWORD)wParam;
+        *pDriveMask = (DWORD)wParam;
+        dbv.dbcv_size = sizeof(dbv);
+        dbv.dbcv_devicetype = DBT_DEVTYP_VOLUME;
+        if (removed) {
+            dbv.dbcv_unitmask = removed;
+            ReleaseRemovedDrive(&dbv);
+            LogCurrentPaths("removed");
+        }
+        if (arrived) {
+            dbv.dbcv_unitmask = arrived;
+            TakeArrivedDrive(&dbv);
+            LogCurrentPaths("arrived");
+        }
+        return 0;
+    }
+    case PTMSG_FOLDER_ROLLOVER:
+        RollOverFolder((int)wParam);
+        LogCurrentPaths("rollover");
+        return 0;
+
+    case PTMSG_PATH_PLAN:
+        if (RunPathPlan((int)wParam, (int)lParam))
+            LogCurrentPaths("plan");
+        else
+            DaemonLog("%s  plan      skipped, the drive is missing", nodeNames[wParam % 4]);
+        return 0;
+
+    case PTMSG_CONTROL: // the control pipe waits for the result
+        if (!RunPathPlan((int)wParam, (int)lParam)) {
+            DaemonLog("%s  control   skipped, the drive is missing", nodeNames[wParam % 4]);
+            return 0;
+        }
+        LogCurrentPaths("control");
+        return 1;
+
+    case PTMSG_PROBE_RESULT:
+        TakeProbeResult((int)wParam, (int)lParam);
+        if (PROBE_ONLINE != lParam && PROBE_MISMATCH != lParam)
+            DaemonLog("%s  probe     %s", nodeNames[wParam % 4], PROBE_TIMEOUT == lParam ?
+                "the drive doesn't answer" : "the drive is missing");
+        LogCurrentPaths("probed");
+        return 0;
+
+    case WM_CREATE:
+        pPTM->hWndDialog = hWnd;
+        DaemonLog("started");
+        ReadOriginalPaths();
+        LogCurrentPaths("original");
+        StartDriveProbes();
+        StartEngine();
+        *pDriveMask = scanMask = GetLogicalDrives();
+        if (HEADLESS_DAEMON == pPTM->headless)
+            SchedAdd(DriveScanTick, NULL, DAEMON_SCAN_MS, DAEMON_SCAN_MS);
+        return 0;
+
+    case WM_CLOSE:
+        DaemonLog("stopped");
+        DestroyWindow(hWnd);
+        return 0;
+
+    case WM_DESTROY:
+        PostQuitMessage(0);
+        return 0;
+    }
+    return DefWindowProc(hWnd, message, wParam, lParam);
+}
+
+// Instead of CreateDialog() in WinMain. The window is never shown. The
+// second station finds the class registered already.
+HWND CreateDaemonWindow(HINSTANCE hInstance) {
+    WNDCLASS wc{};
+
+    wc.lpfnWndProc = DaemonWndProc;
+    wc.hInstance = hInstance;
+    wc.lpszClassName = szDaemonClass;
+    if (!RegisterClass(&wc) && ERROR_CLASS_ALREADY_EXISTS != GetLastError())
+        return NULL;
+    return CreateWindow(szDaemonClass, pPTM->szMyWindowTitle, WS_OVERLAPPED,
+        0, 0, 0, 0, NULL, NULL, hInstance, NULL);
+}
+
+// -daemon stop
+void CmdDaemon(const char* szArg) {
+    char szTitle[32], szVersion[16];
+    HWND hWnd;
+
+    if (!szArg || lstrcmpi(szArg, "stop")) {
+        printf("%s", szMsgUsage);
+        return;
+    }
+    lstrcpyn(szVersion, pPTM->szQirxVersion, 16);
+    _strupr_s(szVersion, 16);
+    sprintf(szTitle, "%s (%s)", szAppName, szVersion);
+    hWnd = FindWindow(szDaemonClass, szTitle);
+    if (!hWnd) {
+        printf("No daemon of PathTweaker is running for %s.\n", szVersion);
+        return;
+    }
+    PostMessage(hWnd, WM_CLOSE, 0, 0);
+    printf("The daemon stops, the recording paths are set back to QIRX's own ones.\n");
+}
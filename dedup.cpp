@@ -0,0 +1,609 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+// Recordings moved between the system drive and the external drives leave
+// copies behind. The duplicate finder walks all recording folders we know
+// and narrows the files down in three steps:
+//   1. same size
+//   2. same hash of the first and the last 64 KiB
+//   3. same hash of the whole file
+// Steps 2 and 3 read the files with one thread per physical disk, so the
+// disks work in parallel and none of them has to seek between two files.
+// Hard links of one file (or a folder listed twice) count as one file.
+//
+// In each group of equal files, a copy outside the system drive is kept,
+// otherwise the oldest one. DEDUP_DELETE deletes the others, DEDUP_LINK
+// replaces copies on the same volume by hard links. Both compare the files
+// byte by byte before they touch anything.
+
+#define DEDUP_PARTIAL       (64 * 1024)
+#define DEDUP_BUFFER        (1024 * 1024)
+#define DEDUP_MIN_SIZE      (64 * 1024)   // our reports, indexes and the logs are smaller
+#define DEDUP_MAX_DEPTH     4             // sub-folders below a recording folder
+#define DEDUP_MAX_WORKERS   32
+#define DEDUP_NO_DISK       0xFFFF
+
+#define DF_CANDIDATE        0
+#define DF_UNIQUE           1
+#define DF_SAME             2             // another name of a file we have already
+#define DF_FAILED           3             // in use or unreadable
+
+extern int IsPathTweakerFile(const char* szName);
+extern HANDLE CreateEngineThread(LPTHREAD_START_ROUTINE pfnThread, LPVOID param);
+
+struct DEDUPFILE {
+    char szName[MAX_PATH_BUFFER_SIZE];
+    ULONGLONG size;
+    ULONGLONG fileIndex;
+    ULONGLONG partialHash;
+    ULONGLONG fullHash;
+    FILETIME ftWrite;
+    DWORD volSerial;
+    int worker;
+    int onSystemDrive;
+    int state;
+};
+
+struct DEDUPSCAN {
+    DEDUPFILE* pFiles;
+    DWORD numFiles;
+    DWORD maxFiles;
+    int fullPass;
+    volatile int* pCancel;
+    int numWorkers;
+    DWORD workerDisk[DEDUP_MAX_WORKERS];
+    int letterWorker[26];     // -1: not looked up yet
+    char systemDrive;
+};
+
+struct DEDUPWORKER {
+    DEDUPSCAN* pScan;
+    int worker;
+    ULONGLONG bytesRead;
+};
+
+
+// A 64 bit hash in the way of xxHash64: four lanes over 32 byte stripes.
+// Not cryptographic, the files are compared byte by byte before anything
+// is deleted.
+#define DH_P1 0x9E3779B185EBCA87ull
+#define DH_P2 0xC2B2AE3D27D4EB4Full
+#define DH_P3 0x165667B19E3779F9ull
+
+struct DEDUPHASH {
+    ULONGLONG v[4];
+    ULONGLONG total;
+};
+
+inline ULONGLONG DedupRound(ULONGLONG acc, ULONGLONG input) {
+    acc += input * DH_P2;
+    acc = (acc << 31) | (acc >> 33);
+    return acc * DH_P1;
+}
+
+void DedupHashInit(DEDUPHASH* pH, ULONGLONG seed) {
+    pH->v[0] = seed + DH_P1 + DH_P2;
+    pH->v[1] = seed + DH_P2;
+    pH->v[2] = seed;
+    pH->v[3] = seed - DH_P1;
+    pH->total = 0;
+}
+
+// All but the last call with a multiple of 32 bytes
+void DedupHashUpdate(DEDUPHASH* pH, const BYTE* p, SIZE_T len) {
+    ULONGLONG w;
+    SIZE_T i;
+
+    for (i = 0; i + 32 <= len; i += 32) {
+        for (int k = 0; k < 4; k++) {
+            memcpy(&w, p + i + k * 8, 8);
+            pH->v[k] = DedupRound(pH->v[k], w);
+        }
+    }
+    for (; i + 8 <= len; i += 8) {
+        memcpy(&w, p + i, 8);
+        pH->v[0] = DedupRound(pH->v[0], w);
+    }
+    for (; i < len; i++)
+        pH->v[1] = DedupRound(pH->v[1], p[i]);
+    pH->total += len;
+}
+
+ULONGLONG DedupHashFinal(const DEDUPHASH* pH) {
+    ULONGLONG h;
+
+    h = ((pH->v[0] << 1) | (pH->v[0] >> 63)) + ((pH->v[1] << 7) | (pH->v[1] >> 57)) +
+        ((pH->v[2] << 12) | (pH->v[2] >> 52)) + ((pH->v[3] << 18) | (pH->v[3] >> 46));
+    for (int k = 0; k < 4; k++)
+        h = (h ^ DedupRound(0, pH->v[k])) * DH_P1 + DH_P3;
+    h += pH->total;
+    h ^= h >> 33;
+    h *= DH_P2;
+    h ^= h >> 29;
+    h *= DH_P3;
+    return h ^ (h >> 32);
+}
+
+// Hashes len bytes from offset on
+int DedupHashRange(HANDLE hFile, ULONGLONG offset, ULONGLONG len, BYTE* pBuf, DEDUPHASH* pH,
+    volatile int* pCancel, ULONGLONG* pBytesRead) {
+    LARGE_INTEGER li;
+    DWORD dNumBytesRead, want;
+
+    li.QuadPart = offset;
+    if (!SetFilePointerEx(hFile, li, NULL, FILE_BEGIN))
+        return 0;
+    while (len && !*pCancel) {
+        want = len < DEDUP_BUFFER ? (DWORD)len : DEDUP_BUFFER;
+        if (!ReadFile(hFile, pBuf, want, &dNumBytesRead, NULL) || dNumBytesRead != want)
+            return 0;
+        DedupHashUpdate(pH, pBuf, want);
+        len -= want;
+        *pBytesRead += want;
+    }
+    return !len;
+}
+
+
+// One worker per physical disk, each reads the candidates on its disk
+DWORD WINAPI DedupThread(LPVOID param) {
+    DEDUPWORKER* pW = (DEDUPWORKER*)param;
+    DEDUPSCAN* pScan = pW->pScan;
+    DEDUPFILE* pF;
+    BY_HANDLE_FILE_INFORMATION info;
+    DEDUPHASH h;
+    HANDLE hFile;
+    BYTE* pBuf;
+    int ok;
+
+    pBuf = (BYTE*)VCALLOC(DEDUP_BUFFER);
+    if (!pBuf)
+        return 0;
+
+    for (DWORD i = 0; i < pScan->numFiles && !*pScan->pCancel; i++) {
+        pF = &pScan->pFiles[i];
+        if (pF->worker != pW->worker || pF->state != DF_CANDIDATE)
+            continue;
+        // small files are hashed completely in the first pass
+        if (pScan->fullPass && pF->size <= 2 * DEDUP_PARTIAL)
+            continue;
+
+        // A recording still written by QIRX can't be opened like this
+        hFile = CreateFile(pF->szName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN, 0);
+        if (INVALID_HANDLE_VALUE == hFile) {
+            pF->state = DF_FAILED;
+            continue;
+        }
+
+        DedupHashInit(&h, pF->size);
+        if (pScan->fullPass) {
+            ok = DedupHashRange(hFile, 0, pF->size, pBuf, &h, pScan->pCancel, &pW->bytesRead);
+            pF->fullHash = DedupHashFinal(&h);
+        }
+        else {
+            ok = GetFileInformationByHandle(hFile, &info);
+            pF->volSerial = info.dwVolumeSerialNumber;
+            pF->fileIndex = ((ULONGLONG)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+
+            if (pF->size <= 2 * DEDUP_PARTIAL) {
+                ok = ok && DedupHashRange(hFile, 0, pF->size, pBuf, &h, pScan->pCancel, &pW->bytesRead);
+                pF->partialHash = pF->fullHash = DedupHashFinal(&h);
+            }
+            else {
+                ok = ok && DedupHashRange(hFile, 0, DEDUP_PARTIAL, pBuf, &h, pScan->pCancel, &pW->bytesRead) &&
+                    DedupHashRange(hFile, pF->size - DEDUP_PARTIAL, DEDUP_PARTIAL, pBuf, &h,
+                        pScan->pCancel, &pW->bytesRead);
+                pF->partialHash = DedupHashFinal(&h);
+            }
+        }
+        CloseHandle(hFile);
+        if (!ok)
+            pF->state = DF_FAILED;
+    }
+    VFREE(pBuf);
+    return 0;
+}
+
+// Runs one pass with a thread per disk. Returns the bytes read.
+ULONGLONG RunDedupPass(DEDUPSCAN* pScan, int fullPass) {
+    HANDLE hThreads[DEDUP_MAX_WORKERS];
+    DEDUPWORKER workers[DEDUP_MAX_WORKERS];
+    ULONGLONG bytesRead = 0;
+    int numThreads = 0;
+
+    pScan->fullPass = fullPass;
+    for (int w = 0; w < pScan->numWorkers; w++) {
+        workers[w].pScan = pScan;
+        workers[w].worker = w;
+        workers[w].bytesRead = 0;
+        hThreads[numThreads] = CreateEngineThread(DedupThread, &workers[w]);
+        if (hThreads[numThreads])
+            numThreads++;
+        else
+            DedupThread(&workers[w]);
+    }
+    WaitForMultipleObjects(numThreads, hThreads, TRUE, INFINITE);
+    for (int i = 0; i < numThreads; i++)
+        CloseHandle(hThreads[i]);
+    for (int w = 0; w < pScan->numWorkers; w++)
+        bytesRead += workers[w].bytesRead;
+    return bytesRead;
+}
+
+
+// The physical disk of a drive letter. Volumes we can't ask get a worker
+// of their own, network shares share one.
+int GetDedupWorker(DEDUPSCAN* pScan, const char* szName) {
+    char szVolume[8];
+    VOLUME_DISK_EXTENTS ext;
+    HANDLE hVolume;
+    DWORD disk = DEDUP_NO_DISK, dNumBytes;
+    int letter = -1, w;
+
+    if (szName[1] == ':' && (szName[0] | 0x20) >= 'a' && (szName[0] | 0x20) <= 'z') {
+        letter = (szName[0] | 0x20) - 'a';
+        if (pScan->letterWorker[letter] >= 0)
+            return pScan->letterWorker[letter];
+
+        sprintf(szVolume, "\\\\.\\%c:", 'A' + letter);
+        hVolume = CreateFile(szVolume, 0, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, 0, 0);
+        if (INVALID_HANDLE_VALUE != hVolume) {
+            // a volume over several disks: the first one is good enough
+            if (DeviceIoControl(hVolume, IOCTL_VOLUME_GET_VOLUME_DISK_EXTENTS, NULL, 0, &ext, sizeof(ext),
+                &dNumBytes, NULL) || ERROR_MORE_DATA == GetLastError())
+                disk = ext.Extents[0].DiskNumber;
+            CloseHandle(hVolume);
+        }
+        if (DEDUP_NO_DISK == disk)
+            disk = 0x10000 + letter;
+    }
+
+    for (w = 0; w < pScan->numWorkers; w++)
+        if (pScan->workerDisk[w] == disk)
+            break;
+    if (w == pScan->numWorkers) {
+        if (w < DEDUP_MAX_WORKERS)
+            pScan->workerDisk[pScan->numWorkers++] = disk;
+        else
+            w = disk % DEDUP_MAX_WORKERS;
+    }
+    if (letter >= 0)
+        pScan->letterWorker[letter] = w;
+    return w;
+}
+
+void CollectDedupFiles(DEDUPSCAN* pScan, const char* szFolder, int depth) {
+    char szPattern[MAX_PATH_BUFFER_SIZE + 8], szFile[MAX_PATH_BUFFER_SIZE * 2];
+    WIN32_FIND_DATA fd;
+    HANDLE hFind;
+    DEDUPFILE* pF;
+    ULARGE_INTEGER size;
+    void* pNew;
+    int len;
+
+    len = lstrlen(szFolder);
+    if (!len || len + 3 >= MAX_PATH_BUFFER_SIZE)
+        return;
+    sprintf(szPattern, "%s%s*", szFolder, szFolder[len - 1] == '\\' ? "" : "\\");
+
+    hFind = FindFirstFile(szPattern, &fd);
+    if (INVALID_HANDLE_VALUE == hFind)
+        return;
+
+    do {
+        if (fd.dwFileAttributes & (FILE_ATTRIBUTE_REPARSE_POINT | FILE_ATTRIBUTE_SYSTEM))
+            continue; // no junction loops, no "System Volume Information"
+        if (IsPathTweakerFile(fd.cFileName))
+            continue;
+        sprintf(szFile, "%s%s%s", szFolder, szFolder[len - 1] == '\\' ? "" : "\\", fd.cFileName);
+        if (lstrlen(szFile) + 8 >= MAX_PATH_BUFFER_SIZE)
+            continue;
+
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            if (depth < DEDUP_MAX_DEPTH && lstrcmp(fd.cFileName, ".") && lstrcmp(fd.cFileName, ".."))
+                CollectDedupFiles(pScan, szFile, depth + 1);
+            continue;
+        }
+
+        size.LowPart = fd.nFileSizeLow;
+        size.HighPart = fd.nFileSizeHigh;
+        if (size.QuadPart < DEDUP_MIN_SIZE)
+            continue;
+
+        if (pScan->numFiles == pScan->maxFiles) {
+            pNew = realloc(pScan->pFiles, (pScan->maxFiles + 1024) * sizeof(DEDUPFILE));
+            if (!pNew)
+                break;
+            pScan->pFiles = (DEDUPFILE*)pNew;
+            pScan->maxFiles += 1024;
+        }
+        pF = &pScan->pFiles[pScan->numFiles++];
+        memset(pF, 0, sizeof(DEDUPFILE));
+        lstrcpy(pF->szName, szFile);
+        pF->size = size.QuadPart;
+        pF->ftWrite = fd.ftLastWriteTime;
+        pF->onSystemDrive = (szFile[0] | 0x20) == (pScan->systemDrive | 0x20) && szFile[1] == ':';
+        pF->worker = GetDedupWorker(pScan, szFile);
+
+    } while (!*pScan->pCancel && FindNextFile(hFind, &fd));
+
+    FindClose(hFind);
+}
+
+
+// Sorting: candidates first, then by the keys of the step. The last one
+// also puts the copy to keep at the front of its group.
+int CompareDedupSize(const void* a, const void* b) {
+    const DEDUPFILE* pa = (const DEDUPFILE*)a, *pb = (const DEDUPFILE*)b;
+
+    if (pa->state != pb->state)
+        return pa->state - pb->state;
+    return pa->size < pb->size ? -1 : pa->size > pb->size;
+}
+
+int CompareDedupIdentity(const void* a, const void* b) {
+    const DEDUPFILE* pa = (const DEDUPFILE*)a, *pb = (const DEDUPFILE*)b;
+
+    if (pa->state != pb->state)
+        return pa->state - pb->state;
+    if (pa->volSerial != pb->volSerial)
+        return pa->volSerial < pb->volSerial ? -1 : 1;
+    return pa->fileIndex < pb->fileIndex ? -1 : pa->fileIndex > pb->fileIndex;
+}
+
+int CompareDedupPartial(const void* a, const void* b) {
+    const DEDUPFILE* pa = (const DEDUPFILE*)a, *pb = (const DEDUPFILE*)b;
+    int c = CompareDedupSize(a, b);
+
+    if (c)
+        return c;
+    return pa->partialHash < pb->partialHash ? -1 : pa->partialHash > pb->partialHash;
+}
+
+int CompareDedupFull(const void* a, const void* b) {
+    const DEDUPFILE* pa = (const DEDUPFILE*)a, *pb = (const DEDUPFILE*)b;
+    int c = CompareDedupSize(a, b);
+
+    if (c)
+        return c;
+    if (pa->fullHash != pb->fullHash)
+        return pa->fullHash < pb->fullHash ? -1 : 1;
+    if (pa->onSystemDrive != pb->onSystemDrive)
+        return pa->onSystemDrive - pb->onSystemDrive;
+    c = CompareFileTime(&pa->ftWrite, &pb->ftWrite);
+    return c ? c : lstrcmpi(pa->szName, pb->szName);
+}
+
+typedef int (*PFNDEDUPCOMPARE)(const void* a, const void* b);
+
+// Sorts by the keys and marks files without an equal partner as unique.
+// Returns the number of candidates left.
+DWORD MarkDedupSingles(DEDUPSCAN* pScan, PFNDEDUPCOMPARE pfnKeys, PFNDEDUPCOMPARE pfnGroup) {
+    DEDUPFILE* pF = pScan->pFiles;
+    DWORD n = 0, start, i;
+
+    qsort(pF, pScan->numFiles, sizeof(DEDUPFILE), pfnKeys);
+    while (n < pScan->numFiles && pF[n].state == DF_CANDIDATE)
+        n++;
+
+    for (start = 0; start < n; start = i) {
+        for (i = start + 1; i < n && !pfnGroup(&pF[start], &pF[i]); i++)
+            ;
+        if (i - start == 1)
+            pF[start].state = DF_UNIQUE;
+    }
+    qsort(pF, pScan->numFiles, sizeof(DEDUPFILE), pfnKeys);
+    for (n = 0; n < pScan->numFiles && pF[n].state == DF_CANDIDATE; n++)
+        ;
+    return n;
+}
+
+int CompareDedupGroup(const void* a, const void* b) {
+    const DEDUPFILE* pa = (const DEDUPFILE*)a, *pb = (const DEDUPFILE*)b;
+
+    return pa->size != pb->size || pa->fullHash != pb->fullHash;
+}
+
+// Two names of one file: all but one leave the race
+void MarkDedupSameFiles(DEDUPSCAN* pScan) {
+    DEDUPFILE* pF = pScan->pFiles;
+
+    qsort(pF, pScan->numFiles, sizeof(DEDUPFILE), CompareDedupIdentity);
+    for (DWORD i = 1; i < pScan->numFiles && pF[i].state == DF_CANDIDATE; i++)
+        if (pF[i].volSerial == pF[i - 1].volSerial && pF[i].fileIndex == pF[i - 1].fileIndex)
+            pF[i].state = DF_SAME;
+}
+
+
+// Byte by byte, before we delete or link anything
+int SameDedupContents(const char* szA, const char* szB, BYTE* pBufA, BYTE* pBufB) {
+    HANDLE hA, hB;
+    DWORD dReadA, dReadB;
+    int ret = 0;
+
+    hA = CreateFile(szA, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    hB = CreateFile(szB, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+
+    if (INVALID_HANDLE_VALUE != hA && INVALID_HANDLE_VALUE != hB) {
+        for (;;) {
+            if (!ReadFile(hA, pBufA, DEDUP_BUFFER, &dReadA, NULL) ||
+                !ReadFile(hB, pBufB, DEDUP_BUFFER, &dReadB, NULL) || dReadA != dReadB ||
+                memcmp(pBufA, pBufB, dReadA))
+                break;
+            if (!dReadA) {
+                ret++;
+                break;
+            }
+        }
+    }
+    if (INVALID_HANDLE_VALUE != hA)
+        CloseHandle(hA);
+    if (INVALID_HANDLE_VALUE != hB)
+        CloseHandle(hB);
+    return ret;
+}
+
+// The copy becomes a hard link to szTarget, via a temporary name, so the
+// copy is not lost if the link fails
+int LinkDedupCopy(const char* szCopy, const char* szTarget) {
+    char szTemp[MAX_PATH_BUFFER_SIZE + 8];
+
+    sprintf(szTemp, "%s.lnk~", szCopy);
+    if (!CreateHardLink(szTemp, szTarget, NULL))
+        return 0;
+    if (MoveFileEx(szTemp, szCopy, MOVEFILE_REPLACE_EXISTING))
+        return 1;
+    DeleteFile(szTemp);
+    return 0;
+}
+
+void DedupLine(HANDLE hReport, const char* szFormat, ...) {
+    char buff[MAX_PATH_BUFFER_SIZE + 128];
+    DWORD dNumBytesWritten;
+    va_list args;
+    int len;
+
+    va_start(args, szFormat);
+    len = vsnprintf(buff, sizeof(buff) - 2, szFormat, args);
+    va_end(args);
+    if (len < 0 || len > (int)sizeof(buff) - 3)
+        len = sizeof(buff) - 3;
+
+    printf("%s\n", buff);
+    if (INVALID_HANDLE_VALUE != hReport) {
+        lstrcpy(buff + len, "\r\n");
+        WriteFile(hReport, buff, len + 2, &dNumBytesWritten, NULL);
+    }
+}
+
+
+// Finds the duplicates in the folders (and below) and does the action.
+// Prints the report and writes it to "dedup.txt" next to "dlg.dat".
+// Returns the number of duplicate files found.
+int DedupCollection(const char (*szFolders)[MAX_PATH_BUFFER_SIZE], int numFolders, int action,
+    volatile int* pCancel) {
+    DEDUPSCAN scan{};
+    DEDUPFILE* pF;
+    HANDLE hReport = INVALID_HANDLE_VALUE;
+    LARGE_INTEGER qpf, liStart, liEnd;
+    ULONGLONG bytesRead, wasted = 0;
+    DWORD n, start, i, k;
+    BYTE* pBufA;
+    char szSystem[MAX_PATH_BUFFER_SIZE];
+    int numGroups = 0, numDup = 0, numDone = 0;
+    const char* szDone;
+
+    pBufA = (BYTE*)VCALLOC(2 * DEDUP_BUFFER);
+    if (!pBufA)
+        return 0;
+
+    QueryPerformanceFrequency(&qpf);
+    QueryPerformanceCounter(&liStart);
+    scan.pCancel = pCancel;
+    memset(scan.letterWorker, -1, sizeof(scan.letterWorker));
+    GetSystemDirectory(szSystem, MAX_PATH_BUFFER_SIZE);
+    scan.systemDrive = szSystem[0];
+
+    for (int f = 0; f < numFolders; f++)
+        CollectDedupFiles(&scan, szFolders[f], 0);
+
+    if (pPTM->haveDlgConfig)
+        hReport = CreateFile(pPTM->szDedupReportFileName, GENERIC_WRITE, FILE_SHARE_READ, 0,
+            CREATE_ALWAYS, 0, 0);
+    for (int f = 0; f < numFolders; f++)
+        DedupLine(hReport, "folder %s", szFolders[f]);
+    DedupLine(hReport, "%lu files of %d KiB or more on %d disk(s)", scan.numFiles,
+        DEDUP_MIN_SIZE / 1024, scan.numWorkers);
+    DedupLine(hReport, "");
+
+    // 1. size, 2. head and tail, 3. the whole file
+    n = MarkDedupSingles(&scan, CompareDedupSize, CompareDedupSize);
+    bytesRead = RunDedupPass(&scan, 0);
+    MarkDedupSameFiles(&scan);
+    n = MarkDedupSingles(&scan, CompareDedupPartial, CompareDedupPartial);
+    if (n && !*pCancel)
+        bytesRead += RunDedupPass(&scan, 1);
+    n = MarkDedupSingles(&scan, CompareDedupFull, CompareDedupGroup);
+
+    pF = scan.pFiles;
+    for (start = 0; start < n && !*pCancel; start = i) {
+        for (i = start + 1; i < n && !CompareDedupGroup(&pF[start], &pF[i]); i++)
+            ;
+        numGroups++;
+        DedupLine(hReport, "%llu bytes, hash %016llX", pF[start].size, pF[start].fullHash);
+        DedupLine(hReport, "  keep      %s", pF[start].szName);
+
+        for (DWORD j = start + 1; j < i; j++) {
+            numDup++;
+            wasted += pF[j].size;
+            szDone = "copy     ";
+
+            if (DEDUP_DELETE == action) {
+                szDone = "NOT EQUAL";
+                if (SameDedupContents(pF[start].szName, pF[j].szName, pBufA, pBufA + DEDUP_BUFFER)) {
+                    szDone = DeleteFile(pF[j].szName) ? "deleted  " : "failed   ";
+                    numDone += szDone[0] == 'd';
+                }
+            }
+            else if (DEDUP_LINK == action) {
+                // to the first copy on the same volume, the first one there stays
+                for (k = start; k < j && pF[k].volSerial != pF[j].volSerial; k++)
+                    ;
+                szDone = "kept     ";
+                if (k < j) {
+                    szDone = "NOT EQUAL";
+                    if (SameDedupContents(pF[k].szName, pF[j].szName, pBufA, pBufA + DEDUP_BUFFER)) {
+                        szDone = LinkDedupCopy(pF[j].szName, pF[k].szName) ? "linked   " : "failed   ";
+                        numDone += szDone[0] == 'l';
+                    }
+                }
+            }
+            DedupLine(hReport, "  %s %s", szDone, pF[j].szName);
+        }
+    }
+
+    for (i = 0, k = 0; i < scan.numFiles; i++)
+        k += pF[i].state == DF_FAILED;
+    QueryPerformanceCounter(&liEnd);
+    DedupLine(hReport, "");
+    if (DEDUP_REPORT == action)
+        DedupLine(hReport, "%d group(s), %d duplicate(s), %.1f MB in the copies", numGroups, numDup,
+            wasted / 1e6);
+    else
+        DedupLine(hReport, "%d group(s), %d duplicate(s), %.1f MB in the copies, %d %s", numGroups, numDup,
+            wasted / 1e6, numDone, DEDUP_LINK == action ? "linked" : "deleted");
+    DedupLine(hReport, "%lu file(s) in use or unreadable, %.1f MB read in %.1f s%s", k, bytesRead / 1e6,
+        (double)(liEnd.QuadPart - liStart.QuadPart) / qpf.QuadPart, *pCancel ? ", CANCELLED" : "");
+
+    if (INVALID_HANDLE_VALUE != hReport)
+        CloseHandle(hReport);
+    free(scan.pFiles);
+    VFREE(pBufA);
+    return numDup;
+}
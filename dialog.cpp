@@ -28,33 +28,64 @@
 #include "resource1.h"
 #include <Dbt.h>
 #include <Shlwapi.h>
-#include <intrin.h>
 
 #pragma comment(lib, "Shlwapi.lib")
 
 #define CLICK_DLG_CONTROL(CONTROL_ID) SendMessage(GetDlgItem(hDlg, CONTROL_ID), BM_CLICK, 0, 0)
-#define TIMER_ON  SetTimer(hDlg, 123, 2000, NULL);
-#define TIMER_OFF KillTimer(hDlg,123);
+#define TIMER_ON  StartBlinkTimer();
+#define TIMER_OFF StopBlinkTimer();
+#define BLINK_MS  2000
 #define COLREF_QIRXBLUE (RGB(25, 88, 132))
 #define COLREF_HALFRED (RGB(128, 0, 0))
-#define PT_DRIVE_REMOVED 0
-#define PT_DRIVE_ARRIVED 1
 
 
-extern int ProcessQirxXMLFile(char* szInOutNodeContent, const char* nodeNeedle, int configReadWrite);
-extern DWORD WINAPI DiskSpaceThread(LPVOID param);
+extern void PublishSpaceSnapshot();
 extern DWORD WINAPI SelectFolderThread(LPVOID param);
-extern int CheckPathExists(char* path);
+extern int StartFragCheck(int node);
+extern void CancelFragCheck();
+extern int TakeFragCheck(LPARAM lParam);
+extern char* GetExternalPathOfNode(int node);
+extern void StartDriveProbes();
+extern int ReadDriveIdentity(const char* szPath, DRIVEIDENTITY* pId);
+extern void SetDriveIdentity(int node, const DRIVEIDENTITY* pFound);
+extern int SchedAdd(PFNSCHEDPROC pfn, void* param, DWORD dueMs, DWORD periodMs);
+extern void SchedRemove(int id);
 extern void WriteDlgConfigFile();
+extern void ReadOriginalPaths();
+extern void StartEngine();
+extern int AllDrivesOnline();
+extern void TakeArrivedDrive(_DEV_BROADCAST_VOLUME* dbv);
+extern void ReleaseRemovedDrive(_DEV_BROADCAST_VOLUME* dbv);
+extern void RollOverFolder(int node);
+extern int RunPathPlan(int node, int target);
+extern void TakeProbeResult(int node, int result);
+extern void TakeIdentityAnswer(int node, int yes);
+extern DWORD GetVolumeSerial(char* pathOnDrive);
+extern void MakePathCurrent();
+extern void RestoreOriginalPath();
+extern HANDLE CreateEngineThread(LPTHREAD_START_ROUTINE pfnThread, LPVOID param);
 
 
 void UpdateDlgControls();
-int SerialCheck(char* szStoredExternalPath, DWORD storedSerial);
-DWORD GetVolumeSerial(char* pathOnDrive);
-int ValidatePath(_DEV_BROADCAST_VOLUME* dbv, int mode, char* szStoredExternalPath, int storedSerial);
-void MakePathCurrent();
 void ResetPath();
 
+static int blinkTimer = SCHED_NONE;
+
+// The label of a missing drive blinks, on the SchedulerThread
+void PostBlink(void* param) {
+    PostMessage(pPTM->hWndDialog, PTMSG_BLINK, 0, 0);
+}
+
+void StartBlinkTimer() {
+    if (SCHED_NONE == blinkTimer)
+        blinkTimer = SchedAdd(PostBlink, NULL, BLINK_MS, BLINK_MS);
+}
+
+void StopBlinkTimer() {
+    SchedRemove(blinkTimer);
+    blinkTimer = SCHED_NONE;
+}
+
 
 
 // a little margin around the path looks better than the path 
@@ -80,11 +111,6 @@ void InitTransparencySlider(HWND hSlider, int value) {
 }
 
 
-void StopSpaceThread() {
-    ResetEvent(pPTM->hWaitPathSwitch); // block disk_space_thread
-    pPTM->flagNewPath = 1;
-}
-
 INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
     static HBRUSH backgroundQirx, backgroundHalfRed;
     static BOOL doubleClickSwitcher = 0, timerSwitcher = 0;
@@ -95,6 +121,7 @@ INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lPar
     static HFONT hFont;
     int answer;
     char buf[64];
+    DRIVEIDENTITY driveId;
 
     switch (message) {
     case WM_CTLCOLORSTATIC: { // red background for ext. path label
@@ -124,10 +151,19 @@ INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lPar
     }
 
 
-    case WM_TIMER: {
+    case PTMSG_BLINK: {
 // One timer-message may still wait in the message-queue after killing
 // the timer, so the wrong text may be written into the label.
 // Make sure we always write the correct text into the label.
+        if (pPTM->nodeProbing[pPTM->currentNodeSelection] || pPTM->nodePending[pPTM->currentNodeSelection]) {
+            if (timerSwitcher)
+                CompactPathAndSetLabelText(IDC_LBL_EXTERNAL_PATH, GetExternalPathOfNode(pPTM->currentNodeSelection));
+            else
+                SetDlgItemText(hDlg, IDC_LBL_EXTERNAL_PATH,
+                    pPTM->nodePending[pPTM->currentNodeSelection] ? szPathPending : szPathProbing);
+            timerSwitcher = !timerSwitcher;
+            break;
+        }
         switch (pPTM->currentNodeSelection) {
         case NODE_RAW:
             if (timerSwitcher || (pPTM->flagRawDriveOnline)) {
@@ -201,44 +237,42 @@ INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lPar
                     break;
                 }
                 case IDC_BUTTON_SELECT_FOLDER: {
+                    CancelFragCheck();
                     EnableWindow(GetDlgItem(hDlg, IDC_BUTTON_SELECT_FOLDER), 0); // avoid re-entry
                     EnableWindow(GetDlgItem(hDlg, IDC_COMBO_PATH_SELECTOR), 0); // avoid switching
                     switch (pPTM->currentNodeSelection) {
                     case NODE_RAW:
-                        ht = CreateThread(NULL, 0, SelectFolderThread, pPTM->mDlgSet.szExtRawPath, 0, NULL);
+                        ht = CreateEngineThread(SelectFolderThread, pPTM->mDlgSet.szExtRawPath);
                         break;
                     case NODE_AUD:
-                        ht = CreateThread(NULL, 0, SelectFolderThread, pPTM->mDlgSet.szExtAudPath, 0, NULL);
+                        ht = CreateEngineThread(SelectFolderThread, pPTM->mDlgSet.szExtAudPath);
                         break;
                     case NODE_ETI:
-                        ht = CreateThread(NULL, 0, SelectFolderThread, pPTM->mDlgSet.szExtEtiPath, 0, NULL);
+                        ht = CreateEngineThread(SelectFolderThread, pPTM->mDlgSet.szExtEtiPath);
                         break;
                     default:
-                        ht = CreateThread(NULL, 0, SelectFolderThread, pPTM->mDlgSet.szExtTiiPath, 0, NULL);
+                        ht = CreateEngineThread(SelectFolderThread, pPTM->mDlgSet.szExtTiiPath);
                         break;
                     }
                     CloseHandle(ht);
                     break;
                 }
-                case IDC_BUTTON_SET_PATH: {
-                    StopSpaceThread();
-                    MakePathCurrent();
-                    UpdateDlgControls();
-                    SetEvent(pPTM->hWaitPathSwitch); // unblock disk_space_thread
+                case IDC_BUTTON_SET_PATH: { // goes on with PTMSG_FRAG_CHECKED
+                    if (StartFragCheck(pPTM->currentNodeSelection))
+                        EnableWindow(GetDlgItem(hDlg, IDC_BUTTON_SET_PATH), 0);
                     break;
                 }
                 case IDC_BUTTON_RESET_PATH: {
-                    StopSpaceThread();
+                    CancelFragCheck();
                     ResetPath();
                     UpdateDlgControls();
-                    SetEvent(pPTM->hWaitPathSwitch);
+                    PublishSpaceSnapshot();
                     break;
                 }
                 case IDC_CHECK_AUTO_PATH_SWAP: {
                     pPTM->mDlgSet.autoPathSwap = IsDlgButtonChecked(hDlg, IDC_CHECK_AUTO_PATH_SWAP);
 
                     if (pPTM->mDlgSet.autoPathSwap) {
-                        StopSpaceThread();
                         answer = pPTM->currentNodeSelection; // temp save
                         pPTM->currentNodeSelection = NODE_RAW;
                         if (pPTM->flagRawDriveOnline)
@@ -260,7 +294,7 @@ INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lPar
 
                         pPTM->currentNodeSelection = answer;
                         UpdateDlgControls();
-                        SetEvent(pPTM->hWaitPathSwitch); // unblock disk_space_thread
+                        PublishSpaceSnapshot();
                     }
                     break;
                 }
@@ -272,7 +306,7 @@ INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lPar
         } // BN_CLICKED
         else if (HIWORD(wParam) == CBN_SELCHANGE) {
             if (LOWORD(wParam) == IDC_COMBO_PATH_SELECTOR) {
-                StopSpaceThread();
+                CancelFragCheck();
                 pPTM->currentNodeSelection = SendMessage(pPTM->hWndCbNodeSel, CB_GETCURSEL, 0, 0);
                 switch (pPTM->currentNodeSelection) {
                 case NODE_RAW:
@@ -290,7 +324,7 @@ INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lPar
                 }
                 SetDlgItemText(hDlg, IDC_GROUP_DRIVE, buf);
                 UpdateDlgControls();
-                SetEvent(pPTM->hWaitPathSwitch);
+                PublishSpaceSnapshot();
             }
         }
         break;
@@ -300,136 +334,19 @@ INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lPar
     case WM_DEVICECHANGE: {
         switch (wParam) {
             case DBT_DEVICEARRIVAL: {
-                StopSpaceThread();
-
-                if (ValidatePath((_DEV_BROADCAST_VOLUME*)lParam, PT_DRIVE_ARRIVED,
-                    pPTM->mDlgSet.szExtRawPath, pPTM->mDlgSet.rawPathDriveSerial)) {
-                    pPTM->flagRawDriveOnline = 1;
-                    pPTM->flagRawDriveSet = 0;
-
-                    if (pPTM->mDlgSet.autoPathSwap) {
-                        if (ProcessQirxXMLFile(pPTM->mDlgSet.szExtRawPath, needleRawOut, CONFIG_WRITE)) {
-                            memcpy(pPTM->szCurrentRawPath, pPTM->mDlgSet.szExtRawPath, MAX_PATH_BUFFER_SIZE);
-                            pPTM->flagRawDriveSet = 1;
-                        }
-                    }
-                }
-
-                if (ValidatePath((_DEV_BROADCAST_VOLUME*)lParam, PT_DRIVE_ARRIVED,
-                    pPTM->mDlgSet.szExtAudPath, pPTM->mDlgSet.audPathDriveSerial)) {
-                    pPTM->flagAudDriveOnline = 1;
-                    pPTM->flagAudDriveSet = 0;
-
-                    if (pPTM->mDlgSet.autoPathSwap) {
-                        if (ProcessQirxXMLFile(pPTM->mDlgSet.szExtAudPath, needleAudOut, CONFIG_WRITE)) {
-                            memcpy(pPTM->szCurrentAudPath, pPTM->mDlgSet.szExtAudPath, MAX_PATH_BUFFER_SIZE);
-                            pPTM->flagAudDriveSet = 1;
-                        }
-                    }
-                }
-
-                if (ValidatePath((_DEV_BROADCAST_VOLUME*)lParam, PT_DRIVE_ARRIVED,
-                    pPTM->mDlgSet.szExtTiiPath, pPTM->mDlgSet.tiiPathDriveSerial)) {
-                    pPTM->flagTiiDriveOnline = 1;
-                    pPTM->flagTiiDriveSet = 0;
-
-                    if (pPTM->mDlgSet.autoPathSwap) {
-                        if (ProcessQirxXMLFile(pPTM->mDlgSet.szExtTiiPath, needleTiiLog, CONFIG_WRITE)) {
-                            memcpy(pPTM->szCurrentTiiPath, pPTM->mDlgSet.szExtTiiPath, MAX_PATH_BUFFER_SIZE);
-                            pPTM->flagTiiDriveSet = 1;
-                        }
-                    }
-                }
-  
-                if (pPTM->flagIsQ5) {
-
-                    if (ValidatePath((_DEV_BROADCAST_VOLUME*)lParam, PT_DRIVE_ARRIVED,
-                        pPTM->mDlgSet.szExtEtiPath, pPTM->mDlgSet.etiPathDriveSerial)) {
-                        pPTM->flagEtiDriveOnline = 1;
-                        pPTM->flagEtiDriveSet = 0;
-                        
-                        if (pPTM->mDlgSet.autoPathSwap) {
-                            if (ProcessQirxXMLFile(pPTM->mDlgSet.szExtEtiPath, needleEtiOut, CONFIG_WRITE)) {
-                                memcpy(pPTM->szCurrentEtiPath, pPTM->mDlgSet.szExtEtiPath, MAX_PATH_BUFFER_SIZE);
-                                pPTM->flagEtiDriveSet = 1;
-                            }
-                        }
-                    }
-
-                    if (pPTM->flagAudDriveOnline && pPTM->flagRawDriveOnline
-                        && pPTM->flagTiiDriveOnline && pPTM->flagEtiDriveOnline)
-                        TIMER_OFF;
-                }
-                else {
-
-                    if (pPTM->flagAudDriveOnline && pPTM->flagRawDriveOnline
-                        && pPTM->flagTiiDriveOnline)
-                        TIMER_OFF;
-                }
-
+                TakeArrivedDrive((_DEV_BROADCAST_VOLUME*)lParam);
+                if (AllDrivesOnline())
+                    TIMER_OFF;
                 UpdateDlgControls();
-                SetEvent(pPTM->hWaitPathSwitch); // go, disk_space_thread
                 ret = true;
                 break;
             }
 
             case DBT_DEVICEREMOVECOMPLETE: {
-                StopSpaceThread();
-
-                if (ValidatePath((_DEV_BROADCAST_VOLUME*)lParam, PT_DRIVE_REMOVED,
-                    pPTM->mDlgSet.szExtRawPath, pPTM->mDlgSet.rawPathDriveSerial)) {
-                    pPTM->flagRawDriveOnline = 0;
-
-                    if (ProcessQirxXMLFile(pPTM->szOriginalRawPath, needleRawOut, CONFIG_WRITE)) {
-                        memcpy(pPTM->szCurrentRawPath, pPTM->szOriginalRawPath, MAX_PATH_BUFFER_SIZE);
-                        pPTM->flagRawDriveSet = 0;
-                    }
-                }
-
-                if (ValidatePath((_DEV_BROADCAST_VOLUME*)lParam, PT_DRIVE_REMOVED,
-                    pPTM->mDlgSet.szExtAudPath, pPTM->mDlgSet.audPathDriveSerial)) {
-                    pPTM->flagAudDriveOnline = 0;
-
-                    if (ProcessQirxXMLFile(pPTM->szOriginalAudPath, needleAudOut, CONFIG_WRITE)) {
-                        memcpy(pPTM->szCurrentAudPath, pPTM->szOriginalAudPath, MAX_PATH_BUFFER_SIZE);
-                        pPTM->flagAudDriveSet = 0;
-                    }
-                }
-
-                if (ValidatePath((_DEV_BROADCAST_VOLUME*)lParam, PT_DRIVE_REMOVED,
-                    pPTM->mDlgSet.szExtTiiPath, pPTM->mDlgSet.tiiPathDriveSerial)) {
-                    pPTM->flagTiiDriveOnline = 0;
-
-                    if (ProcessQirxXMLFile(pPTM->szOriginalTiiPath, needleTiiLog, CONFIG_WRITE)) {
-                        memcpy(pPTM->szCurrentTiiPath, pPTM->szOriginalTiiPath, MAX_PATH_BUFFER_SIZE);
-                        pPTM->flagTiiDriveSet = 0;
-                    }
-                }
-
-                if (pPTM->flagIsQ5) {
-                    
-                    if (ValidatePath((_DEV_BROADCAST_VOLUME*)lParam, PT_DRIVE_REMOVED,
-                        pPTM->mDlgSet.szExtEtiPath, pPTM->mDlgSet.etiPathDriveSerial)) {
-                        pPTM->flagEtiDriveOnline = 0;
-                        
-                        if (ProcessQirxXMLFile(pPTM->szOriginalEtiPath, needleEtiOut, CONFIG_WRITE)) {
-                            memcpy(pPTM->szCurrentEtiPath, pPTM->szOriginalEtiPath, MAX_PATH_BUFFER_SIZE);
-                            pPTM->flagEtiDriveSet = 0;
-                        }
-                    }
-
-                    if (!pPTM->flagAudDriveOnline || !pPTM->flagRawDriveOnline ||
-                        !pPTM->flagTiiDriveOnline || !pPTM->flagEtiDriveOnline)
-                        TIMER_ON;
-                }
-                else {
-                    if (!pPTM->flagAudDriveOnline || !pPTM->flagRawDriveOnline ||
-                        !pPTM->flagTiiDriveOnline)
-                        TIMER_ON;
-                }
-
+                ReleaseRemovedDrive((_DEV_BROADCAST_VOLUME*)lParam);
+                if (!AllDrivesOnline())
+                    TIMER_ON;
                 UpdateDlgControls();
-                SetEvent(pPTM->hWaitPathSwitch); // go, disk_space_thread
                 ret = true;
                 break;
             }
@@ -481,6 +398,8 @@ INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lPar
 
 
     case PTMSG_FOLDER_SELECTION_READY: {
+        if (ReadDriveIdentity(GetExternalPathOfNode(pPTM->currentNodeSelection), &driveId))
+            SetDriveIdentity(pPTM->currentNodeSelection, &driveId);
         switch (pPTM->currentNodeSelection) {
         case NODE_RAW:
             pPTM->flagRawDriveOnline = 1;
@@ -506,11 +425,8 @@ INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lPar
         EnableWindow(GetDlgItem(hDlg, IDC_BUTTON_SELECT_FOLDER), 1);
         EnableWindow(GetDlgItem(hDlg, IDC_COMBO_PATH_SELECTOR), 1);
 
-        if (pPTM->mDlgSet.autoPathSwap) {
-            StopSpaceThread();
-            MakePathCurrent();
-            SetEvent(pPTM->hWaitPathSwitch);
-        }
+        if (pPTM->mDlgSet.autoPathSwap) // goes on with PTMSG_FRAG_CHECKED
+            StartFragCheck(pPTM->currentNodeSelection);
 
         UpdateDlgControls();
         WriteDlgConfigFile();
@@ -528,6 +444,46 @@ INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lPar
 
         break;
     }
+    case PTMSG_FOLDER_ROLLOVER: { // the date of the subfolder changed
+        RollOverFolder((int)wParam);
+        UpdateDlgControls();
+        break;
+    }
+    case PTMSG_PATH_PLAN: { // a path plan is due
+        if (RunPathPlan((int)wParam, (int)lParam))
+            UpdateDlgControls();
+        break;
+    }
+    case PTMSG_CONTROL: { // the control pipe waits for the result
+        answer = RunPathPlan((int)wParam, (int)lParam);
+        if (answer)
+            UpdateDlgControls();
+        SetWindowLongPtr(hDlg, DWLP_MSGRESULT, answer);
+        ret = TRUE;
+        break;
+    }
+    case PTMSG_FRAG_CHECKED: { // the drive of the path is fine, or wanted anyway
+        if (TakeFragCheck(lParam) && (int)wParam == pPTM->currentNodeSelection) {
+            MakePathCurrent();
+            PublishSpaceSnapshot();
+        }
+        UpdateDlgControls();
+        break;
+    }
+    case PTMSG_PROBE_RESULT: { // a stored path was looked at
+        TakeProbeResult((int)wParam, (int)lParam);
+        if (AllDrivesOnline())
+            TIMER_OFF;
+        UpdateDlgControls();
+        break;
+    }
+    case PTMSG_IDENTITY_ANSWER: {
+        TakeIdentityAnswer((int)wParam, (int)lParam);
+        if (AllDrivesOnline())
+            TIMER_OFF;
+        UpdateDlgControls();
+        break;
+    }
     case PTMSG_FOLDER_SELECTION_ERROR: {
         MessageBox(hDlg, szMsgSelectFolderErr, szAppName, MB_ICONERROR | MB_SETFOREGROUND);
     }
@@ -557,19 +513,9 @@ INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lPar
         SendMessage(pPTM->hWndCbNodeSel, CB_ADDSTRING, 0, (LPARAM)szRaw);
         SendMessage(pPTM->hWndCbNodeSel, CB_ADDSTRING, 0, (LPARAM)szAudio);
         SendMessage(pPTM->hWndCbNodeSel, CB_ADDSTRING, 0, (LPARAM)szTii);
-        // Read the original paths from the config-file.
-        if (ProcessQirxXMLFile(pPTM->szOriginalRawPath, needleRawOut, CONFIG_READ))
-            memcpy(pPTM->szCurrentRawPath, pPTM->szOriginalRawPath, MAX_PATH_BUFFER_SIZE);
-        if (ProcessQirxXMLFile(pPTM->szOriginalAudPath, needleAudOut, CONFIG_READ))
-            memcpy(pPTM->szCurrentAudPath, pPTM->szOriginalAudPath, MAX_PATH_BUFFER_SIZE);
-        if (ProcessQirxXMLFile(pPTM->szOriginalTiiPath, needleTiiLog, CONFIG_READ))
-            memcpy(pPTM->szCurrentTiiPath, pPTM->szOriginalTiiPath, MAX_PATH_BUFFER_SIZE);
-
-        if (pPTM->flagIsQ5) { // skip entry if version !5
+        if (pPTM->flagIsQ5) // skip entry if version !5
             SendMessage(pPTM->hWndCbNodeSel, CB_ADDSTRING, 0, (LPARAM)szEti);
-            if (ProcessQirxXMLFile(pPTM->szOriginalEtiPath, needleEtiOut, CONFIG_READ))
-                memcpy(pPTM->szCurrentEtiPath, pPTM->szOriginalEtiPath, MAX_PATH_BUFFER_SIZE);
-        }
+        ReadOriginalPaths();
         
         SendMessage(pPTM->hWndCbNodeSel, CB_SETCURSEL, 0, 0);
 
@@ -581,36 +527,9 @@ INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lPar
         InitTransparencySlider(GetDlgItem(hDlg, IDC_SLIDER_TRANSP), pPTM->mDlgSet.transparency);
         SetLayeredWindowAttributes(hDlg, 0, pPTM->mDlgSet.transparency, LWA_ALPHA);
 
-        pPTM->flagRawDriveOnline = CheckPathExists(pPTM->mDlgSet.szExtRawPath);
-        if (pPTM->flagRawDriveOnline)
-            pPTM->flagRawDriveOnline =
-            SerialCheck(pPTM->mDlgSet.szExtRawPath, pPTM->mDlgSet.rawPathDriveSerial);
-
-        pPTM->flagAudDriveOnline = CheckPathExists(pPTM->mDlgSet.szExtAudPath);
-        if (pPTM->flagAudDriveOnline)
-            pPTM->flagAudDriveOnline =
-            SerialCheck(pPTM->mDlgSet.szExtAudPath, pPTM->mDlgSet.audPathDriveSerial);
-
-        pPTM->flagTiiDriveOnline = CheckPathExists(pPTM->mDlgSet.szExtTiiPath);
-        if (pPTM->flagTiiDriveOnline)
-            pPTM->flagTiiDriveOnline =
-            SerialCheck(pPTM->mDlgSet.szExtTiiPath, pPTM->mDlgSet.tiiPathDriveSerial);
-        
-        if (pPTM->flagIsQ5) {
-            pPTM->flagEtiDriveOnline = CheckPathExists(pPTM->mDlgSet.szExtEtiPath);
-            if (pPTM->flagEtiDriveOnline)
-                pPTM->flagEtiDriveOnline =
-                SerialCheck(pPTM->mDlgSet.szExtEtiPath, pPTM->mDlgSet.etiPathDriveSerial);
-            
-            if (!pPTM->flagAudDriveOnline || !pPTM->flagRawDriveOnline ||
-                !pPTM->flagTiiDriveOnline || !pPTM->flagEtiDriveOnline)
-                TIMER_ON;
-        }
-        else {
-            if (!pPTM->flagAudDriveOnline || !pPTM->flagRawDriveOnline ||
-                !pPTM->flagTiiDriveOnline)
-                TIMER_ON;
-        }
+        // the drives are looked at in the background, see drive_probe.cpp
+        StartDriveProbes();
+        TIMER_ON;
 
 
         // simulating clicks
@@ -625,7 +544,7 @@ INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lPar
         pPTM->labelWidth = rc.right - rc.left + 48; // needs to be revisited
 
         UpdateDlgControls();
-        pPTM->hDiskSpaceThread = CreateThread(NULL, 0, DiskSpaceThread, NULL, 0, NULL);
+        StartEngine();
         ret = true;
         break;
     }
@@ -645,6 +564,7 @@ INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lPar
             DeleteObject(backgroundQirx);
             DeleteObject(backgroundHalfRed);
             DeleteObject(hFont);
+            CancelFragCheck();
             DestroyWindow(hDlg);
         }
         break;
@@ -656,107 +576,8 @@ INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lPar
     return ret;
 }
 
-
-// The message from the system may report not only one volume on 
-// a physical drive, so we have to loop through the unitmask. 
-
-int ValidatePath(_DEV_BROADCAST_VOLUME* dbv, int mode,
-    char* szStoredExternalPath, int storedSerial) {
-    int ret = 0;
-    char driveLetter;
-    DWORD mask, idx;
-
-    if (DBT_DEVTYP_VOLUME == dbv->dbcv_devicetype) {
-        mask = dbv->dbcv_unitmask;
-        int numDevs = __popcntd(mask); // count the volumes
-
-        for (int i = 0; i < numDevs; i++) {
-            idx = _bit_scan_forward(mask);
-            driveLetter = chDriveBase + idx;
-            if (toupper(driveLetter) == toupper(szStoredExternalPath[0])) {
-                if (PT_DRIVE_ARRIVED == mode) {
-                    if (CheckPathExists(szStoredExternalPath)) {
-                        if (SerialCheck(szStoredExternalPath, storedSerial))
-                            ret++; // all is fine, go out
-                        goto out;
-                    }
-                    else // path not found on drive, go out
-                        goto out;
-                }
-                else {
-                    ret++;
-                    goto out;
-                }
-            }
-            // reset the lowest bit and check the next drive-letter (if any)
-            _bittestandreset((LONG*)&mask, idx);
-        }
-    }
-out:
-    return ret;
-}
-
-void MakePathCurrent() {
-    switch (pPTM->currentNodeSelection) {
-    case NODE_RAW:
-        if (ProcessQirxXMLFile(pPTM->mDlgSet.szExtRawPath, needleRawOut, CONFIG_WRITE)) {
-            memcpy(pPTM->szCurrentRawPath, pPTM->mDlgSet.szExtRawPath, MAX_PATH_BUFFER_SIZE);
-            pPTM->flagRawDriveSet = 1;
-        }
-        break;
-
-    case NODE_AUD:
-        if (ProcessQirxXMLFile(pPTM->mDlgSet.szExtAudPath, needleAudOut, CONFIG_WRITE)) {
-            memcpy(pPTM->szCurrentAudPath, pPTM->mDlgSet.szExtAudPath, MAX_PATH_BUFFER_SIZE);
-            pPTM->flagAudDriveSet = 1;
-        }
-        break;
-
-    case NODE_ETI:
-        if (ProcessQirxXMLFile(pPTM->mDlgSet.szExtEtiPath, needleEtiOut, CONFIG_WRITE)) {
-            memcpy(pPTM->szCurrentEtiPath, pPTM->mDlgSet.szExtEtiPath, MAX_PATH_BUFFER_SIZE);
-            pPTM->flagEtiDriveSet = 1;
-        }
-        break;
-
-    default:
-        if (ProcessQirxXMLFile(pPTM->mDlgSet.szExtTiiPath, needleTiiLog, CONFIG_WRITE)) {
-            memcpy(pPTM->szCurrentTiiPath, pPTM->mDlgSet.szExtTiiPath, MAX_PATH_BUFFER_SIZE);
-            pPTM->flagTiiDriveSet = 1;
-        }
-        break;
-    }
-}
-
 void ResetPath() {
-    switch (pPTM->currentNodeSelection) {
-    case NODE_RAW:
-        if (ProcessQirxXMLFile(pPTM->szOriginalRawPath, needleRawOut, CONFIG_WRITE)) {
-            memcpy(pPTM->szCurrentRawPath, pPTM->szOriginalRawPath, MAX_PATH_BUFFER_SIZE);
-            pPTM->flagRawDriveSet = 0;
-        }
-        break;
-    case NODE_AUD:
-        if (ProcessQirxXMLFile(pPTM->szOriginalAudPath, needleAudOut, CONFIG_WRITE)) {
-            memcpy(pPTM->szCurrentAudPath, pPTM->szOriginalAudPath, MAX_PATH_BUFFER_SIZE);
-            pPTM->flagAudDriveSet = 0;
-        }
-        break;
-
-    case NODE_ETI:
-        if (ProcessQirxXMLFile(pPTM->szOriginalEtiPath, needleEtiOut, CONFIG_WRITE)) {
-            memcpy(pPTM->szCurrentEtiPath, pPTM->szOriginalEtiPath, MAX_PATH_BUFFER_SIZE);
-            pPTM->flagEtiDriveSet = 0;
-        }
-        break;
-    default:
-        if (ProcessQirxXMLFile(pPTM->szOriginalTiiPath, needleTiiLog, CONFIG_WRITE)) {
-            memcpy(pPTM->szCurrentTiiPath, pPTM->szOriginalTiiPath, MAX_PATH_BUFFER_SIZE);
-            pPTM->flagTiiDriveSet = 0;
-        }
-        break;
-    }
-
+    RestoreOriginalPath();
     if (pPTM->mDlgSet.autoPathSwap) {
         CheckDlgButton(pPTM->hWndDialog, IDC_CHECK_AUTO_PATH_SWAP, BST_UNCHECKED);
         pPTM->mDlgSet.autoPathSwap = 0;
@@ -819,26 +640,3 @@ void UpdateDlgControls() {
         DisableAllButtons();
 }
 
-DWORD GetVolumeSerial(char* pathOnDrive) {
-    char drive[8]{};
-    DWORD serial = 0;
-    memcpy(drive, pathOnDrive, 3);
-    GetVolumeInformation(drive, NULL, 0, &serial, NULL, NULL, NULL, 0);
-    return serial;
-}
-
-int SerialCheck(char* szStoredExternalPath, DWORD storedSerial) {
-    int answer, ret = 0;
-    char msg[384];
-
-    if (GetVolumeSerial(szStoredExternalPath) == storedSerial)
-        ret++;
-    else {
-        sprintf(msg, "%s\n\n%s", szStoredExternalPath, szMsgSerialCheck);
-        answer = MessageBox(pPTM->hWndDialog, msg,
-            "PathTweaker - drive serial check", MB_YESNO | MB_SETFOREGROUND | MB_ICONQUESTION);
-        if (IDYES == answer)
-            ret++;
-    }
-    return ret;
-}
@@ -26,21 +26,20 @@
 
 #include "PathTweaker.h"
 
-#define AVG_UPDATE_INTERVAL 20 // one speed meassurement every AVG_UPDATE_INTERVAL seconds
+extern ULONGLONG GetReservedBytes(const char* szPath);
+extern int SchedAddIo(PFNSCHEDPROC pfn, void* param, DWORD dueMs, DWORD periodMs);
+extern void SeqPublish(volatile LONG* pSequence, void* pShared, const void* pData, DWORD size);
+extern DWORD SeqRead(volatile LONG* pSequence, const void* pShared, void* pData, DWORD size);
+extern int IsNodeOnline(int node);
+extern DWORD GetVolumeSerial(char* pathOnDrive);
+extern void AppendSample(int node, const NODESPACE* pSpace, int external, const FILETIME* pTime);
+
 const double cdOneMillionByte = 1'000'000.0; // We want to see the speed in million bytes per sec. ("4.096") 
 const double cdMinRawWriteSpeed = 4'000'000.0; // ADS-B (2 MSpl/s and at least two bytes per sample)
 const double cdMinEtiWriteSpeed = 250'000.0;   // A little bit below 2 Mbit/s
 
 
 
-struct MOVINGAVERAGEARRAY {
-    double* pArrayValues;
-    unsigned int arrayInsertIndex;
-    unsigned int numElements;
-};
-
-
-
 int InitMovingAverageArray(MOVINGAVERAGEARRAY* pAvgArray, unsigned int numElements);
 void InsertMovingAverageValue(MOVINGAVERAGEARRAY* pAvgArray, double newVal);
 void SetAllMovingAverageValues(MOVINGAVERAGEARRAY* pAvgArray, double value);
@@ -48,114 +47,239 @@ double GetMovingAverage(MOVINGAVERAGEARRAY* pAvgArray);
 void FreeMovingAverageArray(MOVINGAVERAGEARRAY* pAvgArray);
 
 
-DWORD WINAPI DiskSpaceThread(LPVOID DTM) {
+// The free space and the write speed of the current paths, once a second
+// on the worker of the station (SchedAddIo(), scheduler.cpp): a drive
+// which hangs holds up this station only. Each node has its own
+// averages, the dialog shows the ones of the selected node. The paths
+// come from the snapshot the dialog publishes after each path switch (see
+// snapshot.cpp), the tick never waits for the dialog. What the tick found
+// goes out the same way, for the control pipe (control_pipe.cpp), and
+// each sample goes to the ring file (sample_ring.cpp).
+// The estimator itself, SampleNode(), asks a SPACEINPUT for the time and
+// the free space, "-spacereplay" (space_replay.cpp) gives it traces.
+static struct DISKSPACE {
+    SPACEINPUT input;
+    NODESAMPLER nodes[4];
+    SPACESTATUS status;
+    int timer;
+} diskSpaces[STATION_MAX];
+
+// On the dialog's thread, after each path switch and each change of the
+// selected node
+void PublishSpaceSnapshot() {
+    const SPACESNAPSHOT* pLast = &pPTM->spaceSnap.snap; // we are the only writer
+    const char* szCurrent[4] = { pPTM->szCurrentRawPath, pPTM->szCurrentAudPath,
+        pPTM->szCurrentTiiPath, pPTM->szCurrentEtiPath };
+    const int set[4] = { pPTM->flagRawDriveSet, pPTM->flagAudDriveSet,
+        pPTM->flagTiiDriveSet, pPTM->flagEtiDriveSet };
+    SPACESNAPSHOT snap;
+
+    snap.generation = pLast->generation + 1;
+    snap.node = pPTM->currentNodeSelection;
+    for (int node = 0; node < 4; node++) {
+        lstrcpyn(snap.szPaths[node], szCurrent[node], MAX_PATH_BUFFER_SIZE);
+        if (lstrcmp(snap.szPaths[node], pLast->szPaths[node])) {
+            snap.changed[node] = snap.generation;
+            if (pLast->generation) // the first one is no switch
+                InterlockedIncrement64(&pPTM->counters.pathSwitches);
+        }
+        else
+            snap.changed[node] = pLast->changed[node];
+        snap.online[node] = (BYTE)IsNodeOnline(node);
+        snap.external[node] = (BYTE)set[node];
+    }
+    SeqPublish(&pPTM->spaceSnap.sequence, &pPTM->spaceSnap.snap, &snap, sizeof(snap));
+}
+
+void SystemSpaceClock(void* param, LARGE_INTEGER* pNow) {
+    QueryPerformanceCounter(pNow);
+}
+
+BOOL SystemSpaceQuery(void* param, const char* szPath, ULARGE_INTEGER* pFree, ULARGE_INTEGER* pTotal) {
+    ULARGE_INTEGER ullFree;
+
+    if (!GetDiskFreeSpaceEx(szPath, pFree, pTotal, &ullFree))
+        return FALSE;
+    // our placeholder is free space for QIRX, see space_reserve.cpp
+    pFree->QuadPart += GetReservedBytes(szPath);
+    return TRUE;
+}
+
+DWORD SystemSpaceSerial(void* param, char* szPath) {
+    return GetVolumeSerial(szPath);
+}
+
+// The time left is never counted with less
+double MinWriteSpeed(int node) {
+    return NODE_ETI == node ? cdMinEtiWriteSpeed : cdMinRawWriteSpeed;
+}
+
+// Returns 0 if the drive doesn't answer
+int SampleNode(NODESAMPLER* pNs, const SPACEINPUT* pIn, int node, const char* szPath, NODESPACE* pSpace) {
+    double speed, minSpeed, deltaTime;
+    LARGE_INTEGER liStart, liCurTime;
+    ULARGE_INTEGER ullFreeToCaller, ullDisk;
+    int ret = 0;
+
+    pIn->pfnClock(pIn->param, &liStart);
+    if (!pIn->pfnQuery(pIn->param, szPath, &ullFreeToCaller, &ullDisk)) {
+        InterlockedIncrement64(&pPTM->counters.spaceFailures);
+        return ret;
+    }
+    pIn->pfnClock(pIn->param, &liCurTime);
+    pSpace->sampleMicros = (DWORD)((liCurTime.QuadPart - liStart.QuadPart) * pIn->tickPeriod * 1000000.0);
+    if (pSpace->sampleMicros >= SPACE_STALL_MS * 1000)
+        InterlockedIncrement64(&pPTM->counters.spaceStalls);
+    minSpeed = MinWriteSpeed(node);
+
+    // a new path, start over
+    if (lstrcmp(szPath, pNs->szPath)) {
+        lstrcpyn(pNs->szPath, szPath, MAX_PATH_BUFFER_SIZE);
+        pNs->volumeSerial = pIn->pfnSerial(pIn->param, pNs->szPath);
+        pNs->ullLastSpace = ullFreeToCaller;
+        pNs->liLastTick = liCurTime;
+        pNs->ullOldSpace = ullFreeToCaller;
+        SetAllMovingAverageValues(&pNs->speedAvgArr, minSpeed);
+        pNs->displayCounter = SPACE_AVG_INTERVAL;
+    }
+
+    if (pNs->displayCounter == SPACE_AVG_INTERVAL) {
+        if (ullFreeToCaller.QuadPart <= pNs->ullOldSpace.QuadPart) {
+
+            deltaTime = (liCurTime.QuadPart - pNs->liOldTime.QuadPart) * pIn->tickPeriod;
+            speed = (pNs->ullOldSpace.QuadPart - ullFreeToCaller.QuadPart) / deltaTime;
+
+            InsertMovingAverageValue(&pNs->displaySpeedAvgArr, speed);
+            if (speed < minSpeed)
+                speed = minSpeed;
+        }
+        else {
+            SetAllMovingAverageValues(&pNs->speedAvgArr, minSpeed);
+            speed = minSpeed;
+        }
+        InsertMovingAverageValue(&pNs->speedAvgArr, speed);
+        pNs->ullOldSpace = ullFreeToCaller;
+        pNs->liOldTime = liCurTime;
+        pNs->displayCounter = 0;
+    }
+    pNs->displayCounter++;
+
+    deltaTime = (liCurTime.QuadPart - pNs->liLastTick.QuadPart) * pIn->tickPeriod;
+    if (deltaTime > 0.0)
+        pSpace->rate = ((double)pNs->ullLastSpace.QuadPart - (double)ullFreeToCaller.QuadPart) / deltaTime;
+    else
+        pSpace->rate = 0.0;
+    pNs->ullLastSpace = ullFreeToCaller;
+    pNs->liLastTick = liCurTime;
+
+    pSpace->volumeSerial = pNs->volumeSerial;
+    pSpace->freeBytes = ullFreeToCaller.QuadPart;
+    pSpace->totalBytes = ullDisk.QuadPart;
+    pSpace->writeSpeed = GetMovingAverage(&pNs->displaySpeedAvgArr);
+    pSpace->remSeconds = (ULONGLONG)(ullFreeToCaller.QuadPart / GetMovingAverage(&pNs->speedAvgArr));
+    ret++;
+    return ret;
+}
+
+// The path of the node in the snapshot. A path switched away from and back
+// since the last sample starts over, too: the drive may be another one.
+int SampleSnapshotNode(NODESAMPLER* pNs, const SPACEINPUT* pIn, const SPACESNAPSHOT* pSnap, int node,
+    NODESPACE* pSpace) {
+    if (pSnap->changed[node] != pNs->changed) {
+        pNs->changed = pSnap->changed[node];
+        pNs->szPath[0] = 0;
+    }
+    return SampleNode(pNs, pIn, node, pSnap->szPaths[node], pSpace);
+}
+
+void DiskSpaceTick(void* param) {
+    DISKSPACE* pDs = &diskSpaces[pPTM->station];
+    SPACESNAPSHOT snap;
+    NODESPACE* pShown;
+    FILETIME ftNow;
     char buff[32];
-    int a, b, displayCounter = 0;
-    double displaySpeed, deltaTime, qpfPeriod;
-    LARGE_INTEGER qpf, liOldTime, liCurTime;
-    ULARGE_INTEGER ullFreeToCaller, ullDisk, ullFree, ullOldSpace;
     unsigned long long remTime, hours, minutes;
-    MOVINGAVERAGEARRAY speedAvgArr, displaySpeedAvgArr;
-
-    GetDiskFreeSpaceEx(pPTM->szCurrentRawPath, &ullFreeToCaller, &ullDisk, &ullFree);
-    ullOldSpace = ullFreeToCaller;
- 
-    a = InitMovingAverageArray(&speedAvgArr, 20);
-    b = InitMovingAverageArray(&displaySpeedAvgArr, 3);
-
-    if (a && b) {
-        SetAllMovingAverageValues(&speedAvgArr, cdMinRawWriteSpeed);
-
-
-        QueryPerformanceFrequency(&qpf);
-        qpfPeriod = 1.0 / qpf.QuadPart;
-        QueryPerformanceCounter(&liOldTime);
-        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
-
-        while (!pPTM->finishThread) {
-            // Wait here until possible path-switching stuff is over.
-            // pPTM->flagNewPath is set when we can go again.
-            WaitForSingleObject(pPTM->hWaitPathSwitch, INFINITE);
-
-            switch (pPTM->currentNodeSelection) {
-            case NODE_RAW:
-                GetDiskFreeSpaceEx(pPTM->szCurrentRawPath, &ullFreeToCaller, &ullDisk, &ullFree);
-                break;
-            case NODE_AUD:
-                GetDiskFreeSpaceEx(pPTM->szCurrentAudPath, &ullFreeToCaller, &ullDisk, &ullFree);
-                break;
-            case NODE_ETI:
-                GetDiskFreeSpaceEx(pPTM->szCurrentEtiPath, &ullFreeToCaller, &ullDisk, &ullFree);
-                break;
-            default:
-                GetDiskFreeSpaceEx(pPTM->szCurrentTiiPath, &ullFreeToCaller, &ullDisk, &ullFree);
-                break;
-            }
-
-            if (pPTM->flagNewPath) {
-                ullOldSpace = ullFreeToCaller;
-
-                if (pPTM->currentNodeSelection == NODE_ETI)
-                    SetAllMovingAverageValues(&speedAvgArr, cdMinEtiWriteSpeed);
-                else
-                    SetAllMovingAverageValues(&speedAvgArr, cdMinRawWriteSpeed);
-
-                displayCounter = AVG_UPDATE_INTERVAL;
-                pPTM->flagNewPath = 0;
-            }
-
-            if (displayCounter == AVG_UPDATE_INTERVAL) {
-                if (ullFreeToCaller.QuadPart <= ullOldSpace.QuadPart) {
-
-                    QueryPerformanceCounter(&liCurTime);
-                    deltaTime = (liCurTime.QuadPart - liOldTime.QuadPart) * qpfPeriod;
-                    displaySpeed = (ullOldSpace.QuadPart - ullFreeToCaller.QuadPart) / deltaTime;
-
-                    InsertMovingAverageValue(&displaySpeedAvgArr, displaySpeed);
-                    sprintf(buff, "%.3f", GetMovingAverage(&displaySpeedAvgArr) / cdOneMillionByte);
-                    SetWindowText(pPTM->hWndLbWriteSpeed, buff);
-
-                    if (pPTM->currentNodeSelection == NODE_ETI) {
-                        if (displaySpeed < cdMinEtiWriteSpeed)
-                            displaySpeed = cdMinEtiWriteSpeed;
-                    }
-                    else {
-                        if (displaySpeed < cdMinRawWriteSpeed)
-                            displaySpeed = cdMinRawWriteSpeed;
-                    }
-                }
-                else {
-                    if (pPTM->currentNodeSelection == NODE_ETI) {
-                        SetAllMovingAverageValues(&speedAvgArr, cdMinEtiWriteSpeed);
-                        displaySpeed = cdMinEtiWriteSpeed;
-                    }
-                    else {
-                        SetAllMovingAverageValues(&speedAvgArr, cdMinRawWriteSpeed);
-                        displaySpeed = cdMinRawWriteSpeed;
-                    }
-                }
-                InsertMovingAverageValue(&speedAvgArr, displaySpeed);
-                ullOldSpace = ullFreeToCaller;
-                liOldTime = liCurTime;
-                displayCounter = 0;
-            }
-
-            remTime =  (unsigned long long)(ullFreeToCaller.QuadPart / GetMovingAverage(&speedAvgArr));
-            hours = remTime / 3600;
-            remTime -= hours * 3600;
-            minutes = remTime / 60;
-            remTime -= minutes * 60;
-
-            sprintf(buff, "%02llu:%02llu:%02llu", hours, minutes, remTime);
-            SetWindowText(pPTM->hWndLbRemRecTime, buff);
-            displayCounter++;
-            Sleep(1000);
+
+    InterlockedIncrement64(&pPTM->counters.lockReads);
+    InterlockedAdd64(&pPTM->counters.lockRetries,
+        SeqRead(&pPTM->spaceSnap.sequence, &pPTM->spaceSnap.snap, &snap, sizeof(snap)));
+    GetSystemTimeAsFileTime(&ftNow);
+    for (int node = 0; node < 4; node++) {
+        if (snap.szPaths[node][0] &&
+            SampleSnapshotNode(&pDs->nodes[node], &pDs->input, &snap, node, &pDs->status.nodes[node])) {
+            pDs->status.nodes[node].generation = snap.generation;
+            AppendSample(node, &pDs->status.nodes[node], snap.external[node], &ftNow);
         }
+        else
+            memset(&pDs->status.nodes[node], 0, sizeof(NODESPACE));
     }
+    pDs->status.numTicks++;
+    SeqPublish(&pPTM->spaceStatus.sequence, &pPTM->spaceStatus.status, &pDs->status, sizeof(SPACESTATUS));
+
+    pShown = &pDs->status.nodes[snap.node];
+    if (pPTM->headless || !pShown->generation)
+        return;
+
+    sprintf(buff, "%.3f", pShown->writeSpeed / cdOneMillionByte);
+    SetWindowText(pPTM->hWndLbWriteSpeed, buff);
+
+    remTime = pShown->remSeconds;
+    hours = remTime / 3600;
+    remTime -= hours * 3600;
+    minutes = remTime / 60;
+    remTime -= minutes * 60;
+
+    sprintf(buff, "%02llu:%02llu:%02llu", hours, minutes, remTime);
+    SetWindowText(pPTM->hWndLbRemRecTime, buff);
+}
+
+// The averages of a node, the clock reading pNow at the start
+int InitNodeSampler(NODESAMPLER* pNs, const LARGE_INTEGER* pNow) {
+    int ret = 0;
+
+    memset(pNs, 0, sizeof(NODESAMPLER));
+    if (!InitMovingAverageArray(&pNs->speedAvgArr, SPACE_AVG_SPEEDS) ||
+        !InitMovingAverageArray(&pNs->displaySpeedAvgArr, SPACE_AVG_DISPLAY))
+        return ret;
+    pNs->liOldTime = *pNow;
+    ret++;
+    return ret;
+}
+
+void FreeNodeSampler(NODESAMPLER* pNs) {
+    FreeMovingAverageArray(&pNs->speedAvgArr);
+    FreeMovingAverageArray(&pNs->displaySpeedAvgArr);
+}
+
+int StartDiskSpaceTimer() {
+    DISKSPACE* pDs = &diskSpaces[pPTM->station];
+    LARGE_INTEGER qpf, now;
+    int ret = 0;
+
+    memset(pDs, 0, sizeof(DISKSPACE));
+    PublishSpaceSnapshot();
+    QueryPerformanceFrequency(&qpf);
+    pDs->input.tickPeriod = 1.0 / qpf.QuadPart;
+    pDs->input.pfnClock = SystemSpaceClock;
+    pDs->input.pfnQuery = SystemSpaceQuery;
+    pDs->input.pfnSerial = SystemSpaceSerial;
+    QueryPerformanceCounter(&now);
+
+    for (int node = 0; node < 4; node++)
+        if (!InitNodeSampler(&pDs->nodes[node], &now))
+            return ret;
+    pDs->timer = SchedAddIo(DiskSpaceTick, NULL, 0, 1000);
+    if (SCHED_NONE != pDs->timer)
+        ret++;
+    return ret;
+}
+
+// After the timers of the station are gone, see SchedRemoveStation()
+void FreeDiskSpaceTimer() {
+    DISKSPACE* pDs = &diskSpaces[pPTM->station];
 
-    FreeMovingAverageArray(&speedAvgArr);
-    FreeMovingAverageArray(&displaySpeedAvgArr);
-    return 0;
+    for (int node = 0; node < 4; node++)
+        FreeNodeSampler(&pDs->nodes[node]);
 }
 
 inline int InitMovingAverageArray(MOVINGAVERAGEARRAY* pAvgArray, unsigned int numElements) {
@@ -0,0 +1,245 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+extern void DaemonLog(const char* szFormat, ...);
+extern HANDLE CreateEngineThread(LPTHREAD_START_ROUTINE pfnThread, LPVOID param);
+
+// Is the drive at the stored path the drive the path was selected on? The
+// 32-bit serial number of the file system alone is weak, two cards
+// formatted by the same camera may share it. Next to it we keep the
+// volume GUID Windows gives the partition and the 64-bit serial number
+// NTFS and ReFS have (DRIVEIDENTITY, stored behind the path plans in
+// "dlg.dat"). Old settings without them get them the first time the
+// serial number matches.
+//
+// If the drive is not the stored one, the policy of the node decides,
+// section "[Identity]" of "options.ini", e.g. "Raw=label":
+//   ask     ask the user (default)
+//   trust   take any drive with the path on it
+//   label   take it if the volume label matches, ask otherwise
+//   strict  never take another drive
+// The questions are not modal for the dialog: they come one after the
+// other on a thread of their own, the node waits meanwhile
+// (PTMSG_IDENTITY_ANSWER), all the other nodes go on.
+
+static DRIVEIDENTITY promptFound[STATION_MAX][4];
+static char szPromptPaths[STATION_MAX][4][MAX_PATH_BUFFER_SIZE];
+static int pendingPrompts[STATION_MAX]; // bit per node
+static int promptBusy[STATION_MAX];
+static VOLUMESOURCE volumeSource; // the system if empty
+
+static const char* policyNames[4] = { "ask", "trust", "label", "strict" }; // by IDP_...
+static const char* nodeNames[4] = { "raw", "aud", "tii", "eti" };
+
+
+DWORD GetStoredSerialOfNode(int node) {
+    switch (node) {
+    case NODE_RAW:
+        return pPTM->mDlgSet.rawPathDriveSerial;
+    case NODE_AUD:
+        return pPTM->mDlgSet.audPathDriveSerial;
+    case NODE_ETI:
+        return pPTM->mDlgSet.etiPathDriveSerial;
+    default:
+        return pPTM->mDlgSet.tiiPathDriveSerial;
+    }
+}
+
+// IDP_ASK for unknown names
+int GetIdentityPolicy(const char* szName) {
+    for (int i = 0; i < 4; i++)
+        if (!lstrcmpi(szName, policyNames[i]))
+            return i;
+    return IDP_ASK;
+}
+
+// What the system knows about the drive of szPath
+int ReadSystemDriveIdentity(void* param, const char* szPath, DRIVEIDENTITY* pId) {
+    char szRoot[MAX_PATH_BUFFER_SIZE];
+    FILE_ID_INFO idInfo;
+    HANDLE hDir;
+    int ret = 0;
+
+    memset(pId, 0, sizeof(DRIVEIDENTITY));
+    if (!GetVolumePathName(szPath, szRoot, MAX_PATH_BUFFER_SIZE) ||
+        !GetVolumeInformation(szRoot, pId->szLabel, sizeof(pId->szLabel), &pId->serial, NULL, NULL, NULL, 0))
+        return ret;
+    if (!GetVolumeNameForVolumeMountPoint(szRoot, pId->szVolumeGuid, sizeof(pId->szVolumeGuid)))
+        pId->szVolumeGuid[0] = 0;
+
+    // FAT and exFAT have no 64-bit serial number
+    hDir = CreateFile(szPath, FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        0, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, 0);
+    if (INVALID_HANDLE_VALUE != hDir) {
+        if (GetFileInformationByHandleEx(hDir, FileIdInfo, &idInfo, sizeof(idInfo)) &&
+            idInfo.VolumeSerialNumber != pId->serial)
+            pId->serial64 = idInfo.VolumeSerialNumber;
+        CloseHandle(hDir);
+    }
+    ret++;
+    return ret;
+}
+
+// What we know about the drive of szPath. Returns 0 if the drive doesn't
+// answer.
+int ReadDriveIdentity(const char* szPath, DRIVEIDENTITY* pId) {
+    if (volumeSource.pfnIdentity)
+        return volumeSource.pfnIdentity(volumeSource.param, szPath, pId);
+    return ReadSystemDriveIdentity(NULL, szPath, pId);
+}
+
+// The simulated drives of "-hotplug", NULL for the system again
+void SetVolumeSource(const VOLUMESOURCE* pSource) {
+    if (pSource)
+        volumeSource = *pSource;
+    else
+        memset(&volumeSource, 0, sizeof(VOLUMESOURCE));
+}
+
+// The verdict on the drive found for the node, IDV_... Thread-safe as long
+// as the stored settings don't change.
+int CheckDriveIdentity(int node, const DRIVEIDENTITY* pFound) {
+    const DRIVEIDENTITY* pStored = &pPTM->driveIds.ids[node];
+    int match;
+
+    match = pFound->serial == GetStoredSerialOfNode(node);
+    if (pStored->szVolumeGuid[0] && pFound->szVolumeGuid[0])
+        match = match && !lstrcmpi(pStored->szVolumeGuid, pFound->szVolumeGuid);
+    if (pStored->serial64 && pFound->serial64)
+        match = match && pStored->serial64 == pFound->serial64;
+    if (match)
+        return IDV_MATCH;
+
+    switch (pPTM->opt.identityPolicy[node]) {
+    case IDP_TRUST:
+        return IDV_ACCEPT;
+    case IDP_LABEL:
+        if (pStored->szLabel[0] && !lstrcmp(pStored->szLabel, pFound->szLabel))
+            return IDV_ACCEPT;
+        return IDV_ASK;
+    case IDP_STRICT:
+        return IDV_REJECT;
+    default:
+        return IDV_ASK;
+    }
+}
+
+// A new path was selected, its drive is the one from now on
+void SetDriveIdentity(int node, const DRIVEIDENTITY* pFound) {
+    memcpy(&pPTM->driveIds.ids[node], pFound, sizeof(DRIVEIDENTITY));
+    memcpy(pPTM->driveIds.magic, "DRID", 4);
+}
+
+// Old settings get the stronger identity with the first match of the
+// serial number
+void RememberDriveIdentity(int node, const DRIVEIDENTITY* pFound) {
+    const DRIVEIDENTITY* pStored = &pPTM->driveIds.ids[node];
+
+    if (!pStored->serial && pFound->serial == GetStoredSerialOfNode(node))
+        SetDriveIdentity(node, pFound);
+}
+
+
+DWORD WINAPI IdentityPromptThread(LPVOID param) {
+    char msg[MAX_PATH_BUFFER_SIZE + 512];
+    int node = (int)(INT_PTR)param;
+    int answer;
+
+    sprintf(msg, "%s\n\nsaved:  \"%s\", serial number %08lX\nfound:  \"%s\", serial number %08lX\n\n%s",
+        szPromptPaths[pPTM->station][node], pPTM->driveIds.ids[node].szLabel, GetStoredSerialOfNode(node),
+        promptFound[pPTM->station][node].szLabel, promptFound[pPTM->station][node].serial, szMsgSerialCheck);
+    answer = MessageBox(NULL, msg, "PathTweaker - drive serial check",
+        MB_YESNO | MB_SETFOREGROUND | MB_TOPMOST | MB_ICONQUESTION);
+    PostMessage(pPTM->hWndDialog, PTMSG_IDENTITY_ANSWER, node, IDYES == answer);
+    return 0;
+}
+
+// Shows the next question, if none is on the screen. On the dialog's thread.
+void NextIdentityPrompt() {
+    HANDLE hThread;
+
+    if (promptBusy[pPTM->station])
+        return;
+    for (int node = 0; node < 4; node++) {
+        if (!(pendingPrompts[pPTM->station] & (1 << node)))
+            continue;
+        pendingPrompts[pPTM->station] &= ~(1 << node);
+        hThread = CreateEngineThread(IdentityPromptThread, (LPVOID)(INT_PTR)node);
+        if (hThread) {
+            CloseHandle(hThread);
+            promptBusy[pPTM->station] = 1;
+            break;
+        }
+        pPTM->nodePending[node] = 0;
+    }
+}
+
+void QueueIdentityPrompt(int node, const char* szPath, const DRIVEIDENTITY* pFound) {
+    if (pPTM->nodePending[node])
+        return; // asked already
+    if (pPTM->headless) { // nobody to ask, wait for the stored drive
+        DaemonLog("%s  identity  not the stored drive (serial number %08lX), ignored", nodeNames[node],
+            pFound->serial);
+        return;
+    }
+    lstrcpyn(szPromptPaths[pPTM->station][node], szPath, MAX_PATH_BUFFER_SIZE);
+    memcpy(&promptFound[pPTM->station][node], pFound, sizeof(DRIVEIDENTITY));
+    pPTM->nodePending[node] = 1;
+    pendingPrompts[pPTM->station] |= 1 << node;
+    NextIdentityPrompt();
+}
+
+// The answer to a question is in, on to the next one
+void IdentityPromptDone(int node) {
+    pPTM->nodePending[node] = 0;
+    promptBusy[pPTM->station] = 0;
+    NextIdentityPrompt();
+}
+
+// For a drive arriving: 1 if the node takes it. A question leaves the node
+// waiting for PTMSG_IDENTITY_ANSWER.
+int VerifyDriveIdentity(int node, char* szPath) {
+    DRIVEIDENTITY found;
+    int ret = 0;
+
+    if (!ReadDriveIdentity(szPath, &found))
+        return ret;
+    switch (CheckDriveIdentity(node, &found)) {
+    case IDV_MATCH:
+        RememberDriveIdentity(node, &found);
+        ret++;
+        break;
+    case IDV_ACCEPT:
+        ret++;
+        break;
+    case IDV_ASK:
+        QueueIdentityPrompt(node, szPath, &found);
+        break;
+    }
+    return ret;
+}
@@ -0,0 +1,120 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+// The rawOut node of QIRX's config-file has a "maxSize" attribute next to
+// the path, QIRX starts a new file when a raw-recording reaches it (0: no
+// limit). FAT32 can't hold a file of 4 GiB, a raw-recording gets there
+// after 17 minutes and is lost from then on. Whenever a raw-path goes into
+// the config-file, GetRawMaxSize() looks at the file system of its drive
+// and lowers maxSize for FAT drives. The original paths get QIRX's own
+// setting back.
+//
+// GetLayoutWarning() complains about cluster sizes which slow down long
+// sequential writes, mostly on flash cards formatted by a camera or an
+// old tool.
+
+#define LAYOUT_MIN_CLUSTER_FAT32  (32 * 1024)
+#define LAYOUT_MIN_CLUSTER_EXFAT  (64 * 1024)
+#define LAYOUT_MIN_CLUSTER_NTFS   (4 * 1024)
+
+extern int ProcessQirxXMLNode(const char* nodeNeedle, QIRXATTRIBUTE* pAttribs, int numAttribs, int configReadWrite);
+
+
+// File system name and cluster size of the drive of szPath
+int GetDriveLayout(const char* szPath, char* szFs, DWORD* pClusterSize) {
+    char szRoot[MAX_PATH_BUFFER_SIZE];
+    DWORD sectorsPerCluster, bytesPerSector, freeClusters, totalClusters;
+    int ret = 0;
+
+    if (!GetVolumePathName(szPath, szRoot, MAX_PATH_BUFFER_SIZE) ||
+        !GetVolumeInformation(szRoot, NULL, 0, NULL, NULL, NULL, szFs, 16) ||
+        !GetDiskFreeSpace(szRoot, &sectorsPerCluster, &bytesPerSector, &freeClusters, &totalClusters))
+        return ret;
+    *pClusterSize = sectorsPerCluster * bytesPerSector;
+    ret++;
+    return ret;
+}
+
+int IsFatDrive(const char* szFs) {
+    return !lstrcmpi(szFs, "FAT32") || !lstrcmpi(szFs, "FAT");
+}
+
+// Remembers QIRX's own maxSize, called once with the original paths
+void ReadOriginalRawMaxSize() {
+    QIRXATTRIBUTE attrib{};
+
+    attrib.szName = "maxSize";
+    if (ProcessQirxXMLNode(needleRawOut, &attrib, 1, CONFIG_READ) && lstrlen(attrib.szValue) < 16)
+        lstrcpy(pPTM->szOriginalRawMaxSize, attrib.szValue);
+}
+
+// The maxSize to go with szPath. Returns 0 if maxSize is left alone.
+int GetRawMaxSize(const char* szPath, char* szMaxSize) {
+    char szFs[16];
+    DWORD clusterSize;
+    int maxSize;
+
+    if (!pPTM->opt.tuneMaxSize || !pPTM->szOriginalRawMaxSize[0])
+        return 0;
+
+    lstrcpy(szMaxSize, pPTM->szOriginalRawMaxSize);
+    if (lstrcmpi(szPath, pPTM->szOriginalRawPath) && GetDriveLayout(szPath, szFs, &clusterSize) &&
+        IsFatDrive(szFs)) {
+        maxSize = atoi(pPTM->szOriginalRawMaxSize);
+        if (maxSize <= 0 || maxSize > pPTM->opt.fat32MaxSize)
+            sprintf(szMaxSize, "%d", pPTM->opt.fat32MaxSize);
+    }
+    return 1;
+}
+
+// Returns 0 if the drive of szPath is fine for recordings, else 1 and the
+// reason in szWarning, which holds LAYOUT_WARNING_SIZE bytes
+int GetLayoutWarning(const char* szPath, char* szWarning) {
+    char szFs[16];
+    DWORD clusterSize, minCluster;
+    int ret = 0;
+
+    szWarning[0] = 0;
+    if (!GetDriveLayout(szPath, szFs, &clusterSize))
+        return ret;
+
+    if (IsFatDrive(szFs))
+        minCluster = LAYOUT_MIN_CLUSTER_FAT32;
+    else if (!lstrcmpi(szFs, "exFAT"))
+        minCluster = LAYOUT_MIN_CLUSTER_EXFAT;
+    else
+        minCluster = LAYOUT_MIN_CLUSTER_NTFS;
+
+    if (clusterSize >= minCluster)
+        return ret;
+    _snprintf_s(szWarning, LAYOUT_WARNING_SIZE, _TRUNCATE,
+        "%s with %lu KiB clusters is slow for long recordings, %lu KiB or more are better.",
+        szFs, clusterSize / 1024, minCluster / 1024);
+    ret++;
+    return ret;
+}
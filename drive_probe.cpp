@@ -0,0 +1,132 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+// At the start, the stored external paths are looked at on a thread per
+// node, so a sleeping or slow drive doesn't hold up the dialog. Each probe
+// posts its result (PTMSG_PROBE_RESULT), the dialog shows "probing" until
+// then. A probe which takes longer than PROBE_TIMEOUT_MS is reported as a
+// timeout, the drive counts as missing until the probe is back after all.
+//
+// Whether the drive found is the stored one is up to the identity policy
+// of the node, see drive_identity.cpp.
+
+#define PROBE_TIMEOUT_MS  10000
+
+extern int CheckPathExists(char* path);
+extern char* GetExternalPathOfNode(int node);
+extern int SchedAdd(PFNSCHEDPROC pfn, void* param, DWORD dueMs, DWORD periodMs);
+extern int ReadDriveIdentity(const char* szPath, DRIVEIDENTITY* pId);
+extern int CheckDriveIdentity(int node, const DRIVEIDENTITY* pFound);
+extern HANDLE CreateEngineThread(LPTHREAD_START_ROUTINE pfnThread, LPVOID param);
+
+static char szProbePaths[STATION_MAX][4][MAX_PATH_BUFFER_SIZE];
+static DRIVEIDENTITY probeFound[STATION_MAX][4];
+static volatile LONG probeDone[STATION_MAX][4];
+
+
+void SetDriveOnline(int node, int online) {
+    switch (node) {
+    case NODE_RAW:
+        pPTM->flagRawDriveOnline = online;
+        break;
+    case NODE_AUD:
+        pPTM->flagAudDriveOnline = online;
+        break;
+    case NODE_ETI:
+        pPTM->flagEtiDriveOnline = online;
+        break;
+    default:
+        pPTM->flagTiiDriveOnline = online;
+        break;
+    }
+}
+
+// The identity of the drive, valid after PTMSG_PROBE_RESULT
+const DRIVEIDENTITY* GetProbedIdentity(int node) {
+    return &probeFound[pPTM->station][node];
+}
+
+// The first one to finish posts, the probe or the timeout
+void PostProbeResult(int node, int result) {
+    if (!InterlockedExchange(&probeDone[pPTM->station][node], 1))
+        PostMessage(pPTM->hWndDialog, PTMSG_PROBE_RESULT, node, result);
+}
+
+DWORD WINAPI ProbeThread(LPVOID param) {
+    int node = (int)(INT_PTR)param;
+    int result = PROBE_OFFLINE;
+    char* szPath = szProbePaths[pPTM->station][node];
+    DRIVEIDENTITY* pFound = &probeFound[pPTM->station][node];
+
+    if (CheckPathExists(szPath) && ReadDriveIdentity(szPath, pFound)) {
+        switch (CheckDriveIdentity(node, pFound)) {
+        case IDV_MATCH:
+        case IDV_ACCEPT:
+            result = PROBE_ONLINE;
+            break;
+        case IDV_ASK:
+            result = PROBE_MISMATCH;
+            break;
+        }
+    }
+
+    // a late result still counts
+    if (InterlockedExchange(&probeDone[pPTM->station][node], 1) && PROBE_OFFLINE == result)
+        return 0;
+    PostMessage(pPTM->hWndDialog, PTMSG_PROBE_RESULT, node, result);
+    return 0;
+}
+
+// On the SchedulerThread
+void ProbeTimeout(void* param) {
+    PostProbeResult((int)(INT_PTR)param, PROBE_TIMEOUT);
+}
+
+// Called in WM_INITDIALOG, the nodes without a stored path are not probed
+void StartDriveProbes() {
+    HANDLE hThread;
+
+    for (int node = 0; node < 4; node++) {
+        pPTM->nodeProbing[node] = 0;
+        SetDriveOnline(node, 0);
+        if (NODE_ETI == node && !pPTM->flagIsQ5)
+            break;
+        if (!GetExternalPathOfNode(node)[0])
+            continue;
+
+        // the thread may outlive a change of the settings
+        lstrcpyn(szProbePaths[pPTM->station][node], GetExternalPathOfNode(node), MAX_PATH_BUFFER_SIZE);
+        probeDone[pPTM->station][node] = 0;
+        hThread = CreateEngineThread(ProbeThread, (LPVOID)(INT_PTR)node);
+        if (!hThread)
+            continue;
+        CloseHandle(hThread);
+        pPTM->nodeProbing[node] = 1;
+        SchedAdd(ProbeTimeout, (void*)(INT_PTR)node, PROBE_TIMEOUT_MS, 0);
+    }
+}
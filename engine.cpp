@@ -0,0 +1,519 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+#include <Dbt.h>
+#include <intrin.h>
+
+// The engine of PathTweaker: the original paths from QIRX's config-file,
+// the path switches, the drives coming and going and the work in the
+// background. Nothing in here touches a window. The dialog (dialog.cpp)
+// and the daemon (daemon.cpp) call it from their message handlers and
+// show the new state in their own way.
+
+#define PT_DRIVE_REMOVED 0
+#define PT_DRIVE_ARRIVED 1
+
+extern int ProcessQirxXMLFile(char* szInOutNodeContent, const char* nodeNeedle, int configReadWrite);
+extern int StartDiskSpaceTimer();
+extern int OpenSampleRing();
+extern void PublishSpaceSnapshot();
+extern DWORD WINAPI PostRecordingThread(LPVOID param);
+extern DWORD WINAPI PlaybackPrefetchThread(LPVOID param);
+extern DWORD WINAPI ReserveThread(LPVOID param);
+extern DWORD WINAPI PrewarmThread(LPVOID param);
+extern void WakePrewarm();
+extern int CheckPathExists(char* path);
+extern void ReadOriginalRawMaxSize();
+extern char* GetExternalPathOfNode(int node);
+extern char* GetTargetFolder(int node);
+extern void SavePreviousFolder(int node, const char* szCurrent);
+extern void StartFolderRotation();
+extern void StartPathPlans();
+extern int IsNodeOnline(int node);
+extern void SetDriveOnline(int node, int online);
+extern const DRIVEIDENTITY* GetProbedIdentity(int node);
+extern int VerifyDriveIdentity(int node, char* szPath);
+extern void RememberDriveIdentity(int node, const DRIVEIDENTITY* pFound);
+extern void QueueIdentityPrompt(int node, const char* szPath, const DRIVEIDENTITY* pFound);
+extern void IdentityPromptDone(int node);
+extern void StartControlPipe();
+extern void StopControlPipe();
+extern void StartMetrics();
+extern void RecordLatency(int phase, int node, const LARGE_INTEGER* pStart);
+extern int SchedRemoveStation();
+extern void FreeDiskSpaceTimer();
+extern void CloseSampleRing();
+extern int WriteLatencyTrace();
+extern void WriteDlgConfigFile();
+
+struct ENGINETHREAD {
+    LPTHREAD_START_ROUTINE pfnThread;
+    LPVOID param;
+    PATHTWEAKERMEM* pMem;     // the station of the creator
+};
+
+int ValidatePath(_DEV_BROADCAST_VOLUME* dbv, int mode, int node);
+void TakeProbedDrive(int node);
+void MakePathCurrent();
+void RestoreOriginalPath();
+
+
+int AllDrivesOnline() {
+    return pPTM->flagAudDriveOnline && pPTM->flagRawDriveOnline && pPTM->flagTiiDriveOnline &&
+        (pPTM->flagEtiDriveOnline || !pPTM->flagIsQ5);
+}
+
+// Read the original paths from the config-file.
+void ReadOriginalPaths() {
+    if (ProcessQirxXMLFile(pPTM->szOriginalRawPath, needleRawOut, CONFIG_READ))
+        memcpy(pPTM->szCurrentRawPath, pPTM->szOriginalRawPath, MAX_PATH_BUFFER_SIZE);
+    ReadOriginalRawMaxSize();
+    if (ProcessQirxXMLFile(pPTM->szOriginalAudPath, needleAudOut, CONFIG_READ))
+        memcpy(pPTM->szCurrentAudPath, pPTM->szOriginalAudPath, MAX_PATH_BUFFER_SIZE);
+    if (ProcessQirxXMLFile(pPTM->szOriginalTiiPath, needleTiiLog, CONFIG_READ))
+        memcpy(pPTM->szCurrentTiiPath, pPTM->szOriginalTiiPath, MAX_PATH_BUFFER_SIZE);
+
+    if (pPTM->flagIsQ5) { // skip entry if version !5
+        if (ProcessQirxXMLFile(pPTM->szOriginalEtiPath, needleEtiOut, CONFIG_READ))
+            memcpy(pPTM->szCurrentEtiPath, pPTM->szOriginalEtiPath, MAX_PATH_BUFFER_SIZE);
+    }
+}
+
+DWORD WINAPI EngineThreadStart(LPVOID param) {
+    ENGINETHREAD start = *(ENGINETHREAD*)param;
+    DWORD ret;
+
+    free(param);
+    pPTM = start.pMem;
+    ret = start.pfnThread(start.param);
+    InterlockedDecrement(&start.pMem->numEngineThreads);
+    return ret;
+}
+
+// CreateThread() for all the threads which use pPTM, the new one works for
+// the station of the caller. The memory of the station may not go or be
+// used again while numEngineThreads is not 0, a thread waiting for a hung
+// drive keeps it, see stations.cpp.
+HANDLE CreateEngineThread(LPTHREAD_START_ROUTINE pfnThread, LPVOID param) {
+    ENGINETHREAD* pStart;
+    HANDLE hThread;
+
+    pStart = (ENGINETHREAD*)malloc(sizeof(ENGINETHREAD));
+    if (!pStart)
+        return NULL;
+    pStart->pfnThread = pfnThread;
+    pStart->param = param;
+    pStart->pMem = pPTM;
+    InterlockedIncrement(&pPTM->numEngineThreads);
+    hThread = CreateThread(NULL, 0, EngineThreadStart, pStart, 0, NULL);
+    if (!hThread) {
+        InterlockedDecrement(&pPTM->numEngineThreads);
+        free(pStart);
+    }
+    return hThread;
+}
+
+// The work in the background, after the drives are being probed
+void StartEngine() {
+    OpenSampleRing();
+    StartDiskSpaceTimer();
+    pPTM->hPostRecordingThread = CreateEngineThread(PostRecordingThread, NULL);
+    pPTM->hPrefetchThread = CreateEngineThread(PlaybackPrefetchThread, NULL);
+    pPTM->hReserveThread = CreateEngineThread(ReserveThread, NULL);
+    pPTM->hPrewarmThread = CreateEngineThread(PrewarmThread, NULL);
+    StartFolderRotation();
+    StartPathPlans();
+    StartControlPipe();
+    StartMetrics();
+}
+
+// A thread which doesn't end in time goes on, see CreateEngineThread()
+void WaitForEngineThread(HANDLE* phThread, DWORD ms) {
+    if (*phThread) {
+        WaitForSingleObject(*phThread, ms);
+        CloseHandle(*phThread);
+        *phThread = NULL;
+    }
+}
+
+// After the message loop of the dialog or the daemon. The timers of the
+// station go, the wheel keeps turning for the other stations. The paths
+// are set back to the original ones.
+void StopEngine() {
+    pPTM->finishThread = 1;
+    StopControlPipe(); // may wait for a client
+    if (SchedRemoveStation()) { // else a disk timer still uses them
+        FreeDiskSpaceTimer();
+        CloseSampleRing();
+    }
+    if (pPTM->opt.traceSwitches)
+        WriteLatencyTrace();
+
+    WaitForEngineThread(&pPTM->hPostRecordingThread, 5000);
+    WaitForEngineThread(&pPTM->hPrefetchThread, 2000);
+    WaitForEngineThread(&pPTM->hMetricsThread, 2000);
+    WaitForEngineThread(&pPTM->hPrewarmThread, 5000);  // deletes the probes
+    WaitForEngineThread(&pPTM->hReserveThread, 5000);  // deletes the placeholders
+
+    // restore the default paths, if other paths are set
+    if (pPTM->flagRawDriveSet)
+        ProcessQirxXMLFile(pPTM->szOriginalRawPath, needleRawOut, CONFIG_WRITE);
+    if (pPTM->flagAudDriveSet)
+        ProcessQirxXMLFile(pPTM->szOriginalAudPath, needleAudOut, CONFIG_WRITE);
+    if (pPTM->flagTiiDriveSet)
+        ProcessQirxXMLFile(pPTM->szOriginalTiiPath, needleTiiLog, CONFIG_WRITE);
+    if (pPTM->flagEtiDriveSet)
+        ProcessQirxXMLFile(pPTM->szOriginalEtiPath, needleEtiOut, CONFIG_WRITE);
+
+    WriteDlgConfigFile();
+}
+
+
+// DBT_DEVICEARRIVAL. The time up to each written path is LAT_ARRIVAL,
+// see latency.cpp.
+void TakeArrivedDrive(_DEV_BROADCAST_VOLUME* dbv) {
+    LARGE_INTEGER liEvent;
+    char* pTarget;
+
+    QueryPerformanceCounter(&liEvent);
+    InterlockedIncrement64(&pPTM->counters.driveArrivals);
+
+    if (ValidatePath(dbv, PT_DRIVE_ARRIVED, NODE_RAW)) {
+        pPTM->flagRawDriveOnline = 1;
+        pPTM->flagRawDriveSet = 0;
+
+        if (pPTM->mDlgSet.autoPathSwap) {
+            pTarget = GetTargetFolder(NODE_RAW);
+            if (ProcessQirxXMLFile(pTarget, needleRawOut, CONFIG_WRITE)) {
+                memcpy(pPTM->szCurrentRawPath, pTarget, MAX_PATH_BUFFER_SIZE);
+                pPTM->flagRawDriveSet = 1;
+                RecordLatency(LAT_ARRIVAL, NODE_RAW, &liEvent);
+            }
+        }
+    }
+
+    if (ValidatePath(dbv, PT_DRIVE_ARRIVED, NODE_AUD)) {
+        pPTM->flagAudDriveOnline = 1;
+        pPTM->flagAudDriveSet = 0;
+
+        if (pPTM->mDlgSet.autoPathSwap) {
+            pTarget = GetTargetFolder(NODE_AUD);
+            if (ProcessQirxXMLFile(pTarget, needleAudOut, CONFIG_WRITE)) {
+                memcpy(pPTM->szCurrentAudPath, pTarget, MAX_PATH_BUFFER_SIZE);
+                pPTM->flagAudDriveSet = 1;
+                RecordLatency(LAT_ARRIVAL, NODE_AUD, &liEvent);
+            }
+        }
+    }
+
+    if (ValidatePath(dbv, PT_DRIVE_ARRIVED, NODE_TII)) {
+        pPTM->flagTiiDriveOnline = 1;
+        pPTM->flagTiiDriveSet = 0;
+
+        if (pPTM->mDlgSet.autoPathSwap) {
+            pTarget = GetTargetFolder(NODE_TII);
+            if (ProcessQirxXMLFile(pTarget, needleTiiLog, CONFIG_WRITE)) {
+                memcpy(pPTM->szCurrentTiiPath, pTarget, MAX_PATH_BUFFER_SIZE);
+                pPTM->flagTiiDriveSet = 1;
+                RecordLatency(LAT_ARRIVAL, NODE_TII, &liEvent);
+            }
+        }
+    }
+
+    if (pPTM->flagIsQ5 && ValidatePath(dbv, PT_DRIVE_ARRIVED, NODE_ETI)) {
+        pPTM->flagEtiDriveOnline = 1;
+        pPTM->flagEtiDriveSet = 0;
+
+        if (pPTM->mDlgSet.autoPathSwap) {
+            pTarget = GetTargetFolder(NODE_ETI);
+            if (ProcessQirxXMLFile(pTarget, needleEtiOut, CONFIG_WRITE)) {
+                memcpy(pPTM->szCurrentEtiPath, pTarget, MAX_PATH_BUFFER_SIZE);
+                pPTM->flagEtiDriveSet = 1;
+                RecordLatency(LAT_ARRIVAL, NODE_ETI, &liEvent);
+            }
+        }
+    }
+
+    PublishSpaceSnapshot();
+    WakePrewarm();
+}
+
+// DBT_DEVICEREMOVECOMPLETE, LAT_REMOVAL as above
+void ReleaseRemovedDrive(_DEV_BROADCAST_VOLUME* dbv) {
+    LARGE_INTEGER liEvent;
+
+    QueryPerformanceCounter(&liEvent);
+    InterlockedIncrement64(&pPTM->counters.driveRemovals);
+
+    if (ValidatePath(dbv, PT_DRIVE_REMOVED, NODE_RAW)) {
+        pPTM->flagRawDriveOnline = 0;
+
+        if (ProcessQirxXMLFile(pPTM->szOriginalRawPath, needleRawOut, CONFIG_WRITE)) {
+            memcpy(pPTM->szCurrentRawPath, pPTM->szOriginalRawPath, MAX_PATH_BUFFER_SIZE);
+            pPTM->flagRawDriveSet = 0;
+            RecordLatency(LAT_REMOVAL, NODE_RAW, &liEvent);
+        }
+    }
+
+    if (ValidatePath(dbv, PT_DRIVE_REMOVED, NODE_AUD)) {
+        pPTM->flagAudDriveOnline = 0;
+
+        if (ProcessQirxXMLFile(pPTM->szOriginalAudPath, needleAudOut, CONFIG_WRITE)) {
+            memcpy(pPTM->szCurrentAudPath, pPTM->szOriginalAudPath, MAX_PATH_BUFFER_SIZE);
+            pPTM->flagAudDriveSet = 0;
+            RecordLatency(LAT_REMOVAL, NODE_AUD, &liEvent);
+        }
+    }
+
+    if (ValidatePath(dbv, PT_DRIVE_REMOVED, NODE_TII)) {
+        pPTM->flagTiiDriveOnline = 0;
+
+        if (ProcessQirxXMLFile(pPTM->szOriginalTiiPath, needleTiiLog, CONFIG_WRITE)) {
+            memcpy(pPTM->szCurrentTiiPath, pPTM->szOriginalTiiPath, MAX_PATH_BUFFER_SIZE);
+            pPTM->flagTiiDriveSet = 0;
+            RecordLatency(LAT_REMOVAL, NODE_TII, &liEvent);
+        }
+    }
+
+    if (pPTM->flagIsQ5 && ValidatePath(dbv, PT_DRIVE_REMOVED, NODE_ETI)) {
+        pPTM->flagEtiDriveOnline = 0;
+
+        if (ProcessQirxXMLFile(pPTM->szOriginalEtiPath, needleEtiOut, CONFIG_WRITE)) {
+            memcpy(pPTM->szCurrentEtiPath, pPTM->szOriginalEtiPath, MAX_PATH_BUFFER_SIZE);
+            pPTM->flagEtiDriveSet = 0;
+            RecordLatency(LAT_REMOVAL, NODE_ETI, &liEvent);
+        }
+    }
+
+    PublishSpaceSnapshot();
+    WakePrewarm();
+}
+
+// PTMSG_FOLDER_ROLLOVER, the date of the subfolder changed
+void RollOverFolder(int node) {
+    int saveNode;
+
+    saveNode = pPTM->currentNodeSelection;
+    pPTM->currentNodeSelection = node;
+    switch (node) {
+    case NODE_RAW:
+        SavePreviousFolder(NODE_RAW, pPTM->szCurrentRawPath);
+        break;
+    case NODE_AUD:
+        SavePreviousFolder(NODE_AUD, pPTM->szCurrentAudPath);
+        break;
+    case NODE_ETI:
+        SavePreviousFolder(NODE_ETI, pPTM->szCurrentEtiPath);
+        break;
+    default:
+        SavePreviousFolder(NODE_TII, pPTM->szCurrentTiiPath);
+        break;
+    }
+    MakePathCurrent();
+    pPTM->currentNodeSelection = saveNode;
+    PublishSpaceSnapshot();
+}
+
+// PTMSG_PATH_PLAN, a path plan is due, and PTMSG_CONTROL from the control
+// pipe. Returns 0 if the drive is missing.
+int RunPathPlan(int node, int target) {
+    int saveNode, ret = 0;
+
+    if (PLAN_TO_EXTERNAL == target && !IsNodeOnline(node))
+        return ret;
+    saveNode = pPTM->currentNodeSelection;
+    pPTM->currentNodeSelection = node;
+    if (PLAN_TO_EXTERNAL == target)
+        MakePathCurrent();
+    else
+        RestoreOriginalPath();
+    pPTM->currentNodeSelection = saveNode;
+    PublishSpaceSnapshot();
+    ret++;
+    return ret;
+}
+
+// PTMSG_PROBE_RESULT, a stored path was looked at
+void TakeProbeResult(int node, int result) {
+    pPTM->nodeProbing[node] = 0;
+    if (IsNodeOnline(node)) // the drive arrived meanwhile
+        return;
+    if (PROBE_ONLINE == result) {
+        RememberDriveIdentity(node, GetProbedIdentity(node));
+        TakeProbedDrive(node);
+    }
+    else if (PROBE_MISMATCH == result)
+        QueueIdentityPrompt(node, GetExternalPathOfNode(node), GetProbedIdentity(node));
+}
+
+// PTMSG_IDENTITY_ANSWER, the drive may be gone meanwhile
+void TakeIdentityAnswer(int node, int yes) {
+    if (yes && !IsNodeOnline(node) && CheckPathExists(GetExternalPathOfNode(node)))
+        TakeProbedDrive(node);
+    IdentityPromptDone(node);
+}
+
+
+
+// The message from the system may report not only one volume on 
+// a physical drive, so we have to loop through the unitmask. 
+
+// The identity of an arriving drive is up to the policy of the node, see
+// drive_identity.cpp
+int ValidatePath(_DEV_BROADCAST_VOLUME* dbv, int mode, int node) {
+    int ret = 0;
+    char driveLetter, *szStoredExternalPath;
+    DWORD mask, idx;
+    LARGE_INTEGER liStart, liSerial;
+
+    QueryPerformanceCounter(&liStart);
+    szStoredExternalPath = GetExternalPathOfNode(node);
+
+    if (DBT_DEVTYP_VOLUME == dbv->dbcv_devicetype) {
+        mask = dbv->dbcv_unitmask;
+        int numDevs = __popcntd(mask); // count the volumes
+
+        for (int i = 0; i < numDevs; i++) {
+            idx = _bit_scan_forward(mask);
+            driveLetter = chDriveBase + idx;
+            if (toupper(driveLetter) == toupper(szStoredExternalPath[0])) {
+                if (PT_DRIVE_ARRIVED == mode) {
+                    if (CheckPathExists(szStoredExternalPath)) {
+                        QueryPerformanceCounter(&liSerial);
+                        if (VerifyDriveIdentity(node, szStoredExternalPath))
+                            ret++; // all is fine, go out
+                        RecordLatency(LAT_SERIAL, node, &liSerial);
+                        goto out;
+                    }
+                    else // path not found on drive, go out
+                        goto out;
+                }
+                else {
+                    ret++;
+                    goto out;
+                }
+            }
+            // reset the lowest bit and check the next drive-letter (if any)
+            _bittestandreset((LONG*)&mask, idx);
+        }
+    }
+out:
+    RecordLatency(LAT_VALIDATE, node, &liStart);
+    return ret;
+}
+
+// The startup probe (or the user) found the stored drive, the same as a
+// drive arriving
+void TakeProbedDrive(int node) {
+    int saveNode;
+
+    SetDriveOnline(node, 1);
+    if (pPTM->mDlgSet.autoPathSwap) {
+        saveNode = pPTM->currentNodeSelection;
+        pPTM->currentNodeSelection = node;
+        MakePathCurrent();
+        pPTM->currentNodeSelection = saveNode;
+    }
+    PublishSpaceSnapshot(); // the threads see the drive online, too
+}
+
+void MakePathCurrent() {
+    char* pTarget;
+
+    switch (pPTM->currentNodeSelection) {
+    case NODE_RAW:
+        pTarget = GetTargetFolder(NODE_RAW);
+        if (ProcessQirxXMLFile(pTarget, needleRawOut, CONFIG_WRITE)) {
+            memcpy(pPTM->szCurrentRawPath, pTarget, MAX_PATH_BUFFER_SIZE);
+            pPTM->flagRawDriveSet = 1;
+        }
+        break;
+
+    case NODE_AUD:
+        pTarget = GetTargetFolder(NODE_AUD);
+        if (ProcessQirxXMLFile(pTarget, needleAudOut, CONFIG_WRITE)) {
+            memcpy(pPTM->szCurrentAudPath, pTarget, MAX_PATH_BUFFER_SIZE);
+            pPTM->flagAudDriveSet = 1;
+        }
+        break;
+
+    case NODE_ETI:
+        pTarget = GetTargetFolder(NODE_ETI);
+        if (ProcessQirxXMLFile(pTarget, needleEtiOut, CONFIG_WRITE)) {
+            memcpy(pPTM->szCurrentEtiPath, pTarget, MAX_PATH_BUFFER_SIZE);
+            pPTM->flagEtiDriveSet = 1;
+        }
+        break;
+
+    default:
+        pTarget = GetTargetFolder(NODE_TII);
+        if (ProcessQirxXMLFile(pTarget, needleTiiLog, CONFIG_WRITE)) {
+            memcpy(pPTM->szCurrentTiiPath, pTarget, MAX_PATH_BUFFER_SIZE);
+            pPTM->flagTiiDriveSet = 1;
+        }
+        break;
+    }
+    WakePrewarm();
+}
+
+void RestoreOriginalPath() {
+    switch (pPTM->currentNodeSelection) {
+    case NODE_RAW:
+        if (ProcessQirxXMLFile(pPTM->szOriginalRawPath, needleRawOut, CONFIG_WRITE)) {
+            memcpy(pPTM->szCurrentRawPath, pPTM->szOriginalRawPath, MAX_PATH_BUFFER_SIZE);
+            pPTM->flagRawDriveSet = 0;
+        }
+        break;
+    case NODE_AUD:
+        if (ProcessQirxXMLFile(pPTM->szOriginalAudPath, needleAudOut, CONFIG_WRITE)) {
+            memcpy(pPTM->szCurrentAudPath, pPTM->szOriginalAudPath, MAX_PATH_BUFFER_SIZE);
+            pPTM->flagAudDriveSet = 0;
+        }
+        break;
+
+    case NODE_ETI:
+        if (ProcessQirxXMLFile(pPTM->szOriginalEtiPath, needleEtiOut, CONFIG_WRITE)) {
+            memcpy(pPTM->szCurrentEtiPath, pPTM->szOriginalEtiPath, MAX_PATH_BUFFER_SIZE);
+            pPTM->flagEtiDriveSet = 0;
+        }
+        break;
+    default:
+        if (ProcessQirxXMLFile(pPTM->szOriginalTiiPath, needleTiiLog, CONFIG_WRITE)) {
+            memcpy(pPTM->szCurrentTiiPath, pPTM->szOriginalTiiPath, MAX_PATH_BUFFER_SIZE);
+            pPTM->flagTiiDriveSet = 0;
+        }
+        break;
+    }
+}
+
+DWORD GetVolumeSerial(char* pathOnDrive) {
+    char drive[8]{};
+    DWORD serial = 0;
+    memcpy(drive, pathOnDrive, 3);
+    GetVolumeInformation(drive, NULL, 0, &serial, NULL, NULL, NULL, 0);
+    return serial;
+}
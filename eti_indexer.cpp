@@ -0,0 +1,586 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+#include <intrin.h>
+
+// ETI(NI) recordings (ETSI EN 300 799) are a plain sequence of 6144 byte
+// frames, one every 24 ms. A frame looks like this:
+//
+//   ERR (1) | FSYNC (3) | FC (4) | STC (4 * NST) | EOH (4) | MST | EOF (4) | TIST (4) | padding
+//
+// FSYNC alternates between 0x073AB6 and 0xF8C549. EOH carries the CRC over
+// FC, STC and MNSC, EOF the CRC over the MST (FIC and all sub-channels).
+// Both are CRC-16/CCITT, MSB first, preset 0xFFFF and inverted.
+//
+// We walk a finished recording through a memory map, check every frame and
+// write a small index "<recording>.idx" next to it. The index holds runs of
+// contiguous frames, so a player can seek to any 24 ms slot with a binary
+// search. Dropped frames (gaps in the frame counter FCT), garbage between
+// frames and broken frames go into "<recording>.txt".
+
+#define ETI_FRAME_SIZE      6144
+#define ETI_FRAME_RATE      (1000.0 / 24.0)
+#define ETI_FCT_MODULO      250
+#define ETI_FSYNC_EVEN      0x073AB6
+#define ETI_FSYNC_ODD       0xF8C549
+#define ETI_CRC_POLY        0x1021
+#define ETI_MAP_WINDOW      (32 * 1024 * 1024)
+#define ETI_MAX_REPORT      500      // lines per report, the summary is always written
+#define ETI_INDEX_VERSION   1
+
+#define ETI_FRAME_OK        0
+#define ETI_FRAME_NOSYNC    1
+#define ETI_FRAME_BADHEADER 2
+#define ETI_FRAME_BADBODY   3
+#define ETI_FRAME_ERRFLAG   4
+
+extern int OpenMappedFile(MAPPEDFILE* pMf, const char* szFileName);
+extern BYTE* MapFileWindow(MAPPEDFILE* pMf, ULONGLONG offset, SIZE_T* pInOutSize);
+extern void CloseMappedFile(MAPPEDFILE* pMf);
+extern int ForEachRecording(const char* szFolder, const char* szExt, PFNRECORDINGPROC pfnRecording,
+    volatile int* pCancel);
+
+
+struct ETIINDEXSEGMENT {
+    ULONGLONG fileOffset;     // of the first frame in this run
+    DWORD firstFrame;         // logical frame number (time / 24 ms)
+    DWORD numFrames;
+};
+
+struct ETISCAN {
+    ETIINDEXHEADER hdr;
+    ETIINDEXSEGMENT* pSegments;
+    unsigned int maxSegments;
+    unsigned int numReportLines;
+    int lastFct;              // -1 until the first good frame
+    int inGap;
+    ULONGLONG gapStart;
+    HANDLE hReport;
+};
+
+typedef unsigned int (*PFNCRC16)(unsigned int crc, const BYTE* p, SIZE_T len);
+
+static unsigned short crc16Table[8][256];
+static unsigned long long clmulK128, clmulK192;
+static PFNCRC16 pEtiCrc16;
+
+
+unsigned int Crc16Table(unsigned int crc, const BYTE* p, SIZE_T len);
+unsigned int Crc16Clmul(unsigned int crc, const BYTE* p, SIZE_T len);
+
+
+// x^n mod P(x), the folding constants for the PCLMULQDQ kernel
+static unsigned long long Crc16XPowMod(int n) {
+    unsigned int r = 1;
+    while (n--) {
+        r <<= 1;
+        if (r & 0x10000)
+            r ^= 0x10000 | ETI_CRC_POLY;
+    }
+    return r;
+}
+
+void InitEtiCrc16() {
+    unsigned int crc;
+    int cpuInfo[4];
+
+    if (pEtiCrc16)
+        return;
+
+    for (int i = 0; i < 256; i++) {
+        crc = i << 8;
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ ETI_CRC_POLY : crc << 1;
+        crc16Table[0][i] = (unsigned short)crc;
+    }
+    // crc16Table[k][i]: CRC of byte i followed by k zero bytes
+    for (int k = 1; k < 8; k++)
+        for (int i = 0; i < 256; i++)
+            crc16Table[k][i] = (unsigned short)((crc16Table[k - 1][i] << 8) ^
+                crc16Table[0][crc16Table[k - 1][i] >> 8]);
+
+    clmulK128 = Crc16XPowMod(128);
+    clmulK192 = Crc16XPowMod(192);
+
+    __cpuid(cpuInfo, 1); // ECX bit 1: PCLMULQDQ, bit 9: SSSE3
+    if ((cpuInfo[2] & (1 << 1)) && (cpuInfo[2] & (1 << 9)))
+        pEtiCrc16 = Crc16Clmul;
+    else
+        pEtiCrc16 = Crc16Table;
+}
+
+// Slicing-by-8, the fallback for old CPUs and for the short header CRCs
+unsigned int Crc16Table(unsigned int crc, const BYTE* p, SIZE_T len) {
+    crc &= 0xFFFF;
+
+    while (len >= 8) {
+        crc = crc16Table[7][p[0] ^ (crc >> 8)] ^ crc16Table[6][p[1] ^ (crc & 0xFF)] ^
+              crc16Table[5][p[2]] ^ crc16Table[4][p[3]] ^ crc16Table[3][p[4]] ^
+              crc16Table[2][p[5]] ^ crc16Table[1][p[6]] ^ crc16Table[0][p[7]];
+        p += 8;
+        len -= 8;
+    }
+    while (len--)
+        crc = (crc << 8 & 0xFFFF) ^ crc16Table[0][(crc >> 8) ^ *p++];
+
+    return crc;
+}
+
+// Carry-less multiplication folds 16 bytes per step. The 128 bit
+// accumulator holds the message so far (big endian, bit 127 first), and
+// folding it over the next block is
+//     acc = hi64(acc) * (x^192 mod P) ^ lo64(acc) * (x^128 mod P) ^ next
+// which keeps the remainder mod P. The last accumulator and the tail are
+// handed over to the table code. The preset is simply XORed into the first
+// two message bytes.
+PT_TARGET("pclmul,ssse3")
+unsigned int Crc16Clmul(unsigned int crc, const BYTE* p, SIZE_T len) {
+    __m128i acc, next, k, swap;
+    BYTE tmp[16];
+
+    if (len < 32)
+        return Crc16Table(crc, p, len);
+
+    swap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    k = _mm_set_epi64x((long long)clmulK192, (long long)clmulK128);
+
+    acc = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), swap);
+    acc = _mm_xor_si128(acc, _mm_slli_si128(_mm_cvtsi32_si128(crc & 0xFFFF), 14));
+    p += 16;
+    len -= 16;
+
+    while (len >= 16) {
+        next = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), swap);
+        next = _mm_xor_si128(next, _mm_clmulepi64_si128(acc, k, 0x11));
+        acc = _mm_xor_si128(next, _mm_clmulepi64_si128(acc, k, 0x00));
+        p += 16;
+        len -= 16;
+    }
+
+    _mm_storeu_si128((__m128i*)tmp, _mm_shuffle_epi8(acc, swap));
+    crc = Crc16Table(0, tmp, 16);
+    return Crc16Table(crc, p, len);
+}
+
+
+inline unsigned int EtiCrc(const BYTE* p, SIZE_T len) {
+    return pEtiCrc16(0xFFFF, p, len) ^ 0xFFFF;
+}
+
+// Checks one frame. *pFct gets the frame counter, if the header is fine.
+int CheckEtiFrame(const BYTE* p, int* pFct) {
+    unsigned int fsync, nst, eoh, mst, mstLen;
+
+    fsync = (p[1] << 16) | (p[2] << 8) | p[3];
+    if (ETI_FSYNC_EVEN != fsync && ETI_FSYNC_ODD != fsync)
+        return ETI_FRAME_NOSYNC;
+
+    nst = p[5] & 0x7F;
+    eoh = 8 + 4 * nst;
+    if (EtiCrc(p + 4, eoh - 4 + 2) != (unsigned int)((p[eoh + 2] << 8) | p[eoh + 3]))
+        return ETI_FRAME_BADHEADER;
+
+    // FIC size depends on the mode (MID 3 is mode III)
+    mstLen = 0;
+    if (p[5] & 0x80)
+        mstLen = (((p[6] >> 3) & 3) == 3) ? 128 : 96;
+
+    for (unsigned int i = 0; i < nst; i++) // STL is in 64 bit words
+        mstLen += (((p[8 + 4 * i + 2] & 3) << 8) | p[8 + 4 * i + 3]) * 8;
+
+    mst = eoh + 4;
+    if (mst + mstLen + 8 > ETI_FRAME_SIZE)
+        return ETI_FRAME_BADHEADER;
+
+    *pFct = p[4];
+
+    if (EtiCrc(p + mst, mstLen) != (unsigned int)((p[mst + mstLen] << 8) | p[mst + mstLen + 1]))
+        return ETI_FRAME_BADBODY;
+
+    if (p[0] != 0xFF)
+        return ETI_FRAME_ERRFLAG;
+
+    return ETI_FRAME_OK;
+}
+
+
+void EtiReport(ETISCAN* pScan, const char* fmt, ULONGLONG offset, ULONGLONG value) {
+    char buff[160];
+    DWORD dNumBytesWritten;
+    int len;
+
+    if (INVALID_HANDLE_VALUE == pScan->hReport || pScan->numReportLines >= ETI_MAX_REPORT)
+        return;
+
+    len = sprintf(buff, "0x%012llX  ", offset);
+    len += sprintf(buff + len, fmt, value);
+    if (++pScan->numReportLines == ETI_MAX_REPORT)
+        len += sprintf(buff + len, "\r\n... more lines suppressed");
+    buff[len++] = '\r';
+    buff[len++] = '\n';
+    WriteFile(pScan->hReport, buff, len, &dNumBytesWritten, NULL);
+}
+
+void AddEtiFrame(ETISCAN* pScan, ULONGLONG offset) {
+    ETIINDEXSEGMENT* pSeg;
+    void* pNew;
+
+    pSeg = pScan->hdr.numSegments ? &pScan->pSegments[pScan->hdr.numSegments - 1] : NULL;
+
+    if (!pSeg || pSeg->fileOffset + (ULONGLONG)pSeg->numFrames * ETI_FRAME_SIZE != offset
+        || pSeg->firstFrame + pSeg->numFrames != pScan->hdr.numLogicalFrames) {
+
+        if (pScan->hdr.numSegments == pScan->maxSegments) {
+            pNew = realloc(pScan->pSegments, (pScan->maxSegments + 256) * sizeof(ETIINDEXSEGMENT));
+            if (!pNew)
+                return; // the index gets incomplete, but the scan goes on
+            pScan->pSegments = (ETIINDEXSEGMENT*)pNew;
+            pScan->maxSegments += 256;
+        }
+        pSeg = &pScan->pSegments[pScan->hdr.numSegments++];
+        pSeg->fileOffset = offset;
+        pSeg->firstFrame = pScan->hdr.numLogicalFrames;
+        pSeg->numFrames = 0;
+    }
+    pSeg->numFrames++;
+    pScan->hdr.numFrames++;
+    pScan->hdr.numLogicalFrames++;
+}
+
+void EndEtiGap(ETISCAN* pScan, ULONGLONG offset) {
+    if (pScan->inGap) {
+        pScan->hdr.numGaps++;
+        pScan->hdr.numGapBytes += offset - pScan->gapStart;
+        EtiReport(pScan, "gap: %llu bytes without frame sync", pScan->gapStart,
+            offset - pScan->gapStart);
+        pScan->inGap = 0;
+    }
+}
+
+// Walks the frames in p[0..len), which is located at baseOffset in the
+// file. Returns the number of bytes used, the rest (less than one frame or
+// a part we could not sync to) has to be handed in again with the next
+// window. lastWindow is set if there is nothing more behind p + len.
+SIZE_T ScanEtiWindow(ETISCAN* pScan, const BYTE* p, SIZE_T len, ULONGLONG baseOffset, int lastWindow) {
+    SIZE_T pos = 0, q;
+    int status, fct = 0, dropped;
+
+    while (pos + ETI_FRAME_SIZE <= len) {
+        status = CheckEtiFrame(p + pos, &fct);
+
+        if (ETI_FRAME_NOSYNC == status) {
+            if (!pScan->inGap) {
+                pScan->inGap = 1;
+                pScan->gapStart = baseOffset + pos;
+            }
+            // Search for the next frame with a valid header. A sync pattern
+            // alone is too weak, it may show up in the payload.
+            for (q = pos + 1; q + ETI_FRAME_SIZE <= len; q++) {
+                if (p[q + 1] == 0x07 || p[q + 1] == 0xF8) {
+                    status = CheckEtiFrame(p + q, &fct);
+                    if (ETI_FRAME_NOSYNC != status && ETI_FRAME_BADHEADER != status)
+                        break;
+                }
+            }
+            pos = q;
+            continue;
+        }
+
+        EndEtiGap(pScan, baseOffset + pos);
+
+        if (ETI_FRAME_BADHEADER == status) {
+            // The FCT is not trustworthy, so count it as the expected frame.
+            pScan->hdr.numCorrupted++;
+            EtiReport(pScan, "frame %llu: header CRC error", baseOffset + pos,
+                pScan->hdr.numLogicalFrames);
+            if (pScan->lastFct >= 0)
+                pScan->lastFct = (pScan->lastFct + 1) % ETI_FCT_MODULO;
+        }
+        else {
+            if (pScan->lastFct >= 0) {
+                dropped = (fct - pScan->lastFct - 1 + ETI_FCT_MODULO) % ETI_FCT_MODULO;
+                if (dropped) {
+                    pScan->hdr.numGaps++;
+                    pScan->hdr.numLogicalFrames += dropped;
+                    EtiReport(pScan, "gap: %llu frames dropped (FCT jump)",
+                        baseOffset + pos, dropped);
+                }
+            }
+            pScan->lastFct = fct;
+
+            if (ETI_FRAME_BADBODY == status) {
+                pScan->hdr.numCorrupted++;
+                EtiReport(pScan, "frame %llu: MST CRC error", baseOffset + pos,
+                    pScan->hdr.numLogicalFrames);
+            }
+            else if (ETI_FRAME_ERRFLAG == status) {
+                pScan->hdr.numErrFlagged++;
+                EtiReport(pScan, "frame %llu: ERR byte set by the receiver",
+                    baseOffset + pos, pScan->hdr.numLogicalFrames);
+            }
+        }
+        AddEtiFrame(pScan, baseOffset + pos);
+        pos += ETI_FRAME_SIZE;
+    }
+
+    if (lastWindow && pos < len) { // truncated last frame
+        if (!pScan->inGap) {
+            pScan->inGap = 1;
+            pScan->gapStart = baseOffset + pos;
+        }
+        pos = len;
+    }
+    if (lastWindow)
+        EndEtiGap(pScan, baseOffset + pos);
+
+    return pos;
+}
+
+void InitEtiScan(ETISCAN* pScan) {
+    memset(pScan, 0, sizeof(ETISCAN));
+    memcpy(pScan->hdr.magic, "ETIX", 4);
+    pScan->hdr.version = ETI_INDEX_VERSION;
+    pScan->lastFct = -1;
+    pScan->hReport = INVALID_HANDLE_VALUE;
+    InitEtiCrc16();
+}
+
+
+// Checks one finished recording and writes the index and the report.
+// *pHdr (optional) gets the results. pCancel may stop us any time.
+int EtiIndexFile(const char* szFileName, ETIINDEXHEADER* pHdr, volatile int* pCancel) {
+    char szOut[MAX_PATH_BUFFER_SIZE + 8], buff[512];
+    MAPPEDFILE mf;
+    ETISCAN scan;
+    ULONGLONG offset = 0;
+    SIZE_T size, used;
+    const BYTE* p;
+    HANDLE hIdx;
+    DWORD dNumBytesWritten;
+    LARGE_INTEGER qpf, liStart, liEnd;
+    double seconds;
+    int len, ret = 0;
+
+    if (lstrlen(szFileName) >= MAX_PATH_BUFFER_SIZE)
+        return ret;
+
+    if (!OpenMappedFile(&mf, szFileName))
+        return ret; // busy (still recording?), empty or gone
+
+    InitEtiScan(&scan);
+    sprintf(szOut, "%s%s", szFileName, szReportExt);
+    scan.hReport = CreateFile(szOut, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
+
+    QueryPerformanceFrequency(&qpf);
+    QueryPerformanceCounter(&liStart);
+
+    while (offset < mf.fileSize && !*pCancel) {
+        size = ETI_MAP_WINDOW;
+        p = MapFileWindow(&mf, offset, &size);
+        if (!p)
+            break;
+        used = ScanEtiWindow(&scan, p, size, offset, offset + size == mf.fileSize);
+        if (!used) // window smaller than a frame, but not the last one?
+            break;
+        offset += used;
+    }
+
+    QueryPerformanceCounter(&liEnd);
+    seconds = (double)(liEnd.QuadPart - liStart.QuadPart) / qpf.QuadPart;
+    scan.hdr.fileSize = mf.fileSize;
+    CloseMappedFile(&mf);
+
+    if (offset >= scan.hdr.fileSize) { // otherwise cancelled or failed
+        sprintf(szOut, "%s%s", szFileName, szIndexExt);
+        hIdx = CreateFile(szOut, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
+        if (INVALID_HANDLE_VALUE != hIdx) {
+            WriteFile(hIdx, &scan.hdr, sizeof(ETIINDEXHEADER), &dNumBytesWritten, NULL);
+            if (scan.hdr.numSegments)
+                WriteFile(hIdx, scan.pSegments, scan.hdr.numSegments * sizeof(ETIINDEXSEGMENT),
+                    &dNumBytesWritten, NULL);
+            CloseHandle(hIdx);
+            ret++;
+        }
+    }
+
+    if (INVALID_HANDLE_VALUE != scan.hReport) {
+        len = sprintf(buff,
+            "\r\n%s\r\n"
+            "%s, %llu bytes, %lu frames (%.1f s), %lu dropped, %lu gaps (%llu bytes)\r\n"
+            "%lu CRC errors, %lu frames flagged by the receiver, %lu index segments\r\n"
+            "checked in %.3f s (%.1f MB/s)\r\n",
+            szFileName, ret ? "complete" : "CANCELLED",
+            scan.hdr.fileSize, scan.hdr.numFrames, scan.hdr.numLogicalFrames / ETI_FRAME_RATE,
+            scan.hdr.numLogicalFrames - scan.hdr.numFrames, scan.hdr.numGaps, scan.hdr.numGapBytes,
+            scan.hdr.numCorrupted, scan.hdr.numErrFlagged, scan.hdr.numSegments,
+            seconds, seconds > 0. ? offset / seconds / 1'000'000.0 : 0.);
+        WriteFile(scan.hReport, buff, len, &dNumBytesWritten, NULL);
+        CloseHandle(scan.hReport);
+    }
+
+    if (pHdr)
+        memcpy(pHdr, &scan.hdr, sizeof(ETIINDEXHEADER));
+    free(scan.pSegments);
+    return ret;
+}
+
+// An index is up to date, if it was made for a file of the same size.
+int HaveEtiIndex(const char* szFileName, ULONGLONG fileSize) {
+    char szIdx[MAX_PATH_BUFFER_SIZE + 8];
+    ETIINDEXHEADER hdr;
+    DWORD dNumBytesRead = 0;
+    HANDLE hIdx;
+
+    sprintf(szIdx, "%s%s", szFileName, szIndexExt);
+    hIdx = CreateFile(szIdx, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
+    if (INVALID_HANDLE_VALUE == hIdx)
+        return 0;
+
+    ReadFile(hIdx, &hdr, sizeof(ETIINDEXHEADER), &dNumBytesRead, NULL);
+    CloseHandle(hIdx);
+
+    return dNumBytesRead == sizeof(ETIINDEXHEADER) && !memcmp(hdr.magic, "ETIX", 4) &&
+        ETI_INDEX_VERSION == hdr.version && hdr.fileSize == fileSize;
+}
+
+// Indexes a recording if there is no up-to-date index. Files still open
+// for writing by QIRX are skipped by OpenMappedFile().
+int EtiIndexIfNeeded(const char* szFileName, ULONGLONG fileSize, volatile int* pCancel) {
+    if (HaveEtiIndex(szFileName, fileSize))
+        return 0;
+    return EtiIndexFile(szFileName, NULL, pCancel);
+}
+
+// Indexes all *.eti files in szFolder. Returns the number of new indexes.
+int EtiIndexFolder(const char* szFolder, volatile int* pCancel) {
+    return ForEachRecording(szFolder, szEtiExt, EtiIndexIfNeeded, pCancel);
+}
+
+
+// Throughput benchmark with synthetic frames in memory, without disk I/O.
+// Some frames get broken and dropped, so the checking paths are covered.
+// Prints the results to stdout.
+void EtiBenchmark(int megaBytes) {
+    const int nst = 8, stl = 84; // 8 sub-channels, 672 bytes each
+    BYTE* pBuf, *pFrame;
+    unsigned int numFrames, frame, fct = 0, eoh, mst, mstLen, crc, seed = 12345;
+    ETISCAN scan;
+    LARGE_INTEGER qpf, liStart, liEnd;
+    double seconds;
+    PFNCRC16 kernels[2] = { Crc16Table, Crc16Clmul };
+    const char* names[2] = { "table (slicing-by-8)", "PCLMULQDQ" };
+    int cpuInfo[4];
+
+    InitEtiCrc16();
+    numFrames = (unsigned int)((ULONGLONG)megaBytes * 1024 * 1024 / ETI_FRAME_SIZE);
+    if (!numFrames)
+        numFrames = 1;
+
+    pBuf = (BYTE*)VCALLOC((SIZE_T)numFrames * ETI_FRAME_SIZE);
+    if (!pBuf) {
+        printf("Not enough memory for %d MB.\n", megaBytes);
+        return;
+    }
+
+    eoh = 8 + 4 * nst;
+    mst = eoh + 4;
+    mstLen = 96 + nst * stl * 8;
+
+    for (frame = 0; frame < numFrames; frame++) {
+        if (frame % 1000 == 999) // a dropped frame now and then
+            fct = (fct + 1) % ETI_FCT_MODULO;
+
+        pFrame = pBuf + (SIZE_T)frame * ETI_FRAME_SIZE;
+        memset(pFrame, 0x55, ETI_FRAME_SIZE);
+        pFrame[0] = 0xFF;
+        pFrame[1] = (fct & 1) ? 0xF8 : 0x07;
+        pFrame[2] = (fct & 1) ? 0xC5 : 0x3A;
+        pFrame[3] = (fct & 1) ? 0x49 : 0xB6;
+        pFrame[4] = (BYTE)fct;
+        pFrame[5] = 0x80 | nst;       // FICF, NST
+        pFrame[6] = (1 << 3);         // FP 0, MID 1 (mode I), FL high bits
+        pFrame[7] = (BYTE)((nst + 1 + mstLen / 4) & 0xFF);
+        pFrame[6] |= (BYTE)(((nst + 1 + mstLen / 4) >> 8) & 7);
+        for (int i = 0; i < nst; i++) {
+            pFrame[8 + 4 * i] = (BYTE)((i + 1) << 2);
+            pFrame[8 + 4 * i + 1] = 0;
+            pFrame[8 + 4 * i + 2] = (BYTE)(stl >> 8);
+            pFrame[8 + 4 * i + 3] = (BYTE)stl;
+        }
+        pFrame[eoh] = 0xFF;  // MNSC
+        pFrame[eoh + 1] = 0xFF;
+        crc = Crc16Table(0xFFFF, pFrame + 4, eoh - 4 + 2) ^ 0xFFFF;
+        pFrame[eoh + 2] = (BYTE)(crc >> 8);
+        pFrame[eoh + 3] = (BYTE)crc;
+
+        for (unsigned int i = 0; i < mstLen; i++) {
+            seed = seed * 1103515245 + 12345;
+            pFrame[mst + i] = (BYTE)(seed >> 16);
+        }
+        crc = Crc16Table(0xFFFF, pFrame + mst, mstLen) ^ 0xFFFF;
+        pFrame[mst + mstLen] = (BYTE)(crc >> 8);
+        pFrame[mst + mstLen + 1] = (BYTE)crc;
+        pFrame[mst + mstLen + 2] = 0xFF; // RFU
+        pFrame[mst + mstLen + 3] = 0xFF;
+        memset(pFrame + mst + mstLen + 4, 0xFF, 4); // TIST
+
+        if (frame % 5000 == 4999) // a broken frame now and then
+            pFrame[mst + 100] ^= 0x10;
+
+        fct = (fct + 1) % ETI_FCT_MODULO;
+    }
+
+    __cpuid(cpuInfo, 1);
+    printf("ETI checker benchmark, %u frames (%.1f MB, %.1f minutes of recording)\n",
+        numFrames, (double)numFrames * ETI_FRAME_SIZE / 1'000'000.0, numFrames / ETI_FRAME_RATE / 60.0);
+
+    for (int k = 0; k < 2; k++) {
+        if (1 == k && !((cpuInfo[2] & (1 << 1)) && (cpuInfo[2] & (1 << 9)))) {
+            printf("%-22s not supported by this CPU\n", names[k]);
+            continue;
+        }
+        pEtiCrc16 = kernels[k];
+        InitEtiScan(&scan);
+
+        QueryPerformanceFrequency(&qpf);
+        QueryPerformanceCounter(&liStart);
+        ScanEtiWindow(&scan, pBuf, (SIZE_T)numFrames * ETI_FRAME_SIZE, 0, 1);
+        QueryPerformanceCounter(&liEnd);
+
+        seconds = (double)(liEnd.QuadPart - liStart.QuadPart) / qpf.QuadPart;
+        printf("%-22s %9.1f MB/s, %7.0fx real time | frames %lu, dropped %lu, CRC errors %lu, segments %lu\n",
+            names[k], (double)numFrames * ETI_FRAME_SIZE / seconds / 1'000'000.0,
+            numFrames / ETI_FRAME_RATE / seconds, scan.hdr.numFrames,
+            scan.hdr.numLogicalFrames - scan.hdr.numFrames, scan.hdr.numCorrupted,
+            scan.hdr.numSegments);
+        free(scan.pSegments);
+    }
+
+    pEtiCrc16 = NULL;
+    InitEtiCrc16(); // back to the best kernel
+    VFREE(pBuf);
+}
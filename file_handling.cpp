@@ -33,6 +33,8 @@
 
 #include "PathTweaker.h"
 
+extern int GetIdentityPolicy(const char* szName);
+
 int  GetUserLocalAppDataBasePath(char* szLocalAppDataBasePath);
 int  GetSubFolder(char* szInoutBasePath, const char* szSubFolder);
 int  CreateSubFolder(char* szInoutBasePath, const char* szNewFolder);
@@ -59,6 +61,13 @@ void CollectPaths() {
             if (!status)
                 CreateSubFolder(temp, pPTM->szQirxVersion);
             sprintf(pPTM->szDlgFullConfigFileName, "%s\\%s", temp, szDlgConfigFile);
+            sprintf(pPTM->szOptionsFileName, "%s\\%s", temp, szOptionsFile);
+            sprintf(pPTM->szTiiStoreFileName, "%s\\%s", temp, szTiiStoreFile);
+            sprintf(pPTM->szDedupReportFileName, "%s\\%s", temp, szDedupReportFile);
+            sprintf(pPTM->szSpinupReportFileName, "%s\\%s", temp, szSpinupReportFile);
+            sprintf(pPTM->szDaemonLogFileName, "%s\\%s", temp, szDaemonLogFile);
+            sprintf(pPTM->szSampleRingFileName, "%s\\%s", temp, szSampleRingFile);
+            sprintf(pPTM->szTraceFileName, "%s\\%s", temp, szTraceFile);
             sprintf(pPTM->szQirxFullConfigBackupFileName, "%s\\%s%s", 
                 temp, pPTM->szQirxVersion, szQirxConfigExt);
             pPTM->haveDlgConfig = 1;           
@@ -125,20 +134,40 @@ int CreateSubFolder(char* szInoutPath, const char* szNewFolder) {
     return ret;
 }
 
+// "qirx2" ... "qirx9"
+int IsQirxVersionArg(const char* szArg) {
+    return szArg && !_strnicmp(szArg, "qirx", 4) && szArg[4] >= '2' && szArg[4] <= '9' && !szArg[5];
+}
+
 // Returns version-string (like "qirx4" ) from qirx.bat inside
 // of the program-folder. Needed to find QIRXs config-file. Works 
 // for Qirx versions 3 and 4. QIRX2 needs a 'faked' qirx.bat inside
 // of its program-direcrory.
+// "-daemon qirxN" and the stations of "-stations" come with their version
+// instead, they don't need a qirx.bat.
 
 inline int GetQirxVersionString(char* szVersion) {
     HANDLE hIn;
     LARGE_INTEGER size;
     DWORD dNumBytesRead;
     char* pVersion;
+    const char* pArg = NULL;
     int ret = 0;
     char input[256];
     memset(input, 0, 256);
 
+    if (IsQirxVersionArg(pPTM->szQirxVersion)) // a station, see stations.cpp
+        pArg = pPTM->szQirxVersion;
+    else if (__argc > 2 && !lstrcmpi(__argv[1], "-daemon"))
+        pArg = __argv[2];
+    if (IsQirxVersionArg(pArg)) {
+        lstrcpyn(szVersion, pArg, 6);
+        if (szVersion[4] == '5')
+            pPTM->flagIsQ5 = 1;
+        ret++;
+        return ret;
+    }
+
     hIn = CreateFile("qirx.bat", GENERIC_READ, 0, 0, OPEN_EXISTING, 0, 0);
 
     if (INVALID_HANDLE_VALUE != hIn) {
@@ -207,10 +236,14 @@ int GetQirxConfigFileName(char* szQirxFullConfigFileName) {
 // ReadDlgConfigFile() reads the dialog-settings from disk. 
 // If the file does not exists (first run) or the size is not correct
 // due to updates, it fails and some defaults will be used.
+// The path plans and the drive identities follow the settings, a file
+// without them is fine.
 int ReadDlgConfigFile() {
-    DWORD dNumBytesRead = 0;
+    DWORD dNumBytesRead = 0, dNumPlanBytes = 0, dNumIdBytes = 0;
     LARGE_INTEGER size;
     MAINDLGSETTINGS dummy;
+    PATHPLANS plans;
+    DRIVEIDENTITIES ids;
     HANDLE hIni;
     int ret = 0;
 
@@ -220,8 +253,15 @@ int ReadDlgConfigFile() {
         if (INVALID_HANDLE_VALUE != hIni) {
             GetFileSizeEx(hIni, &size);
 
-            if (sizeof(MAINDLGSETTINGS) == size.LowPart)
+            if (sizeof(MAINDLGSETTINGS) == size.LowPart ||
+                sizeof(MAINDLGSETTINGS) + sizeof(PATHPLANS) == size.LowPart ||
+                sizeof(MAINDLGSETTINGS) + sizeof(PATHPLANS) + sizeof(DRIVEIDENTITIES) == size.LowPart)
                 ReadFile(hIni, &dummy, sizeof(MAINDLGSETTINGS), &dNumBytesRead, NULL);
+            if (dNumBytesRead == sizeof(MAINDLGSETTINGS) && size.LowPart > sizeof(MAINDLGSETTINGS))
+                ReadFile(hIni, &plans, sizeof(PATHPLANS), &dNumPlanBytes, NULL);
+            if (dNumPlanBytes == sizeof(PATHPLANS) &&
+                size.LowPart > sizeof(MAINDLGSETTINGS) + sizeof(PATHPLANS))
+                ReadFile(hIni, &ids, sizeof(DRIVEIDENTITIES), &dNumIdBytes, NULL);
 
             CloseHandle(hIni);
 
@@ -229,6 +269,11 @@ int ReadDlgConfigFile() {
                 memcpy(&pPTM->mDlgSet, &dummy, sizeof(MAINDLGSETTINGS));
                 ret++;
             }
+            if (dNumPlanBytes == sizeof(PATHPLANS) && !memcmp(plans.magic, "PLAN", 4) &&
+                plans.numPlans <= PLAN_MAX)
+                memcpy(&pPTM->plans, &plans, sizeof(PATHPLANS));
+            if (dNumIdBytes == sizeof(DRIVEIDENTITIES) && !memcmp(ids.magic, "DRID", 4))
+                memcpy(&pPTM->driveIds, &ids, sizeof(DRIVEIDENTITIES));
         }
     }
     return ret;
@@ -244,7 +289,170 @@ void WriteDlgConfigFile() {
         if (INVALID_HANDLE_VALUE != hIni) {
             WriteFile(hIni, &pPTM->mDlgSet, sizeof(MAINDLGSETTINGS),
                 &dNumBytesWritten, NULL);
+            if (pPTM->plans.numPlans || pPTM->driveIds.magic[0]) {
+                memcpy(pPTM->plans.magic, "PLAN", 4);
+                WriteFile(hIni, &pPTM->plans, sizeof(PATHPLANS),
+                    &dNumBytesWritten, NULL);
+            }
+            if (pPTM->driveIds.magic[0])
+                WriteFile(hIni, &pPTM->driveIds, sizeof(DRIVEIDENTITIES),
+                    &dNumBytesWritten, NULL);
             CloseHandle(hIni);
         }
     }
 }
+
+
+// ReadOptionsFile() reads "options.ini". Missing values get their
+// defaults, and a missing file is written with the defaults, so the user
+// finds something to edit.
+void ReadOptionsFile() {
+    static const char* szNodeKeys[4] = { "Raw", "Audio", "Tii", "Eti" }; // by node
+    char buff[16];
+
+    // QIRX's config-file is used without "dlg.dat", too
+    pPTM->opt.configOpenRetries = CONFIG_OPEN_RETRIES;
+    pPTM->opt.configRetryMs = CONFIG_RETRY_MS;
+    pPTM->opt.configSettleMs = CONFIG_SETTLE_MS;
+    if (!pPTM->haveDlgConfig)
+        return;
+
+    pPTM->opt.compressRaw = GetPrivateProfileInt(szOptSecPostRec, "CompressRaw", 0,
+        pPTM->szOptionsFileName);
+    pPTM->opt.deleteRawAfterPack = GetPrivateProfileInt(szOptSecPostRec, "DeleteRawAfterCompress", 0,
+        pPTM->szOptionsFileName);
+    pPTM->opt.packThreads = GetPrivateProfileInt(szOptSecPostRec, "CompressThreads", 0,
+        pPTM->szOptionsFileName);
+    pPTM->opt.readAhead = GetPrivateProfileInt(szOptSecPlayback, "ReadAhead", 1,
+        pPTM->szOptionsFileName);
+    pPTM->opt.readAheadSeconds = GetPrivateProfileInt(szOptSecPlayback, "ReadAheadSeconds", 8,
+        pPTM->szOptionsFileName);
+    if (pPTM->opt.readAheadSeconds < 1 || pPTM->opt.readAheadSeconds > 60)
+        pPTM->opt.readAheadSeconds = 8;
+    pPTM->opt.reserveRawGB = GetPrivateProfileInt(szOptSecReserve, "RawGB", 0, pPTM->szOptionsFileName);
+    pPTM->opt.reserveAudGB = GetPrivateProfileInt(szOptSecReserve, "AudioGB", 0, pPTM->szOptionsFileName);
+    pPTM->opt.reserveEtiGB = GetPrivateProfileInt(szOptSecReserve, "EtiGB", 0, pPTM->szOptionsFileName);
+    if (pPTM->opt.reserveRawGB < 0)
+        pPTM->opt.reserveRawGB = 0;
+    if (pPTM->opt.reserveAudGB < 0)
+        pPTM->opt.reserveAudGB = 0;
+    if (pPTM->opt.reserveEtiGB < 0)
+        pPTM->opt.reserveEtiGB = 0;
+    pPTM->opt.tuneMaxSize = GetPrivateProfileInt(szOptSecLayout, "TuneMaxSize", 1, pPTM->szOptionsFileName);
+    pPTM->opt.fat32MaxSize = GetPrivateProfileInt(szOptSecLayout, "Fat32MaxSize", 4000, pPTM->szOptionsFileName);
+    if (pPTM->opt.fat32MaxSize <= 0 || pPTM->opt.fat32MaxSize > 4095)
+        pPTM->opt.fat32MaxSize = 4000;
+    for (int node = 0; node < 4; node++)
+        GetPrivateProfileString(szOptSecSubfolders, szNodeKeys[node], "", pPTM->opt.szSubfolders[node],
+            sizeof(pPTM->opt.szSubfolders[node]), pPTM->szOptionsFileName);
+    pPTM->opt.prewarm = GetPrivateProfileInt(szOptSecPrewarm, "Prewarm", 1, pPTM->szOptionsFileName);
+    pPTM->opt.keepAwakeSeconds = GetPrivateProfileInt(szOptSecPrewarm, "KeepAwakeSeconds", 120,
+        pPTM->szOptionsFileName);
+    if (pPTM->opt.keepAwakeSeconds < 0)
+        pPTM->opt.keepAwakeSeconds = 0;
+    for (int node = 0; node < 4; node++) {
+        GetPrivateProfileString(szOptSecIdentity, szNodeKeys[node], "ask", buff, sizeof(buff),
+            pPTM->szOptionsFileName);
+        pPTM->opt.identityPolicy[node] = GetIdentityPolicy(buff);
+    }
+    pPTM->opt.metricsPort = GetPrivateProfileInt(szOptSecMetrics, "Port", 0, pPTM->szOptionsFileName);
+    if (pPTM->opt.metricsPort < 0 || pPTM->opt.metricsPort > 65535)
+        pPTM->opt.metricsPort = 0;
+    pPTM->opt.traceSwitches = GetPrivateProfileInt(szOptSecMetrics, "Trace", 0, pPTM->szOptionsFileName);
+    pPTM->opt.configOpenRetries = GetPrivateProfileInt(szOptSecQirxConfig, "OpenRetries", CONFIG_OPEN_RETRIES,
+        pPTM->szOptionsFileName);
+    if (pPTM->opt.configOpenRetries < 1)
+        pPTM->opt.configOpenRetries = 1;
+    pPTM->opt.configRetryMs = GetPrivateProfileInt(szOptSecQirxConfig, "RetryMs", CONFIG_RETRY_MS,
+        pPTM->szOptionsFileName);
+    pPTM->opt.configSettleMs = GetPrivateProfileInt(szOptSecQirxConfig, "SettleMs", CONFIG_SETTLE_MS,
+        pPTM->szOptionsFileName);
+    if (pPTM->opt.configRetryMs < 0 || pPTM->opt.configSettleMs < 0) {
+        pPTM->opt.configRetryMs = CONFIG_RETRY_MS;
+        pPTM->opt.configSettleMs = CONFIG_SETTLE_MS;
+    }
+
+    if (INVALID_FILE_ATTRIBUTES == GetFileAttributes(pPTM->szOptionsFileName)) {
+        sprintf(buff, "%d", pPTM->opt.compressRaw);
+        WritePrivateProfileString(szOptSecPostRec, "CompressRaw", buff, pPTM->szOptionsFileName);
+        sprintf(buff, "%d", pPTM->opt.deleteRawAfterPack);
+        WritePrivateProfileString(szOptSecPostRec, "DeleteRawAfterCompress", buff, pPTM->szOptionsFileName);
+        sprintf(buff, "%d", pPTM->opt.packThreads);
+        WritePrivateProfileString(szOptSecPostRec, "CompressThreads", buff, pPTM->szOptionsFileName);
+        sprintf(buff, "%d", pPTM->opt.readAhead);
+        WritePrivateProfileString(szOptSecPlayback, "ReadAhead", buff, pPTM->szOptionsFileName);
+        sprintf(buff, "%d", pPTM->opt.readAheadSeconds);
+        WritePrivateProfileString(szOptSecPlayback, "ReadAheadSeconds", buff, pPTM->szOptionsFileName);
+        WritePrivateProfileString(szOptSecReserve, "RawGB", "0", pPTM->szOptionsFileName);
+        WritePrivateProfileString(szOptSecReserve, "AudioGB", "0", pPTM->szOptionsFileName);
+        WritePrivateProfileString(szOptSecReserve, "EtiGB", "0", pPTM->szOptionsFileName);
+        sprintf(buff, "%d", pPTM->opt.tuneMaxSize);
+        WritePrivateProfileString(szOptSecLayout, "TuneMaxSize", buff, pPTM->szOptionsFileName);
+        sprintf(buff, "%d", pPTM->opt.fat32MaxSize);
+        WritePrivateProfileString(szOptSecLayout, "Fat32MaxSize", buff, pPTM->szOptionsFileName);
+        for (int node = 0; node < 4; node++)
+            WritePrivateProfileString(szOptSecSubfolders, szNodeKeys[node], "", pPTM->szOptionsFileName);
+        sprintf(buff, "%d", pPTM->opt.prewarm);
+        WritePrivateProfileString(szOptSecPrewarm, "Prewarm", buff, pPTM->szOptionsFileName);
+        sprintf(buff, "%d", pPTM->opt.keepAwakeSeconds);
+        WritePrivateProfileString(szOptSecPrewarm, "KeepAwakeSeconds", buff, pPTM->szOptionsFileName);
+        for (int node = 0; node < 4; node++)
+            WritePrivateProfileString(szOptSecIdentity, szNodeKeys[node], "ask", pPTM->szOptionsFileName);
+        WritePrivateProfileString(szOptSecMetrics, "Port", "0", pPTM->szOptionsFileName);
+        WritePrivateProfileString(szOptSecMetrics, "Trace", "0", pPTM->szOptionsFileName);
+        sprintf(buff, "%d", pPTM->opt.configOpenRetries);
+        WritePrivateProfileString(szOptSecQirxConfig, "OpenRetries", buff, pPTM->szOptionsFileName);
+        sprintf(buff, "%d", pPTM->opt.configRetryMs);
+        WritePrivateProfileString(szOptSecQirxConfig, "RetryMs", buff, pPTM->szOptionsFileName);
+        sprintf(buff, "%d", pPTM->opt.configSettleMs);
+        WritePrivateProfileString(szOptSecQirxConfig, "SettleMs", buff, pPTM->szOptionsFileName);
+    }
+}
+
+
+// Calls pfnRecording for each file "*<szExt>" in szFolder, the file name
+// comes with the full path. Returns the sum of the return values.
+int ForEachRecording(const char* szFolder, const char* szExt, PFNRECORDINGPROC pfnRecording,
+    volatile int* pCancel) {
+    char szPrefix[MAX_PATH_BUFFER_SIZE], szPattern[MAX_PATH_BUFFER_SIZE + 8];
+    char szFile[MAX_PATH_BUFFER_SIZE * 2];
+    WIN32_FIND_DATA fd;
+    HANDLE hFind;
+    ULARGE_INTEGER size;
+    int len, extLen, ret = 0;
+
+    len = lstrlen(szFolder);
+    if (!len || len + 2 >= MAX_PATH_BUFFER_SIZE)
+        return ret;
+
+    lstrcpyn(szPrefix, szFolder, MAX_PATH_BUFFER_SIZE);
+    if (szPrefix[len - 1] != '\\' && szPrefix[len - 1] != '/')
+        lstrcat(szPrefix, "\\");
+    sprintf(szPattern, "%s*%s", szPrefix, szExt);
+    extLen = lstrlen(szExt);
+
+    hFind = FindFirstFile(szPattern, &fd);
+    if (INVALID_HANDLE_VALUE == hFind)
+        return ret;
+
+    do {
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            continue;
+        // "*.eti" matches "*.etix" as well (8.3 names)
+        len = lstrlen(fd.cFileName);
+        if (len <= extLen || lstrcmpi(fd.cFileName + len - extLen, szExt))
+            continue;
+
+        sprintf(szFile, "%s%s", szPrefix, fd.cFileName);
+        if (lstrlen(szFile) + 8 >= MAX_PATH_BUFFER_SIZE) // room for our extensions
+            continue;
+
+        size.LowPart = fd.nFileSizeLow;
+        size.HighPart = fd.nFileSizeHigh;
+        ret += pfnRecording(szFile, size.QuadPart, pCancel);
+
+    } while (!*pCancel && FindNextFile(hFind, &fd));
+
+    FindClose(hFind);
+    return ret;
+}
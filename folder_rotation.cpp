@@ -0,0 +1,227 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+// After some months, thousands of recordings lie in one external folder
+// and FAT/exFAT drives get slow at finding and creating files there.
+// Section "[Subfolders]" of "options.ini" takes a template per node, like
+//    Raw=%Y\%m%d
+// which puts the recordings into "<external path>\2025\0614". Known are
+// %Y (2025), %y (25), %m, %d, %H (hour), %j (day of the year) and %%.
+//
+// GetTargetFolder() expands the template for the current local time and
+// creates the folder, this is what goes into QIRX's config-file instead of
+// the external path. The FolderRotationTick creates the next folder a
+// little ahead of time and asks the dialog to switch over when the time
+// of the template rolls over (PTMSG_FOLDER_ROLLOVER). The folder before
+// the switch is still looked at by the post-recording stages, a recording
+// running over midnight ends there.
+
+#define ROTATE_POLL_MS  1000
+#define ROTATE_LEAD_S   120     // create the next folder that early
+
+extern int SchedAddIo(PFNSCHEDPROC pfn, void* param, DWORD dueMs, DWORD periodMs);
+extern DWORD SeqRead(volatile LONG* pSequence, const void* pShared, void* pData, DWORD size);
+
+static char szTargets[STATION_MAX][4][MAX_PATH_BUFFER_SIZE];
+static char szPrevious[STATION_MAX][4][MAX_PATH_BUFFER_SIZE];
+static char szPosted[STATION_MAX][4][MAX_PATH_BUFFER_SIZE];
+
+static const WORD daysBeforeMonth[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+
+
+char* GetExternalPathOfNode(int node) {
+    switch (node) {
+    case NODE_RAW:
+        return pPTM->mDlgSet.szExtRawPath;
+    case NODE_AUD:
+        return pPTM->mDlgSet.szExtAudPath;
+    case NODE_ETI:
+        return pPTM->mDlgSet.szExtEtiPath;
+    default:
+        return pPTM->mDlgSet.szExtTiiPath;
+    }
+}
+
+// No drive letters, no way up and no absolute paths in a template
+int IsValidTemplate(const char* szTemplate) {
+    return szTemplate[0] && szTemplate[0] != '\\' && szTemplate[0] != '/' &&
+        !strchr(szTemplate, ':') && !strstr(szTemplate, "..");
+}
+
+// szBase plus the expanded template, 0 if too long
+int ExpandFolderTemplate(const char* szBase, const char* szTemplate, const SYSTEMTIME* pSt, char* szOut) {
+    char* pOut;
+    int len, day, ret = 0;
+
+    len = lstrlen(szBase);
+    if (!len || len + 2 >= MAX_PATH_BUFFER_SIZE)
+        return ret;
+    lstrcpy(szOut, szBase);
+    pOut = szOut + len;
+    if (pOut[-1] != '\\' && pOut[-1] != '/')
+        *pOut++ = '\\';
+
+    for (const char* p = szTemplate; *p; p++) {
+        if (pOut - szOut + 8 >= MAX_PATH_BUFFER_SIZE)
+            return ret;
+        if (*p != '%' || !p[1]) {
+            *pOut++ = *p;
+            continue;
+        }
+        switch (*++p) {
+        case 'Y':
+            pOut += sprintf(pOut, "%04u", pSt->wYear);
+            break;
+        case 'y':
+            pOut += sprintf(pOut, "%02u", pSt->wYear % 100);
+            break;
+        case 'm':
+            pOut += sprintf(pOut, "%02u", pSt->wMonth);
+            break;
+        case 'd':
+            pOut += sprintf(pOut, "%02u", pSt->wDay);
+            break;
+        case 'H':
+            pOut += sprintf(pOut, "%02u", pSt->wHour);
+            break;
+        case 'j':
+            day = daysBeforeMonth[(pSt->wMonth - 1) % 12] + pSt->wDay;
+            if (pSt->wMonth > 2 && !(pSt->wYear % 4) && (pSt->wYear % 100 || !(pSt->wYear % 400)))
+                day++;
+            pOut += sprintf(pOut, "%03d", day);
+            break;
+        default: // "%%" and unknown ones
+            *pOut++ = *p;
+            break;
+        }
+    }
+
+    // no trailing separator
+    while (pOut > szOut + len && (pOut[-1] == '\\' || pOut[-1] == '/'))
+        pOut--;
+    *pOut = 0;
+    ret++;
+    return ret;
+}
+
+// Creates all missing folders of szPath
+int CreateFolderTree(const char* szPath) {
+    char buff[MAX_PATH_BUFFER_SIZE];
+    int ret = 0;
+
+    lstrcpyn(buff, szPath, MAX_PATH_BUFFER_SIZE);
+    for (char* p = buff + 3; *p; p++) { // behind "X:\"
+        if (*p != '\\' && *p != '/')
+            continue;
+        *p = 0;
+        CreateDirectory(buff, NULL);
+        *p = '\\';
+    }
+    if (CreateDirectory(buff, NULL) || ERROR_ALREADY_EXISTS == GetLastError())
+        ret++;
+    return ret;
+}
+
+// The local time seconds from now
+void GetLocalTimeAhead(SYSTEMTIME* pSt, int seconds) {
+    ULARGE_INTEGER ul;
+    FILETIME ft;
+
+    GetLocalTime(pSt);
+    SystemTimeToFileTime(pSt, &ft);
+    ul.LowPart = ft.dwLowDateTime;
+    ul.HighPart = ft.dwHighDateTime;
+    ul.QuadPart += (ULONGLONG)seconds * 10'000'000;
+    ft.dwLowDateTime = ul.LowPart;
+    ft.dwHighDateTime = ul.HighPart;
+    FileTimeToSystemTime(&ft, pSt);
+}
+
+// The folder to go into QIRX's config-file when the external path of the
+// node is made current: the external path itself without a template.
+char* GetTargetFolder(int node) {
+    SYSTEMTIME st;
+    char* pExternal;
+
+    pExternal = GetExternalPathOfNode(node);
+    if (!IsValidTemplate(pPTM->opt.szSubfolders[node]))
+        return pExternal;
+
+    GetLocalTime(&st);
+    if (!ExpandFolderTemplate(pExternal, pPTM->opt.szSubfolders[node], &st, szTargets[pPTM->station][node]) ||
+        !CreateFolderTree(szTargets[pPTM->station][node]))
+        return pExternal;
+    return szTargets[pPTM->station][node];
+}
+
+// Called by the dialog before a rollover, the old folder is kept for the
+// post-recording stages
+void SavePreviousFolder(int node, const char* szCurrent) {
+    lstrcpyn(szPrevious[pPTM->station][node], szCurrent, MAX_PATH_BUFFER_SIZE);
+}
+
+const char* GetPreviousFolder(int node) {
+    return szPrevious[pPTM->station][node];
+}
+
+
+// Once a second on the worker of the station, it creates folders, see
+// SchedAddIo() in scheduler.cpp
+void FolderRotationTick(void* param) {
+    static char szAhead[STATION_MAX][4][MAX_PATH_BUFFER_SIZE];
+    SPACESNAPSHOT snap; // the paths as the dialog published them
+    char szNow[MAX_PATH_BUFFER_SIZE];
+    SYSTEMTIME st;
+
+    SeqRead(&pPTM->spaceSnap.sequence, &pPTM->spaceSnap.snap, &snap, sizeof(snap));
+    for (int node = 0; node < 4; node++) {
+        if (NODE_ETI == node && !pPTM->flagIsQ5)
+            break;
+        if (!IsValidTemplate(pPTM->opt.szSubfolders[node]) || !snap.online[node])
+            continue;
+
+        // the next folder is there before QIRX needs it
+        GetLocalTimeAhead(&st, ROTATE_LEAD_S);
+        if (ExpandFolderTemplate(GetExternalPathOfNode(node), pPTM->opt.szSubfolders[node], &st, szNow) &&
+            lstrcmpi(szNow, szAhead[pPTM->station][node]) && CreateFolderTree(szNow))
+            lstrcpy(szAhead[pPTM->station][node], szNow);
+
+        // time to switch over, asked once per folder
+        GetLocalTime(&st);
+        if (snap.external[node] &&
+            ExpandFolderTemplate(GetExternalPathOfNode(node), pPTM->opt.szSubfolders[node], &st, szNow) &&
+            lstrcmpi(szNow, snap.szPaths[node]) && lstrcmpi(szNow, szPosted[pPTM->station][node])) {
+            lstrcpy(szPosted[pPTM->station][node], szNow);
+            PostMessage(pPTM->hWndDialog, PTMSG_FOLDER_ROLLOVER, node, 0);
+        }
+    }
+}
+
+void StartFolderRotation() {
+    SchedAddIo(FolderRotationTick, NULL, ROTATE_POLL_MS, ROTATE_POLL_MS);
+}
@@ -0,0 +1,367 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+// A drive which can't keep up with a recording is mostly a fragmented one:
+// the old recordings are scattered, and a new one ends up in the gaps
+// between them. FragAnalyzeFolder() asks the file system for the extents
+// of each file in a folder (FSCTL_GET_RETRIEVAL_POINTERS) and for the free
+// clusters of the volume (FSCTL_GET_VOLUME_BITMAP), which gives the
+// largest contiguous free region. Reading the bitmap needs administrator
+// rights, without them the free region stays unknown.
+//
+// The figure we judge by is the number of extra extents per GiB of data,
+// a file in one piece has none.
+//
+// Before the dialog makes an external path current, StartFragCheck() looks
+// at it on a thread of its own. The dialog stays usable meanwhile and gets
+// the result with PTMSG_FRAG_CHECKED. Another check, another node or the
+// end of the dialog cancel it.
+
+#define FRAG_RP_BUFFER      4096                    // retrieval pointers per call
+#define FRAG_BITMAP_BYTES   (1024 * 1024)           // 8 Mi clusters per call
+#define FRAG_WARN_PER_GB    8.0                     // extra extents per GiB
+#define FRAG_WARN_MIN_DATA  (1024ull * 1024 * 1024) // too few data below this
+#define FRAG_WARN_FREE_RUN  (1024ull * 1024 * 1024) // 4 minutes of raw-recording
+
+extern int GetLayoutWarning(const char* szPath, char* szWarning);
+extern int ForEachRecording(const char* szFolder, const char* szExt, PFNRECORDINGPROC pfnRecording,
+    volatile int* pCancel);
+extern HANDLE CreateEngineThread(LPTHREAD_START_ROUTINE pfnThread, LPVOID param);
+extern char* GetExternalPathOfNode(int node);
+
+// One call of FragAnalyzeFolder(). FragFileCallback() gets to it by the
+// cancel flag it is given, which is this one.
+struct FRAGSCAN {
+    volatile int cancel;
+    volatile int* pCancel;    // the caller's
+    FRAGREPORT* pRep;
+    int listFiles;
+};
+
+// A check for the dialog, freed by the one who gets it last
+struct FRAGCHECK {
+    volatile int cancel;
+    int node;
+    char szPath[MAX_PATH_BUFFER_SIZE];
+    FRAGREPORT rep;
+    char szWarning[LAYOUT_WARNING_SIZE]; // empty: the layout is fine
+};
+
+static FRAGCHECK* pFragChecks[STATION_MAX]; // the one the dialog waits for
+
+
+// Number of extents of a file, 0 for files that fit into the MFT record.
+// Extents following each other on the disk count as one.
+int GetFileExtents(const char* szFileName, DWORD* pExtents) {
+    STARTING_VCN_INPUT_BUFFER in{};
+    RETRIEVAL_POINTERS_BUFFER* pRp;
+    BYTE buff[FRAG_RP_BUFFER];
+    HANDLE hFile;
+    LONGLONG vcn, nextLcn = -1;
+    DWORD dNumBytes, err;
+    BOOL ok;
+    int ret = 0;
+
+    *pExtents = 0;
+    // works while QIRX is still writing
+    hFile = CreateFile(szFileName, FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        0, OPEN_EXISTING, 0, 0);
+    if (INVALID_HANDLE_VALUE == hFile)
+        return ret;
+
+    pRp = (RETRIEVAL_POINTERS_BUFFER*)buff;
+    for (;;) {
+        ok = DeviceIoControl(hFile, FSCTL_GET_RETRIEVAL_POINTERS, &in, sizeof(in), pRp, sizeof(buff),
+            &dNumBytes, NULL);
+        err = ok ? 0 : GetLastError();
+        if (!ok && ERROR_MORE_DATA != err) {
+            if (ERROR_HANDLE_EOF == err) // resident or empty
+                ret++;
+            break;
+        }
+
+        vcn = pRp->StartingVcn.QuadPart;
+        for (DWORD i = 0; i < pRp->ExtentCount; i++) {
+            // -1: sparse or compressed, nothing on the disk
+            if (pRp->Extents[i].Lcn.QuadPart != -1) {
+                if (pRp->Extents[i].Lcn.QuadPart != nextLcn)
+                    (*pExtents)++;
+                nextLcn = pRp->Extents[i].Lcn.QuadPart + pRp->Extents[i].NextVcn.QuadPart - vcn;
+            }
+            vcn = pRp->Extents[i].NextVcn.QuadPart;
+        }
+        if (ok) {
+            ret++;
+            break;
+        }
+        in.StartingVcn.QuadPart = vcn;
+    }
+    CloseHandle(hFile);
+    return ret;
+}
+
+// Walks the allocation bitmap of the volume for the largest run of free
+// clusters. Returns 0 without administrator rights.
+int GetFreeRuns(const char* szFolder, FRAGREPORT* pRep, volatile int* pCancel) {
+    STARTING_LCN_INPUT_BUFFER in{};
+    VOLUME_BITMAP_BUFFER* pBm;
+    char szVolume[8];
+    HANDLE hVolume;
+    ULONGLONG run = 0, largest = 0, numBits;
+    DWORD sectorsPerCluster, bytesPerSector, freeClusters, totalClusters, dNumBytes;
+    BOOL ok;
+    BYTE b;
+    int ret = 0;
+
+    if (szFolder[1] != ':')
+        return ret; // no network drives
+    sprintf(szVolume, "%c:\\", szFolder[0]);
+    if (!GetDiskFreeSpace(szVolume, &sectorsPerCluster, &bytesPerSector, &freeClusters, &totalClusters))
+        return ret;
+    pRep->clusterSize = sectorsPerCluster * bytesPerSector;
+
+    sprintf(szVolume, "\\\\.\\%c:", szFolder[0]);
+    hVolume = CreateFile(szVolume, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, 0, 0);
+    if (INVALID_HANDLE_VALUE == hVolume)
+        return ret;
+
+    pBm = (VOLUME_BITMAP_BUFFER*)VCALLOC(sizeof(VOLUME_BITMAP_BUFFER) + FRAG_BITMAP_BYTES);
+    if (!pBm) {
+        CloseHandle(hVolume);
+        return ret;
+    }
+
+    pRep->numFreeRuns = 0;
+    while (!*pCancel) {
+        ok = DeviceIoControl(hVolume, FSCTL_GET_VOLUME_BITMAP, &in, sizeof(in), pBm,
+            sizeof(VOLUME_BITMAP_BUFFER) + FRAG_BITMAP_BYTES, &dNumBytes, NULL);
+        if (!ok && ERROR_MORE_DATA != GetLastError())
+            break;
+
+        // the start is rounded down to a multiple of 8
+        numBits = (ULONGLONG)(dNumBytes - offsetof(VOLUME_BITMAP_BUFFER, Buffer)) * 8;
+        if (numBits > (ULONGLONG)pBm->BitmapSize.QuadPart)
+            numBits = pBm->BitmapSize.QuadPart;
+
+        for (ULONGLONG i = 0; i < numBits; i += 8) {
+            b = pBm->Buffer[i >> 3];
+            if (!b && i + 8 <= numBits) {
+                run += 8; // all free
+                continue;
+            }
+            if (0xFF == b) {
+                if (run) {
+                    pRep->numFreeRuns++;
+                    if (run > largest)
+                        largest = run;
+                }
+                run = 0;
+                continue;
+            }
+            for (ULONGLONG bit = 0; bit < 8 && i + bit < numBits; bit++) {
+                if (b & (1 << bit)) {
+                    if (run) {
+                        pRep->numFreeRuns++;
+                        if (run > largest)
+                            largest = run;
+                    }
+                    run = 0;
+                }
+                else
+                    run++;
+            }
+        }
+
+        if (ok) {
+            ret++;
+            break;
+        }
+        in.StartingLcn.QuadPart = pBm->StartingLcn.QuadPart + numBits;
+    }
+    if (run) {
+        pRep->numFreeRuns++;
+        if (run > largest)
+            largest = run;
+    }
+    if (ret)
+        pRep->largestFreeRun = largest * pRep->clusterSize;
+
+    VFREE(pBm);
+    CloseHandle(hVolume);
+    return ret;
+}
+
+int FragFileCallback(const char* szFileName, ULONGLONG fileSize, volatile int* pCancel) {
+    FRAGSCAN* pScan = CONTAINING_RECORD(pCancel, FRAGSCAN, cancel);
+    FRAGREPORT* pRep = pScan->pRep;
+    DWORD extents;
+
+    if (*pScan->pCancel) {
+        pScan->cancel = 1;
+        return 0;
+    }
+    if (!fileSize || !GetFileExtents(szFileName, &extents))
+        return 0;
+
+    pRep->numFiles++;
+    pRep->bytes += fileSize;
+    pRep->numExtents += extents ? extents : 1;
+    if (extents > 1) {
+        pRep->numFragmentedFiles++;
+        if (pScan->listFiles)
+            printf("%7lu extents %10.1f MiB  %s\n", extents, fileSize / 1048576.0, szFileName);
+    }
+    if (extents > pRep->worstExtents) {
+        pRep->worstExtents = extents;
+        lstrcpyn(pRep->szWorstFile, szFileName, MAX_PATH_BUFFER_SIZE);
+    }
+    return 1;
+}
+
+// Adds the files of szFolder to pRep. The free regions are looked up once
+// per report. listFiles prints the fragmented files to stdout.
+int FragAnalyzeFolder(const char* szFolder, FRAGREPORT* pRep, int listFiles, volatile int* pCancel) {
+    FRAGSCAN scan{};
+    int ret;
+
+    scan.pCancel = pCancel;
+    scan.pRep = pRep;
+    scan.listFiles = listFiles;
+    ret = ForEachRecording(szFolder, "", FragFileCallback, &scan.cancel); // all files
+    if (!pRep->clusterSize)
+        GetFreeRuns(szFolder, pRep, pCancel);
+    return ret;
+}
+
+double FragExtraPerGB(const FRAGREPORT* pRep) {
+    if (!pRep->bytes)
+        return 0;
+    return (double)(pRep->numExtents - pRep->numFiles) * 1073741824.0 / pRep->bytes;
+}
+
+// 1 if the drive will likely fail to keep up with a recording
+int FragIsBad(const FRAGREPORT* pRep) {
+    int ret = 0;
+
+    if (pRep->bytes >= FRAG_WARN_MIN_DATA && FragExtraPerGB(pRep) > FRAG_WARN_PER_GB)
+        ret++;
+    if (pRep->clusterSize && pRep->largestFreeRun && pRep->largestFreeRun < FRAG_WARN_FREE_RUN)
+        ret++;
+    return ret;
+}
+
+void FragFormatReport(const char* szName, const FRAGREPORT* pRep, char* szOut) {
+    char szFree[96];
+
+    if (pRep->largestFreeRun)
+        sprintf(szFree, "largest free region %.1f GiB in %llu free regions",
+            pRep->largestFreeRun / 1073741824.0, pRep->numFreeRuns);
+    else
+        lstrcpy(szFree, "free regions unknown (needs administrator rights)");
+
+    sprintf(szOut, "%s\n%lu files, %.1f GiB, %lu fragmented, %llu extents, %.1f extra extents per GiB\n%s\n",
+        szName, pRep->numFiles, pRep->bytes / 1073741824.0, pRep->numFragmentedFiles,
+        pRep->numExtents, FragExtraPerGB(pRep), szFree);
+}
+
+DWORD WINAPI FragCheckThread(LPVOID param) {
+    FRAGCHECK* pCheck = (FRAGCHECK*)param;
+
+    FragAnalyzeFolder(pCheck->szPath, &pCheck->rep, 0, &pCheck->cancel);
+    if (!pCheck->cancel)
+        GetLayoutWarning(pCheck->szPath, pCheck->szWarning);
+
+    // the dialog doesn't wait for a cancelled one
+    if (pCheck->cancel || !PostMessage(pPTM->hWndDialog, PTMSG_FRAG_CHECKED, pCheck->node, (LPARAM)pCheck))
+        free(pCheck);
+    return 0;
+}
+
+// On the dialog, the running check of the station is forgotten
+void CancelFragCheck() {
+    if (pFragChecks[pPTM->station]) {
+        pFragChecks[pPTM->station]->cancel = 1;
+        pFragChecks[pPTM->station] = NULL;
+    }
+}
+
+// Called before the external path of a node is made current, the result
+// comes with PTMSG_FRAG_CHECKED. Returns 0 if the check didn't start.
+int StartFragCheck(int node) {
+    FRAGCHECK* pCheck;
+    HANDLE hThread;
+    int ret = 0;
+
+    CancelFragCheck();
+    pCheck = (FRAGCHECK*)calloc(1, sizeof(FRAGCHECK));
+    if (!pCheck)
+        return ret;
+    pCheck->node = node;
+    lstrcpyn(pCheck->szPath, GetExternalPathOfNode(node), MAX_PATH_BUFFER_SIZE);
+    hThread = CreateEngineThread(FragCheckThread, pCheck);
+    if (!hThread) {
+        free(pCheck);
+        return ret;
+    }
+    CloseHandle(hThread);
+    pFragChecks[pPTM->station] = pCheck;
+    ret++;
+    return ret;
+}
+
+// PTMSG_FRAG_CHECKED. Returns 1 if the path is fine or the user wants it
+// anyway, 0 for a check cancelled meanwhile.
+int TakeFragCheck(LPARAM lParam) {
+    FRAGCHECK* pCheck = (FRAGCHECK*)lParam;
+    char msg[MAX_PATH_BUFFER_SIZE + 544];
+    int answer, ret = 0;
+
+    if (pCheck != pFragChecks[pPTM->station]) {
+        free(pCheck);
+        return ret;
+    }
+    pFragChecks[pPTM->station] = NULL;
+
+    if (!FragIsBad(&pCheck->rep) && !pCheck->szWarning[0])
+        ret++;
+    else {
+        FragFormatReport(pCheck->szPath, &pCheck->rep, msg);
+        if (pCheck->szWarning[0]) {
+            lstrcat(msg, pCheck->szWarning);
+            lstrcat(msg, "\n");
+        }
+        lstrcat(msg, "\n");
+        lstrcat(msg, szMsgFragCheck);
+        answer = MessageBox(pPTM->hWndDialog, msg,
+            "PathTweaker - drive check", MB_YESNO | MB_SETFOREGROUND | MB_ICONWARNING);
+        if (IDYES == answer)
+            ret++;
+    }
+    free(pCheck);
+    return ret;
+}
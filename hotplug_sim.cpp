@@ -0,0 +1,499 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+#include <Dbt.h>
+#include <stdarg.h>
+
+// "-hotplug" is a stress test of the drive handling of the engine
+// (TakeArrivedDrive() and ReleaseRemovedDrive() in engine.cpp) without
+// real drives. A simulated volume manager takes free drive letters and
+// maps them to folders in the folder for temporary files with
+// DefineDosDevice(), as "subst" does. Plugging in defines the letter and
+// hands the engine a DBT_DEVICEARRIVAL, pulling removes the letter and
+// hands it a DBT_DEVICEREMOVECOMPLETE afterwards, as Windows does. What
+// the engine reads about a drive (ReadDriveIdentity()) and its free space
+// come from the simulation, so a letter can be plugged with the stored
+// drive, another drive with the same label, another one, or a blank one
+// without the folders.
+//
+// raw and aud share a drive, tii and eti have one each, the fourth letter
+// belongs to no node. Each node has another identity policy (raw ask, aud
+// trust, tii label, eti strict), nobody answers a question. QIRX's
+// config-file is a copy in the temporary folder, "settle" is the pause
+// after each write (0 ms by default, no QIRX reads the copy).
+//
+// "events" random events (seed= gives the same sequence again), now and
+// then two letters at once, as from a card reader. After each of them,
+// for each node:
+//   - the config-file has the path the engine took,
+//   - it is the external path if the drive is plugged, the folder is on it
+//     and the policy takes the drive, the original path otherwise,
+//   - the disk space display got the path, and at a tick (not after each
+//     event, they come faster) it samples the drive plugged now.
+// A drive no node uses must not cause a write. The result is CSV: the
+// rewrites per event and the time the engine took per arrival and removal,
+// then the same from the histograms of latency.cpp.
+
+#define HOTPLUG_EVENTS     2000
+#define HOTPLUG_LETTERS    4     // the last one belongs to no node
+#define HOTPLUG_REPORT_MAX 20    // violations printed
+
+#define MEDIA_STORED 0           // the drive the paths were selected on
+#define MEDIA_LABEL  1           // another drive with the same label
+#define MEDIA_OTHER  2
+#define MEDIA_BLANK  3           // another drive without the folders
+#define MEDIA_KINDS  4
+
+extern void TakeArrivedDrive(_DEV_BROADCAST_VOLUME* dbv);
+extern void ReleaseRemovedDrive(_DEV_BROADCAST_VOLUME* dbv);
+extern void ReadOriginalPaths();
+extern void PublishSpaceSnapshot();
+extern int ProcessQirxXMLFile(char* szInOutNodeContent, const char* nodeNeedle, int configReadWrite);
+extern int MakeBenchConfig(const char* szFile, DWORD size, int nodesAtEnd);
+extern int CompareMicros(const void* a, const void* b);
+extern int CheckPathExists(char* path);
+extern int CreateFolderTree(const char* szPath);
+extern char* GetExternalPathOfNode(int node);
+extern DWORD GetVolumeSerial(char* pathOnDrive);
+extern void SetVolumeSource(const VOLUMESOURCE* pSource);
+extern DWORD SeqRead(volatile LONG* pSequence, const void* pShared, void* pData, DWORD size);
+extern void ReadLatency(int phase, LATENCYSUMMARY* pSum);
+extern void SystemSpaceClock(void* param, LARGE_INTEGER* pNow);
+extern int SampleSnapshotNode(NODESAMPLER* pNs, const SPACEINPUT* pIn, const SPACESNAPSHOT* pSnap, int node,
+    NODESPACE* pSpace);
+extern int InitNodeSampler(NODESAMPLER* pNs, const LARGE_INTEGER* pNow);
+extern void FreeNodeSampler(NODESAMPLER* pNs);
+
+struct SIMVOLUME {
+    char szDrive[4];          // "X:"
+    int media;                // MEDIA_..., -1: not plugged
+    char szMounts[MEDIA_KINDS][MAX_PATH_BUFFER_SIZE]; // the folder behind the letter
+    DRIVEIDENTITY ids[MEDIA_KINDS];
+    ULONGLONG freeBytes[MEDIA_KINDS];
+};
+
+static struct {
+    SIMVOLUME volumes[HOTPLUG_LETTERS];
+    char szOriginals[4][MAX_PATH_BUFFER_SIZE];
+    unsigned int seed;
+    int event;
+    LONG64 numViolations;
+} sim;
+
+static const int nodeVolumes[4] = { 0, 0, 1, 2 }; // raw and aud share a drive
+static const int nodePolicies[4] = { IDP_ASK, IDP_TRUST, IDP_LABEL, IDP_STRICT };
+static const char* needles[4] = { needleRawOut, needleAudOut, needleTiiLog, needleEtiOut };
+static const char* nodeNames[4] = { "raw", "aud", "tii", "eti" };
+static const char* mediaNames[MEDIA_KINDS] = { "stored", "label", "other", "blank" };
+
+
+unsigned int SimRandom(unsigned int n) {
+    sim.seed = sim.seed * 1103515245 + 12345;
+    return (sim.seed >> 16) % n;
+}
+
+void SimViolation(int node, const char* szFormat, ...) {
+    char line[2 * MAX_PATH_BUFFER_SIZE + 128];
+    va_list args;
+
+    if (sim.numViolations++ >= HOTPLUG_REPORT_MAX)
+        return;
+    va_start(args, szFormat);
+    _vsnprintf_s(line, sizeof(line), _TRUNCATE, szFormat, args);
+    va_end(args);
+    fprintf(stderr, "event %d, %s: %s\n", sim.event, node < 0 ? "-" : nodeNames[node], line);
+}
+
+// NULL if the path isn't on a simulated drive
+SIMVOLUME* SimVolumeOfPath(const char* szPath) {
+    for (int v = 0; v < HOTPLUG_LETTERS; v++)
+        if (toupper(szPath[0]) == sim.volumes[v].szDrive[0] && ':' == szPath[1])
+            return &sim.volumes[v];
+    return NULL;
+}
+
+// VOLUMESOURCE
+int SimDriveIdentity(void* param, const char* szPath, DRIVEIDENTITY* pId) {
+    const SIMVOLUME* pVol = SimVolumeOfPath(szPath);
+
+    if (!pVol || pVol->media < 0)
+        return 0;
+    *pId = pVol->ids[pVol->media];
+    return 1;
+}
+
+// SPACEINPUT, the original paths are on a real drive
+BOOL SimSpaceQuery(void* param, const char* szPath, ULARGE_INTEGER* pFree, ULARGE_INTEGER* pTotal) {
+    const SIMVOLUME* pVol = SimVolumeOfPath(szPath);
+    ULARGE_INTEGER ullFree;
+
+    if (!pVol)
+        return GetDiskFreeSpaceEx(szPath, pFree, pTotal, &ullFree);
+    if (pVol->media < 0)
+        return FALSE;
+    pFree->QuadPart = pVol->freeBytes[pVol->media];
+    pTotal->QuadPart = 1'000'000'000'000;
+    return TRUE;
+}
+
+DWORD SimSpaceSerial(void* param, char* szPath) {
+    const SIMVOLUME* pVol = SimVolumeOfPath(szPath);
+
+    if (!pVol)
+        return GetVolumeSerial(szPath);
+    return pVol->media < 0 ? 0 : pVol->ids[pVol->media].serial;
+}
+
+int SimPlug(SIMVOLUME* pVol, int media) {
+    int ret = 0;
+
+    if (!DefineDosDevice(0, pVol->szDrive, pVol->szMounts[media]))
+        return ret;
+    pVol->media = media;
+    ret++;
+    return ret;
+}
+
+void SimPull(SIMVOLUME* pVol) {
+    if (pVol->media < 0)
+        return;
+    DefineDosDevice(DDD_REMOVE_DEFINITION | DDD_EXACT_MATCH_ON_REMOVE, pVol->szDrive, pVol->szMounts[pVol->media]);
+    pVol->media = -1;
+}
+
+// What the engine has to make of the drive plugged for the node
+int SimExpectsExternal(int node) {
+    const SIMVOLUME* pVol = &sim.volumes[nodeVolumes[node]];
+
+    switch (pVol->media) {
+    case MEDIA_STORED:
+        return 1;
+    case MEDIA_LABEL:
+        return IDP_TRUST == nodePolicies[node] || IDP_LABEL == nodePolicies[node];
+    case MEDIA_OTHER:
+        return IDP_TRUST == nodePolicies[node];
+    default: // blank or none
+        return 0;
+    }
+}
+
+// The drives, the node's paths on them and the stored identities. Returns
+// 0 if there are not enough free drive letters.
+int SimSetup(const char* szFolder) {
+    DWORD usedLetters = GetLogicalDrives();
+    DWORD* pStoredSerials[4] = { &pPTM->mDlgSet.rawPathDriveSerial, &pPTM->mDlgSet.audPathDriveSerial,
+        &pPTM->mDlgSet.tiiPathDriveSerial, &pPTM->mDlgSet.etiPathDriveSerial };
+    char szPath[MAX_PATH_BUFFER_SIZE];
+    SIMVOLUME* pVol;
+    int letter = 'Z', ret = 0;
+
+    for (int v = 0; v < HOTPLUG_LETTERS; v++) {
+        pVol = &sim.volumes[v];
+        while (letter >= 'D' && (usedLetters & (1 << (letter - 'A'))))
+            letter--;
+        if (letter < 'D')
+            return ret;
+        sprintf(pVol->szDrive, "%c:", letter--);
+        pVol->media = -1;
+        for (int m = 0; m < MEDIA_KINDS; m++) {
+            sprintf(pVol->szMounts[m], "%s\\%c-%s", szFolder, pVol->szDrive[0], mediaNames[m]);
+            CreateFolderTree(pVol->szMounts[m]);
+            pVol->ids[m].serial = 0x5A000000 | v << 8 | m;
+            pVol->ids[m].serial64 = (ULONGLONG)pVol->ids[m].serial << 32 | 0xC0DE;
+            sprintf(pVol->ids[m].szVolumeGuid, "\\\\?\\Volume{%08lx-0000-0000-0000-%012x}\\", pVol->ids[m].serial, m);
+            if (MEDIA_STORED == m || MEDIA_LABEL == m)
+                sprintf(pVol->ids[m].szLabel, "REC-%c", pVol->szDrive[0]);
+            else
+                sprintf(pVol->ids[m].szLabel, "%s-%c", mediaNames[m], pVol->szDrive[0]);
+            pVol->freeBytes[m] = (m + 1) * 100'000'000'000ull + v * 1'000'000'000ull;
+        }
+    }
+
+    for (int node = 0; node < 4; node++) {
+        pVol = &sim.volumes[nodeVolumes[node]];
+        sprintf(GetExternalPathOfNode(node), "%s\\QIRX\\%s", pVol->szDrive, nodeNames[node]);
+        for (int m = 0; m < MEDIA_KINDS; m++) {
+            if (MEDIA_BLANK == m)
+                continue;
+            sprintf(szPath, "%s\\QIRX\\%s", pVol->szMounts[m], nodeNames[node]);
+            CreateFolderTree(szPath);
+        }
+        *pStoredSerials[node] = pVol->ids[MEDIA_STORED].serial;
+        pPTM->driveIds.ids[node] = pVol->ids[MEDIA_STORED];
+        pPTM->opt.identityPolicy[node] = nodePolicies[node];
+
+        sprintf(sim.szOriginals[node], "%s\\original\\%s", szFolder, nodeNames[node]);
+        CreateFolderTree(sim.szOriginals[node]);
+        if (!ProcessQirxXMLFile(sim.szOriginals[node], needles[node], CONFIG_WRITE))
+            return ret;
+    }
+    memcpy(pPTM->driveIds.magic, "DRID", 4);
+    ReadOriginalPaths();
+    ret++;
+    return ret;
+}
+
+// The invariants after an event. pPaths has the paths of the config-file
+// before it and gets the ones after it. Returns the number of nodes whose
+// path changed.
+int SimCheck(char (*pPaths)[MAX_PATH_BUFFER_SIZE], NODESAMPLER* pSamplers, const SPACEINPUT* pInput, int tick) {
+    const char* szCurrent[4] = { pPTM->szCurrentRawPath, pPTM->szCurrentAudPath,
+        pPTM->szCurrentTiiPath, pPTM->szCurrentEtiPath };
+    char szPath[MAX_PATH_BUFFER_SIZE];
+    const char* szExternal;
+    const SIMVOLUME* pVol;
+    SPACESNAPSHOT snap;
+    NODESPACE space;
+    int numChanged = 0;
+
+    SeqRead(&pPTM->spaceSnap.sequence, &pPTM->spaceSnap.snap, &snap, sizeof(snap));
+    for (int node = 0; node < 4; node++) {
+        if (!ProcessQirxXMLFile(szPath, needles[node], CONFIG_READ)) {
+            SimViolation(node, "config-file not readable");
+            continue;
+        }
+        if (lstrcmp(szPath, pPaths[node]))
+            numChanged++;
+        lstrcpy(pPaths[node], szPath);
+
+        if (lstrcmp(szPath, szCurrent[node]))
+            SimViolation(node, "config-file %s, engine %s", szPath, szCurrent[node]);
+        szExternal = GetExternalPathOfNode(node);
+        if (SimExpectsExternal(node)) {
+            if (_strnicmp(szPath, szExternal, lstrlen(szExternal)) || !CheckPathExists(szPath))
+                SimViolation(node, "%s, not the external path on the %s drive", szPath,
+                    mediaNames[sim.volumes[nodeVolumes[node]].media]);
+        }
+        else if (lstrcmpi(szPath, sim.szOriginals[node]))
+            SimViolation(node, "%s, not the original path (drive %s)", szPath,
+                sim.volumes[nodeVolumes[node]].media < 0 ? "pulled" : mediaNames[sim.volumes[nodeVolumes[node]].media]);
+        if (lstrcmp(snap.szPaths[node], szPath))
+            SimViolation(node, "disk space display has %s", snap.szPaths[node]);
+
+        if (!tick)
+            continue;
+        pVol = SimVolumeOfPath(snap.szPaths[node]);
+        if (!SampleSnapshotNode(&pSamplers[node], pInput, &snap, node, &space) || !pVol || pVol->media < 0)
+            continue;
+        if (space.volumeSerial != pVol->ids[pVol->media].serial || space.freeBytes != pVol->freeBytes[pVol->media])
+            SimViolation(node, "disk space of serial number %08lX, the %s drive is %08lX", space.volumeSerial,
+                mediaNames[pVol->media], pVol->ids[pVol->media].serial);
+    }
+    return numChanged;
+}
+
+void PrintMicros(LONG64* pMicros, int num) {
+    LONG64 sum = 0;
+
+    qsort(pMicros, num, sizeof(LONG64), CompareMicros);
+    for (int i = 0; i < num; i++)
+        sum += pMicros[i];
+    printf(",%lld,%lld,%lld,%lld", num ? sum / num : 0, num ? pMicros[num / 2] : 0,
+        num ? pMicros[(num * 99) / 100] : 0, num ? pMicros[num - 1] : 0);
+}
+
+// -hotplug [events=n] [seed=n] [settle=ms]
+// Returns 0 for the usage.
+int CmdHotplug(int argc, char** argv) {
+    char szFolder[MAX_PATH_BUFFER_SIZE], szConfig[MAX_PATH_BUFFER_SIZE], szPaths[4][MAX_PATH_BUFFER_SIZE]{};
+    PATHTWEAKERMEM* pSaved;
+    VOLUMESOURCE source = { SimDriveIdentity, NULL };
+    SPACEINPUT input;
+    NODESAMPLER samplers[4];
+    _DEV_BROADCAST_VOLUME dbv{};
+    LARGE_INTEGER qpf, liStart, liEnd;
+    LATENCYSUMMARY sum;
+    LONG64 writes, numWrites = 0, numUnchanged = 0, maxWrites = 0, numIdleWrites = 0, *pArrivals, *pRemovals;
+    int numEvents = HOTPLUG_EVENTS, settleMs = 0, numArrivals = 0, numRemovals = 0, numPlugged, arrival, want, first;
+    unsigned int seed = GetTickCount();
+    SIMVOLUME* pVol;
+
+    for (int i = 0; i < argc; i++) {
+        if (!_strnicmp(argv[i], "events=", 7))
+            numEvents = atoi(argv[i] + 7);
+        else if (!_strnicmp(argv[i], "seed=", 5))
+            seed = (unsigned int)strtoul(argv[i] + 5, NULL, 10);
+        else if (!_strnicmp(argv[i], "settle=", 7))
+            settleMs = atoi(argv[i] + 7);
+        else
+            return 0;
+    }
+    if (numEvents < 1 || settleMs < 0)
+        return 0;
+
+    if (!GetTempPath(MAX_PATH_BUFFER_SIZE - 64, szFolder))
+        return 1;
+    lstrcat(szFolder, "PathTweakerHotplug");
+    CreateDirectory(szFolder, NULL);
+    sprintf(szConfig, "%s\\qirx4%s", szFolder, szQirxConfigExt);
+    if (!MakeBenchConfig(szConfig, 24 * 1024, 0)) {
+        printf("%s could not be written.\n", szConfig);
+        return 1;
+    }
+    pSaved = (PATHTWEAKERMEM*)VCALLOC(sizeof(PATHTWEAKERMEM));
+    pArrivals = (LONG64*)VCALLOC(numEvents * sizeof(LONG64));
+    pRemovals = (LONG64*)VCALLOC(numEvents * sizeof(LONG64));
+    if (!pSaved || !pArrivals || !pRemovals)
+        goto out;
+
+    // the engine runs on our copy of the settings, nobody is asked
+    memcpy(pSaved, pPTM, sizeof(PATHTWEAKERMEM));
+    lstrcpy(pPTM->szQirxFullConfigFileName, szConfig);
+    sprintf(pPTM->szDaemonLogFileName, "%s\\hotplug.txt", szFolder);
+    pPTM->headless = HEADLESS_DAEMON;
+    pPTM->flagIsQ5 = 1;
+    pPTM->mDlgSet.autoPathSwap = 1;
+    pPTM->opt.configSettleMs = settleMs;
+    pPTM->flagRawDriveSet = pPTM->flagAudDriveSet = pPTM->flagTiiDriveSet = pPTM->flagEtiDriveSet = 0;
+    pPTM->flagRawDriveOnline = pPTM->flagAudDriveOnline = pPTM->flagTiiDriveOnline = pPTM->flagEtiDriveOnline = 0;
+    memset(pPTM->latency, 0, sizeof(pPTM->latency));
+    if (!SimSetup(szFolder)) {
+        printf("No free drive letters or %s not writable.\n", szConfig);
+        goto restore;
+    }
+    SetVolumeSource(&source);
+    PublishSpaceSnapshot();
+
+    QueryPerformanceFrequency(&qpf);
+    input.tickPeriod = 1.0 / qpf.QuadPart;
+    input.pfnClock = SystemSpaceClock;
+    input.pfnQuery = SimSpaceQuery;
+    input.pfnSerial = SimSpaceSerial;
+    input.param = NULL;
+    QueryPerformanceCounter(&liStart);
+    for (int node = 0; node < 4; node++)
+        InitNodeSampler(&samplers[node], &liStart);
+    sim.seed = seed;
+    SimCheck(szPaths, samplers, &input, 1);
+
+    fprintf(stderr, "Drives %s %s %s %s in %s, seed=%u\n", sim.volumes[0].szDrive, sim.volumes[1].szDrive,
+        sim.volumes[2].szDrive, sim.volumes[3].szDrive, szFolder, seed);
+    for (sim.event = 1; sim.event <= numEvents; sim.event++) {
+        numPlugged = 0;
+        for (int v = 0; v < HOTPLUG_LETTERS; v++)
+            numPlugged += sim.volumes[v].media >= 0;
+        arrival = !numPlugged || (numPlugged < HOTPLUG_LETTERS && SimRandom(2));
+        want = SimRandom(8) ? 1 : 2; // two at once from a card reader
+        first = SimRandom(HOTPLUG_LETTERS);
+
+        dbv.dbcv_size = sizeof(dbv);
+        dbv.dbcv_devicetype = DBT_DEVTYP_VOLUME;
+        dbv.dbcv_unitmask = 0;
+        for (int i = 0; i < HOTPLUG_LETTERS && want; i++) {
+            pVol = &sim.volumes[(first + i) % HOTPLUG_LETTERS];
+            if (arrival == (pVol->media >= 0))
+                continue;
+            if (arrival) {
+                // mostly the stored drive
+                switch (SimRandom(20)) {
+                case 0: case 1: case 2:
+                    SimPlug(pVol, MEDIA_LABEL);
+                    break;
+                case 3: case 4: case 5:
+                    SimPlug(pVol, MEDIA_OTHER);
+                    break;
+                case 6: case 7:
+                    SimPlug(pVol, MEDIA_BLANK);
+                    break;
+                default:
+                    SimPlug(pVol, MEDIA_STORED);
+                    break;
+                }
+                if (pVol->media < 0)
+                    continue;
+            }
+            else
+                SimPull(pVol);
+            dbv.dbcv_unitmask |= 1 << (pVol->szDrive[0] - 'A');
+            want--;
+        }
+        if (!dbv.dbcv_unitmask) {
+            SimViolation(-1, "%s failed", arrival ? "DefineDosDevice()" : "removal");
+            break;
+        }
+
+        writes = pPTM->counters.configWrites;
+        QueryPerformanceCounter(&liStart);
+        if (arrival)
+            TakeArrivedDrive(&dbv);
+        else
+            ReleaseRemovedDrive(&dbv);
+        QueryPerformanceCounter(&liEnd);
+        writes = pPTM->counters.configWrites - writes;
+        if (arrival)
+            pArrivals[numArrivals++] = (liEnd.QuadPart - liStart.QuadPart) * 1000000 / qpf.QuadPart;
+        else
+            pRemovals[numRemovals++] = (liEnd.QuadPart - liStart.QuadPart) * 1000000 / qpf.QuadPart;
+
+        numWrites += writes;
+        if (writes > maxWrites)
+            maxWrites = writes;
+        // a drive no node uses
+        if (dbv.dbcv_unitmask == (DWORD)(1 << (sim.volumes[HOTPLUG_LETTERS - 1].szDrive[0] - 'A')) && writes) {
+            numIdleWrites += writes;
+            SimViolation(-1, "%lld write(s) for %s, no node uses it", writes, sim.volumes[HOTPLUG_LETTERS - 1].szDrive);
+        }
+        writes -= SimCheck(szPaths, samplers, &input, !SimRandom(3));
+        if (writes > 0)
+            numUnchanged += writes;
+    }
+
+    printf("events,arrivals,removals,seed,rewrites,rewrites_per_event,max_rewrites,unchanged_rewrites,idle_rewrites,"
+        "violations,arrival_mean_us,arrival_p50_us,arrival_p99_us,arrival_max_us,removal_mean_us,removal_p50_us,"
+        "removal_p99_us,removal_max_us\n");
+    printf("%d,%d,%d,%u,%lld,%.2f,%lld,%lld,%lld,%lld", numArrivals + numRemovals, numArrivals, numRemovals, seed,
+        numWrites, (double)numWrites / (numArrivals + numRemovals ? numArrivals + numRemovals : 1), maxWrites,
+        numUnchanged, numIdleWrites, sim.numViolations);
+    PrintMicros(pArrivals, numArrivals);
+    PrintMicros(pRemovals, numRemovals);
+    printf("\n\nswitch,count,mean_us,p50_us,p90_us,p99_us,max_us\n");
+    for (int phase = LAT_ARRIVAL; phase <= LAT_REMOVAL; phase++) {
+        ReadLatency(phase, &sum);
+        printf("%s,%lld,%lld,%lld,%lld,%lld,%lld\n", phase == LAT_ARRIVAL ? "arrival" : "removal", sum.count,
+            sum.count ? sum.sumMicros / sum.count : 0, sum.p50, sum.p90, sum.p99, sum.maxMicros);
+    }
+    fprintf(stderr, "%lld violation(s).\n", sim.numViolations);
+
+    for (int v = 0; v < HOTPLUG_LETTERS; v++)
+        SimPull(&sim.volumes[v]);
+    for (int node = 0; node < 4; node++)
+        FreeNodeSampler(&samplers[node]);
+    SetVolumeSource(NULL);
+
+restore:
+    memcpy(pPTM, pSaved, sizeof(PATHTWEAKERMEM));
+    DeleteFile(szConfig);
+
+out:
+    if (pSaved)
+        VFREE(pSaved);
+    if (pArrivals)
+        VFREE(pArrivals);
+    if (pRemovals)
+        VFREE(pRemovals);
+    return 1;
+}
@@ -0,0 +1,597 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+#include <intrin.h>
+#include <math.h>
+
+// QIRX writes raw recordings as interleaved I/Q pairs of unsigned bytes,
+// 127.5 is zero. With 2.048 MSpl/s that are 4 MB per second, so a
+// recording of an hour is about 15 GB.
+//
+// The scanner cuts a finished recording into blocks of 1 MiB (a quarter
+// second) and computes for each block the DC offset of I and Q, the mean
+// power, the number of clipped samples (0 or 255) and the number of bytes
+// in zero-filled stretches. The receiver never delivers 16 zeros in a row,
+// so these are write dropouts. Several threads work on separate windows
+// of the file mapping.
+//
+// Results go to "<recording>.iqs" (IQSUMMARYHEADER followed by one
+// IQBLOCKSTATS per block) and a readable report to "<recording>.txt".
+
+#define IQ_BLOCK_SIZE       (1024 * 1024)
+#define IQ_MAP_WINDOW       (64 * 1024 * 1024)  // a multiple of IQ_BLOCK_SIZE
+#define IQ_MAX_THREADS      8
+#define IQ_SAMPLE_RATE      2'048'000.0
+#define IQ_FULL_SCALE_POWER (2.0 * 127.5 * 127.5)
+#define IQ_MIN_POWER_DB     -99.0f     // for blocks without any signal
+#define IQ_SILENT_DB        20.0f      // blocks this far below the median are silent
+#define IQ_MAX_REPORT       500        // lines per report, the summary is always written
+#define IQ_SUMMARY_VERSION  1
+
+extern int OpenMappedFile(MAPPEDFILE* pMf, const char* szFileName);
+extern BYTE* MapFileWindow(MAPPEDFILE* pMf, ULONGLONG offset, SIZE_T* pInOutSize);
+extern void UnmapFileWindow(MAPPEDFILE* pMf);
+extern void CloseMappedFile(MAPPEDFILE* pMf);
+extern int ForEachRecording(const char* szFolder, const char* szExt, PFNRECORDINGPROC pfnRecording,
+    volatile int* pCancel);
+extern HANDLE CreateEngineThread(LPTHREAD_START_ROUTINE pfnThread, LPVOID param);
+
+
+struct IQBLOCKSTATS {
+    float dcI;                // relative to full scale
+    float dcQ;
+    float powerDb;            // dBFS
+    DWORD numClipped;         // samples (bytes) at 0 or 255, without the dropouts
+    DWORD numZeroBytes;       // in zero-filled 16 byte chunks
+};
+
+// Raw sums of a block, the kernels below fill it
+struct IQSUMS {
+    ULONGLONG sumI;
+    ULONGLONG sumQ;
+    ULONGLONG sumSquares;     // of (x - 128), I and Q
+    ULONGLONG numClipped;
+    ULONGLONG numZeroChunks;
+};
+
+struct IQSCAN {
+    MAPPEDFILE* pMf;
+    const BYTE* pData;        // the benchmark has its data in memory, no pMf then
+    ULONGLONG fileSize;
+    IQBLOCKSTATS* pBlocks;
+    DWORD numBlocks;
+    volatile long nextWindow;
+    long numWindows;
+    volatile long failed;
+    volatile int* pCancel;
+    int background;
+};
+
+typedef void (*PFNIQSUMS)(const BYTE* p, SIZE_T len, IQSUMS* pSums);
+
+
+// The plain C version, for the tail of a block and as reference for the
+// benchmark. len must be even.
+void IqSumsScalar(const BYTE* p, SIZE_T len, IQSUMS* pSums) {
+    SIZE_T i, j;
+    int v, zeros;
+
+    for (i = 0; i < len; i += 16) {
+        zeros = 0;
+        for (j = i; j < i + 16 && j < len; j++) {
+            if (j & 1)
+                pSums->sumQ += p[j];
+            else
+                pSums->sumI += p[j];
+            v = p[j] - 128;
+            pSums->sumSquares += v * v;
+            if (0 == p[j] || 255 == p[j])
+                pSums->numClipped++;
+            zeros += !p[j];
+        }
+        if (16 == zeros)
+            pSums->numZeroChunks++;
+    }
+}
+
+// SSE2 does 16 bytes (8 I/Q pairs) per step. PSADBW sums up the bytes,
+// with the odd bytes masked out for I and shifted down for Q. The squares
+// come from PMADDWD on the sign-extended (x - 128) values, which gives
+// I*I + Q*Q per pair. Clipped bytes are counted in 8 bit lanes, so the
+// counters are flushed every 255 steps, the 32 bit square sums as well.
+void IqSumsSse2(const BYTE* p, SIZE_T len, IQSUMS* pSums) {
+    __m128i v, s, lo, hi, isZero, zero, ones, evenMask, sign;
+    __m128i accI, accQ, accSq, accClip, sq, clip8;
+    SIZE_T steps, n;
+    ULONGLONG zeroChunks = 0;
+    long long tmp[2];
+
+    zero = _mm_setzero_si128();
+    ones = _mm_set1_epi8(-1);
+    evenMask = _mm_set1_epi16(0x00FF);
+    sign = _mm_set1_epi8((char)0x80);
+    accI = accQ = accSq = accClip = zero;
+
+    steps = len / 16;
+    while (steps) {
+        n = steps < 255 ? steps : 255;
+        steps -= n;
+        sq = clip8 = zero;
+
+        while (n--) {
+            v = _mm_loadu_si128((const __m128i*)p);
+            p += 16;
+
+            accI = _mm_add_epi64(accI, _mm_sad_epu8(_mm_and_si128(v, evenMask), zero));
+            accQ = _mm_add_epi64(accQ, _mm_sad_epu8(_mm_srli_epi16(v, 8), zero));
+
+            s = _mm_xor_si128(v, sign);
+            lo = _mm_srai_epi16(_mm_unpacklo_epi8(s, s), 8);
+            hi = _mm_srai_epi16(_mm_unpackhi_epi8(s, s), 8);
+            sq = _mm_add_epi32(sq, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+
+            isZero = _mm_cmpeq_epi8(v, zero);
+            clip8 = _mm_sub_epi8(clip8, _mm_or_si128(isZero, _mm_cmpeq_epi8(v, ones)));
+            zeroChunks += (0xFFFF == _mm_movemask_epi8(isZero));
+        }
+        accClip = _mm_add_epi64(accClip, _mm_sad_epu8(clip8, zero));
+        accSq = _mm_add_epi64(accSq, _mm_unpacklo_epi32(sq, zero));
+        accSq = _mm_add_epi64(accSq, _mm_unpackhi_epi32(sq, zero));
+    }
+
+    _mm_storeu_si128((__m128i*)tmp, accI);
+    pSums->sumI += tmp[0] + tmp[1];
+    _mm_storeu_si128((__m128i*)tmp, accQ);
+    pSums->sumQ += tmp[0] + tmp[1];
+    _mm_storeu_si128((__m128i*)tmp, accSq);
+    pSums->sumSquares += tmp[0] + tmp[1];
+    _mm_storeu_si128((__m128i*)tmp, accClip);
+    pSums->numClipped += tmp[0] + tmp[1];
+    pSums->numZeroChunks += zeroChunks;
+
+    if (len & 15)
+        IqSumsScalar(p, len & 15, pSums);
+}
+
+
+void IqBlockStats(const BYTE* p, SIZE_T len, IQBLOCKSTATS* pStats, PFNIQSUMS pfnSums) {
+    IQSUMS sums{};
+    double n, power;
+
+    len &= ~(SIZE_T)1; // whole pairs only
+    if (!len) {
+        memset(pStats, 0, sizeof(IQBLOCKSTATS));
+        pStats->powerDb = IQ_MIN_POWER_DB;
+        return;
+    }
+    pfnSums(p, len, &sums);
+
+    // (x - 127.5)^2 = (x - 128)^2 + (x - 128) + 0.25
+    n = len / 2.0;
+    power = (sums.sumSquares + (double)(sums.sumI + sums.sumQ) - 2 * 128.0 * n + 0.5 * n) / n;
+
+    pStats->dcI = (float)((sums.sumI / n - 127.5) / 127.5);
+    pStats->dcQ = (float)((sums.sumQ / n - 127.5) / 127.5);
+    pStats->powerDb = power > 0. ? (float)(10.0 * log10(power / IQ_FULL_SCALE_POWER)) : IQ_MIN_POWER_DB;
+    if (pStats->powerDb < IQ_MIN_POWER_DB)
+        pStats->powerDb = IQ_MIN_POWER_DB;
+    pStats->numZeroBytes = (DWORD)(sums.numZeroChunks * 16);
+    pStats->numClipped = (DWORD)(sums.numClipped - pStats->numZeroBytes);
+}
+
+
+// Worker threads take the next window of the file until all are done.
+// They share the file mapping of the caller, each one with its own view.
+DWORD WINAPI IqScanThread(LPVOID param) {
+    IQSCAN* pScan = (IQSCAN*)param;
+    MAPPEDFILE mf;
+    ULONGLONG offset;
+    SIZE_T size, pos, len;
+    DWORD block;
+    const BYTE* p;
+    long window;
+
+    if (pScan->background)
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+
+    if (pScan->pMf) {
+        memcpy(&mf, pScan->pMf, sizeof(MAPPEDFILE));
+        mf.pView = NULL;
+    }
+
+    while (!*pScan->pCancel && !pScan->failed) {
+        window = InterlockedIncrement(&pScan->nextWindow) - 1;
+        if (window >= pScan->numWindows)
+            break;
+
+        offset = (ULONGLONG)window * IQ_MAP_WINDOW;
+        size = IQ_MAP_WINDOW;
+        if (pScan->pData) {
+            p = pScan->pData + offset;
+            if (size > pScan->fileSize - offset)
+                size = (SIZE_T)(pScan->fileSize - offset);
+        }
+        else
+            p = MapFileWindow(&mf, offset, &size);
+        if (!p) {
+            InterlockedExchange(&pScan->failed, 1);
+            break;
+        }
+
+        block = (DWORD)(offset / IQ_BLOCK_SIZE);
+        for (pos = 0; pos < size && block < pScan->numBlocks; pos += IQ_BLOCK_SIZE, block++) {
+            len = size - pos < IQ_BLOCK_SIZE ? size - pos : IQ_BLOCK_SIZE;
+            IqBlockStats(p + pos, len, &pScan->pBlocks[block], IqSumsSse2);
+        }
+    }
+
+    if (pScan->pMf)
+        UnmapFileWindow(&mf);
+    if (pScan->background)
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+    return 0;
+}
+
+// Runs the workers on an opened file (or the benchmark data). Returns 0 if
+// cancelled or failed.
+int RunIqScan(IQSCAN* pScan) {
+    HANDLE hThreads[IQ_MAX_THREADS];
+    SYSTEM_INFO si;
+    int numThreads = 0;
+
+    GetSystemInfo(&si);
+    pScan->numWindows = (long)((pScan->fileSize + IQ_MAP_WINDOW - 1) / IQ_MAP_WINDOW);
+
+    for (DWORD i = 0; i < si.dwNumberOfProcessors && i < IQ_MAX_THREADS
+        && (long)i < pScan->numWindows; i++) {
+        hThreads[numThreads] = CreateEngineThread(IqScanThread, pScan);
+        if (hThreads[numThreads])
+            numThreads++;
+    }
+
+    if (!numThreads) // then we do it on our own
+        IqScanThread(pScan);
+
+    if (numThreads) {
+        WaitForMultipleObjects(numThreads, hThreads, TRUE, INFINITE);
+        for (int i = 0; i < numThreads; i++)
+            CloseHandle(hThreads[i]);
+    }
+    return !*pScan->pCancel && !pScan->failed;
+}
+
+
+int CompareFloat(const void* a, const void* b) {
+    float fa = *(const float*)a, fb = *(const float*)b;
+    return (fa > fb) - (fa < fb);
+}
+
+// Fills the file-wide values of the header from the blocks
+void SummarizeIqBlocks(IQSUMMARYHEADER* pHdr, const IQBLOCKSTATS* pBlocks) {
+    double dcI = 0., dcQ = 0., power = 0.;
+    float* pPowers;
+    int inDropout = 0, bin;
+
+    for (DWORD i = 0; i < pHdr->numBlocks; i++) {
+        dcI += pBlocks[i].dcI;
+        dcQ += pBlocks[i].dcQ;
+        power += pow(10.0, pBlocks[i].powerDb / 10.0);
+        pHdr->numClipped += pBlocks[i].numClipped;
+        pHdr->numZeroBytes += pBlocks[i].numZeroBytes;
+
+        if (pBlocks[i].numZeroBytes && !inDropout)
+            pHdr->numDropouts++;
+        inDropout = pBlocks[i].numZeroBytes != 0;
+
+        bin = (int)-pBlocks[i].powerDb;
+        if (bin < 0)
+            bin = 0;
+        if (bin >= IQ_HIST_BINS)
+            bin = IQ_HIST_BINS - 1;
+        pHdr->histogram[bin]++;
+    }
+    if (!pHdr->numBlocks)
+        return;
+
+    pHdr->dcI = (float)(dcI / pHdr->numBlocks);
+    pHdr->dcQ = (float)(dcQ / pHdr->numBlocks);
+    pHdr->powerDb = (float)(10.0 * log10(power / pHdr->numBlocks));
+
+    pPowers = (float*)malloc(pHdr->numBlocks * sizeof(float));
+    if (pPowers) {
+        for (DWORD i = 0; i < pHdr->numBlocks; i++)
+            pPowers[i] = pBlocks[i].powerDb;
+        qsort(pPowers, pHdr->numBlocks, sizeof(float), CompareFloat);
+        pHdr->medianPowerDb = pPowers[pHdr->numBlocks / 2];
+        free(pPowers);
+
+        for (DWORD i = 0; i < pHdr->numBlocks; i++)
+            if (pBlocks[i].powerDb < pHdr->medianPowerDb - IQ_SILENT_DB)
+                pHdr->numSilent++;
+    }
+}
+
+
+// Writes runs of dropout and silent blocks, the summary and the histogram
+void WriteIqReport(HANDLE hReport, const char* szFileName, const IQSUMMARYHEADER* pHdr,
+    const IQBLOCKSTATS* pBlocks, int complete, double seconds, ULONGLONG bytesDone) {
+    char buff[640];
+    DWORD dNumBytesWritten, start = 0;
+    int len, lines = 0, kind, runKind = 0;
+    const char* kinds[3] = { "", "dropout (zero-filled)", "silent" };
+
+    for (DWORD i = 0; i <= pHdr->numBlocks && lines < IQ_MAX_REPORT; i++) {
+        kind = 0;
+        if (i < pHdr->numBlocks) {
+            if (pBlocks[i].numZeroBytes)
+                kind = 1;
+            else if (pBlocks[i].powerDb < pHdr->medianPowerDb - IQ_SILENT_DB)
+                kind = 2;
+        }
+        if (kind == runKind)
+            continue;
+        if (runKind) {
+            len = sprintf(buff, "0x%012llX  %8.2f s  %s for %.2f s\r\n",
+                (ULONGLONG)start * IQ_BLOCK_SIZE, start * (IQ_BLOCK_SIZE / 2 / IQ_SAMPLE_RATE),
+                kinds[runKind], (i - start) * (IQ_BLOCK_SIZE / 2 / IQ_SAMPLE_RATE));
+            if (++lines == IQ_MAX_REPORT)
+                len += sprintf(buff + len, "... more lines suppressed\r\n");
+            WriteFile(hReport, buff, len, &dNumBytesWritten, NULL);
+        }
+        runKind = kind;
+        start = i;
+    }
+
+    len = sprintf(buff,
+        "\r\n%s\r\n"
+        "%s, %llu bytes (%.1f s at 2.048 MSpl/s), %lu blocks of 1 MiB\r\n"
+        "DC offset I %+.4f, Q %+.4f (full scale 1.0)\r\n"
+        "power %.1f dBFS (median %.1f dBFS), %lu silent blocks\r\n"
+        "%llu clipped samples (%.4f %%), %lu dropouts with %llu zero bytes\r\n"
+        "checked in %.3f s (%.1f MB/s)\r\n\r\n"
+        "power histogram (blocks per dB):\r\n",
+        szFileName, complete ? "complete" : "CANCELLED",
+        pHdr->fileSize, pHdr->fileSize / 2 / IQ_SAMPLE_RATE, pHdr->numBlocks,
+        pHdr->dcI, pHdr->dcQ, pHdr->powerDb, pHdr->medianPowerDb, pHdr->numSilent,
+        pHdr->numClipped, pHdr->fileSize ? 100.0 * pHdr->numClipped / pHdr->fileSize : 0.,
+        pHdr->numDropouts, pHdr->numZeroBytes,
+        seconds, seconds > 0. ? bytesDone / seconds / 1'000'000.0 : 0.);
+    WriteFile(hReport, buff, len, &dNumBytesWritten, NULL);
+
+    for (int i = 0; i < IQ_HIST_BINS; i++) {
+        if (!pHdr->histogram[i])
+            continue;
+        len = sprintf(buff, "%4d dBFS %8lu\r\n", -i, pHdr->histogram[i]);
+        WriteFile(hReport, buff, len, &dNumBytesWritten, NULL);
+    }
+}
+
+
+// Scans one finished recording and writes the summary and the report.
+// *pHdr (optional) gets the results. pCancel may stop us any time.
+int IqScanFile(const char* szFileName, IQSUMMARYHEADER* pHdr, volatile int* pCancel, int background) {
+    char szOut[MAX_PATH_BUFFER_SIZE + 8];
+    IQSUMMARYHEADER hdr{};
+    MAPPEDFILE mf;
+    IQSCAN scan{};
+    HANDLE hOut;
+    DWORD dNumBytesWritten;
+    LARGE_INTEGER qpf, liStart, liEnd;
+    double seconds;
+    int ret = 0;
+
+    if (lstrlen(szFileName) >= MAX_PATH_BUFFER_SIZE)
+        return ret;
+
+    if (!OpenMappedFile(&mf, szFileName))
+        return ret; // busy (still recording?), empty or gone
+
+    memcpy(hdr.magic, "IQSM", 4);
+    hdr.version = IQ_SUMMARY_VERSION;
+    hdr.fileSize = mf.fileSize;
+    hdr.blockSize = IQ_BLOCK_SIZE;
+    hdr.numBlocks = (DWORD)((mf.fileSize / 2 * 2 + IQ_BLOCK_SIZE - 1) / IQ_BLOCK_SIZE); // whole pairs
+
+    scan.pMf = &mf;
+    scan.fileSize = mf.fileSize;
+    scan.numBlocks = hdr.numBlocks;
+    scan.pCancel = pCancel;
+    scan.background = background;
+    scan.pBlocks = (IQBLOCKSTATS*)VCALLOC(hdr.numBlocks * sizeof(IQBLOCKSTATS));
+
+    if (scan.pBlocks) {
+        QueryPerformanceFrequency(&qpf);
+        QueryPerformanceCounter(&liStart);
+        ret = RunIqScan(&scan);
+        QueryPerformanceCounter(&liEnd);
+        seconds = (double)(liEnd.QuadPart - liStart.QuadPart) / qpf.QuadPart;
+
+        if (ret) {
+            SummarizeIqBlocks(&hdr, scan.pBlocks);
+
+            ret = 0;
+            sprintf(szOut, "%s%s", szFileName, szIqSummaryExt);
+            hOut = CreateFile(szOut, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
+            if (INVALID_HANDLE_VALUE != hOut) {
+                WriteFile(hOut, &hdr, sizeof(IQSUMMARYHEADER), &dNumBytesWritten, NULL);
+                WriteFile(hOut, scan.pBlocks, hdr.numBlocks * sizeof(IQBLOCKSTATS),
+                    &dNumBytesWritten, NULL);
+                CloseHandle(hOut);
+                ret++;
+            }
+        }
+
+        sprintf(szOut, "%s%s", szFileName, szReportExt);
+        hOut = CreateFile(szOut, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
+        if (INVALID_HANDLE_VALUE != hOut) {
+            WriteIqReport(hOut, szFileName, &hdr, scan.pBlocks, ret, seconds,
+                ret ? mf.fileSize : 0);
+            CloseHandle(hOut);
+        }
+        VFREE(scan.pBlocks);
+    }
+    CloseMappedFile(&mf);
+
+    if (pHdr)
+        memcpy(pHdr, &hdr, sizeof(IQSUMMARYHEADER));
+    return ret;
+}
+
+// A summary is up to date, if it was made for a file of the same size.
+int HaveIqSummary(const char* szFileName, ULONGLONG fileSize) {
+    char szSum[MAX_PATH_BUFFER_SIZE + 8];
+    IQSUMMARYHEADER hdr;
+    DWORD dNumBytesRead = 0;
+    HANDLE hSum;
+
+    sprintf(szSum, "%s%s", szFileName, szIqSummaryExt);
+    hSum = CreateFile(szSum, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
+    if (INVALID_HANDLE_VALUE == hSum)
+        return 0;
+
+    ReadFile(hSum, &hdr, sizeof(IQSUMMARYHEADER), &dNumBytesRead, NULL);
+    CloseHandle(hSum);
+
+    return dNumBytesRead == sizeof(IQSUMMARYHEADER) && !memcmp(hdr.magic, "IQSM", 4) &&
+        IQ_SUMMARY_VERSION == hdr.version && hdr.fileSize == fileSize;
+}
+
+// For the PostRecordingThread, so the workers run in background mode, too
+int IqScanIfNeeded(const char* szFileName, ULONGLONG fileSize, volatile int* pCancel) {
+    if (HaveIqSummary(szFileName, fileSize))
+        return 0;
+    return IqScanFile(szFileName, NULL, pCancel, 1);
+}
+
+int IqScanFolder(const char* szFolder, volatile int* pCancel) {
+    return ForEachRecording(szFolder, szRawExt, IqScanIfNeeded, pCancel);
+}
+
+
+// Throughput benchmark with synthetic IQ data in memory, without disk I/O.
+// The data is noise with a DC offset and a tone, with some clipped bursts,
+// a silent stretch and a zero-filled dropout. Prints the results to stdout.
+void IqBenchmark(int megaBytes) {
+    BYTE* pBuf;
+    SIZE_T size;
+    IQSCAN scan{};
+    IQSUMMARYHEADER hdr;
+    IQBLOCKSTATS* pRef;
+    LARGE_INTEGER qpf, liStart, liEnd;
+    double seconds, phase = 0., amp;
+    unsigned int seed = 12345;
+    int noise, v, mismatch = 0;
+    volatile int neverCancel = 0;
+
+    if (megaBytes < 1)
+        megaBytes = 1;
+    size = (SIZE_T)megaBytes * IQ_BLOCK_SIZE;
+    pBuf = (BYTE*)VCALLOC(size);
+    hdr.numBlocks = megaBytes;
+    pRef = (IQBLOCKSTATS*)VCALLOC(hdr.numBlocks * sizeof(IQBLOCKSTATS));
+    scan.pBlocks = (IQBLOCKSTATS*)VCALLOC(hdr.numBlocks * sizeof(IQBLOCKSTATS));
+    if (!pBuf || !pRef || !scan.pBlocks) {
+        printf("Not enough memory for %d MB.\n", megaBytes);
+        if (pBuf)
+            VFREE(pBuf);
+        if (pRef)
+            VFREE(pRef);
+        if (scan.pBlocks)
+            VFREE(scan.pBlocks);
+        return;
+    }
+
+    for (SIZE_T i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        noise = (int)((seed >> 16) & 31) - 16;
+        amp = 40.0;
+        if ((i / IQ_BLOCK_SIZE) % 50 == 10)      // a strong burst, clipped
+            amp = 200.0;
+        else if ((i / IQ_BLOCK_SIZE) % 50 == 30) // nearly nothing
+            amp = 0.5, noise /= 16;
+        if (!(i & 1))
+            phase += 0.05;
+        v = 130 + noise + (int)(amp * ((i & 1) ? sin(phase) : cos(phase)));
+        pBuf[i] = (BYTE)(v < 0 ? 0 : v > 255 ? 255 : v);
+    }
+    if (size > 3 * IQ_BLOCK_SIZE)  // a dropout of 100 ms in the third block
+        memset(pBuf + 2 * IQ_BLOCK_SIZE + 1000, 0, 409600);
+
+    printf("IQ scanner benchmark, %d MB (%.1f s of recording at 2.048 MSpl/s)\n",
+        megaBytes, size / 2 / IQ_SAMPLE_RATE);
+
+    QueryPerformanceFrequency(&qpf);
+    QueryPerformanceCounter(&liStart);
+    for (DWORD i = 0; i < hdr.numBlocks; i++)
+        IqBlockStats(pBuf + (SIZE_T)i * IQ_BLOCK_SIZE, IQ_BLOCK_SIZE, &pRef[i], IqSumsScalar);
+    QueryPerformanceCounter(&liEnd);
+    seconds = (double)(liEnd.QuadPart - liStart.QuadPart) / qpf.QuadPart;
+    printf("%-22s %9.1f MB/s, %7.0fx real time\n", "scalar, 1 thread",
+        size / seconds / 1'000'000.0, size / 2 / IQ_SAMPLE_RATE / seconds);
+
+    QueryPerformanceCounter(&liStart);
+    for (DWORD i = 0; i < hdr.numBlocks; i++)
+        IqBlockStats(pBuf + (SIZE_T)i * IQ_BLOCK_SIZE, IQ_BLOCK_SIZE, &scan.pBlocks[i], IqSumsSse2);
+    QueryPerformanceCounter(&liEnd);
+    seconds = (double)(liEnd.QuadPart - liStart.QuadPart) / qpf.QuadPart;
+    printf("%-22s %9.1f MB/s, %7.0fx real time\n", "SSE2, 1 thread",
+        size / seconds / 1'000'000.0, size / 2 / IQ_SAMPLE_RATE / seconds);
+
+    for (DWORD i = 0; i < hdr.numBlocks; i++)
+        if (memcmp(&pRef[i], &scan.pBlocks[i], sizeof(IQBLOCKSTATS)))
+            mismatch++;
+
+    memset(scan.pBlocks, 0, hdr.numBlocks * sizeof(IQBLOCKSTATS));
+    scan.pData = pBuf;
+    scan.fileSize = size;
+    scan.pCancel = &neverCancel;
+    scan.numBlocks = hdr.numBlocks;
+
+    QueryPerformanceCounter(&liStart);
+    RunIqScan(&scan);
+    QueryPerformanceCounter(&liEnd);
+    seconds = (double)(liEnd.QuadPart - liStart.QuadPart) / qpf.QuadPart;
+    printf("%-22s %9.1f MB/s, %7.0fx real time\n", "SSE2, all threads",
+        size / seconds / 1'000'000.0, size / 2 / IQ_SAMPLE_RATE / seconds);
+
+    for (DWORD i = 0; i < hdr.numBlocks; i++)
+        if (memcmp(&pRef[i], &scan.pBlocks[i], sizeof(IQBLOCKSTATS)))
+            mismatch++;
+
+    memset(&hdr, 0, sizeof(IQSUMMARYHEADER));
+    hdr.fileSize = size;
+    hdr.numBlocks = megaBytes;
+    SummarizeIqBlocks(&hdr, scan.pBlocks);
+    printf("DC I %+.4f, Q %+.4f | power %.1f dBFS, median %.1f | %lu silent blocks | "
+        "%llu clipped | %lu dropouts, %llu zero bytes | %s\n",
+        hdr.dcI, hdr.dcQ, hdr.powerDb, hdr.medianPowerDb, hdr.numSilent, hdr.numClipped,
+        hdr.numDropouts, hdr.numZeroBytes, mismatch ? "KERNELS DIFFER" : "kernels match");
+
+    VFREE(pBuf);
+    VFREE(pRef);
+    VFREE(scan.pBlocks);
+}
@@ -0,0 +1,226 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+#include <intrin.h>
+
+// The path switches are timed phase by phase. LAT_ARRIVAL and LAT_REMOVAL
+// run from the device event up to the written config-file, per node: this
+// is how long QIRX kept on recording to the old path. On the way there are
+// ValidatePath() (engine.cpp) with the check of the drive's identity
+// (LAT_SERIAL), and in ProcessQirxXMLNode() (configparser.cpp) the open
+// with its retries, the read, the rewrite and the pause for QIRX.
+//
+// Each phase has a histogram in the manner of HdrHistogram: the
+// microseconds go to 16 buckets per power of two, exact below 32 us and
+// within 1/16 above. A time is counted with a few interlocked operations,
+// no lock, from any thread. The metrics exporter and "lat" of the control
+// pipe read the buckets as they are.
+//
+// With "Trace=1" in the section "[Metrics]" of "options.ini", the phases
+// are kept in a ring of the last TRACE_EVENTS, too. They go to "trace.json"
+// next to "dlg.dat" at the end, or on "trace" of the control pipe, in the
+// trace event format of Chrome (chrome://tracing, ui.perfetto.dev). The
+// stations of "-stations" share the ring, each one writes its own events.
+
+#define TRACE_EVENTS    8192
+#define TRACE_LINE_MAX  192
+
+struct TRACEEVENT {
+    volatile LONG64 sequence; // n + 1, 0 while being written
+    LONGLONG start;           // of QueryPerformanceCounter()
+    LONGLONG ticks;
+    DWORD threadId;
+    short phase;
+    short node;               // -1: not known
+    int station;              // see stations.cpp
+};
+
+static TRACEEVENT traceEvents[TRACE_EVENTS];
+static volatile LONG64 numTraceEvents;
+static LONGLONG qpcFrequency;
+
+static const char* phaseNames[LAT_PHASES] = {
+    "arrival", "removal", "validate", "serial", "open", "read", "rewrite", "settle" };
+static const char* nodeNames[4] = { "raw", "aud", "tii", "eti" };
+
+
+int LatencyBucket(ULONGLONG micros) {
+    unsigned long msb;
+    int shift;
+
+    if (micros > 0xFFFFFFFF)
+        micros = 0xFFFFFFFF;
+    if (micros < 16)
+        return (int)micros;
+    _BitScanReverse(&msb, (unsigned long)micros);
+    shift = msb - 4;
+    return (shift + 1) * 16 + (int)((micros >> shift) & 15);
+}
+
+// The largest time of the bucket
+ULONGLONG LatencyBucketTop(int bucket) {
+    int shift;
+
+    if (bucket < 16)
+        return bucket;
+    shift = bucket / 16 - 1;
+    return ((ULONGLONG)(16 + bucket % 16 + 1) << shift) - 1;
+}
+
+// The phase took from *pStart up to now. Any thread.
+void RecordLatency(int phase, int node, const LARGE_INTEGER* pStart) {
+    LATENCYHISTO* pHisto = &pPTM->latency[phase];
+    TRACEEVENT* pEvent;
+    LARGE_INTEGER liNow, qpf;
+    LONG64 micros, max, n;
+
+    QueryPerformanceCounter(&liNow);
+    if (!qpcFrequency) {
+        QueryPerformanceFrequency(&qpf);
+        qpcFrequency = qpf.QuadPart;
+    }
+    micros = (liNow.QuadPart - pStart->QuadPart) * 1000000 / qpcFrequency;
+
+    InterlockedIncrement(&pHisto->buckets[LatencyBucket(micros)]);
+    InterlockedIncrement64(&pHisto->count);
+    InterlockedAdd64(&pHisto->sumMicros, micros);
+    for (max = pHisto->maxMicros; micros > max; max = pHisto->maxMicros)
+        if (max == InterlockedCompareExchange64(&pHisto->maxMicros, micros, max))
+            break;
+
+    if (!pPTM->opt.traceSwitches)
+        return;
+    n = InterlockedIncrement64(&numTraceEvents) - 1;
+    pEvent = &traceEvents[n % TRACE_EVENTS];
+    pEvent->sequence = 0;
+    MemoryBarrier();
+    pEvent->start = pStart->QuadPart;
+    pEvent->ticks = liNow.QuadPart - pStart->QuadPart;
+    pEvent->threadId = GetCurrentThreadId();
+    pEvent->phase = (short)phase;
+    pEvent->node = (short)node;
+    pEvent->station = pPTM->station;
+    MemoryBarrier();
+    pEvent->sequence = n + 1;
+}
+
+// The counts of a phase as they are now, the percentiles from a copy of
+// the buckets
+void ReadLatency(int phase, LATENCYSUMMARY* pSum) {
+    const LATENCYHISTO* pHisto = &pPTM->latency[phase];
+    LONG buckets[LAT_BUCKETS];
+    LONG64 total = 0, seen = 0, targets[3];
+    LONG64* pResults[3] = { &pSum->p50, &pSum->p90, &pSum->p99 };
+    int next = 0;
+
+    for (int i = 0; i < LAT_BUCKETS; i++) {
+        buckets[i] = pHisto->buckets[i];
+        total += buckets[i];
+    }
+    pSum->count = pHisto->count;
+    pSum->sumMicros = pHisto->sumMicros;
+    pSum->maxMicros = pHisto->maxMicros;
+    pSum->p50 = pSum->p90 = pSum->p99 = 0;
+    targets[0] = (total * 50 + 99) / 100;
+    targets[1] = (total * 90 + 99) / 100;
+    targets[2] = (total * 99 + 99) / 100;
+
+    for (int i = 0; i < LAT_BUCKETS && next < 3 && total; i++) {
+        seen += buckets[i];
+        while (next < 3 && seen >= targets[next]) {
+            *pResults[next] = (LONG64)LatencyBucketTop(i);
+            if (*pResults[next] > pSum->maxMicros)
+                *pResults[next] = pSum->maxMicros;
+            next++;
+        }
+    }
+}
+
+// "lat" of the control pipe, a line per phase in microseconds
+int FormatLatencyLines(char* pOut) {
+    LATENCYSUMMARY sum;
+    int len = 0;
+
+    for (int phase = 0; phase < LAT_PHASES; phase++) {
+        ReadLatency(phase, &sum);
+        len += sprintf(pOut + len, "lat %s %lld %lld %lld %lld %lld %lld\n", phaseNames[phase], sum.count,
+            sum.count ? sum.sumMicros / sum.count : 0, sum.p50, sum.p90, sum.p99, sum.maxMicros);
+    }
+    return len;
+}
+
+const char* GetLatencyPhaseName(int phase) {
+    return phaseNames[phase];
+}
+
+// The ring to "trace.json". Returns the number of events written.
+int WriteLatencyTrace() {
+    const TRACEEVENT* pEvent;
+    TRACEEVENT ev;
+    LONG64 written, first;
+    char* pText, szNode[24];
+    DWORD len = 0, dNumBytes;
+    HANDLE hFile;
+    int ret = 0;
+
+    written = numTraceEvents;
+    if (!written || !qpcFrequency)
+        return ret;
+    pText = (char*)VCALLOC(TRACE_EVENTS * TRACE_LINE_MAX + 256);
+    if (!pText)
+        return ret;
+
+    first = written > TRACE_EVENTS ? written - TRACE_EVENTS : 0;
+    len = sprintf(pText, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (LONG64 n = first; n < written; n++) {
+        pEvent = &traceEvents[n % TRACE_EVENTS];
+        memcpy(&ev, (const void*)pEvent, sizeof(ev));
+        MemoryBarrier();
+        if (ev.sequence != n + 1 || pEvent->sequence != n + 1)
+            continue; // written again meanwhile
+        if (ev.station != pPTM->station)
+            continue;
+        szNode[0] = 0;
+        if (ev.node >= 0 && ev.node < 4)
+            sprintf(szNode, ",\"args\":{\"node\":\"%s\"}", nodeNames[ev.node]);
+        // "ts" in microseconds of the performance counter
+        len += sprintf(pText + len, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%lu,\"tid\":%lu,"
+            "\"ts\":%.3f,\"dur\":%.3f%s}", ret ? ",\n" : "", phaseNames[ev.phase],
+            ev.phase <= LAT_REMOVAL ? "switch" : "phase", GetCurrentProcessId(), ev.threadId,
+            (double)ev.start * 1e6 / qpcFrequency, (double)ev.ticks * 1e6 / qpcFrequency, szNode);
+        ret++;
+    }
+    len += sprintf(pText + len, "\n]}\n");
+
+    hFile = CreateFile(pPTM->szTraceFileName, GENERIC_WRITE, FILE_SHARE_READ, 0, CREATE_ALWAYS, 0, 0);
+    if (INVALID_HANDLE_VALUE == hFile || !WriteFile(hFile, pText, len, &dNumBytes, NULL))
+        ret = 0;
+    if (INVALID_HANDLE_VALUE != hFile)
+        CloseHandle(hFile);
+    VFREE(pText);
+    return ret;
+}
@@ -0,0 +1,115 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+// Recordings are much too large for mapping them at once, at least for
+// the 32-bit builds. We map a sliding window instead. The views must start
+// at a multiple of the allocation granularity (64 KiB), so the returned
+// pointer usually points somewhere into the view.
+
+int OpenMappedFile(MAPPEDFILE* pMf, const char* szFileName) {
+    int ret = 0;
+    LARGE_INTEGER liSize;
+    SYSTEM_INFO si;
+
+    memset(pMf, 0, sizeof(MAPPEDFILE));
+
+// No FILE_SHARE_WRITE: if QIRX still writes into the file, we fail here
+// and the file is not a finished recording.
+    pMf->hFile = CreateFile(szFileName, GENERIC_READ, FILE_SHARE_READ, 0,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+
+    if (INVALID_HANDLE_VALUE != pMf->hFile) {
+        GetFileSizeEx(pMf->hFile, &liSize);
+        pMf->fileSize = liSize.QuadPart;
+
+        if (pMf->fileSize) { // an empty file can't be mapped
+            pMf->hMapping = CreateFileMapping(pMf->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (pMf->hMapping) {
+                GetSystemInfo(&si);
+                pMf->granularity = si.dwAllocationGranularity;
+                ret++;
+            }
+        }
+        if (!ret) {
+            CloseHandle(pMf->hFile);
+            pMf->hFile = INVALID_HANDLE_VALUE;
+        }
+    }
+    return ret;
+}
+
+// Copies of a MAPPEDFILE may map their own windows of the same file, from
+// other threads, too. Only the owner calls CloseMappedFile(), the copies
+// release their view with UnmapFileWindow().
+void UnmapFileWindow(MAPPEDFILE* pMf) {
+    if (pMf->pView) {
+        UnmapViewOfFile(pMf->pView);
+        pMf->pView = NULL;
+    }
+}
+
+// Returns a pointer to the byte at "offset" and at most *pInOutSize bytes
+// behind it. *pInOutSize is clipped at the end of the file. The previous
+// view becomes invalid.
+BYTE* MapFileWindow(MAPPEDFILE* pMf, ULONGLONG offset, SIZE_T* pInOutSize) {
+    ULONGLONG viewStart, viewEnd;
+
+    UnmapFileWindow(pMf);
+
+    if (offset >= pMf->fileSize) {
+        *pInOutSize = 0;
+        return NULL;
+    }
+
+    viewStart = offset - (offset % pMf->granularity);
+    viewEnd = offset + *pInOutSize;
+    if (viewEnd > pMf->fileSize)
+        viewEnd = pMf->fileSize;
+
+    pMf->pView = (BYTE*)MapViewOfFile(pMf->hMapping, FILE_MAP_READ,
+        (DWORD)(viewStart >> 32), (DWORD)viewStart, (SIZE_T)(viewEnd - viewStart));
+
+    if (!pMf->pView) {
+        *pInOutSize = 0;
+        return NULL;
+    }
+    pMf->viewOffset = viewStart;
+    pMf->viewSize = (SIZE_T)(viewEnd - viewStart);
+    *pInOutSize = (SIZE_T)(viewEnd - offset);
+    return pMf->pView + (offset - viewStart);
+}
+
+void CloseMappedFile(MAPPEDFILE* pMf) {
+    if (pMf->pView)
+        UnmapViewOfFile(pMf->pView);
+    if (pMf->hMapping)
+        CloseHandle(pMf->hMapping);
+    if (pMf->hFile && INVALID_HANDLE_VALUE != pMf->hFile)
+        CloseHandle(pMf->hFile);
+    memset(pMf, 0, sizeof(MAPPEDFILE));
+}
@@ -0,0 +1,302 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include <winsock2.h> // before Windows.h
+#include "PathTweaker.h"
+#include <stdarg.h>
+
+#pragma comment(lib, "Ws2_32.lib")
+
+// The metrics exporter serves what PathTweaker measures in the text format
+// of Prometheus, on "http://127.0.0.1:<Port>/metrics" (section "[Metrics]"
+// of "options.ini", default 0 = off). Once a second a timer (scheduler.cpp)
+// renders the text from the snapshot of the disk space (SPACESTATUS) and
+// the counters (PTCOUNTERS), and publishes it behind a sequence lock (see
+// snapshot.cpp). A scrape only copies the text, it never touches a drive,
+// the config-file or the dialog. The listener takes no other address than
+// the loopback, one request per connection.
+
+#define METRICS_TEXT_MAX     16384
+#define METRICS_REQUEST_MAX  2048
+#define METRICS_RENDER_MS    1000
+#define METRICS_ACCEPT_MS    500    // finishThread is looked at this often
+#define METRICS_RECV_MS      1000
+
+extern int SchedAdd(PFNSCHEDPROC pfn, void* param, DWORD dueMs, DWORD periodMs);
+extern void SeqPublish(volatile LONG* pSequence, void* pShared, const void* pData, DWORD size);
+extern DWORD SeqRead(volatile LONG* pSequence, const void* pShared, void* pData, DWORD size);
+extern void ReadLatency(int phase, LATENCYSUMMARY* pSum);
+extern const char* GetLatencyPhaseName(int phase);
+extern HANDLE CreateEngineThread(LPTHREAD_START_ROUTINE pfnThread, LPVOID param);
+
+struct METRICSTEXT {
+    DWORD length;
+    char text[METRICS_TEXT_MAX];
+};
+
+static struct METRICSLOCK {
+    volatile LONG sequence;   // odd while the timer renders
+    METRICSTEXT rendered;
+} metricsLocks[STATION_MAX];
+
+static METRICSTEXT renderBuffer; // on the SchedulerThread, one station at a time
+static volatile LONG64 numScrapes[STATION_MAX];
+static const char* nodeNames[4] = { "raw", "aud", "tii", "eti" };
+
+
+// ProcessQirxXMLFile() wrote to the config-file, pStart is the time before
+void CountConfigWrite(const LARGE_INTEGER* pStart, int found) {
+    LARGE_INTEGER liNow, qpf;
+    LONG64 micros;
+
+    QueryPerformanceCounter(&liNow);
+    QueryPerformanceFrequency(&qpf);
+    micros = (liNow.QuadPart - pStart->QuadPart) * 1000000 / qpf.QuadPart;
+    InterlockedIncrement64(&pPTM->counters.configWrites);
+    if (!found)
+        InterlockedIncrement64(&pPTM->counters.configWriteFailures);
+    InterlockedAdd64(&pPTM->counters.configWriteMicros, micros);
+    if (micros > pPTM->counters.configWriteMaxMicros) // one writer
+        pPTM->counters.configWriteMaxMicros = micros;
+}
+
+// Appends to the text, nothing if it is full
+void MetricsPrintf(METRICSTEXT* pText, const char* szFormat, ...) {
+    va_list args;
+    int len;
+
+    va_start(args, szFormat);
+    len = _vsnprintf_s(pText->text + pText->length, METRICS_TEXT_MAX - pText->length, _TRUNCATE,
+        szFormat, args);
+    va_end(args);
+    if (len > 0)
+        pText->length += len;
+}
+
+void MetricsHeader(METRICSTEXT* pText, const char* szName, const char* szType, const char* szHelp) {
+    MetricsPrintf(pText, "# HELP pathtweaker_%s %s\n# TYPE pathtweaker_%s %s\n", szName, szHelp, szName, szType);
+}
+
+// A gauge per node, for the nodes sampled since their last switch
+void MetricsNodeGauge(METRICSTEXT* pText, const SPACESNAPSHOT* pSnap, const SPACESTATUS* pStatus,
+    const char* szName, const char* szHelp, int what) {
+    const NODESPACE* pSpace;
+    double value;
+
+    MetricsHeader(pText, szName, "gauge", szHelp);
+    for (int node = 0; node < 4; node++) {
+        pSpace = &pStatus->nodes[node];
+        if (!pSpace->generation || pSpace->generation < pSnap->changed[node])
+            continue;
+        switch (what) {
+        case 0:
+            value = (double)pSpace->freeBytes;
+            break;
+        case 1:
+            value = pSpace->writeSpeed;
+            break;
+        default:
+            value = (double)pSpace->remSeconds;
+            break;
+        }
+        MetricsPrintf(pText, "pathtweaker_%s{node=\"%s\"} %.0f\n", szName, nodeNames[node], value);
+    }
+}
+
+// On the SchedulerThread
+void RenderMetricsTick(void* param) {
+    METRICSTEXT* pText = &renderBuffer;
+    const PTCOUNTERS* pCnt = &pPTM->counters;
+    SPACESNAPSHOT snap;
+    SPACESTATUS status;
+    LATENCYSUMMARY lat;
+    const char* szPhase;
+    METRICSLOCK* pLock;
+    DWORD retries;
+
+    retries = SeqRead(&pPTM->spaceSnap.sequence, &pPTM->spaceSnap.snap, &snap, sizeof(snap));
+    retries += SeqRead(&pPTM->spaceStatus.sequence, &pPTM->spaceStatus.status, &status, sizeof(status));
+    InterlockedAdd64(&pPTM->counters.lockReads, 2);
+    InterlockedAdd64(&pPTM->counters.lockRetries, retries);
+
+    pText->length = 0;
+    MetricsNodeGauge(pText, &snap, &status, "free_bytes", "Free bytes for QIRX on the current path.", 0);
+    MetricsNodeGauge(pText, &snap, &status, "write_bytes_per_second",
+        "Measured write rate on the current path.", 1);
+    MetricsNodeGauge(pText, &snap, &status, "remaining_seconds",
+        "Predicted recording time left on the current path.", 2);
+
+    MetricsHeader(pText, "external", "gauge", "1 if the external path is the current one.");
+    for (int node = 0; node < 4; node++)
+        if (snap.szPaths[node][0])
+            MetricsPrintf(pText, "pathtweaker_external{node=\"%s\"} %d\n", nodeNames[node], snap.external[node]);
+    MetricsHeader(pText, "drive_online", "gauge", "1 if the external drive of the node is there.");
+    for (int node = 0; node < 4; node++)
+        if (snap.szPaths[node][0])
+            MetricsPrintf(pText, "pathtweaker_drive_online{node=\"%s\"} %d\n", nodeNames[node], snap.online[node]);
+
+    MetricsHeader(pText, "path_switches_total", "counter", "Changes of a current path, all nodes.");
+    MetricsPrintf(pText, "pathtweaker_path_switches_total %lld\n", pCnt->pathSwitches);
+    MetricsHeader(pText, "space_ticks_total", "counter", "Samples of the free space.");
+    MetricsPrintf(pText, "pathtweaker_space_ticks_total %lu\n", status.numTicks);
+    MetricsHeader(pText, "space_stalls_total", "counter", "Drives which took 0.5 s or more for their free space.");
+    MetricsPrintf(pText, "pathtweaker_space_stalls_total %lld\n", pCnt->spaceStalls);
+    MetricsHeader(pText, "space_failures_total", "counter", "Drives which didn't tell their free space.");
+    MetricsPrintf(pText, "pathtweaker_space_failures_total %lld\n", pCnt->spaceFailures);
+
+    MetricsHeader(pText, "config_writes_total", "counter", "Writes to QIRX's config-file.");
+    MetricsPrintf(pText, "pathtweaker_config_writes_total %lld\n", pCnt->configWrites);
+    MetricsHeader(pText, "config_write_failures_total", "counter", "Writes which didn't find their node.");
+    MetricsPrintf(pText, "pathtweaker_config_write_failures_total %lld\n", pCnt->configWriteFailures);
+    MetricsHeader(pText, "config_open_retries_total", "counter", "Opens of the config-file while it was in use.");
+    MetricsPrintf(pText, "pathtweaker_config_open_retries_total %lld\n", pCnt->configOpenRetries);
+    MetricsHeader(pText, "config_write_seconds_total", "counter", "Time taken by the writes.");
+    MetricsPrintf(pText, "pathtweaker_config_write_seconds_total %.6f\n", pCnt->configWriteMicros / 1e6);
+    MetricsHeader(pText, "config_write_seconds_max", "gauge", "The longest write.");
+    MetricsPrintf(pText, "pathtweaker_config_write_seconds_max %.6f\n", pCnt->configWriteMaxMicros / 1e6);
+
+    MetricsHeader(pText, "switch_phase_seconds", "summary",
+        "Phases of the path switches, arrival and removal from the device event, see latency.cpp.");
+    for (int phase = 0; phase < LAT_PHASES; phase++) {
+        ReadLatency(phase, &lat);
+        szPhase = GetLatencyPhaseName(phase);
+        MetricsPrintf(pText, "pathtweaker_switch_phase_seconds{phase=\"%s\",quantile=\"0.5\"} %.6f\n", szPhase,
+            lat.p50 / 1e6);
+        MetricsPrintf(pText, "pathtweaker_switch_phase_seconds{phase=\"%s\",quantile=\"0.9\"} %.6f\n", szPhase,
+            lat.p90 / 1e6);
+        MetricsPrintf(pText, "pathtweaker_switch_phase_seconds{phase=\"%s\",quantile=\"0.99\"} %.6f\n", szPhase,
+            lat.p99 / 1e6);
+        MetricsPrintf(pText, "pathtweaker_switch_phase_seconds_sum{phase=\"%s\"} %.6f\n", szPhase,
+            lat.sumMicros / 1e6);
+        MetricsPrintf(pText, "pathtweaker_switch_phase_seconds_count{phase=\"%s\"} %lld\n", szPhase, lat.count);
+    }
+
+    MetricsHeader(pText, "lock_reads_total", "counter", "Reads of the snapshots.");
+    MetricsPrintf(pText, "pathtweaker_lock_reads_total %lld\n", pCnt->lockReads);
+    MetricsHeader(pText, "lock_retries_total", "counter", "Reads of the snapshots done again.");
+    MetricsPrintf(pText, "pathtweaker_lock_retries_total %lld\n", pCnt->lockRetries);
+
+    MetricsHeader(pText, "device_events_total", "counter", "Drives arrived and removed.");
+    MetricsPrintf(pText, "pathtweaker_device_events_total{event=\"arrival\"} %lld\n", pCnt->driveArrivals);
+    MetricsPrintf(pText, "pathtweaker_device_events_total{event=\"removal\"} %lld\n", pCnt->driveRemovals);
+
+    MetricsHeader(pText, "scrapes_total", "counter", "Requests for the metrics.");
+    MetricsPrintf(pText, "pathtweaker_scrapes_total %lld\n", numScrapes[pPTM->station]);
+
+    pLock = &metricsLocks[pPTM->station];
+    SeqPublish(&pLock->sequence, &pLock->rendered, pText, sizeof(METRICSTEXT));
+}
+
+// One request, one answer, the connection is closed afterwards
+void ServeMetricsClient(SOCKET s, METRICSTEXT* pText) {
+    char request[METRICS_REQUEST_MAX], header[160];
+    METRICSLOCK* pLock;
+    DWORD timeout = METRICS_RECV_MS;
+    int len = 0, got;
+
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    while (len < METRICS_REQUEST_MAX - 1) {
+        got = recv(s, request + len, METRICS_REQUEST_MAX - 1 - len, 0);
+        if (got <= 0)
+            break;
+        len += got;
+        request[len] = 0;
+        if (strstr(request, "\r\n\r\n"))
+            break;
+    }
+    request[len] = 0;
+
+    if (!strncmp(request, "GET /metrics ", 13) || !strncmp(request, "GET / ", 6)) {
+        InterlockedIncrement64(&numScrapes[pPTM->station]);
+        pLock = &metricsLocks[pPTM->station];
+        SeqRead(&pLock->sequence, &pLock->rendered, pText, sizeof(METRICSTEXT));
+        len = sprintf(header, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: %lu\r\nConnection: close\r\n\r\n", pText->length);
+        send(s, header, len, 0);
+        send(s, pText->text, pText->length, 0);
+    }
+    else {
+        len = sprintf(header, "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        send(s, header, len, 0);
+    }
+    shutdown(s, SD_SEND);
+}
+
+DWORD WINAPI MetricsThread(LPVOID param) {
+    sockaddr_in addr{};
+    METRICSTEXT* pText;
+    WSADATA wsa;
+    SOCKET listener, client;
+    fd_set readable;
+    timeval tv;
+    BOOL exclusive = TRUE;
+
+    pText = (METRICSTEXT*)VCALLOC(sizeof(METRICSTEXT));
+    if (!pText)
+        return 0;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa)) {
+        VFREE(pText);
+        return 0;
+    }
+    listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (INVALID_SOCKET == listener)
+        goto out;
+    setsockopt(listener, SOL_SOCKET, SO_EXCLUSIVEADDRUSE, (const char*)&exclusive, sizeof(exclusive));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((u_short)pPTM->opt.metricsPort);
+    if (SOCKET_ERROR == bind(listener, (sockaddr*)&addr, sizeof(addr)) || SOCKET_ERROR == listen(listener, 8))
+        goto out;
+
+    while (!pPTM->finishThread) {
+        FD_ZERO(&readable);
+        FD_SET(listener, &readable);
+        tv.tv_sec = 0;
+        tv.tv_usec = METRICS_ACCEPT_MS * 1000;
+        if (select(0, &readable, NULL, NULL, &tv) <= 0)
+            continue;
+        client = accept(listener, NULL, NULL);
+        if (INVALID_SOCKET == client)
+            continue;
+        ServeMetricsClient(client, pText);
+        closesocket(client);
+    }
+
+out:
+    if (INVALID_SOCKET != listener)
+        closesocket(listener);
+    WSACleanup();
+    VFREE(pText);
+    return 0;
+}
+
+void StartMetrics() {
+    if (!pPTM->opt.metricsPort)
+        return;
+    // the first one at once, renderBuffer is for the SchedulerThread only
+    SchedAdd(RenderMetricsTick, NULL, 0, METRICS_RENDER_MS);
+    pPTM->hMetricsThread = CreateEngineThread(MetricsThread, NULL);
+}
@@ -0,0 +1,303 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+// A path plan switches a node to its external path or back to QIRX's
+// original path at a time of the day, e.g. the nightly raw-recordings go
+// to the big HDD at 22:00 and back at 06:00. The plans are kept in
+// "dlg.dat" behind the dialog settings, "-plan" on the command line edits
+// them.
+//
+// Each plan has a one-shot timer on the timer wheel (see scheduler.cpp).
+// The timer waits an hour at most and then looks at the clock again, so
+// a change of the clock (or daylight saving time) is caught. When the
+// time has come, the switch is posted to the dialog, which does it like
+// any other path switch.
+//
+// After sleep or hibernation a plan fires once, not once per time it was
+// due meanwhile, and the next time is reckoned from now. If several plans
+// of a node were missed, only the one due last switches, the node ends up
+// as if the station had been awake all along. The ones skipped are logged
+// by the daemon.
+
+#define PLAN_MAX_WAIT_MS  (3600 * 1000)
+#define PLAN_DAY          (24ull * 3600 * 10'000'000) // in FILETIME units
+#define PLAN_EARLY        10'000'000                  // a second early is fine
+
+extern int SchedAdd(PFNSCHEDPROC pfn, void* param, DWORD dueMs, DWORD periodMs);
+extern void DaemonLog(const char* szFormat, ...);
+extern int ReadDlgConfigFile();
+extern void WriteDlgConfigFile();
+
+static ULONGLONG planDue[STATION_MAX][PLAN_MAX];  // local time, FILETIME units
+static ULONGLONG planDone[STATION_MAX][PLAN_MAX]; // the last time handled
+
+static const char* nodeNames[4] = { "raw", "aud", "tii", "eti" };
+
+
+ULONGLONG GetLocalFileTime(const SYSTEMTIME* pSt) {
+    FILETIME ft;
+    ULARGE_INTEGER ul;
+
+    SystemTimeToFileTime(pSt, &ft);
+    ul.LowPart = ft.dwLowDateTime;
+    ul.HighPart = ft.dwHighDateTime;
+    return ul.QuadPart;
+}
+
+// The next time after "after" the plan is due, 0 if never
+ULONGLONG GetNextPlanTime(const PATHPLAN* pPlan, ULONGLONG after) {
+    SYSTEMTIME st;
+    FILETIME ft;
+    ULONGLONG midnight, due;
+
+    ft.dwLowDateTime = (DWORD)after;
+    ft.dwHighDateTime = (DWORD)(after >> 32);
+    FileTimeToSystemTime(&ft, &st);
+    st.wHour = st.wMinute = st.wSecond = st.wMilliseconds = 0;
+    midnight = GetLocalFileTime(&st);
+
+    for (int day = 0; day <= 7; day++) {
+        due = midnight + day * PLAN_DAY + pPlan->minute * 60ull * 10'000'000;
+        if (due > after && (!pPlan->days || pPlan->days & (1 << ((st.wDayOfWeek + day) % 7))))
+            return due;
+    }
+    return 0;
+}
+
+// The last time up to now the plan was due, *pDue is the first one not
+// handled yet. Returns 0 if it wasn't due.
+ULONGLONG GetLastPlanTime(const PATHPLAN* pPlan, ULONGLONG due, ULONGLONG now, int* pMissed) {
+    ULONGLONG last = 0;
+
+    *pMissed = 0;
+    while (due && due <= now) {
+        if (last)
+            (*pMissed)++;
+        last = due;
+        due = GetNextPlanTime(pPlan, due + 60ull * 10'000'000);
+    }
+    return last;
+}
+
+// Is there a plan of the same node which was due after "last" up to now?
+int IsPlanOvertaken(int i, ULONGLONG last, ULONGLONG now) {
+    const PATHPLAN* pPlan = &pPTM->plans.plans[i];
+    ULONGLONG other;
+    int missed;
+
+    for (DWORD j = 0; j < pPTM->plans.numPlans; j++) {
+        if (j == (DWORD)i || !pPTM->plans.plans[j].enabled || pPTM->plans.plans[j].node != pPlan->node)
+            continue;
+        other = GetLastPlanTime(&pPTM->plans.plans[j], planDue[pPTM->station][j], now, &missed);
+        if (other < planDone[pPTM->station][j])
+            other = planDone[pPTM->station][j];
+        if (other > last)
+            return 1;
+    }
+    return 0;
+}
+
+int IsNodeOnline(int node) {
+    switch (node) {
+    case NODE_RAW:
+        return pPTM->flagRawDriveOnline;
+    case NODE_AUD:
+        return pPTM->flagAudDriveOnline;
+    case NODE_ETI:
+        return pPTM->flagIsQ5 && pPTM->flagEtiDriveOnline;
+    default:
+        return pPTM->flagTiiDriveOnline;
+    }
+}
+
+void PlanTimerProc(void* param);
+
+void ArmPlan(int i) {
+    SYSTEMTIME st;
+    ULONGLONG now, due, waitMs;
+
+    GetLocalTime(&st);
+    now = GetLocalFileTime(&st);
+    due = planDue[pPTM->station][i];
+    waitMs = due > now ? (due - now) / 10'000 : 0;
+    if (waitMs > PLAN_MAX_WAIT_MS)
+        waitMs = PLAN_MAX_WAIT_MS;
+    SchedAdd(PlanTimerProc, (void*)(INT_PTR)i, (DWORD)waitMs, 0);
+}
+
+// On the SchedulerThread
+void PlanTimerProc(void* param) {
+    SYSTEMTIME st;
+    PATHPLAN* pPlan;
+    int i = (int)(INT_PTR)param;
+    ULONGLONG* pDue = &planDue[pPTM->station][i];
+    ULONGLONG now, last;
+    int missed;
+
+    pPlan = &pPTM->plans.plans[i];
+    GetLocalTime(&st);
+    now = GetLocalFileTime(&st) + PLAN_EARLY;
+    last = GetLastPlanTime(pPlan, *pDue, now, &missed);
+    if (last) {
+        if (missed && pPTM->headless)
+            DaemonLog("%s  plan      %d, missed %d time(s) while asleep", nodeNames[pPlan->node % 4],
+                i + 1, missed);
+        if (!IsPlanOvertaken(i, last, now))
+            PostMessage(pPTM->hWndDialog, PTMSG_PATH_PLAN, pPlan->node, pPlan->target);
+        else if (pPTM->headless)
+            DaemonLog("%s  plan      %d skipped, a later one of the node was missed, too",
+                nodeNames[pPlan->node % 4], i + 1);
+        planDone[pPTM->station][i] = last;
+        *pDue = GetNextPlanTime(pPlan, last + 60ull * 10'000'000);
+    }
+    if (*pDue)
+        ArmPlan(i);
+}
+
+void StartPathPlans() {
+    SYSTEMTIME st;
+
+    GetLocalTime(&st);
+    for (DWORD i = 0; i < pPTM->plans.numPlans; i++) {
+        if (!pPTM->plans.plans[i].enabled)
+            continue;
+        planDone[pPTM->station][i] = 0;
+        planDue[pPTM->station][i] = GetNextPlanTime(&pPTM->plans.plans[i], GetLocalFileTime(&st));
+        if (planDue[pPTM->station][i])
+            ArmPlan(i);
+    }
+}
+
+
+void PrintPathPlans() {
+    static const char* dayNames[7] = { "Su", "Mo", "Tu", "We", "Th", "Fr", "Sa" };
+    PATHPLAN* pPlan;
+
+    if (!pPTM->plans.numPlans)
+        printf("No path plans.\n");
+    for (DWORD i = 0; i < pPTM->plans.numPlans; i++) {
+        pPlan = &pPTM->plans.plans[i];
+        printf("%lu: %s %02d:%02d %s", i + 1, nodeNames[pPlan->node % 4], pPlan->minute / 60, pPlan->minute % 60,
+            PLAN_TO_EXTERNAL == pPlan->target ? "external" : "original");
+        if (pPlan->days) {
+            printf(",");
+            for (int d = 1; d <= 7; d++) // Monday first
+                if (pPlan->days & (1 << (d % 7)))
+                    printf(" %s", dayNames[d % 7]);
+        }
+        printf("\n");
+    }
+}
+
+// "1-5", "67" or "1,3,5", Monday is 1. Returns the day mask (bit 0:
+// Sunday) or 0 on errors.
+int ParsePlanDays(const char* szDays) {
+    int mask = 0, from;
+
+    for (const char* p = szDays; *p; p++) {
+        if (*p == ',' || *p == ' ')
+            continue;
+        if (*p < '1' || *p > '7')
+            return 0;
+        from = *p - '0';
+        if (p[1] == '-' && p[2] >= '1' && p[2] <= '7') {
+            for (int d = from; d <= p[2] - '0'; d++)
+                mask |= 1 << (d % 7);
+            p += 2;
+        }
+        else
+            mask |= 1 << (from % 7);
+    }
+    return mask;
+}
+
+// -plan [add node HH:MM external|original [days] | del n]
+// Returns 0 on a wrong command line.
+int CmdPathPlan(int argc, char** argv) {
+    char szTitle[32], szVersion[16];
+    PATHPLAN plan{};
+    int hour, minute, n;
+
+    if (!ReadDlgConfigFile()) { // as in WinMain
+        pPTM->mDlgSet.transparency = 255;
+        pPTM->mDlgSet.topMost = 1;
+    }
+    if (!argc) {
+        PrintPathPlans();
+        return 1;
+    }
+
+    // the dialog writes "dlg.dat" when it ends
+    lstrcpyn(szVersion, pPTM->szQirxVersion, 16);
+    _strupr_s(szVersion, 16);
+    sprintf(szTitle, "%s (%s)", szAppName, szVersion);
+    if (FindWindow(NULL, szTitle)) {
+        printf("Close the dialog of PathTweaker first.\n");
+        return 1;
+    }
+
+    if (!lstrcmpi(argv[0], "add") && argc >= 4) {
+        for (n = 0; n < 4; n++)
+            if (!lstrcmpi(argv[1], nodeNames[n]))
+                break;
+        if (n == 4 || 2 != sscanf(argv[2], "%d:%d", &hour, &minute) || hour < 0 || hour > 23 ||
+            minute < 0 || minute > 59)
+            return 0;
+        plan.node = (BYTE)n;
+        plan.minute = (WORD)(hour * 60 + minute);
+        if (!lstrcmpi(argv[3], "external"))
+            plan.target = PLAN_TO_EXTERNAL;
+        else if (!lstrcmpi(argv[3], "original"))
+            plan.target = PLAN_TO_ORIGINAL;
+        else
+            return 0;
+        if (argc > 4 && !(plan.days = (BYTE)ParsePlanDays(argv[4])))
+            return 0;
+        plan.enabled = 1;
+
+        if (pPTM->plans.numPlans >= PLAN_MAX) {
+            printf("No more than %d plans.\n", PLAN_MAX);
+            return 1;
+        }
+        pPTM->plans.plans[pPTM->plans.numPlans++] = plan;
+    }
+    else if (!lstrcmpi(argv[0], "del") && argc >= 2) {
+        n = atoi(argv[1]);
+        if (n < 1 || n > (int)pPTM->plans.numPlans)
+            return 0;
+        memmove(&pPTM->plans.plans[n - 1], &pPTM->plans.plans[n],
+            (pPTM->plans.numPlans - n) * sizeof(PATHPLAN));
+        pPTM->plans.numPlans--;
+    }
+    else
+        return 0;
+
+    WriteDlgConfigFile();
+    PrintPathPlans();
+    return 1;
+}
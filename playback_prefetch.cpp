@@ -0,0 +1,269 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+#include <RestartManager.h>
+
+#pragma comment(lib, "Rstrtmgr.lib")
+
+// QIRX replaying a recording from a slow drive (USB 2 stick, laptop HDD)
+// stutters whenever the drive takes a break. The PlaybackPrefetchThread
+// finds a recording being replayed and reads it a few seconds ahead of
+// QIRX, so QIRX gets the data from the file cache.
+//
+// A recording is replayed, if another process has it open, but nobody
+// writes into it. The Restart Manager tells us who has it open without
+// opening the file: a probe open with more than read access would make
+// QIRX's own open (FileShare.Read) fail while we hold it. We can't see
+// QIRX's file position, so we assume it starts at the beginning and reads
+// at the rate of the stream: 4.096 MB/s for raw-recordings, 256 kB/s for
+// eti-recordings. After the end of the file it starts over (QIRX's loop
+// mode), until the file is closed.
+//
+// We read 1 MiB chunks into a ring of ReadAheadSeconds, which bounds how
+// far we read ahead. Whether QIRX found a chunk in the cache can't be seen
+// from here, so the report of the recording ("<name>.txt") gets what our
+// own reads measured only: their time, the slowest one and the reads which
+// took longer than the chunk lasts at the stream rate, the ones a player
+// reading by itself would have stuttered at.
+
+#define PF_POLL_MS      2000            // looking for a replayed recording
+#define PF_STEP_MS      50
+#define PF_CHUNK        (1024 * 1024)
+#define PF_MAX_SLOTS    256             // 256 MiB ahead at most
+#define PF_RAW_RATE     4'096'000.0     // 2.048 MSpl/s, 8 bit I and Q
+#define PF_ETI_RATE     256'000.0       // 6144 bytes every 24 ms
+
+extern int GetRecordingFolders(int node, char szFolders[REC_MAX_FOLDERS][MAX_PATH_BUFFER_SIZE]);
+extern int ForEachRecording(const char* szFolder, const char* szExt, PFNRECORDINGPROC pfnRecording,
+    volatile int* pCancel);
+extern void AppendReport(const char* szFileName, const char* szMsg);
+
+
+struct PFSESSION {
+    HANDLE hFile;
+    ULONGLONG fileSize;
+    ULONGLONG chunksPerPass;
+    double rate;              // bytes per second
+    BYTE* pRing;
+    DWORD numSlots;
+    ULONGLONG ahead;          // chunks read, counted over all passes
+    ULONGLONG passed;         // chunks QIRX is done with, as assumed
+    ULONGLONG slowReads;      // longer than the chunk lasts
+    double readMs;
+    double slowestMs;
+};
+
+static char szPlaybackFile[STATION_MAX][MAX_PATH_BUFFER_SIZE];
+
+
+// Another process has a handle on the file, our own session and the
+// post-recording stages don't count
+int IsOpenElsewhere(const char* szFileName) {
+    WCHAR szSessionKey[CCH_RM_SESSION_KEY + 1], wszFileName[MAX_PATH_BUFFER_SIZE];
+    LPCWSTR pFileName = wszFileName;
+    RM_PROCESS_INFO info[8];
+    UINT numNeeded, numInfo = 8;
+    DWORD session, reasons, result;
+    int ret = 0;
+
+    if (!MultiByteToWideChar(CP_ACP, 0, szFileName, -1, wszFileName, MAX_PATH_BUFFER_SIZE) ||
+        ERROR_SUCCESS != RmStartSession(&session, 0, szSessionKey))
+        return ret;
+    if (ERROR_SUCCESS == RmRegisterResources(session, 1, &pFileName, 0, NULL, 0, NULL)) {
+        result = RmGetList(session, &numNeeded, &numInfo, info, &reasons);
+        if (ERROR_MORE_DATA == result)
+            ret++; // more than we asked for, not all of them are us
+        else if (ERROR_SUCCESS == result) {
+            for (UINT i = 0; i < numInfo && !ret; i++)
+                if (info[i].Process.dwProcessId != GetCurrentProcessId())
+                    ret++;
+        }
+    }
+    RmEndSession(session);
+    return ret;
+}
+
+// Open by somebody who reads it, see above
+int IsReplayed(const char* szFileName) {
+    HANDLE hProbe;
+
+    if (!IsOpenElsewhere(szFileName))
+        return 0;
+
+    // fails while QIRX writes into it, a reader can still open it meanwhile
+    hProbe = CreateFile(szFileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, 0, OPEN_EXISTING, 0, 0);
+    if (INVALID_HANDLE_VALUE == hProbe)
+        return 0;
+    CloseHandle(hProbe);
+    return 1;
+}
+
+int FindReplayedCallback(const char* szFileName, ULONGLONG fileSize, volatile int* pCancel) {
+    if (szPlaybackFile[pPTM->station][0] || !fileSize || !IsReplayed(szFileName))
+        return 0;
+    lstrcpyn(szPlaybackFile[pPTM->station], szFileName, MAX_PATH_BUFFER_SIZE);
+    return 1;
+}
+
+// Reads the next chunk into its slot
+int ReadAheadChunk(PFSESSION* pS) {
+    LARGE_INTEGER li, liStart, liEnd, qpf;
+    ULONGLONG offset;
+    DWORD want, dNumBytesRead = 0;
+    double ms;
+    int slot;
+
+    offset = (pS->ahead % pS->chunksPerPass) * PF_CHUNK;
+    want = pS->fileSize - offset < PF_CHUNK ? (DWORD)(pS->fileSize - offset) : PF_CHUNK;
+    slot = (int)(pS->ahead % pS->numSlots);
+
+    QueryPerformanceFrequency(&qpf);
+    QueryPerformanceCounter(&liStart);
+    li.QuadPart = offset;
+    if (!SetFilePointerEx(pS->hFile, li, NULL, FILE_BEGIN) ||
+        !ReadFile(pS->hFile, pS->pRing + (SIZE_T)slot * PF_CHUNK, want, &dNumBytesRead, NULL) ||
+        dNumBytesRead != want)
+        return 0;
+    QueryPerformanceCounter(&liEnd);
+
+    ms = (liEnd.QuadPart - liStart.QuadPart) * 1000.0 / qpf.QuadPart;
+    if (ms > want * 1000.0 / pS->rate)
+        pS->slowReads++;
+    pS->readMs += ms;
+    if (ms > pS->slowestMs)
+        pS->slowestMs = ms;
+    pS->ahead++;
+    return 1;
+}
+
+// Stays ahead of QIRX until it closes the file
+void RunPrefetchSession(const char* szFileName, double rate, volatile int* pCancel) {
+    PFSESSION s{};
+    LARGE_INTEGER li, qpf, liStart, liNow, liProbe;
+    ULONGLONG readerBytes, readerChunk;
+    SYSTEMTIME st;
+    char buff[640];
+    double seconds = 0;
+
+    s.hFile = CreateFile(szFileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (INVALID_HANDLE_VALUE == s.hFile)
+        return;
+    GetFileSizeEx(s.hFile, &li);
+    s.fileSize = li.QuadPart;
+    s.chunksPerPass = (s.fileSize + PF_CHUNK - 1) / PF_CHUNK;
+    s.rate = rate;
+    s.numSlots = (DWORD)(pPTM->opt.readAheadSeconds * rate / PF_CHUNK) + 1;
+    if (s.numSlots < 2)
+        s.numSlots = 2;
+    if (s.numSlots > PF_MAX_SLOTS)
+        s.numSlots = PF_MAX_SLOTS;
+
+    if (s.fileSize)
+        s.pRing = (BYTE*)VCALLOC((SIZE_T)s.numSlots * PF_CHUNK);
+    if (!s.pRing) {
+        CloseHandle(s.hFile);
+        return;
+    }
+
+    GetLocalTime(&st);
+    QueryPerformanceFrequency(&qpf);
+    QueryPerformanceCounter(&liStart);
+    liProbe = liStart;
+
+    while (!*pCancel) {
+        QueryPerformanceCounter(&liNow);
+        seconds = (double)(liNow.QuadPart - liStart.QuadPart) / qpf.QuadPart;
+        readerBytes = (ULONGLONG)(seconds * rate);
+        readerChunk = readerBytes / s.fileSize * s.chunksPerPass + readerBytes % s.fileSize / PF_CHUNK;
+
+        if (s.passed < readerChunk)
+            s.passed = readerChunk;
+        if (s.ahead < s.passed)
+            s.ahead = s.passed; // too slow, don't read what is behind QIRX
+
+        if (s.ahead < s.passed + s.numSlots) {
+            if (!ReadAheadChunk(&s))
+                break;
+        }
+        else
+            Sleep(PF_STEP_MS);
+
+        if ((liNow.QuadPart - liProbe.QuadPart) * 1000 >= PF_POLL_MS * qpf.QuadPart) {
+            if (!IsReplayed(szFileName))
+                break;
+            liProbe = liNow;
+        }
+    }
+
+    sprintf(buff,
+        "\r\nplayback read-ahead %04d-%02d-%02d %02d:%02d:%02d, %.1f s\r\n"
+        "%lu MiB ahead (%.0f s), %llu MiB read in %.1f s, mean %.1f MB/s\r\n"
+        "slowest read %.0f ms, %llu read(s) slower than the stream\r\n",
+        st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, seconds,
+        s.numSlots, s.numSlots * (double)PF_CHUNK / rate, s.ahead, s.readMs / 1000.0,
+        s.readMs > 0 ? s.ahead * (double)PF_CHUNK / 1000.0 / s.readMs : 0.,
+        s.slowestMs, s.slowReads);
+    AppendReport(szFileName, buff);
+
+    VFREE(s.pRing);
+    CloseHandle(s.hFile);
+}
+
+
+// Looks for a replayed recording in the RAW and ETI folders every two
+// seconds. Not while the post-recording stages run, they read recordings
+// too.
+DWORD WINAPI PlaybackPrefetchThread(LPVOID param) {
+    char szFolders[REC_MAX_FOLDERS][MAX_PATH_BUFFER_SIZE];
+    char* szPlayback = szPlaybackFile[pPTM->station];
+    int numFolders, node;
+
+    while (!pPTM->finishThread) {
+        Sleep(PF_POLL_MS);
+        if (!pPTM->opt.readAhead || pPTM->postRecordingBusy)
+            continue;
+
+        szPlayback[0] = 0;
+        numFolders = GetRecordingFolders(NODE_RAW, szFolders);
+        for (int i = 0; i < numFolders && !szPlayback[0]; i++)
+            ForEachRecording(szFolders[i], szRawExt, FindReplayedCallback, &pPTM->finishThread);
+        node = NODE_RAW;
+
+        if (!szPlayback[0] && pPTM->flagIsQ5) {
+            numFolders = GetRecordingFolders(NODE_ETI, szFolders);
+            for (int i = 0; i < numFolders && !szPlayback[0]; i++)
+                ForEachRecording(szFolders[i], szEtiExt, FindReplayedCallback, &pPTM->finishThread);
+            node = NODE_ETI;
+        }
+
+        if (szPlayback[0])
+            RunPrefetchSession(szPlayback, NODE_RAW == node ? PF_RAW_RATE : PF_ETI_RATE,
+                &pPTM->finishThread);
+    }
+    return 0;
+}
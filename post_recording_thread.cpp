@@ -0,0 +1,121 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+#define POST_REC_INTERVAL 30 // seconds between two looks into the folders
+
+extern int EtiIndexFolder(const char* szFolder, volatile int* pCancel);
+extern int IqScanFolder(const char* szFolder, volatile int* pCancel);
+extern int RawPackFolder(const char* szFolder, volatile int* pCancel);
+extern int TiiIngestFolders(const char (*szFolders)[MAX_PATH_BUFFER_SIZE], int numFolders, volatile int* pCancel);
+extern const char* GetPreviousFolder(int node);
+extern DWORD SeqRead(volatile LONG* pSequence, const void* pShared, void* pData, DWORD size);
+
+
+// Current path, the one before a rollover (see folder_rotation.cpp), QIRX's
+// default path and our external path of a node, without duplicates. The
+// current path and the drive come from the snapshot of the dialog, these
+// threads don't read them while the dialog writes.
+// Returns the number of folders.
+int GetRecordingFolders(int node, char szFolders[REC_MAX_FOLDERS][MAX_PATH_BUFFER_SIZE]) {
+    SPACESNAPSHOT snap;
+    char* pCurrent, *pOriginal, *pExternal;
+    const char* pPrevious;
+    int online, num = 0;
+
+    SeqRead(&pPTM->spaceSnap.sequence, &pPTM->spaceSnap.snap, &snap, sizeof(snap));
+    if (NODE_ETI == node) {
+        pOriginal = pPTM->szOriginalEtiPath;
+        pExternal = pPTM->mDlgSet.szExtEtiPath;
+    }
+    else if (NODE_TII == node) {
+        pOriginal = pPTM->szOriginalTiiPath;
+        pExternal = pPTM->mDlgSet.szExtTiiPath;
+    }
+    else {
+        node = NODE_RAW;
+        pOriginal = pPTM->szOriginalRawPath;
+        pExternal = pPTM->mDlgSet.szExtRawPath;
+    }
+    pCurrent = snap.szPaths[node];
+    online = snap.online[node];
+
+    pPrevious = GetPreviousFolder(node);
+    memcpy(szFolders[num++], pCurrent, MAX_PATH_BUFFER_SIZE);
+    if (pPrevious[0] && lstrcmpi(pPrevious, pCurrent) && lstrcmpi(pPrevious, pOriginal) &&
+        lstrcmpi(pPrevious, pExternal))
+        lstrcpyn(szFolders[num++], pPrevious, MAX_PATH_BUFFER_SIZE);
+    if (lstrcmpi(pCurrent, pOriginal))
+        memcpy(szFolders[num++], pOriginal, MAX_PATH_BUFFER_SIZE);
+    if (online && lstrcmpi(pCurrent, pExternal) && lstrcmpi(pOriginal, pExternal))
+        memcpy(szFolders[num++], pExternal, MAX_PATH_BUFFER_SIZE);
+    return num;
+}
+
+
+// The PostRecordingThread looks for finished recordings in the folders
+// we know and runs the post-recording stages on them. Files still open
+// for writing are skipped, so a running recording is left alone. The
+// thread runs in background mode, which also lowers its I/O priority
+// below QIRX's writes to the same drive.
+
+DWORD WINAPI PostRecordingThread(LPVOID param) {
+    char szFolders[REC_MAX_FOLDERS][MAX_PATH_BUFFER_SIZE];
+    int seconds = POST_REC_INTERVAL - 5; // first look shortly after the start
+    int numFolders;
+
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+
+    while (!pPTM->finishThread) {
+        Sleep(1000);
+        if (++seconds < POST_REC_INTERVAL)
+            continue;
+        seconds = 0;
+        pPTM->postRecordingBusy = 1; // no read-ahead meanwhile, we read recordings too
+
+        if (pPTM->flagIsQ5) {
+            numFolders = GetRecordingFolders(NODE_ETI, szFolders);
+            for (int i = 0; i < numFolders && !pPTM->finishThread; i++)
+                EtiIndexFolder(szFolders[i], &pPTM->finishThread);
+        }
+
+        numFolders = GetRecordingFolders(NODE_RAW, szFolders);
+        for (int i = 0; i < numFolders && !pPTM->finishThread; i++) {
+            IqScanFolder(szFolders[i], &pPTM->finishThread);
+            if (pPTM->opt.compressRaw) // after the scan, the original may be deleted
+                RawPackFolder(szFolders[i], &pPTM->finishThread);
+        }
+
+        // The log QIRX is writing to is read up to its last complete line
+        numFolders = GetRecordingFolders(NODE_TII, szFolders);
+        TiiIngestFolders(szFolders, numFolders, &pPTM->finishThread);
+        pPTM->postRecordingBusy = 0;
+    }
+
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+    return 0;
+}
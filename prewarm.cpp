@@ -0,0 +1,210 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+// An external HDD which went to sleep needs some seconds to spin up, and
+// the file system reads the folder before the first file is created. If
+// QIRX is the first one to write, the start of the recording waits for
+// all that.
+//
+// When an external path becomes the current one, the PrewarmThread reads
+// the folder and writes a small probe ("PathTweaker.raw.probe" etc., one
+// per node) through to the disk, so the drive is up before QIRX needs it.
+// While the path stays current, the probe is written again every
+// "KeepAwakeSeconds", which keeps the drive from going to sleep. The time
+// the drive took is written to "spinup.txt" next to "dlg.dat", for each
+// pre-warm and for each slow keep-awake (the drive was asleep, the
+// interval is too long for it).
+
+#define PREWARM_POLL_MS  1000
+#define PREWARM_PROBE    4096  // bytes
+#define PREWARM_SLOW_MS  300   // a keep-awake slower than this is reported
+
+extern DWORD SeqRead(volatile LONG* pSequence, const void* pShared, void* pData, DWORD size);
+
+struct PREWARM {
+    char szFolder[MAX_PATH_BUFFER_SIZE]; // the current path we look after
+    char szProbe[MAX_PATH_BUFFER_SIZE];
+    int idleSeconds;
+};
+
+static PREWARM prewarms[STATION_MAX][4]; // per node
+static HANDLE hPrewarmEvents[STATION_MAX];
+static const char* nodeNames[4] = { "raw", "aud", "tii", "eti" };
+
+
+// Our external path (or its dated subfolder) on a drive which is online,
+// in the snapshot
+const char* GetPrewarmFolder(const SPACESNAPSHOT* pSnap, int node) {
+    return pSnap->online[node] && pSnap->external[node] ? pSnap->szPaths[node] : NULL;
+}
+
+double GetElapsedMs(const LARGE_INTEGER* pStart) {
+    LARGE_INTEGER qpf, now;
+
+    QueryPerformanceFrequency(&qpf);
+    QueryPerformanceCounter(&now);
+    return (now.QuadPart - pStart->QuadPart) * 1000.0 / qpf.QuadPart;
+}
+
+// Reads all entries of the folder, this is what the file system needs
+// before a file is created there
+int TouchFolder(const char* szFolder) {
+    char szPattern[MAX_PATH_BUFFER_SIZE + 8];
+    WIN32_FIND_DATA fd;
+    HANDLE hFind;
+    int ret = 0;
+
+    sprintf(szPattern, "%s%s*", szFolder, szFolder[lstrlen(szFolder) - 1] == '\\' ? "" : "\\");
+    hFind = FindFirstFile(szPattern, &fd);
+    if (INVALID_HANDLE_VALUE == hFind)
+        return ret;
+    while (FindNextFile(hFind, &fd) && !pPTM->finishThread)
+        ;
+    FindClose(hFind);
+    ret++;
+    return ret;
+}
+
+// Writes the probe through to the disk
+int WriteProbe(const char* szProbe) {
+    static BYTE zeros[PREWARM_PROBE];
+    DWORD dNumBytes;
+    HANDLE hFile;
+    int ret = 0;
+
+    hFile = CreateFile(szProbe, GENERIC_WRITE, 0, 0, OPEN_ALWAYS,
+        FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_NOT_CONTENT_INDEXED | FILE_FLAG_WRITE_THROUGH, 0);
+    if (INVALID_HANDLE_VALUE == hFile)
+        return ret;
+    if (WriteFile(hFile, zeros, PREWARM_PROBE, &dNumBytes, NULL) && PREWARM_PROBE == dNumBytes &&
+        FlushFileBuffers(hFile))
+        ret++;
+    CloseHandle(hFile);
+    return ret;
+}
+
+void AppendSpinupReport(const char* szFolder, int node, const char* szWhat, double folderMs, double probeMs) {
+    char line[MAX_PATH_BUFFER_SIZE + 128];
+    SYSTEMTIME st;
+    DWORD dNumBytes;
+    HANDLE hReport;
+    int len;
+
+    hReport = CreateFile(pPTM->szSpinupReportFileName, FILE_APPEND_DATA, FILE_SHARE_READ, 0, OPEN_ALWAYS, 0, 0);
+    if (INVALID_HANDLE_VALUE == hReport)
+        return;
+    GetLocalTime(&st);
+    len = sprintf(line, "%04u-%02u-%02u %02u:%02u:%02u  %s  %-10s folder %7.0f ms  probe %6.0f ms  %s\r\n",
+        st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, nodeNames[node], szWhat,
+        folderMs, probeMs, szFolder);
+    WriteFile(hReport, line, len, &dNumBytes, NULL);
+    CloseHandle(hReport);
+}
+
+void ReleasePrewarm(PREWARM* pPre) {
+    if (pPre->szProbe[0]) {
+        DeleteFile(pPre->szProbe);
+        pPre->szProbe[0] = 0;
+    }
+    pPre->szFolder[0] = 0;
+}
+
+// The time of the folder is mostly the spin-up, the probe shows how fast
+// the drive takes a write once it is up
+void Prewarm(PREWARM* pPre, int node, int keepAwake) {
+    LARGE_INTEGER start;
+    double folderMs, probeMs;
+
+    QueryPerformanceCounter(&start);
+    if (!TouchFolder(pPre->szFolder))
+        return;
+    folderMs = GetElapsedMs(&start);
+
+    QueryPerformanceCounter(&start);
+    if (!WriteProbe(pPre->szProbe))
+        return;
+    probeMs = GetElapsedMs(&start);
+
+    if (!keepAwake || folderMs + probeMs >= PREWARM_SLOW_MS)
+        AppendSpinupReport(pPre->szFolder, node, keepAwake ? "keep-awake" : "pre-warm", folderMs, probeMs);
+}
+
+// Called after a path switch, the new path is warmed at once
+void WakePrewarm() {
+    if (hPrewarmEvents[pPTM->station])
+        SetEvent(hPrewarmEvents[pPTM->station]);
+}
+
+
+DWORD WINAPI PrewarmThread(LPVOID param) {
+    SPACESNAPSHOT snap;
+    PREWARM* pPre;
+    const char* pFolder;
+
+    if (!pPTM->opt.prewarm)
+        return 0;
+    hPrewarmEvents[pPTM->station] = CreateEvent(NULL, false, false, NULL);
+
+    while (!pPTM->finishThread) {
+        if (WAIT_OBJECT_0 == WaitForSingleObject(hPrewarmEvents[pPTM->station], PREWARM_POLL_MS))
+            Sleep(100); // let the dialog finish the switch
+        SeqRead(&pPTM->spaceSnap.sequence, &pPTM->spaceSnap.snap, &snap, sizeof(snap));
+
+        for (int node = 0; node < 4 && !pPTM->finishThread; node++) {
+            pPre = &prewarms[pPTM->station][node];
+            pFolder = GetPrewarmFolder(&snap, node);
+            if (!pFolder) {
+                ReleasePrewarm(pPre);
+                continue;
+            }
+
+            // a new current path
+            if (lstrcmpi(pPre->szFolder, pFolder)) {
+                ReleasePrewarm(pPre);
+                lstrcpyn(pPre->szFolder, pFolder, MAX_PATH_BUFFER_SIZE);
+                sprintf(pPre->szProbe, "%s%s", pFolder, pFolder[lstrlen(pFolder) - 1] == '\\' ? "" : "\\");
+                sprintf(pPre->szProbe + lstrlen(pPre->szProbe), szProbeFile, nodeNames[node]);
+                pPre->idleSeconds = 0;
+                Prewarm(pPre, node, 0);
+                continue;
+            }
+
+            pPre->idleSeconds += PREWARM_POLL_MS / 1000;
+            if (pPTM->opt.keepAwakeSeconds > 0 && pPre->idleSeconds >= pPTM->opt.keepAwakeSeconds) {
+                pPre->idleSeconds = 0;
+                Prewarm(pPre, node, 1);
+            }
+        }
+    }
+
+    for (int node = 0; node < 4; node++)
+        ReleasePrewarm(&prewarms[pPTM->station][node]);
+    CloseHandle(hPrewarmEvents[pPTM->station]);
+    hPrewarmEvents[pPTM->station] = NULL;
+    return 0;
+}
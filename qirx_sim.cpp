@@ -0,0 +1,357 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+#include <stdarg.h>
+
+// A stand-in for QIRX and its watch on the config-file, to find the open
+// retries and the pause after each access of ProcessQirxXMLNode()
+// ("OpenRetries", "RetryMs" and "SettleMs" in "options.ini") from data.
+// QIRX reads its config-file again as soon as it was changed. If it gets
+// no handle then, it gives up and quits (see configparser.cpp).
+//
+// "-fakeqirx file [delay=ms] [hold=ms] [log=file]" does the same as a
+// process of its own: it waits for a change in the folder of the file,
+// opens the file "delay" ms later the way QIRX does, reads it and keeps it
+// open for "hold" ms. Each open which fails (where QIRX would quit) goes to
+// the log, or to stdout.
+//
+// "-qirxsim" is the driver. It makes a config-file in a folder for
+// temporary files, starts "-fakeqirx" on it and switches all four paths
+// "switches" times with the engine's ProcessQirxXMLNode(), for each
+// combination of the lists given for "delay", "hold" and "settle". The two
+// processes share a FAKEQIRX, so the driver changes the times of the fake
+// and reads its counts without a restart. The result is CSV, a line per
+// combination: the opens of the fake and how many of them failed, our own
+// retries and give-ups, and the time of a switch of all four paths.
+
+#define SIM_SWITCHES     100
+#define SIM_MAX_VALUES   8
+#define SIM_WAIT_MS      250   // the fake looks at FAKEQIRX.stop this often
+#define SIM_START_MS     5000
+#define SIM_READ_CHUNK   65536
+
+extern int ProcessQirxXMLNode(const char* nodeNeedle, QIRXATTRIBUTE* pAttribs, int numAttribs, int configReadWrite);
+extern int MakeBenchConfig(const char* szFile, DWORD size, int nodesAtEnd);
+extern int CompareMicros(const void* a, const void* b);
+
+struct FAKEQIRX {
+    volatile LONG stop;
+    volatile LONG ready;
+    volatile LONG delayMs;    // from the change up to the open
+    volatile LONG holdMs;     // the file stays open
+    volatile LONG64 changes;
+    volatile LONG64 opens;
+    volatile LONG64 failures; // QIRX would quit here
+};
+
+static const char* needles[4] = { needleRawOut, needleAudOut, needleTiiLog, needleEtiOut };
+
+
+void FakeQirxLog(HANDLE hLog, const char* szFormat, ...) {
+    char line[MAX_PATH_BUFFER_SIZE + 128];
+    SYSTEMTIME st;
+    va_list args;
+    DWORD dNumBytes;
+    int len;
+
+    GetLocalTime(&st);
+    len = sprintf(line, "%02u:%02u:%02u.%03u  ", st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
+    va_start(args, szFormat);
+    _vsnprintf_s(line + len, sizeof(line) - len - 2, _TRUNCATE, szFormat, args);
+    va_end(args);
+    len = lstrlen(line);
+    lstrcpy(line + len, "\r\n");
+    WriteFile(hLog, line, len + 2, &dNumBytes, NULL);
+}
+
+// Until pState->stop
+void RunFakeQirx(FAKEQIRX* pState, const char* szFile, HANDLE hLog) {
+    char szFolder[MAX_PATH_BUFFER_SIZE], *pSlash, *pBuf;
+    LARGE_INTEGER qpf, liChange, liNow;
+    HANDLE hChange, hFile;
+    DWORD dNumBytes;
+
+    lstrcpyn(szFolder, szFile, MAX_PATH_BUFFER_SIZE);
+    pSlash = strrchr(szFolder, '\\');
+    if (pSlash)
+        *pSlash = 0;
+    pBuf = (char*)VCALLOC(SIM_READ_CHUNK);
+    if (!pBuf)
+        return;
+    hChange = FindFirstChangeNotification(szFolder, FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE);
+    if (INVALID_HANDLE_VALUE == hChange) {
+        FakeQirxLog(hLog, "%s can't be watched (%lu)", szFolder, GetLastError());
+        VFREE(pBuf);
+        return;
+    }
+    QueryPerformanceFrequency(&qpf);
+    pState->ready = 1;
+
+    while (!pState->stop) {
+        if (WAIT_OBJECT_0 != WaitForSingleObject(hChange, SIM_WAIT_MS))
+            continue;
+        QueryPerformanceCounter(&liChange);
+        InterlockedIncrement64(&pState->changes);
+        if (pState->delayMs)
+            Sleep(pState->delayMs);
+
+        hFile = CreateFile(szFile, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+        InterlockedIncrement64(&pState->opens);
+        if (INVALID_HANDLE_VALUE == hFile) {
+            InterlockedIncrement64(&pState->failures);
+            QueryPerformanceCounter(&liNow);
+            FakeQirxLog(hLog, "open failed (%lu), %.1f ms after the change", GetLastError(),
+                (liNow.QuadPart - liChange.QuadPart) * 1000.0 / qpf.QuadPart);
+        }
+        else {
+            while (ReadFile(hFile, pBuf, SIM_READ_CHUNK, &dNumBytes, NULL) && dNumBytes)
+                ;
+            if (pState->holdMs)
+                Sleep(pState->holdMs);
+            CloseHandle(hFile);
+        }
+        FindNextChangeNotification(hChange);
+    }
+    FindCloseChangeNotification(hChange);
+    VFREE(pBuf);
+}
+
+// -fakeqirx file [delay=ms] [hold=ms] [log=file] [sim=name]. Returns 0 for
+// the usage.
+int CmdFakeQirx(int argc, char** argv) {
+    FAKEQIRX local{}, *pState = &local;
+    const char* szFile = NULL, *szLog = NULL, *szSim = NULL;
+    HANDLE hLog, hMapping = NULL;
+
+    for (int i = 0; i < argc; i++) {
+        if (!_strnicmp(argv[i], "delay=", 6))
+            local.delayMs = atoi(argv[i] + 6);
+        else if (!_strnicmp(argv[i], "hold=", 5))
+            local.holdMs = atoi(argv[i] + 5);
+        else if (!_strnicmp(argv[i], "log=", 4))
+            szLog = argv[i] + 4;
+        else if (!_strnicmp(argv[i], "sim=", 4))
+            szSim = argv[i] + 4;
+        else if (!szFile)
+            szFile = argv[i];
+        else
+            return 0;
+    }
+    if (!szFile || local.delayMs < 0 || local.holdMs < 0)
+        return 0;
+
+    if (szSim) { // started by -qirxsim
+        hMapping = OpenFileMapping(FILE_MAP_ALL_ACCESS, FALSE, szSim);
+        pState = hMapping ? (FAKEQIRX*)MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(FAKEQIRX)) : NULL;
+        if (!pState) {
+            if (hMapping)
+                CloseHandle(hMapping);
+            return 1;
+        }
+    }
+    hLog = szLog ? CreateFile(szLog, FILE_APPEND_DATA, FILE_SHARE_READ, 0, OPEN_ALWAYS, 0, 0) :
+        GetStdHandle(STD_OUTPUT_HANDLE);
+
+    if (!szSim)
+        printf("Watching %s like QIRX, delay %ld ms, hold %ld ms. Ctrl+C ends.\n", szFile, local.delayMs,
+            local.holdMs);
+    fflush(stdout);
+    RunFakeQirx(pState, szFile, hLog);
+
+    if (szLog && INVALID_HANDLE_VALUE != hLog)
+        CloseHandle(hLog);
+    if (hMapping) {
+        UnmapViewOfFile(pState);
+        CloseHandle(hMapping);
+    }
+    return 1;
+}
+
+// "0,25,100", returns the number of values, 0 if one is wrong
+int ParseSimList(const char* szList, int* pValues) {
+    int num = 0;
+
+    while (*szList && num < SIM_MAX_VALUES) {
+        if (*szList < '0' || *szList > '9')
+            return 0;
+        pValues[num++] = atoi(szList);
+        while (*szList >= '0' && *szList <= '9')
+            szList++;
+        if (*szList == ',')
+            szList++;
+        else if (*szList)
+            return 0;
+    }
+    return num;
+}
+
+// One combination of the times, a line of CSV
+void RunSimCase(FAKEQIRX* pState, int switches, LONG64* pMicros) {
+    QIRXATTRIBUTE attrib{};
+    LARGE_INTEGER qpf, liStart, liEnd;
+    LONG64 opens, failures, retries, sum = 0;
+    int gaveUp = 0;
+
+    QueryPerformanceFrequency(&qpf);
+    Sleep(SIM_WAIT_MS); // the fake reads what is left
+    opens = pState->opens;
+    failures = pState->failures;
+    retries = pPTM->counters.configOpenRetries;
+
+    for (int s = 0; s < switches; s++) {
+        lstrcpy(attrib.szValue, s & 1 ? "E:\\Recordings\\" : "C:\\Users\\User\\AppData\\Local/qirx4/Raw/");
+        QueryPerformanceCounter(&liStart);
+        for (int node = 0; node < 4; node++)
+            if (!ProcessQirxXMLNode(needles[node], &attrib, 1, CONFIG_WRITE))
+                gaveUp++;
+        QueryPerformanceCounter(&liEnd);
+        pMicros[s] = (liEnd.QuadPart - liStart.QuadPart) * 1000000 / qpf.QuadPart;
+        sum += pMicros[s];
+    }
+    Sleep(pState->delayMs + pState->holdMs + SIM_WAIT_MS);
+
+    opens = pState->opens - opens;
+    failures = pState->failures - failures;
+    qsort(pMicros, switches, sizeof(LONG64), CompareMicros);
+    printf("%ld,%ld,%d,%d,%d,%d,%lld,%lld,%.4f,%lld,%d,%.1f,%.1f,%.1f,%.1f\n", pState->delayMs, pState->holdMs,
+        pPTM->opt.configOpenRetries, pPTM->opt.configRetryMs, pPTM->opt.configSettleMs, switches, opens, failures,
+        opens ? (double)failures / opens : 0., pPTM->counters.configOpenRetries - retries, gaveUp,
+        sum / 1000.0 / switches, pMicros[switches / 2] / 1000.0, pMicros[switches - 1 - switches / 100] / 1000.0,
+        pMicros[switches - 1] / 1000.0);
+    fflush(stdout);
+}
+
+// -qirxsim [switches=n] [delay=ms,...] [hold=ms,...] [settle=ms,...]
+// [retry=ms]. Returns 0 for the usage.
+int CmdQirxSim(int argc, char** argv) {
+    char szFolder[MAX_PATH_BUFFER_SIZE], szFile[MAX_PATH_BUFFER_SIZE], szLog[MAX_PATH_BUFFER_SIZE];
+    char szSaveConfig[MAX_PATH_BUFFER_SIZE], szName[64], szExe[MAX_PATH_BUFFER_SIZE];
+    char szCmd[3 * MAX_PATH_BUFFER_SIZE + 128];
+    int delays[SIM_MAX_VALUES] = { 0, 10 }, holds[SIM_MAX_VALUES] = { 5 }, settles[SIM_MAX_VALUES] = { 0, 50, 100 };
+    int numDelays = 2, numHolds = 1, numSettles = 3, switches = SIM_SWITCHES, saveSettle, saveRetry;
+    STARTUPINFO si{};
+    PROCESS_INFORMATION pi{};
+    FAKEQIRX* pState = NULL;
+    HANDLE hMapping;
+    LONG64* pMicros = NULL;
+
+    saveRetry = pPTM->opt.configRetryMs;
+    for (int i = 0; i < argc; i++) {
+        if (!_strnicmp(argv[i], "switches=", 9))
+            switches = atoi(argv[i] + 9);
+        else if (!_strnicmp(argv[i], "delay=", 6))
+            numDelays = ParseSimList(argv[i] + 6, delays);
+        else if (!_strnicmp(argv[i], "hold=", 5))
+            numHolds = ParseSimList(argv[i] + 5, holds);
+        else if (!_strnicmp(argv[i], "settle=", 7))
+            numSettles = ParseSimList(argv[i] + 7, settles);
+        else if (!_strnicmp(argv[i], "retry=", 6))
+            pPTM->opt.configRetryMs = atoi(argv[i] + 6);
+        else
+            return 0;
+        if (!numDelays || !numHolds || !numSettles || switches < 1 || pPTM->opt.configRetryMs < 0) {
+            pPTM->opt.configRetryMs = saveRetry;
+            return 0;
+        }
+    }
+
+    if (!GetTempPath(MAX_PATH_BUFFER_SIZE - 32, szFolder) || !GetModuleFileName(NULL, szExe, MAX_PATH_BUFFER_SIZE)) {
+        pPTM->opt.configRetryMs = saveRetry;
+        return 1;
+    }
+    lstrcat(szFolder, "PathTweakerSim");
+    CreateDirectory(szFolder, NULL);
+    sprintf(szFile, "%s\\qirx4%s", szFolder, szQirxConfigExt);
+    sprintf(szLog, "%s\\fakeqirx.txt", szFolder);
+    DeleteFile(szLog);
+    if (!MakeBenchConfig(szFile, 24 * 1024, 0)) {
+        printf("%s could not be written.\n", szFile);
+        pPTM->opt.configRetryMs = saveRetry;
+        return 1;
+    }
+
+    sprintf(szName, "Local\\PathTweakerFakeQirx-%lu", GetCurrentProcessId());
+    hMapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(FAKEQIRX), szName);
+    if (hMapping)
+        pState = (FAKEQIRX*)MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(FAKEQIRX));
+    pMicros = (LONG64*)VCALLOC(switches * sizeof(LONG64));
+    if (!pState || !pMicros)
+        goto out;
+    pState->delayMs = delays[0];
+    pState->holdMs = holds[0];
+
+    sprintf(szCmd, "\"%s\" -fakeqirx \"%s\" sim=%s log=\"%s\"", szExe, szFile, szName, szLog);
+    si.cb = sizeof(si);
+    if (!CreateProcess(NULL, szCmd, NULL, NULL, FALSE, CREATE_NO_WINDOW, NULL, NULL, &si, &pi)) {
+        printf("-fakeqirx didn't start (%lu).\n", GetLastError());
+        goto out;
+    }
+    for (int t = 0; t < SIM_START_MS / 10 && !pState->ready; t++)
+        Sleep(10);
+    if (!pState->ready) {
+        printf("-fakeqirx doesn't answer.\n");
+        goto stop;
+    }
+
+    lstrcpy(szSaveConfig, pPTM->szQirxFullConfigFileName);
+    lstrcpy(pPTM->szQirxFullConfigFileName, szFile);
+    saveSettle = pPTM->opt.configSettleMs;
+
+    fprintf(stderr, "Fake QIRX on %s, %d switches of 4 paths per line\n", szFile, switches);
+    printf("delay_ms,hold_ms,open_retries,retry_ms,settle_ms,switches,qirx_opens,qirx_failures,collision_rate,"
+        "retries,gave_up,mean_ms,p50_ms,p99_ms,max_ms\n");
+    for (int d = 0; d < numDelays; d++)
+        for (int h = 0; h < numHolds; h++)
+            for (int s = 0; s < numSettles; s++) {
+                pState->delayMs = delays[d];
+                pState->holdMs = holds[h];
+                pPTM->opt.configSettleMs = settles[s];
+                RunSimCase(pState, switches, pMicros);
+            }
+    fprintf(stderr, "The failed opens of the fake are in %s\n", szLog);
+
+    lstrcpy(pPTM->szQirxFullConfigFileName, szSaveConfig);
+    pPTM->opt.configSettleMs = saveSettle;
+
+stop:
+    pState->stop = 1;
+    if (WAIT_TIMEOUT == WaitForSingleObject(pi.hProcess, 2 * SIM_WAIT_MS + SIM_START_MS))
+        TerminateProcess(pi.hProcess, 1);
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+    DeleteFile(szFile);
+
+out:
+    if (pMicros)
+        VFREE(pMicros);
+    if (pState)
+        UnmapViewOfFile(pState);
+    if (hMapping)
+        CloseHandle(hMapping);
+    pPTM->opt.configRetryMs = saveRetry;
+    return 1;
+}
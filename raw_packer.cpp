@@ -0,0 +1,788 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+#include <intrin.h>
+#include <compressapi.h>
+#include <math.h>
+
+#pragma comment(lib, "Cabinet.lib")
+
+// Packing of finished raw-recordings, "name.raw" becomes "name.rawz".
+//
+// The recording is cut into chunks of 4 MiB, and the chunks are packed on
+// all cores with XPRESS (Huffman) of the Windows compression API. Before
+// that, the I/Q pairs are split into an I plane and a Q plane. The bytes
+// of a plane are much more alike than the interleaved ones, and an
+// optional delta step makes a slowly changing signal smaller still. Which
+// transform works best is probed once per file.
+//
+// The workers write their chunks in the order they finish, the index at
+// the end of the file tells where each chunk is. So any range of the
+// recording can be read back without unpacking the rest, see
+// RawzReadRange().
+//
+//   RAWZHEADER | chunk | chunk | ... | RAWZCHUNK[numChunks]
+
+#define RAWZ_CHUNK_SIZE     (4 * 1024 * 1024)
+#define RAWZ_VERSION        1
+#define RAWZ_MAX_THREADS    16
+#define RAWZ_ALGORITHM      COMPRESS_ALGORITHM_XPRESS_HUFF
+
+#define RAWZ_TF_NONE        0
+#define RAWZ_TF_PLANES      1  // all I bytes, then all Q bytes
+#define RAWZ_TF_DELTA       2  // planes, each byte as difference to its predecessor
+#define RAWZ_NUM_TF         3
+
+extern int OpenMappedFile(MAPPEDFILE* pMf, const char* szFileName);
+extern BYTE* MapFileWindow(MAPPEDFILE* pMf, ULONGLONG offset, SIZE_T* pInOutSize);
+extern void UnmapFileWindow(MAPPEDFILE* pMf);
+extern void CloseMappedFile(MAPPEDFILE* pMf);
+extern int ForEachRecording(const char* szFolder, const char* szExt, PFNRECORDINGPROC pfnRecording,
+    volatile int* pCancel);
+extern HANDLE CreateEngineThread(LPTHREAD_START_ROUTINE pfnThread, LPVOID param);
+
+
+struct RAWZCHUNK {
+    ULONGLONG fileOffset;     // in the packed file
+    DWORD packedSize;
+    WORD transform;
+    WORD stored;              // 1: did not shrink, the original bytes are stored
+};
+
+struct RAWPACK {
+    MAPPEDFILE* pMf;
+    const BYTE* pData;        // the benchmark has its data in memory, no pMf then
+    ULONGLONG rawSize;
+    HANDLE hOut;              // NULL for the benchmark, only the sizes are counted
+    RAWZCHUNK* pChunks;
+    DWORD numChunks;
+    DWORD transform;
+    volatile long nextChunk;
+    volatile long failed;
+    volatile int* pCancel;
+    int background;
+    ULONGLONG writeOffset;
+    CRITICAL_SECTION csWrite;
+};
+
+struct RAWZREADER {
+    HANDLE hFile;
+    RAWZHEADER hdr;
+    RAWZCHUNK* pChunks;
+    DECOMPRESSOR_HANDLE hDecompressor;
+    BYTE* pPacked;
+    BYTE* pChunk;             // the last chunk unpacked, for small reads in a row
+    long cachedChunk;
+};
+
+static const char* szTransforms[RAWZ_NUM_TF] = { "none", "I/Q planes", "I/Q planes + delta" };
+
+
+// SSE2 splits 32 bytes (16 pairs) per step: the even bytes are masked and
+// the odd ones shifted down, PACKUSWB then packs them into two planes.
+void SplitIqPlanes(const BYTE* p, SIZE_T len, BYTE* pOut) {
+    __m128i a, b, mask;
+    BYTE* pI = pOut, *pQ = pOut + len / 2;
+    SIZE_T i;
+
+    mask = _mm_set1_epi16(0x00FF);
+    for (i = 0; i + 32 <= len; i += 32) {
+        a = _mm_loadu_si128((const __m128i*)(p + i));
+        b = _mm_loadu_si128((const __m128i*)(p + i + 16));
+        _mm_storeu_si128((__m128i*)pI, _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+        _mm_storeu_si128((__m128i*)pQ, _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+        pI += 16;
+        pQ += 16;
+    }
+    for (; i + 1 < len; i += 2) {
+        *pI++ = p[i];
+        *pQ++ = p[i + 1];
+    }
+}
+
+void MergeIqPlanes(const BYTE* p, SIZE_T len, BYTE* pOut) {
+    __m128i vi, vq;
+    const BYTE* pI = p, *pQ = p + len / 2;
+    SIZE_T i;
+
+    for (i = 0; i + 32 <= len; i += 32) {
+        vi = _mm_loadu_si128((const __m128i*)pI);
+        vq = _mm_loadu_si128((const __m128i*)pQ);
+        _mm_storeu_si128((__m128i*)(pOut + i), _mm_unpacklo_epi8(vi, vq));
+        _mm_storeu_si128((__m128i*)(pOut + i + 16), _mm_unpackhi_epi8(vi, vq));
+        pI += 16;
+        pQ += 16;
+    }
+    for (; i + 1 < len; i += 2) {
+        pOut[i] = *pI++;
+        pOut[i + 1] = *pQ++;
+    }
+}
+
+// In place, the first byte stays as it is
+void DeltaEncode(BYTE* p, SIZE_T len) {
+    __m128i v, prev;
+    SIZE_T i;
+    BYTE last = 0, cur;
+
+    for (i = 0; i + 16 <= len; i += 16) {
+        v = _mm_loadu_si128((const __m128i*)(p + i));
+        prev = _mm_or_si128(_mm_slli_si128(v, 1), _mm_cvtsi32_si128(last));
+        last = p[i + 15];
+        _mm_storeu_si128((__m128i*)(p + i), _mm_sub_epi8(v, prev));
+    }
+    for (; i < len; i++) {
+        cur = p[i];
+        p[i] = (BYTE)(cur - last);
+        last = cur;
+    }
+}
+
+// The running sum in four shift-and-add steps per 16 bytes
+void DeltaDecode(BYTE* p, SIZE_T len) {
+    __m128i v;
+    SIZE_T i;
+    BYTE last = 0;
+
+    for (i = 0; i + 16 <= len; i += 16) {
+        v = _mm_loadu_si128((const __m128i*)(p + i));
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 1));
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 2));
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+        v = _mm_add_epi8(v, _mm_set1_epi8((char)last));
+        _mm_storeu_si128((__m128i*)(p + i), v);
+        last = (BYTE)(_mm_extract_epi16(v, 7) >> 8);
+    }
+    for (; i < len; i++)
+        last = p[i] = (BYTE)(p[i] + last);
+}
+
+
+// Transforms and packs one chunk into pOut (RAWZ_CHUNK_SIZE bytes) and
+// fills *pChunk, except the file offset. pTmp is a scratch buffer of the
+// same size. Returns a pointer to the bytes to write.
+const BYTE* PackChunk(COMPRESSOR_HANDLE hCompressor, const BYTE* p, SIZE_T len, DWORD transform,
+    BYTE* pTmp, BYTE* pOut, RAWZCHUNK* pChunk) {
+    const BYTE* pSrc = p;
+    SIZE_T packedSize = 0;
+
+    if (RAWZ_TF_NONE != transform) {
+        SplitIqPlanes(p, len, pTmp);
+        if (len & 1)
+            pTmp[len - 1] = p[len - 1];
+        if (RAWZ_TF_DELTA == transform) {
+            DeltaEncode(pTmp, len / 2);
+            DeltaEncode(pTmp + len / 2, len - len / 2);
+        }
+        pSrc = pTmp;
+    }
+
+    pChunk->transform = (WORD)transform;
+    if (Compress(hCompressor, pSrc, len, pOut, RAWZ_CHUNK_SIZE, &packedSize) && packedSize < len) {
+        pChunk->packedSize = (DWORD)packedSize;
+        pChunk->stored = 0;
+        return pOut;
+    }
+    // Incompressible or the buffer was too small. Store the original.
+    pChunk->packedSize = (DWORD)len;
+    pChunk->transform = RAWZ_TF_NONE;
+    pChunk->stored = 1;
+    return p;
+}
+
+// The way back. pTmp is a scratch buffer of RAWZ_CHUNK_SIZE bytes.
+int UnpackChunk(DECOMPRESSOR_HANDLE hDecompressor, const BYTE* pPacked, const RAWZCHUNK* pChunk,
+    SIZE_T len, BYTE* pTmp, BYTE* pOut) {
+    SIZE_T size = 0;
+
+    if (pChunk->stored) {
+        if (pChunk->packedSize != len)
+            return 0;
+        memcpy(pOut, pPacked, len);
+        return 1;
+    }
+    if (RAWZ_TF_NONE == pChunk->transform)
+        return Decompress(hDecompressor, pPacked, pChunk->packedSize, pOut, len, &size) && size == len;
+
+    if (!Decompress(hDecompressor, pPacked, pChunk->packedSize, pTmp, len, &size) || size != len)
+        return 0;
+    if (RAWZ_TF_DELTA == pChunk->transform) {
+        DeltaDecode(pTmp, len / 2);
+        DeltaDecode(pTmp + len / 2, len - len / 2);
+    }
+    MergeIqPlanes(pTmp, len, pOut);
+    if (len & 1)
+        pOut[len - 1] = pTmp[len - 1];
+    return 1;
+}
+
+
+DWORD WINAPI RawPackThread(LPVOID param) {
+    RAWPACK* pPack = (RAWPACK*)param;
+    MAPPEDFILE mf;
+    COMPRESSOR_HANDLE hCompressor = NULL;
+    BYTE* pBuf;
+    const BYTE* p, *pWrite;
+    RAWZCHUNK chunk;
+    ULONGLONG offset;
+    SIZE_T size;
+    LARGE_INTEGER li;
+    DWORD dNumBytesWritten;
+    long index;
+
+    if (pPack->background)
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+
+    if (pPack->pMf) {
+        memcpy(&mf, pPack->pMf, sizeof(MAPPEDFILE));
+        mf.pView = NULL;
+    }
+
+    pBuf = (BYTE*)VCALLOC(2 * RAWZ_CHUNK_SIZE);
+    if (!pBuf || !CreateCompressor(RAWZ_ALGORITHM, NULL, &hCompressor))
+        InterlockedExchange(&pPack->failed, 1);
+
+    while (!*pPack->pCancel && !pPack->failed) {
+        index = InterlockedIncrement(&pPack->nextChunk) - 1;
+        if (index >= (long)pPack->numChunks)
+            break;
+
+        offset = (ULONGLONG)index * RAWZ_CHUNK_SIZE;
+        size = RAWZ_CHUNK_SIZE;
+        if (pPack->pData) {
+            p = pPack->pData + offset;
+            if (size > pPack->rawSize - offset)
+                size = (SIZE_T)(pPack->rawSize - offset);
+        }
+        else
+            p = MapFileWindow(&mf, offset, &size);
+        if (!p) {
+            InterlockedExchange(&pPack->failed, 1);
+            break;
+        }
+
+        pWrite = PackChunk(hCompressor, p, size, pPack->transform, pBuf, pBuf + RAWZ_CHUNK_SIZE, &chunk);
+
+        EnterCriticalSection(&pPack->csWrite);
+        chunk.fileOffset = pPack->writeOffset;
+        pPack->writeOffset += chunk.packedSize;
+        if (pPack->hOut) {
+            li.QuadPart = chunk.fileOffset;
+            if (!SetFilePointerEx(pPack->hOut, li, NULL, FILE_BEGIN) ||
+                !WriteFile(pPack->hOut, pWrite, chunk.packedSize, &dNumBytesWritten, NULL) ||
+                dNumBytesWritten != chunk.packedSize)
+                InterlockedExchange(&pPack->failed, 1);
+        }
+        LeaveCriticalSection(&pPack->csWrite);
+        pPack->pChunks[index] = chunk;
+    }
+
+    if (hCompressor)
+        CloseCompressor(hCompressor);
+    if (pBuf)
+        VFREE(pBuf);
+    if (pPack->pMf)
+        UnmapFileWindow(&mf);
+    if (pPack->background)
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+    return 0;
+}
+
+// Runs the workers. Returns 0 if cancelled or failed.
+int RunRawPack(RAWPACK* pPack, int numThreads) {
+    HANDLE hThreads[RAWZ_MAX_THREADS];
+    SYSTEM_INFO si;
+    int started = 0;
+
+    if (numThreads <= 0) {
+        GetSystemInfo(&si);
+        numThreads = si.dwNumberOfProcessors;
+    }
+    if (numThreads > RAWZ_MAX_THREADS)
+        numThreads = RAWZ_MAX_THREADS;
+    if (numThreads > (int)pPack->numChunks)
+        numThreads = pPack->numChunks;
+
+    InitializeCriticalSection(&pPack->csWrite);
+    for (int i = 0; i < numThreads; i++) {
+        hThreads[started] = CreateEngineThread(RawPackThread, pPack);
+        if (hThreads[started])
+            started++;
+    }
+
+    if (!started)
+        RawPackThread(pPack);
+    else {
+        WaitForMultipleObjects(started, hThreads, TRUE, INFINITE);
+        for (int i = 0; i < started; i++)
+            CloseHandle(hThreads[i]);
+    }
+    DeleteCriticalSection(&pPack->csWrite);
+    return !*pPack->pCancel && !pPack->failed;
+}
+
+// Packs one chunk from the middle of the recording with every transform
+// and returns the best one. Noise-like signals won't shrink much anyway.
+DWORD ProbeTransform(const BYTE* p, SIZE_T len) {
+    COMPRESSOR_HANDLE hCompressor;
+    BYTE* pBuf;
+    RAWZCHUNK chunk;
+    DWORD best = RAWZ_TF_PLANES, bestSize = 0xFFFFFFFF;
+
+    pBuf = (BYTE*)VCALLOC(2 * RAWZ_CHUNK_SIZE);
+    if (!pBuf)
+        return best;
+
+    if (CreateCompressor(RAWZ_ALGORITHM, NULL, &hCompressor)) {
+        for (DWORD tf = 0; tf < RAWZ_NUM_TF; tf++) {
+            PackChunk(hCompressor, p, len, tf, pBuf, pBuf + RAWZ_CHUNK_SIZE, &chunk);
+            if (!chunk.stored && chunk.packedSize < bestSize) {
+                bestSize = chunk.packedSize;
+                best = tf;
+            }
+        }
+        CloseCompressor(hCompressor);
+    }
+    VFREE(pBuf);
+    return best;
+}
+
+
+void CloseRawzReader(RAWZREADER* pRd) {
+    if (pRd->hDecompressor)
+        CloseDecompressor(pRd->hDecompressor);
+    if (pRd->hFile && INVALID_HANDLE_VALUE != pRd->hFile)
+        CloseHandle(pRd->hFile);
+    free(pRd->pChunks);
+    if (pRd->pPacked)
+        VFREE(pRd->pPacked);
+    memset(pRd, 0, sizeof(RAWZREADER));
+}
+
+// Opens a complete packed file and loads the chunk index. A header which
+// doesn't fit the file, e.g. of a broken copy, is rejected.
+int OpenRawzReader(RAWZREADER* pRd, const char* szFileName) {
+    DWORD dNumBytesRead = 0, indexSize;
+    ULONGLONG fileSize = 0, numChunks, indexBytes;
+    LARGE_INTEGER li;
+    int ret = 0;
+
+    memset(pRd, 0, sizeof(RAWZREADER));
+    pRd->cachedChunk = -1;
+    pRd->hFile = CreateFile(szFileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
+    if (INVALID_HANDLE_VALUE == pRd->hFile)
+        return ret;
+
+    ReadFile(pRd->hFile, &pRd->hdr, sizeof(RAWZHEADER), &dNumBytesRead, NULL);
+    if (GetFileSizeEx(pRd->hFile, &li))
+        fileSize = li.QuadPart;
+
+    // the chunks cover the recording, the index lies within the file. It is
+    // counted in 64 bits, a huge rawSize can't wrap it.
+    numChunks = pRd->hdr.rawSize / RAWZ_CHUNK_SIZE + (pRd->hdr.rawSize % RAWZ_CHUNK_SIZE ? 1 : 0);
+    indexBytes = numChunks * sizeof(RAWZCHUNK);
+    indexSize = (DWORD)indexBytes;
+    if (dNumBytesRead == sizeof(RAWZHEADER) && !memcmp(pRd->hdr.magic, "RAWZ", 4) &&
+        RAWZ_VERSION == pRd->hdr.version && RAWZ_CHUNK_SIZE == pRd->hdr.chunkSize &&
+        pRd->hdr.numChunks == numChunks && indexBytes <= MAXDWORD &&
+        pRd->hdr.indexOffset >= sizeof(RAWZHEADER) && pRd->hdr.indexOffset <= fileSize &&
+        indexBytes <= fileSize - pRd->hdr.indexOffset) {
+
+        pRd->pChunks = (RAWZCHUNK*)malloc(indexSize ? indexSize : 1);
+        pRd->pPacked = (BYTE*)VCALLOC(3 * RAWZ_CHUNK_SIZE); // packed, scratch, cached chunk
+        li.QuadPart = pRd->hdr.indexOffset;
+
+        if (pRd->pChunks && pRd->pPacked && SetFilePointerEx(pRd->hFile, li, NULL, FILE_BEGIN) &&
+            ReadFile(pRd->hFile, pRd->pChunks, indexSize, &dNumBytesRead, NULL) &&
+            dNumBytesRead == indexSize &&
+            CreateDecompressor(RAWZ_ALGORITHM, NULL, &pRd->hDecompressor)) {
+            pRd->pChunk = pRd->pPacked + 2 * RAWZ_CHUNK_SIZE;
+            ret++;
+        }
+    }
+    if (!ret)
+        CloseRawzReader(pRd);
+    return ret;
+}
+
+// Reads len bytes of the original recording at offset into pBuf. Only the
+// chunks in the range are unpacked. Returns the number of bytes read.
+SIZE_T RawzReadRange(RAWZREADER* pRd, ULONGLONG offset, BYTE* pBuf, SIZE_T len) {
+    RAWZCHUNK* pChunk;
+    LARGE_INTEGER li;
+    DWORD dNumBytesRead;
+    SIZE_T chunkLen, pos, n, done = 0;
+    long index;
+
+    while (done < len && offset < pRd->hdr.rawSize) {
+        index = (long)(offset / RAWZ_CHUNK_SIZE);
+        pos = (SIZE_T)(offset % RAWZ_CHUNK_SIZE);
+        chunkLen = RAWZ_CHUNK_SIZE;
+        if ((ULONGLONG)index * RAWZ_CHUNK_SIZE + chunkLen > pRd->hdr.rawSize)
+            chunkLen = (SIZE_T)(pRd->hdr.rawSize - (ULONGLONG)index * RAWZ_CHUNK_SIZE);
+
+        if (index != pRd->cachedChunk) {
+            pChunk = &pRd->pChunks[index];
+            li.QuadPart = pChunk->fileOffset;
+            if (pChunk->packedSize > RAWZ_CHUNK_SIZE ||
+                !SetFilePointerEx(pRd->hFile, li, NULL, FILE_BEGIN) ||
+                !ReadFile(pRd->hFile, pRd->pPacked, pChunk->packedSize, &dNumBytesRead, NULL) ||
+                dNumBytesRead != pChunk->packedSize ||
+                !UnpackChunk(pRd->hDecompressor, pRd->pPacked, pChunk, chunkLen,
+                    pRd->pPacked + RAWZ_CHUNK_SIZE, pRd->pChunk)) {
+                pRd->cachedChunk = -1;
+                break;
+            }
+            pRd->cachedChunk = index;
+        }
+
+        n = chunkLen - pos;
+        if (n > len - done)
+            n = len - done;
+        memcpy(pBuf + done, pRd->pChunk + pos, n);
+        done += n;
+        offset += n;
+    }
+    return done;
+}
+
+
+// Compares the packed file with the original, chunk by chunk
+int VerifyRawz(const char* szPacked, MAPPEDFILE* pMf, volatile int* pCancel) {
+    RAWZREADER rd;
+    ULONGLONG offset = 0;
+    SIZE_T size;
+    const BYTE* p;
+    BYTE* pBuf;
+    int ret = 0;
+
+    if (!OpenRawzReader(&rd, szPacked))
+        return ret;
+
+    pBuf = (BYTE*)VCALLOC(RAWZ_CHUNK_SIZE);
+    if (pBuf && rd.hdr.rawSize == pMf->fileSize) {
+        while (offset < pMf->fileSize && !*pCancel) {
+            size = RAWZ_CHUNK_SIZE;
+            p = MapFileWindow(pMf, offset, &size);
+            if (!p || RawzReadRange(&rd, offset, pBuf, size) != size || memcmp(p, pBuf, size))
+                break;
+            offset += size;
+        }
+        ret = offset == pMf->fileSize;
+    }
+    UnmapFileWindow(pMf);
+    if (pBuf)
+        VFREE(pBuf);
+    CloseRawzReader(&rd);
+    return ret;
+}
+
+void GetPackFileName(const char* szFileName, char* szPacked) {
+    int len = lstrlen(szFileName);
+
+    lstrcpyn(szPacked, szFileName, MAX_PATH_BUFFER_SIZE);
+    if (len > 4 && !lstrcmpi(szFileName + len - 4, szRawExt))
+        szPacked[len - 4] = 0;
+    lstrcat(szPacked, szPackExt);
+}
+
+// Appends to the report "<recording>.txt": the ratio and the speed of the
+// packer, the figures of the playback read-ahead
+void AppendReport(const char* szFileName, const char* szMsg) {
+    char szReport[MAX_PATH_BUFFER_SIZE + 8];
+    DWORD dNumBytesWritten;
+    LARGE_INTEGER li{};
+    HANDLE hReport;
+
+    sprintf(szReport, "%s%s", szFileName, szReportExt);
+    hReport = CreateFile(szReport, GENERIC_WRITE, 0, 0, OPEN_ALWAYS, 0, 0);
+    if (INVALID_HANDLE_VALUE != hReport) {
+        SetFilePointerEx(hReport, li, NULL, FILE_END);
+        WriteFile(hReport, szMsg, lstrlen(szMsg), &dNumBytesWritten, NULL);
+        CloseHandle(hReport);
+    }
+}
+
+
+// Packs one finished recording to "<name>.rawz". *pHdr (optional) gets the
+// header. If deleteRaw is set, the recording is deleted after the packed
+// file was read back and compared. pCancel may stop us any time, an
+// unfinished packed file is deleted then.
+int RawPackFile(const char* szFileName, RAWZHEADER* pHdr, volatile int* pCancel, int background,
+    int numThreads, int deleteRaw) {
+    char szPacked[MAX_PATH_BUFFER_SIZE], buff[512];
+    MAPPEDFILE mf;
+    RAWPACK pack{};
+    RAWZHEADER hdr{};
+    LARGE_INTEGER li, qpf, liStart, liEnd;
+    DWORD dNumBytesWritten;
+    SIZE_T size;
+    const BYTE* p;
+    double seconds;
+    int deleted = 0, ret = 0;
+
+    if (lstrlen(szFileName) + 2 >= MAX_PATH_BUFFER_SIZE)
+        return ret;
+    GetPackFileName(szFileName, szPacked);
+
+    if (!OpenMappedFile(&mf, szFileName))
+        return ret; // busy (still recording?), empty or gone
+
+    memcpy(hdr.magic, "RAWZ", 4);
+    hdr.version = RAWZ_VERSION;
+    hdr.rawSize = mf.fileSize;
+    hdr.chunkSize = RAWZ_CHUNK_SIZE;
+    hdr.numChunks = (DWORD)((mf.fileSize + RAWZ_CHUNK_SIZE - 1) / RAWZ_CHUNK_SIZE);
+    hdr.algorithm = RAWZ_ALGORITHM;
+
+    QueryPerformanceFrequency(&qpf);
+    QueryPerformanceCounter(&liStart);
+
+    size = RAWZ_CHUNK_SIZE;
+    p = MapFileWindow(&mf, (ULONGLONG)(hdr.numChunks / 2) * RAWZ_CHUNK_SIZE, &size);
+    hdr.transform = p ? ProbeTransform(p, size) : RAWZ_TF_PLANES;
+    UnmapFileWindow(&mf);
+
+    pack.pMf = &mf;
+    pack.rawSize = mf.fileSize;
+    pack.numChunks = hdr.numChunks;
+    pack.transform = hdr.transform;
+    pack.pCancel = pCancel;
+    pack.background = background;
+    pack.writeOffset = sizeof(RAWZHEADER);
+    pack.pChunks = (RAWZCHUNK*)malloc(hdr.numChunks * sizeof(RAWZCHUNK));
+    pack.hOut = CreateFile(szPacked, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+
+    if (pack.pChunks && INVALID_HANDLE_VALUE != pack.hOut) {
+        // the header without index first, so a broken file is recognized
+        WriteFile(pack.hOut, &hdr, sizeof(RAWZHEADER), &dNumBytesWritten, NULL);
+
+        if (RunRawPack(&pack, numThreads)) {
+            hdr.indexOffset = pack.writeOffset;
+            li.QuadPart = hdr.indexOffset;
+            SetFilePointerEx(pack.hOut, li, NULL, FILE_BEGIN);
+            if (WriteFile(pack.hOut, pack.pChunks, hdr.numChunks * sizeof(RAWZCHUNK),
+                &dNumBytesWritten, NULL) && dNumBytesWritten == hdr.numChunks * sizeof(RAWZCHUNK)) {
+                li.QuadPart = 0;
+                SetFilePointerEx(pack.hOut, li, NULL, FILE_BEGIN);
+                if (WriteFile(pack.hOut, &hdr, sizeof(RAWZHEADER), &dNumBytesWritten, NULL) &&
+                    dNumBytesWritten == sizeof(RAWZHEADER))
+                    ret++;
+            }
+        }
+        CloseHandle(pack.hOut);
+        if (!ret)
+            DeleteFile(szPacked);
+    }
+    QueryPerformanceCounter(&liEnd);
+    seconds = (double)(liEnd.QuadPart - liStart.QuadPart) / qpf.QuadPart;
+
+    if (ret && deleteRaw && VerifyRawz(szPacked, &mf, pCancel))
+        deleted++;
+    CloseMappedFile(&mf);
+    if (deleted)
+        deleted = DeleteFile(szFileName) ? 1 : 0;
+
+    if (ret) {
+        sprintf(buff, "\r\npacked to %s: %llu -> %llu bytes, ratio %.3f, transform %s\r\n"
+            "%.3f s (%.1f MB/s)%s\r\n",
+            szPacked, hdr.rawSize, hdr.indexOffset + hdr.numChunks * sizeof(RAWZCHUNK),
+            (double)hdr.rawSize / (hdr.indexOffset + hdr.numChunks * sizeof(RAWZCHUNK)),
+            szTransforms[hdr.transform], seconds,
+            seconds > 0. ? hdr.rawSize / seconds / 1'000'000.0 : 0.,
+            deleted ? ", verified, original deleted" : "");
+        AppendReport(szFileName, buff);
+    }
+
+    if (pHdr)
+        memcpy(pHdr, &hdr, sizeof(RAWZHEADER));
+    free(pack.pChunks);
+    return ret;
+}
+
+// A packed file is done, if it is complete and made for a file of the same size
+int HaveRawz(const char* szFileName, ULONGLONG fileSize) {
+    char szPacked[MAX_PATH_BUFFER_SIZE];
+    RAWZHEADER hdr;
+    DWORD dNumBytesRead = 0;
+    HANDLE hPacked;
+
+    GetPackFileName(szFileName, szPacked);
+    hPacked = CreateFile(szPacked, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
+    if (INVALID_HANDLE_VALUE == hPacked)
+        return 0;
+
+    ReadFile(hPacked, &hdr, sizeof(RAWZHEADER), &dNumBytesRead, NULL);
+    CloseHandle(hPacked);
+
+    return dNumBytesRead == sizeof(RAWZHEADER) && !memcmp(hdr.magic, "RAWZ", 4) &&
+        RAWZ_VERSION == hdr.version && hdr.indexOffset && hdr.rawSize == fileSize;
+}
+
+// For the PostRecordingThread, with the settings from "options.ini"
+int RawPackIfNeeded(const char* szFileName, ULONGLONG fileSize, volatile int* pCancel) {
+    if (HaveRawz(szFileName, fileSize))
+        return 0;
+    return RawPackFile(szFileName, NULL, pCancel, 1, pPTM->opt.packThreads,
+        pPTM->opt.deleteRawAfterPack);
+}
+
+int RawPackFolder(const char* szFolder, volatile int* pCancel) {
+    return ForEachRecording(szFolder, szRawExt, RawPackIfNeeded, pCancel);
+}
+
+// Writes the original recording from a packed file to szOut
+int RawUnpackFile(const char* szPacked, const char* szOut) {
+    RAWZREADER rd;
+    ULONGLONG offset = 0;
+    HANDLE hOut;
+    BYTE* pBuf;
+    SIZE_T size;
+    DWORD dNumBytesWritten;
+    int ret = 0;
+
+    if (!OpenRawzReader(&rd, szPacked))
+        return ret;
+
+    pBuf = (BYTE*)VCALLOC(RAWZ_CHUNK_SIZE);
+    hOut = CreateFile(szOut, GENERIC_WRITE, 0, 0, CREATE_NEW, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (pBuf && INVALID_HANDLE_VALUE != hOut) {
+        while (offset < rd.hdr.rawSize) {
+            size = RawzReadRange(&rd, offset, pBuf, RAWZ_CHUNK_SIZE);
+            if (!size || !WriteFile(hOut, pBuf, (DWORD)size, &dNumBytesWritten, NULL) ||
+                dNumBytesWritten != size)
+                break;
+            offset += size;
+        }
+        ret = offset == rd.hdr.rawSize;
+        CloseHandle(hOut);
+        if (!ret)
+            DeleteFile(szOut);
+    }
+    if (pBuf)
+        VFREE(pBuf);
+    CloseRawzReader(&rd);
+    return ret;
+}
+
+
+// Ratio and throughput with synthetic IQ data in memory, without disk I/O.
+// A tone in noise, with a quiet part in between. Every transform is packed
+// on all cores, and the chunks are unpacked and compared afterwards.
+void RawPackBenchmark(int megaBytes) {
+    BYTE* pBuf, *pOut, *pTmp, *pPacked;
+    const BYTE* p;
+    SIZE_T size, len;
+    RAWPACK pack{};
+    RAWZCHUNK chunk;
+    DECOMPRESSOR_HANDLE hDecompressor;
+    COMPRESSOR_HANDLE hCompressor;
+    LARGE_INTEGER qpf, liStart, liEnd;
+    double seconds, phase = 0., amp;
+    unsigned int seed = 12345;
+    int noise, v, mismatch;
+    volatile int neverCancel = 0;
+
+    if (megaBytes < 4)
+        megaBytes = 4;
+    size = (SIZE_T)megaBytes * 1024 * 1024;
+    pBuf = (BYTE*)VCALLOC(size);
+    pTmp = (BYTE*)VCALLOC(3 * RAWZ_CHUNK_SIZE);
+    pack.numChunks = (DWORD)((size + RAWZ_CHUNK_SIZE - 1) / RAWZ_CHUNK_SIZE);
+    pack.pChunks = (RAWZCHUNK*)malloc(pack.numChunks * sizeof(RAWZCHUNK));
+    if (!pBuf || !pTmp || !pack.pChunks) {
+        printf("Not enough memory for %d MB.\n", megaBytes);
+        if (pBuf)
+            VFREE(pBuf);
+        if (pTmp)
+            VFREE(pTmp);
+        free(pack.pChunks);
+        return;
+    }
+    pOut = pTmp + RAWZ_CHUNK_SIZE;
+    pPacked = pTmp + 2 * RAWZ_CHUNK_SIZE;
+
+    for (SIZE_T i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        noise = (int)((seed >> 16) & 7) - 4;
+        amp = ((i >> 22) % 4 == 3) ? 2.0 : 30.0;
+        if (!(i & 1))
+            phase += 0.01;
+        v = 128 + noise + (int)(amp * ((i & 1) ? sin(phase) : cos(phase)));
+        pBuf[i] = (BYTE)(v < 0 ? 0 : v > 255 ? 255 : v);
+    }
+
+    printf("Raw packer benchmark, %d MB (%.1f s of recording at 2.048 MSpl/s)\n",
+        megaBytes, size / 4'096'000.0);
+
+    QueryPerformanceFrequency(&qpf);
+    for (DWORD tf = 0; tf < RAWZ_NUM_TF; tf++) {
+        pack.pData = pBuf;
+        pack.rawSize = size;
+        pack.transform = tf;
+        pack.pCancel = &neverCancel;
+        pack.nextChunk = 0;
+        pack.failed = 0;
+        pack.writeOffset = 0;
+
+        QueryPerformanceCounter(&liStart);
+        RunRawPack(&pack, 0);
+        QueryPerformanceCounter(&liEnd);
+        seconds = (double)(liEnd.QuadPart - liStart.QuadPart) / qpf.QuadPart;
+
+        // The workers don't keep the packed chunks, so pack them again for
+        // the round trip.
+        mismatch = pack.failed;
+        if (CreateCompressor(RAWZ_ALGORITHM, NULL, &hCompressor)) {
+            if (CreateDecompressor(RAWZ_ALGORITHM, NULL, &hDecompressor)) {
+                for (DWORD c = 0; c < pack.numChunks; c++) {
+                    len = size - (SIZE_T)c * RAWZ_CHUNK_SIZE;
+                    if (len > RAWZ_CHUNK_SIZE)
+                        len = RAWZ_CHUNK_SIZE;
+                    p = PackChunk(hCompressor, pBuf + (SIZE_T)c * RAWZ_CHUNK_SIZE, len, tf,
+                        pTmp, pOut, &chunk);
+                    memcpy(pPacked, p, chunk.packedSize);
+                    if (!UnpackChunk(hDecompressor, pPacked, &chunk, len, pTmp, pOut) ||
+                        memcmp(pOut, pBuf + (SIZE_T)c * RAWZ_CHUNK_SIZE, len))
+                        mismatch++;
+                }
+                CloseDecompressor(hDecompressor);
+            }
+            CloseCompressor(hCompressor);
+        }
+
+        printf("%-20s ratio %.3f, %9.1f MB/s, %6.0fx real time | %s\n", szTransforms[tf],
+            (double)size / pack.writeOffset, size / seconds / 1'000'000.0,
+            size / 4'096'000.0 / seconds, mismatch ? "ROUND TRIP FAILED" : "round trip ok");
+    }
+
+    printf("probe picks: %s\n", szTransforms[ProbeTransform(pBuf, RAWZ_CHUNK_SIZE)]);
+    VFREE(pBuf);
+    VFREE(pTmp);
+    free(pack.pChunks);
+}
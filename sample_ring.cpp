@@ -0,0 +1,314 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+// Each sample of the disk space (disk_space_thread.cpp) goes to a ring
+// file, "samples.ring" next to "dlg.dat", one per QIRX version. The file
+// has a fixed size: a SAMPLEHEADER and SAMPLE_RING_RECORDS records of 64
+// bytes (16 MiB, about a day at three nodes). It is mapped once at the
+// start, so a sample is a few stores into memory: nothing is allocated, no
+// system call, the system writes the pages back when it likes. The oldest
+// records are overwritten.
+//
+// A record is valid if its sequence number is the one expected at its
+// place. The writer clears it before writing the record and sets it after,
+// so a reader (another process, too) can tell a record being overwritten.
+//
+// "-samples" exports a window of the ring as CSV, for a look at a failed
+// recording afterwards, e.g.
+//   start /wait PathTweaker -samples from=2025-06-01T21:00 to=2025-06-01T23:00 node=raw > raw.csv
+// "-spacereplay trace=ring" runs them through the estimator once more,
+// see space_replay.cpp.
+
+#define SAMPLE_RING_VERSION 1
+#define SAMPLE_RING_RECORDS (256 * 1024)
+
+extern int ParseTiiDate(const char* p, int len, DWORD* pTime);
+extern int ParseTiiClock(const char* p, int len, DWORD* pSeconds);
+extern void CivilFromDays(int z, int* pY, int* pM, int* pD);
+
+struct SAMPLEHEADER {             // 64 bytes
+    char magic[4];                // "PTSR"
+    DWORD version;
+    DWORD recordSize;
+    DWORD numRecords;
+    volatile LONG64 numWritten;   // record n goes to n % numRecords
+    char szStation[16];           // "QIRX4"
+    BYTE reserved[24];
+};
+
+static struct SAMPLERING {
+    HANDLE hFile;
+    HANDLE hMapping;
+    SAMPLEHEADER* pHeader;
+    SAMPLERECORD* pRecords;
+} rings[STATION_MAX];
+
+static const char* nodeNames[4] = { "raw", "aud", "tii", "eti" };
+
+
+inline ULONGLONG SampleRingSize() {
+    return sizeof(SAMPLEHEADER) + (ULONGLONG)SAMPLE_RING_RECORDS * sizeof(SAMPLERECORD);
+}
+
+// Before the disk space timer starts. An old file of another layout starts
+// over.
+int OpenSampleRing() {
+    SAMPLERING* pRing = &rings[pPTM->station];
+    LARGE_INTEGER liSize;
+    int ret = 0;
+
+    if (!pPTM->haveDlgConfig)
+        return ret;
+    pRing->hFile = CreateFile(pPTM->szSampleRingFileName, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, 0,
+        OPEN_ALWAYS, 0, 0);
+    if (INVALID_HANDLE_VALUE == pRing->hFile)
+        return ret;
+
+    GetFileSizeEx(pRing->hFile, &liSize);
+    if ((ULONGLONG)liSize.QuadPart != SampleRingSize()) {
+        liSize.QuadPart = SampleRingSize();
+        if (!SetFilePointerEx(pRing->hFile, liSize, NULL, FILE_BEGIN) || !SetEndOfFile(pRing->hFile))
+            goto fail;
+    }
+    pRing->hMapping = CreateFileMapping(pRing->hFile, NULL, PAGE_READWRITE, 0, 0, NULL);
+    if (!pRing->hMapping)
+        goto fail;
+    pRing->pHeader = (SAMPLEHEADER*)MapViewOfFile(pRing->hMapping, FILE_MAP_WRITE, 0, 0, 0);
+    if (!pRing->pHeader)
+        goto fail;
+    pRing->pRecords = (SAMPLERECORD*)(pRing->pHeader + 1);
+
+    if (memcmp(pRing->pHeader->magic, "PTSR", 4) || SAMPLE_RING_VERSION != pRing->pHeader->version ||
+        sizeof(SAMPLERECORD) != pRing->pHeader->recordSize || SAMPLE_RING_RECORDS != pRing->pHeader->numRecords) {
+        memset(pRing->pHeader, 0, (SIZE_T)SampleRingSize());
+        memcpy(pRing->pHeader->magic, "PTSR", 4);
+        pRing->pHeader->version = SAMPLE_RING_VERSION;
+        pRing->pHeader->recordSize = sizeof(SAMPLERECORD);
+        pRing->pHeader->numRecords = SAMPLE_RING_RECORDS;
+    }
+    lstrcpyn(pRing->pHeader->szStation, pPTM->szQirxVersion, sizeof(pRing->pHeader->szStation));
+    ret++;
+    return ret;
+
+fail:
+    if (pRing->hMapping)
+        CloseHandle(pRing->hMapping);
+    CloseHandle(pRing->hFile);
+    memset(pRing, 0, sizeof(SAMPLERING));
+    return ret;
+}
+
+// On the worker of the station (DiskSpaceTick), the only writer
+void AppendSample(int node, const NODESPACE* pSpace, int external, const FILETIME* pTime) {
+    SAMPLERING* pRing = &rings[pPTM->station];
+    SAMPLERECORD* pRec;
+    LONG64 n;
+
+    if (!pRing->pHeader)
+        return;
+    n = pRing->pHeader->numWritten;
+    pRec = &pRing->pRecords[n % SAMPLE_RING_RECORDS];
+    pRec->sequence = 0;
+    MemoryBarrier();
+    pRec->time = ((ULONGLONG)pTime->dwHighDateTime << 32) | pTime->dwLowDateTime;
+    pRec->freeBytes = pSpace->freeBytes;
+    pRec->totalBytes = pSpace->totalBytes;
+    pRec->rate = pSpace->rate;
+    pRec->avgRate = pSpace->writeSpeed;
+    pRec->volumeSerial = pSpace->volumeSerial;
+    pRec->sampleMicros = pSpace->sampleMicros;
+    pRec->node = (BYTE)node;
+    pRec->flags = (BYTE)((external ? SAMPLE_EXTERNAL : 0) |
+        (pSpace->sampleMicros >= SPACE_STALL_MS * 1000 ? SAMPLE_STALL : 0));
+    MemoryBarrier();
+    pRec->sequence = n + 1;
+    pRing->pHeader->numWritten = n + 1;
+}
+
+// After the timers of the station are gone, see SchedRemoveStation()
+void CloseSampleRing() {
+    SAMPLERING* pRing = &rings[pPTM->station];
+
+    if (!pRing->pHeader)
+        return;
+    FlushViewOfFile(pRing->pHeader, 0);
+    UnmapViewOfFile(pRing->pHeader);
+    CloseHandle(pRing->hMapping);
+    CloseHandle(pRing->hFile);
+    memset(pRing, 0, sizeof(SAMPLERING));
+}
+
+
+// "from=" and "to=" are local times, the records have UTC
+int ParseSampleTime(const char* szArg, int endOfDay, ULONGLONG* pTime) {
+    SYSTEMTIME stLocal{}, stUtc;
+    FILETIME ft;
+    DWORD secs, clock;
+    int n, len, y, m, d;
+
+    len = lstrlen(szArg);
+    n = ParseTiiDate(szArg, len, &secs);
+    if (!n)
+        return 0;
+    if (ParseTiiClock(szArg + n, len - n, &clock))
+        secs += clock;
+    else if (endOfDay)
+        secs += 86399;
+    CivilFromDays(secs / 86400, &y, &m, &d);
+    stLocal.wYear = (WORD)y;
+    stLocal.wMonth = (WORD)m;
+    stLocal.wDay = (WORD)d;
+    stLocal.wHour = (WORD)(secs % 86400 / 3600);
+    stLocal.wMinute = (WORD)(secs % 3600 / 60);
+    stLocal.wSecond = (WORD)(secs % 60);
+    if (!TzSpecificLocalTimeToSystemTime(NULL, &stLocal, &stUtc) || !SystemTimeToFileTime(&stUtc, &ft))
+        return 0;
+    *pTime = ((ULONGLONG)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    if (endOfDay)
+        *pTime += 9999999; // the whole second
+    return 1;
+}
+
+void PrintSample(const SAMPLERECORD* pRec) {
+    SYSTEMTIME st;
+    FILETIME ft, ftLocal;
+
+    ft.dwLowDateTime = (DWORD)pRec->time;
+    ft.dwHighDateTime = (DWORD)(pRec->time >> 32);
+    FileTimeToLocalFileTime(&ft, &ftLocal);
+    FileTimeToSystemTime(&ftLocal, &st);
+    printf("%04u-%02u-%02u %02u:%02u:%02u.%03u,%s,%08lX,%llu,%llu,%.0f,%.0f,%.3f,%s,%s\n",
+        st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds,
+        nodeNames[pRec->node % 4], pRec->volumeSerial, pRec->freeBytes, pRec->totalBytes, pRec->rate,
+        pRec->avgRate, pRec->sampleMicros / 1000.0, pRec->flags & SAMPLE_EXTERNAL ? "ext" : "orig",
+        pRec->flags & SAMPLE_STALL ? "stall" : "");
+}
+
+struct SAMPLEFILTER {
+    ULONGLONG fromTime, toTime;
+    int node;
+};
+
+int PrintFilteredSample(const SAMPLERECORD* pRec, void* param) {
+    const SAMPLEFILTER* pFilter = (const SAMPLEFILTER*)param;
+
+    if (!pRec) {
+        printf("time,node,volume,free_bytes,total_bytes,rate,avg_rate,sample_ms,path,stall\n");
+        return 0;
+    }
+    if (pRec->time < pFilter->fromTime || pRec->time > pFilter->toTime ||
+        (pFilter->node >= 0 && pRec->node != pFilter->node))
+        return 0;
+    PrintSample(pRec);
+    return 1;
+}
+
+// The records of the ring file to pfn, the oldest first, see
+// PFNSAMPLEPROC. Another process may be writing it. Returns 0 if the file
+// isn't there or is no ring file.
+int WalkSampleRing(const char* szFile, PFNSAMPLEPROC pfn, void* param) {
+    const SAMPLEHEADER* pHeader;
+    const SAMPLERECORD* pRecords;
+    SAMPLERECORD rec;
+    LONG64 numWritten, first, numTaken = 0, numTorn = 0;
+    HANDLE hFile, hMapping;
+    LARGE_INTEGER liSize;
+    int ret = 0;
+
+    // the running dialog keeps on writing
+    hFile = CreateFile(szFile, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, 0, 0);
+    if (INVALID_HANDLE_VALUE == hFile) {
+        printf("%s: not found.\n", szFile);
+        return ret;
+    }
+    GetFileSizeEx(hFile, &liSize);
+    hMapping = (ULONGLONG)liSize.QuadPart >= sizeof(SAMPLEHEADER) ?
+        CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    pHeader = hMapping ? (const SAMPLEHEADER*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!pHeader || memcmp(pHeader->magic, "PTSR", 4) || sizeof(SAMPLERECORD) != pHeader->recordSize ||
+        !pHeader->numRecords || // the records are taken modulo numRecords
+        (ULONGLONG)liSize.QuadPart < sizeof(SAMPLEHEADER) + (ULONGLONG)pHeader->numRecords * sizeof(SAMPLERECORD)) {
+        printf("%s: not a ring file of PathTweaker.\n", szFile);
+        goto out;
+    }
+    pRecords = (const SAMPLERECORD*)(pHeader + 1);
+
+    pfn(NULL, param);
+    numWritten = pHeader->numWritten;
+    first = numWritten > pHeader->numRecords ? numWritten - pHeader->numRecords : 0;
+    for (LONG64 n = first; n < numWritten; n++) {
+        memcpy(&rec, (const void*)&pRecords[n % pHeader->numRecords], sizeof(rec));
+        MemoryBarrier();
+        if (rec.sequence != n + 1 || pRecords[n % pHeader->numRecords].sequence != n + 1) {
+            numTorn++; // overwritten meanwhile
+            continue;
+        }
+        numTaken += pfn(&rec, param);
+    }
+    fprintf(stderr, "%s (%s): %lld sample(s), %lld overwritten while reading.\n", szFile, pHeader->szStation,
+        numTaken, numTorn);
+    ret++;
+
+out:
+    if (pHeader)
+        UnmapViewOfFile(pHeader);
+    if (hMapping)
+        CloseHandle(hMapping);
+    CloseHandle(hFile);
+    return ret;
+}
+
+// -samples [from=...] [to=...] [node=...] [file=...]
+// Returns 0 for the usage.
+int CmdSamples(int argc, char** argv) {
+    const char* szFile = pPTM->szSampleRingFileName;
+    SAMPLEFILTER filter = { 0, ~0ull, -1 };
+
+    for (int i = 0; i < argc; i++) {
+        if (!_strnicmp(argv[i], "from=", 5)) {
+            if (!ParseSampleTime(argv[i] + 5, 0, &filter.fromTime))
+                return 0;
+        }
+        else if (!_strnicmp(argv[i], "to=", 3)) {
+            if (!ParseSampleTime(argv[i] + 3, 1, &filter.toTime))
+                return 0;
+        }
+        else if (!_strnicmp(argv[i], "node=", 5)) {
+            for (filter.node = 3; filter.node >= 0 && lstrcmpi(argv[i] + 5, nodeNames[filter.node]); filter.node--)
+                ;
+            if (filter.node < 0)
+                return 0;
+        }
+        else if (!_strnicmp(argv[i], "file=", 5))
+            szFile = argv[i] + 5;
+        else
+            return 0;
+    }
+    WalkSampleRing(szFile, PrintFilteredSample, &filter);
+    return 1;
+}
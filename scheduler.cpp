@@ -0,0 +1,409 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+// All the periodic and timed jobs of the dialog run from one timer wheel:
+// the blinking label, the disk space display, the folder rotation and the
+// path plans. The wheel has SCHED_SLOTS slots of SCHED_TICK_MS each, a
+// timer further away than one turn waits for some rounds in its slot.
+// Adding, removing and firing a timer costs the same, whatever the number
+// of timers.
+//
+// The callbacks run on the SchedulerThread, one after the other. They
+// must be short, whatever touches the dialog or QIRX's config-file is
+// posted to the dialog. A timer is known by its id, a removed timer never
+// fires again, even if it was due already.
+//
+// A timer from SchedAddIo() may wait for the drives: the wheel only wakes
+// the worker of the station, which runs the callback. A drive which hangs
+// keeps this worker, not the wheel and the other stations. While the
+// worker is busy, the next ticks of its timers are dropped.
+//
+// With "-stations" all the stations share the wheel. Each timer keeps the
+// station which added it, and its callback runs with the pPTM of that one.
+//
+// GetTickCount64() goes on during sleep and hibernation. A few late ticks
+// are caught up one by one, after a longer gap the wheel moves on at once
+// and each timer due in it fires once only, not once per tick missed.
+
+#define SCHED_TICK_MS    100
+#define SCHED_SLOTS      512    // one turn: 51.2 s
+#define SCHED_LATE_TICKS 5      // caught up one by one
+
+extern HANDLE CreateEngineThread(LPTHREAD_START_ROUTINE pfnThread, LPVOID param);
+extern void DaemonLog(const char* szFormat, ...);
+
+struct SCHEDTIMER {
+    PFNSCHEDPROC pfn;
+    void* param;
+    DWORD periodTicks;        // 0: once
+    DWORD rounds;             // turns of the wheel still to wait
+    int next;                 // in the slot
+    int linked;               // in a slot
+    int active;               // 0: removed or done, free when not linked
+    int onWorker;             // from SchedAddIo()
+    int queued;               // the worker is still to run it
+    PATHTWEAKERMEM* pMem;     // the station which added it
+};
+
+struct SCHEDWORKER {
+    HANDLE hThread;
+    HANDLE hWake;
+    volatile int finish;
+};
+
+static SCHEDTIMER timers[SCHED_MAX_TIMERS];
+static int slots[SCHED_SLOTS];
+static ULONGLONG curTick;     // the next tick to process
+static CRITICAL_SECTION csSched;
+static HANDLE hSchedThread;
+static volatile int schedFinish;
+static PATHTWEAKERMEM* volatile pRunningMem; // of the callback running
+static SCHEDWORKER workers[STATION_MAX];
+
+
+// Puts the timer into the slot it is due in, lock held
+void SchedInsert(int id, DWORD ticks) {
+    ULONGLONG due;
+
+    if (!ticks)
+        ticks = 1;
+    due = curTick + ticks - 1;
+    timers[id].rounds = (DWORD)((due - curTick) / SCHED_SLOTS);
+    timers[id].next = slots[due % SCHED_SLOTS];
+    timers[id].linked = 1;
+    slots[due % SCHED_SLOTS] = id;
+}
+
+// A removed or finished timer which is in no slot and not waiting for
+// the worker can be used again
+void SchedFreeIfDone(int id) {
+    if (!timers[id].active && !timers[id].linked && !timers[id].queued)
+        timers[id].pfn = NULL;
+}
+
+// Runs the queued timers of its station, each time it is woken up. The
+// last round only takes the removed timers off the queue.
+DWORD WINAPI SchedWorkerThread(LPVOID param) {
+    SCHEDWORKER* pWorker = (SCHEDWORKER*)param;
+    PFNSCHEDPROC pfn;
+    void* pParam;
+    int last = 0;
+
+    while (!last) {
+        WaitForSingleObject(pWorker->hWake, INFINITE);
+        last = pWorker->finish;
+        for (int id = 0; id < SCHED_MAX_TIMERS; id++) {
+            EnterCriticalSection(&csSched);
+            if (!timers[id].queued || timers[id].pMem != pPTM) {
+                LeaveCriticalSection(&csSched);
+                continue;
+            }
+            pfn = timers[id].active ? timers[id].pfn : NULL;
+            pParam = timers[id].param;
+            LeaveCriticalSection(&csSched);
+
+            if (pfn)
+                pfn(pParam);
+
+            EnterCriticalSection(&csSched);
+            if (!timers[id].periodTicks)
+                timers[id].active = 0;
+            timers[id].queued = 0;
+            SchedFreeIfDone(id);
+            LeaveCriticalSection(&csSched);
+        }
+    }
+    return 0;
+}
+
+// The worker of the station of the caller, started with its first timer
+int StartSchedWorker() {
+    SCHEDWORKER* pWorker = &workers[pPTM->station];
+    int ret = 0;
+
+    if (pWorker->hThread)
+        return 1;
+    pWorker->finish = 0;
+    if (!pWorker->hWake)
+        pWorker->hWake = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (pWorker->hWake)
+        pWorker->hThread = CreateEngineThread(SchedWorkerThread, pWorker);
+    if (pWorker->hThread)
+        ret++;
+    return ret;
+}
+
+// Ends the worker of the station of the caller, its timers are removed
+// already. A worker waiting for a hung drive goes on, with its event, the
+// station isn't used again until it is back, see CreateEngineThread().
+// Returns 0 then.
+int StopSchedWorker() {
+    SCHEDWORKER* pWorker = &workers[pPTM->station];
+    int ret = 0;
+
+    if (!pWorker->hThread)
+        return 1;
+    pWorker->finish = 1;
+    SetEvent(pWorker->hWake);
+    if (WaitForSingleObject(pWorker->hThread, 5000) == WAIT_OBJECT_0) {
+        CloseHandle(pWorker->hWake);
+        pWorker->hWake = NULL;
+        ret++;
+    }
+    else
+        DaemonLog("the disk timers of the station still wait for a drive");
+    CloseHandle(pWorker->hThread);
+    pWorker->hThread = NULL;
+    return ret;
+}
+
+// Calls pfn(param) after dueMs, then every periodMs (0: once). Returns the
+// id of the timer or SCHED_NONE if all are in use.
+int SchedAdd(PFNSCHEDPROC pfn, void* param, DWORD dueMs, DWORD periodMs) {
+    int id;
+
+    EnterCriticalSection(&csSched);
+    for (id = 0; id < SCHED_MAX_TIMERS; id++)
+        if (!timers[id].pfn)
+            break;
+    if (id < SCHED_MAX_TIMERS) {
+        timers[id].pfn = pfn;
+        timers[id].param = param;
+        timers[id].periodTicks = (periodMs + SCHED_TICK_MS - 1) / SCHED_TICK_MS;
+        timers[id].active = 1;
+        timers[id].onWorker = 0;
+        timers[id].queued = 0;
+        timers[id].pMem = pPTM;
+        SchedInsert(id, (dueMs + SCHED_TICK_MS - 1) / SCHED_TICK_MS);
+    }
+    else
+        id = SCHED_NONE;
+    LeaveCriticalSection(&csSched);
+    return id;
+}
+
+// Like SchedAdd(), for a callback with disk I/O. It runs on the worker of
+// the station, the wheel goes on meanwhile.
+int SchedAddIo(PFNSCHEDPROC pfn, void* param, DWORD dueMs, DWORD periodMs) {
+    int id;
+
+    if (!StartSchedWorker())
+        return SCHED_NONE;
+    EnterCriticalSection(&csSched);
+    id = SchedAdd(pfn, param, dueMs, periodMs);
+    if (id != SCHED_NONE)
+        timers[id].onWorker = 1;
+    LeaveCriticalSection(&csSched);
+    return id;
+}
+
+// The slot entry goes away when its slot comes round next time. Forget
+// the id afterwards, it will be given to another timer.
+void SchedRemove(int id) {
+    if (id < 0 || id >= SCHED_MAX_TIMERS)
+        return;
+    EnterCriticalSection(&csSched);
+    timers[id].active = 0;
+    SchedFreeIfDone(id);
+    LeaveCriticalSection(&csSched);
+}
+
+// Removes all the timers of the station of the caller and waits for a
+// callback of it which is running, on the wheel and on the worker.
+// Returns 0 if the worker still waits for a drive.
+int SchedRemoveStation() {
+    int running;
+
+    if (!hSchedThread)
+        return 1;
+    EnterCriticalSection(&csSched);
+    for (int id = 0; id < SCHED_MAX_TIMERS; id++) {
+        if (timers[id].pfn && timers[id].pMem == pPTM) {
+            timers[id].active = 0;
+            SchedFreeIfDone(id);
+        }
+    }
+    LeaveCriticalSection(&csSched);
+
+    do {
+        EnterCriticalSection(&csSched);
+        running = pRunningMem == pPTM;
+        LeaveCriticalSection(&csSched);
+        if (running)
+            Sleep(10);
+    } while (running);
+    return StopSchedWorker();
+}
+
+// Moves the wheel on by skipped ticks without firing them, lock held. A
+// timer due in between is due at the next tick, the later ones keep their
+// distance to now.
+void SchedSkip(ULONGLONG skipped) {
+    static int ids[SCHED_MAX_TIMERS];
+    static ULONGLONG left[SCHED_MAX_TIMERS];
+    int id, num = 0;
+    ULONGLONG slotTick;
+
+    for (int s = 0; s < SCHED_SLOTS; s++) {
+        slotTick = (s - curTick % SCHED_SLOTS + SCHED_SLOTS) % SCHED_SLOTS;
+        for (id = slots[s]; id != SCHED_NONE; id = timers[id].next) {
+            timers[id].linked = 0;
+            if (!timers[id].active) {
+                SchedFreeIfDone(id);
+                continue;
+            }
+            ids[num] = id;
+            left[num++] = slotTick + (ULONGLONG)timers[id].rounds * SCHED_SLOTS;
+        }
+        slots[s] = SCHED_NONE;
+    }
+    curTick += skipped;
+    for (int i = 0; i < num; i++)
+        SchedInsert(ids[i], left[i] > skipped ? (DWORD)(left[i] - skipped + 1) : 1);
+}
+
+// Takes the due timers out of the slot of curTick, lock held. Returns them
+// as a list, linked by next.
+int SchedCollectDue() {
+    int* pLink, id, due = SCHED_NONE, *pDueTail = &due;
+
+    pLink = &slots[curTick % SCHED_SLOTS];
+    while ((id = *pLink) != SCHED_NONE) {
+        if (!timers[id].active) {
+            *pLink = timers[id].next;
+            timers[id].linked = 0;
+            SchedFreeIfDone(id);
+            continue;
+        }
+        if (timers[id].rounds) {
+            timers[id].rounds--;
+            pLink = &timers[id].next;
+            continue;
+        }
+        *pLink = timers[id].next; // stays linked in the due list
+        timers[id].next = SCHED_NONE;
+        *pDueTail = id;
+        pDueTail = &timers[id].next;
+    }
+    return due;
+}
+
+DWORD WINAPI SchedulerThread(LPVOID param) {
+    ULONGLONG nextTime, now, skipped;
+    PFNSCHEDPROC pfn;
+    void* pParam;
+    PATHTWEAKERMEM* pMem;
+    int id, next;
+
+    nextTime = GetTickCount64();
+    while (!schedFinish) {
+        now = GetTickCount64();
+        if (now < nextTime) {
+            Sleep((DWORD)(nextTime - now));
+            continue;
+        }
+        // back from sleep: the ticks missed don't fire one after the other
+        skipped = (now - nextTime) / SCHED_TICK_MS;
+        if (skipped > SCHED_LATE_TICKS) {
+            EnterCriticalSection(&csSched);
+            SchedSkip(skipped);
+            LeaveCriticalSection(&csSched);
+            nextTime = now;
+        }
+        nextTime += SCHED_TICK_MS; // a late tick is caught up at once
+
+        EnterCriticalSection(&csSched);
+        id = SchedCollectDue();
+        curTick++;
+        LeaveCriticalSection(&csSched);
+
+        for (; id != SCHED_NONE && !schedFinish; id = next) {
+            EnterCriticalSection(&csSched);
+            next = timers[id].next;
+            timers[id].linked = 0;
+            pfn = timers[id].active ? timers[id].pfn : NULL;
+            pParam = timers[id].param;
+            pMem = timers[id].pMem;
+            if (pfn && timers[id].onWorker) {
+                if (!timers[id].queued) { // else the worker is still busy
+                    timers[id].queued = 1;
+                    SetEvent(workers[pMem->station].hWake);
+                }
+                pfn = NULL;
+            }
+            if (pfn)
+                pRunningMem = pMem;
+            if (!timers[id].active)
+                SchedFreeIfDone(id);
+            else if (timers[id].periodTicks)
+                SchedInsert(id, timers[id].periodTicks);
+            else if (!timers[id].onWorker) // done by the worker
+                timers[id].active = 0;
+            LeaveCriticalSection(&csSched);
+
+            if (pfn) {
+                pPTM = pMem;
+                pfn(pParam);
+            }
+
+            // a one-shot timer is done now
+            EnterCriticalSection(&csSched);
+            if (pfn)
+                SchedFreeIfDone(id);
+            pRunningMem = NULL;
+            LeaveCriticalSection(&csSched);
+        }
+    }
+    return 0;
+}
+
+int StartScheduler() {
+    int ret = 0;
+
+    InitializeCriticalSection(&csSched);
+    for (int i = 0; i < SCHED_SLOTS; i++)
+        slots[i] = SCHED_NONE;
+    schedFinish = 0;
+    hSchedThread = CreateThread(NULL, 0, SchedulerThread, NULL, 0, NULL);
+    if (hSchedThread)
+        ret++;
+    return ret;
+}
+
+void StopScheduler() {
+    if (!hSchedThread)
+        return;
+    schedFinish = 1;
+    WaitForSingleObject(hSchedThread, 5000);
+    CloseHandle(hSchedThread);
+    hSchedThread = NULL;
+    for (int i = 0; i < STATION_MAX; i++)
+        if (workers[i].hWake) // a worker still waiting for a drive
+            return;
+    DeleteCriticalSection(&csSched);
+}
@@ -0,0 +1,178 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+// The disk space display runs on a worker thread and needs the node
+// and the current paths the dialog has just set. The dialog publishes them
+// as a SPACESNAPSHOT behind a sequence lock: the counter is odd while the
+// dialog writes, a reader copies the snapshot and tries again if the
+// counter was odd or has changed meanwhile. The reader never waits for
+// the dialog and never sees half a path, the dialog never waits at all.
+// There is one writer only per lock. The tick publishes what it found
+// (SPACESTATUS) the same way.
+//
+// "-snapstress [seconds]" hammers a lock with switches from one thread
+// while some others read, and checks each snapshot read.
+
+#define SNAP_STRESS_READERS 3
+
+extern HANDLE CreateEngineThread(LPTHREAD_START_ROUTINE pfnThread, LPVOID param);
+
+// pShared is the data behind pSequence, e.g. &pLock->snap
+void SeqPublish(volatile LONG* pSequence, void* pShared, const void* pData, DWORD size) {
+    InterlockedIncrement(pSequence); // odd: writing
+    memcpy(pShared, pData, size);
+    InterlockedIncrement(pSequence); // even: done, full barriers both
+}
+
+// Returns the number of retries
+DWORD SeqRead(volatile LONG* pSequence, const void* pShared, void* pData, DWORD size) {
+    LONG before, after;
+    DWORD retries = 0;
+
+    for (;;) {
+        before = *pSequence;
+        MemoryBarrier();
+        if (!(before & 1)) {
+            memcpy(pData, pShared, size);
+            MemoryBarrier();
+            after = *pSequence;
+            if (before == after)
+                return retries;
+        }
+        retries++;
+        YieldProcessor();
+    }
+}
+
+
+struct SNAPSTRESS {
+    SPACESEQLOCK lock;
+    volatile int finish;
+    volatile LONG64 reads;
+    volatile LONG64 retries;
+    volatile LONG64 torn;
+    volatile LONG64 backwards; // an older generation after a newer one
+};
+
+// A snapshot is right if the node, the generation and each character of
+// the paths agree
+int CheckStressSnapshot(const SPACESNAPSHOT* pSnap) {
+    char c;
+    int len;
+
+    if (pSnap->node != (int)(pSnap->generation % 4))
+        return 0;
+    for (int node = 0; node < 4; node++) {
+        c = (char)('A' + (pSnap->generation + node) % 26);
+        len = 16 + (pSnap->generation + node) % 200;
+        if (lstrlen(pSnap->szPaths[node]) != len)
+            return 0;
+        for (int i = 0; i < len; i++)
+            if (pSnap->szPaths[node][i] != c)
+                return 0;
+    }
+    return 1;
+}
+
+DWORD WINAPI SnapStressReader(LPVOID param) {
+    SNAPSTRESS* pStress = (SNAPSTRESS*)param;
+    SPACESNAPSHOT snap;
+    DWORD lastGeneration = 0, retries;
+    LONG64 reads = 0, sumRetries = 0, torn = 0, backwards = 0;
+
+    while (!pStress->finish) {
+        retries = SeqRead(&pStress->lock.sequence, &pStress->lock.snap, &snap, sizeof(snap));
+        reads++;
+        sumRetries += retries;
+        if (!CheckStressSnapshot(&snap))
+            torn++;
+        if (snap.generation < lastGeneration)
+            backwards++;
+        lastGeneration = snap.generation;
+    }
+    InterlockedAdd64(&pStress->reads, reads);
+    InterlockedAdd64(&pStress->retries, sumRetries);
+    InterlockedAdd64(&pStress->torn, torn);
+    InterlockedAdd64(&pStress->backwards, backwards);
+    return 0;
+}
+
+void SnapshotStress(int seconds) {
+    SNAPSTRESS* pStress;
+    SPACESNAPSHOT snap;
+    HANDLE hThreads[SNAP_STRESS_READERS];
+    ULONGLONG endTime;
+    DWORD numThreads = 0, writes = 0;
+    int len;
+
+    if (seconds < 1)
+        seconds = 1;
+    pStress = (SNAPSTRESS*)VCALLOC(sizeof(SNAPSTRESS));
+    if (!pStress) {
+        printf("Not enough memory.\n");
+        return;
+    }
+
+    memset(&snap, 0, sizeof(snap));
+    for (int node = 0; node < 4; node++)
+        memset(snap.szPaths[node], 'A' + node, 16 + node);
+    SeqPublish(&pStress->lock.sequence, &pStress->lock.snap, &snap, sizeof(snap));
+
+    for (int i = 0; i < SNAP_STRESS_READERS; i++) {
+        hThreads[numThreads] = CreateEngineThread(SnapStressReader, pStress);
+        if (hThreads[numThreads])
+            numThreads++;
+    }
+
+    // the dialog, switching as fast as it can
+    endTime = GetTickCount64() + seconds * 1000ull;
+    while (GetTickCount64() < endTime) {
+        for (int i = 0; i < 1000; i++) {
+            writes++;
+            snap.generation = writes;
+            snap.node = writes % 4;
+            for (int node = 0; node < 4; node++) {
+                len = 16 + (writes + node) % 200;
+                memset(snap.szPaths[node], 'A' + (writes + node) % 26, len);
+                snap.szPaths[node][len] = 0;
+            }
+            SeqPublish(&pStress->lock.sequence, &pStress->lock.snap, &snap, sizeof(snap));
+        }
+    }
+    pStress->finish = 1;
+    WaitForMultipleObjects(numThreads, hThreads, TRUE, INFINITE);
+    for (DWORD i = 0; i < numThreads; i++)
+        CloseHandle(hThreads[i]);
+
+    printf("%d s, %lu switches, %lu readers\n", seconds, writes, numThreads);
+    printf("%lld snapshots read, %.3f retries per read\n", pStress->reads,
+        pStress->reads ? (double)pStress->retries / pStress->reads : 0.0);
+    printf("%lld torn, %lld out of order: %s\n", pStress->torn, pStress->backwards,
+        pStress->torn || pStress->backwards ? "FAILED" : "ok");
+    VFREE(pStress);
+}
@@ -0,0 +1,448 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+#include <math.h>
+
+extern int SampleNode(NODESAMPLER* pNs, const SPACEINPUT* pIn, int node, const char* szPath, NODESPACE* pSpace);
+extern int InitNodeSampler(NODESAMPLER* pNs, const LARGE_INTEGER* pNow);
+extern void FreeNodeSampler(NODESAMPLER* pNs);
+extern double MinWriteSpeed(int node);
+extern int WalkSampleRing(const char* szFile, PFNSAMPLEPROC pfn, void* param);
+
+// "-spacereplay" runs the estimator of the disk space display (SampleNode()
+// in disk_space_thread.cpp) on traces instead of the drives. Its clock,
+// the free space and the serial number come from the trace, nothing waits
+// for a real second: an hour of recording passes in 3.6 s at "speed=1000"
+// (the default), as fast as it goes with "speed=0". The same trace gives
+// the same numbers each time.
+//
+// The synthetic traces are a steady raw recording, one in bursts, one
+// where 50 GB are deleted while recording, one which switches to another
+// drive and back, and a steady eti recording. The timer wheel is late or
+// early by up to 20 ms, the free space goes in clusters. After the
+// averages had the time to fill (REPLAY_WARMUP, from the start and from
+// each delete or switch), the write speed shown must be within a bound of
+// the true one, the time left within a bound of free / max(true speed,
+// MinWriteSpeed()). The write speed is an average of a minute, so with
+// bursts it is off by a quarter in between.
+//
+// "trace=ring" replays the samples of "samples.ring" (sample_ring.cpp),
+// node by node: the write speed must come out as it was recorded. A gap of
+// more than a minute starts the estimator anew, as after a restart of the
+// dialog, a new drive or the external path start it over as in the
+// dialog. A new folder on the same drive can't be told from the samples.
+//
+// Last, the estimator alone is timed for "bench=" samples.
+//   start /wait PathTweaker -spacereplay speed=0 > replay.csv
+
+#define REPLAY_SETTLE      1    // a delete or a switch, the averages start over
+#define REPLAY_RESTART     2    // a new estimator, as at the start of the dialog
+#define REPLAY_WARMUP      (SPACE_AVG_INTERVAL * (SPACE_AVG_SPEEDS + 2)) // s
+#define REPLAY_RING_WARMUP (SPACE_AVG_INTERVAL * (SPACE_AVG_DISPLAY + 1))
+#define REPLAY_RING_GAP    60   // s without a sample: the dialog was restarted
+#define REPLAY_MAX_SAMPLES (256 * 1024) // as many as the ring file holds
+#define REPLAY_TICKS       10'000'000 // 100 ns, as FILETIME
+
+struct REPLAYSAMPLE {
+    LONGLONG time;            // 100 ns since the start of the trace
+    ULONGLONG freeBytes;
+    ULONGLONG totalBytes;
+    double speed;             // the true (or recorded) write speed
+    DWORD volumeSerial;
+    DWORD sampleMicros;       // the query takes
+    int path;                 // a new one is a switch
+    int flags;                // REPLAY_...
+};
+
+struct REPLAYTRACE {
+    char szName[32];
+    int node;
+    REPLAYSAMPLE* pSamples;
+    int numSamples;
+    int warmup;               // s after the start and each REPLAY_SETTLE
+    double speedBound;        // relative errors allowed
+    double remBound;          // < 0: the time left isn't checked
+};
+
+struct REPLAYCASE {
+    const char* szName;
+    int node;
+    int seconds;
+    double rate;              // bytes per second
+    double burstRate;         // within a burst
+    int burstPeriod;          // s, 0: no bursts
+    int burstLength;
+    int eventAt;              // s, the delete or the switch
+    int eventEnd;             // s, the switch back, 0: a delete
+    double deleteBytes;
+    double speedBound;
+    double remBound;
+};
+
+static const REPLAYCASE replayCases[] = {
+    { "steady", NODE_RAW, 7200, 8e6, 0.0, 0, 0, 0, 0, 0.0, 0.01, 0.01 },
+    { "burst", NODE_RAW, 7200, 8e6, 40e6, 120, 10, 0, 0, 0.0, 0.30, 0.06 },
+    { "delete", NODE_RAW, 3600, 8e6, 0.0, 0, 0, 1800, 0, 50e9, 0.01, 0.01 },
+    { "switch", NODE_RAW, 5400, 8e6, 0.0, 0, 0, 1800, 3600, 0.0, 0.01, 0.01 },
+    { "eti", NODE_ETI, 7200, 256'000.0, 0.0, 0, 0, 0, 0, 0.0, 0.01, 0.01 },
+};
+#define REPLAY_CASES ((int)(sizeof(replayCases) / sizeof(replayCases[0])))
+
+// The sample SampleNode() is looking at
+struct REPLAYSTATE {
+    const REPLAYSAMPLE* pSample;
+    int queried;
+};
+
+static const char* nodeNames[4] = { "raw", "aud", "tii", "eti" };
+
+
+// Before and after the query, as far apart as the query took
+void ReplayClock(void* param, LARGE_INTEGER* pNow) {
+    const REPLAYSTATE* pState = (const REPLAYSTATE*)param;
+
+    pNow->QuadPart = pState->pSample->time;
+    if (pState->queried)
+        pNow->QuadPart += pState->pSample->sampleMicros * 10ll;
+}
+
+BOOL ReplayQuery(void* param, const char* szPath, ULARGE_INTEGER* pFree, ULARGE_INTEGER* pTotal) {
+    REPLAYSTATE* pState = (REPLAYSTATE*)param;
+
+    pState->queried = 1;
+    pFree->QuadPart = pState->pSample->freeBytes;
+    pTotal->QuadPart = pState->pSample->totalBytes;
+    return TRUE;
+}
+
+DWORD ReplaySerial(void* param, char* szPath) {
+    return ((const REPLAYSTATE*)param)->pSample->volumeSerial;
+}
+
+// Bytes written from 0 up to t seconds
+double ReplayWritten(const REPLAYCASE* pCase, double t) {
+    double bursts;
+
+    if (!pCase->burstPeriod)
+        return pCase->rate * t;
+    bursts = floor(t / pCase->burstPeriod) * pCase->burstLength +
+        fmin(fmod(t, pCase->burstPeriod), (double)pCase->burstLength);
+    return pCase->rate * t + (pCase->burstRate - pCase->rate) * bursts;
+}
+
+// pSamples has room for pCase->seconds + 1. Returns the number of samples.
+int MakeReplayTrace(const REPLAYCASE* pCase, REPLAYSAMPLE* pSamples) {
+    const ULONGLONG totalBytes[2] = { 500'000'000'000, 1'000'000'000'000 };
+    const DWORD volumeSerials[2] = { 0x1A2B3C4D, 0x5E6F7081 };
+    double freeBytes[2] = { 200e9, 900e9 }, written, lastWritten = 0.0, meanRate = pCase->rate;
+    unsigned int seed = 0x5EED;
+    int path, lastPath = 0;
+
+    if (pCase->burstPeriod)
+        meanRate += (pCase->burstRate - pCase->rate) * pCase->burstLength / pCase->burstPeriod;
+
+    for (int s = 0; s <= pCase->seconds; s++) {
+        REPLAYSAMPLE* pS = &pSamples[s];
+
+        seed = seed * 1103515245 + 12345;
+        pS->time = s * (LONGLONG)REPLAY_TICKS + ((LONGLONG)((seed >> 16) % 401) - 200) * 1000;
+        if (pS->time < 0)
+            pS->time = 0;
+        written = ReplayWritten(pCase, (double)pS->time / REPLAY_TICKS);
+        path = pCase->eventEnd && s >= pCase->eventAt && s < pCase->eventEnd ? 1 : 0;
+        freeBytes[lastPath] -= written - lastWritten;
+        lastWritten = written;
+        pS->flags = s ? 0 : REPLAY_RESTART;
+        if (path != lastPath)
+            pS->flags |= REPLAY_SETTLE;
+        if (pCase->deleteBytes > 0.0 && s == pCase->eventAt) {
+            freeBytes[path] += pCase->deleteBytes;
+            pS->flags |= REPLAY_SETTLE;
+        }
+        lastPath = path;
+
+        pS->path = path;
+        pS->freeBytes = (ULONGLONG)freeBytes[path] & ~4095ull; // clusters
+        pS->totalBytes = totalBytes[path];
+        pS->volumeSerial = volumeSerials[path];
+        pS->sampleMicros = 40;
+        pS->speed = meanRate;
+    }
+    return pCase->seconds + 1;
+}
+
+// The trace through an estimator of its own, paced to speed times real
+// time. Prints its CSV line, returns 1 if it stayed within the bounds.
+int ReplayTrace(const REPLAYTRACE* pTrace, int speed) {
+    const REPLAYSAMPLE* pS;
+    REPLAYSTATE state{};
+    SPACEINPUT input;
+    NODESAMPLER sampler{};
+    NODESPACE space;
+    LARGE_INTEGER qpf, liStart, liNow, liInit;
+    char szPath[32], szRem[64];
+    double minSpeed = MinWriteSpeed(pTrace->node), err, truth, ahead, hours;
+    double speedErrSum = 0.0, speedErrMax = 0.0, remErrSum = 0.0, remErrMax = 0.0;
+    LONGLONG settledAt = 0;
+    int numChecked = 0, numBad = 0, ok;
+
+    input.tickPeriod = 1.0 / REPLAY_TICKS;
+    input.pfnClock = ReplayClock;
+    input.pfnQuery = ReplayQuery;
+    input.pfnSerial = ReplaySerial;
+    input.param = &state;
+    QueryPerformanceFrequency(&qpf);
+    QueryPerformanceCounter(&liStart);
+
+    for (int i = 0; i < pTrace->numSamples; i++) {
+        pS = &pTrace->pSamples[i];
+        if (speed) {
+            QueryPerformanceCounter(&liNow);
+            ahead = (double)(pS->time - pTrace->pSamples[0].time) / REPLAY_TICKS / speed -
+                (double)(liNow.QuadPart - liStart.QuadPart) / qpf.QuadPart;
+            if (ahead > 0.002)
+                Sleep((DWORD)(ahead * 1000.0));
+        }
+        if (pS->flags & REPLAY_RESTART) {
+            FreeNodeSampler(&sampler);
+            liInit.QuadPart = pS->time - REPLAY_TICKS / 100; // as StartDiskSpaceTimer(), just before the tick
+            if (!InitNodeSampler(&sampler, &liInit))
+                break;
+        }
+        if (pS->flags)
+            settledAt = pS->time;
+
+        state.pSample = pS;
+        state.queried = 0;
+        sprintf(szPath, "replay\\%d", pS->path);
+        SampleNode(&sampler, &input, pTrace->node, szPath, &space);
+        if (space.volumeSerial != pS->volumeSerial || !(space.writeSpeed >= 0.0)) {
+            numBad++;
+            continue;
+        }
+        if (pS->time - settledAt < (LONGLONG)pTrace->warmup * REPLAY_TICKS)
+            continue;
+
+        err = fabs(space.writeSpeed - pS->speed) / fmax(pS->speed, minSpeed);
+        speedErrSum += err;
+        speedErrMax = fmax(speedErrMax, err);
+        if (pTrace->remBound >= 0.0) {
+            truth = (double)pS->freeBytes / fmax(pS->speed, minSpeed);
+            err = fabs((double)space.remSeconds - truth) / truth;
+            remErrSum += err;
+            remErrMax = fmax(remErrMax, err);
+        }
+        numChecked++;
+    }
+    QueryPerformanceCounter(&liNow);
+    FreeNodeSampler(&sampler);
+
+    ok = !numBad && speedErrMax <= pTrace->speedBound && (pTrace->remBound < 0.0 || remErrMax <= pTrace->remBound);
+    if (pTrace->remBound >= 0.0)
+        sprintf(szRem, "%.3f,%.3f,%.1f", numChecked ? remErrSum * 100.0 / numChecked : 0.0, remErrMax * 100.0,
+            pTrace->remBound * 100.0);
+    else
+        lstrcpy(szRem, "-,-,-");
+    hours = pTrace->numSamples ?
+        (double)(pTrace->pSamples[pTrace->numSamples - 1].time - pTrace->pSamples[0].time) / REPLAY_TICKS / 3600.0 : 0.0;
+    printf("%s,%s,%d,%.2f,%.3f,%.3f,%.1f,%s,%d,%.0f,%s\n", pTrace->szName, nodeNames[pTrace->node],
+        pTrace->numSamples, hours, numChecked ? speedErrSum * 100.0 / numChecked : 0.0, speedErrMax * 100.0,
+        pTrace->speedBound * 100.0, szRem, numBad, (double)(liNow.QuadPart - liStart.QuadPart) * 1000.0 / qpf.QuadPart,
+        ok ? "ok" : "FAIL");
+    fflush(stdout);
+    return ok;
+}
+
+// The records of "samples.ring", all nodes
+struct REPLAYRING {
+    SAMPLERECORD* pRecords;
+    int numRecords;
+};
+
+int TakeReplayRecord(const SAMPLERECORD* pRec, void* param) {
+    REPLAYRING* pRing = (REPLAYRING*)param;
+
+    if (!pRec || pRing->numRecords == REPLAY_MAX_SAMPLES)
+        return 0;
+    pRing->pRecords[pRing->numRecords++] = *pRec;
+    return 1;
+}
+
+// The samples of a node from the ring. The estimator starts where it had
+// measured the speed (the shown one changed), so it measures in step with
+// the recorded one. Returns the number of samples.
+int MakeRingTrace(const REPLAYRING* pRing, int node, REPLAYSAMPLE* pSamples) {
+    const SAMPLERECORD* pRec, * pLast = NULL;
+    LONGLONG firstTime = 0;
+    DWORD serial = 0;
+    int num = 0, path = 0, external = 0, restart = 1;
+
+    for (int i = 0; i < pRing->numRecords; i++) {
+        pRec = &pRing->pRecords[i];
+        if (pRec->node != node)
+            continue;
+        if (pLast && pRec->time - pLast->time > (ULONGLONG)REPLAY_RING_GAP * REPLAY_TICKS)
+            restart = 1;
+        if (restart && !(pLast && pRec->avgRate != pLast->avgRate)) {
+            pLast = pRec; // wait for a measurement
+            continue;
+        }
+        if (!num)
+            firstTime = (LONGLONG)pRec->time;
+        if (restart || pRec->volumeSerial != serial || (pRec->flags & SAMPLE_EXTERNAL) != external)
+            path++;
+        pSamples[num].time = (LONGLONG)pRec->time - firstTime;
+        pSamples[num].freeBytes = pRec->freeBytes;
+        pSamples[num].totalBytes = pRec->totalBytes;
+        pSamples[num].speed = pRec->avgRate;
+        pSamples[num].volumeSerial = pRec->volumeSerial;
+        pSamples[num].sampleMicros = pRec->sampleMicros;
+        pSamples[num].path = path;
+        pSamples[num].flags = restart ? REPLAY_RESTART : 0;
+        num++;
+        serial = pRec->volumeSerial;
+        external = pRec->flags & SAMPLE_EXTERNAL;
+        restart = 0;
+        pLast = pRec;
+    }
+    return num;
+}
+
+// The estimator alone: a steady raw recording of numSamples seconds
+void SpaceEstimatorBenchmark(int numSamples) {
+    REPLAYSAMPLE sample{};
+    REPLAYSTATE state{};
+    SPACEINPUT input;
+    NODESAMPLER sampler;
+    NODESPACE space;
+    LARGE_INTEGER qpf, liStart, liEnd;
+    double seconds;
+
+    input.tickPeriod = 1.0 / REPLAY_TICKS;
+    input.pfnClock = ReplayClock;
+    input.pfnQuery = ReplayQuery;
+    input.pfnSerial = ReplaySerial;
+    input.param = &state;
+    state.pSample = &sample;
+    sample.freeBytes = 1'000'000'000'000;
+    sample.totalBytes = 2'000'000'000'000;
+    sample.volumeSerial = 0x1A2B3C4D;
+    sample.sampleMicros = 40;
+    liStart.QuadPart = 0;
+    if (!InitNodeSampler(&sampler, &liStart))
+        return;
+
+    QueryPerformanceFrequency(&qpf);
+    QueryPerformanceCounter(&liStart);
+    for (int i = 0; i < numSamples; i++) {
+        sample.time += REPLAY_TICKS;
+        sample.freeBytes -= 8'000'000;
+        state.queried = 0;
+        SampleNode(&sampler, &input, NODE_RAW, "bench", &space);
+    }
+    QueryPerformanceCounter(&liEnd);
+    FreeNodeSampler(&sampler);
+
+    seconds = (double)(liEnd.QuadPart - liStart.QuadPart) / qpf.QuadPart;
+    printf("\nestimator,samples,ms,ns_per_sample,samples_per_s\n");
+    printf("SampleNode,%d,%.1f,%.1f,%.0f\n", numSamples, seconds * 1000.0,
+        numSamples ? seconds * 1e9 / numSamples : 0.0, seconds > 0.0 ? numSamples / seconds : 0.0);
+}
+
+// -spacereplay [trace=...] [speed=n] [file=name] [bench=n]
+// Returns 0 for the usage.
+int CmdSpaceReplay(int argc, char** argv) {
+    const char* szFile = pPTM->szSampleRingFileName;
+    const char* szTrace = NULL; // all
+    REPLAYTRACE trace;
+    REPLAYRING ring{};
+    int speed = 1000, benchSamples = 1'000'000, fileGiven = 0, numTraces = 0, numOk = 0;
+
+    for (int i = 0; i < argc; i++) {
+        if (!_strnicmp(argv[i], "trace=", 6))
+            szTrace = argv[i] + 6;
+        else if (!_strnicmp(argv[i], "speed=", 6))
+            speed = atoi(argv[i] + 6);
+        else if (!_strnicmp(argv[i], "file=", 5)) {
+            szFile = argv[i] + 5;
+            fileGiven = 1;
+        }
+        else if (!_strnicmp(argv[i], "bench=", 6))
+            benchSamples = atoi(argv[i] + 6);
+        else
+            return 0;
+    }
+    if (speed < 0 || benchSamples < 0)
+        return 0;
+
+    trace.pSamples = (REPLAYSAMPLE*)VCALLOC(REPLAY_MAX_SAMPLES * sizeof(REPLAYSAMPLE));
+    if (!trace.pSamples)
+        return 1;
+    printf("trace,node,samples,hours,speed_err_mean_pct,speed_err_max_pct,speed_bound_pct,"
+        "rem_err_mean_pct,rem_err_max_pct,rem_bound_pct,bad,replay_ms,result\n");
+
+    for (int c = 0; c < REPLAY_CASES; c++) {
+        if (szTrace && lstrcmpi(szTrace, replayCases[c].szName))
+            continue;
+        lstrcpyn(trace.szName, replayCases[c].szName, sizeof(trace.szName));
+        trace.node = replayCases[c].node;
+        trace.numSamples = MakeReplayTrace(&replayCases[c], trace.pSamples);
+        trace.warmup = REPLAY_WARMUP;
+        trace.speedBound = replayCases[c].speedBound;
+        trace.remBound = replayCases[c].remBound;
+        numOk += ReplayTrace(&trace, speed);
+        numTraces++;
+    }
+
+    // the ring file if asked for or if there is one
+    if ((szTrace && !lstrcmpi(szTrace, "ring")) ||
+        (!szTrace && (fileGiven || INVALID_FILE_ATTRIBUTES != GetFileAttributes(szFile)))) {
+        ring.pRecords = (SAMPLERECORD*)VCALLOC(REPLAY_MAX_SAMPLES * sizeof(SAMPLERECORD));
+        if (ring.pRecords && WalkSampleRing(szFile, TakeReplayRecord, &ring)) {
+            for (int node = 0; node < 4; node++) {
+                trace.numSamples = MakeRingTrace(&ring, node, trace.pSamples);
+                if (!trace.numSamples)
+                    continue;
+                lstrcpy(trace.szName, "ring");
+                trace.node = node;
+                trace.warmup = REPLAY_RING_WARMUP;
+                trace.speedBound = 0.02; // the clock of the dialog was QPC, ours is the time of the tick
+                trace.remBound = -1.0;
+                numOk += ReplayTrace(&trace, speed);
+                numTraces++;
+            }
+        }
+        if (ring.pRecords)
+            VFREE(ring.pRecords);
+    }
+    VFREE(trace.pSamples);
+
+    if (!szTrace && benchSamples)
+        SpaceEstimatorBenchmark(benchSamples);
+    fprintf(stderr, "%d of %d trace(s) within the bounds.\n", numOk, numTraces);
+    return 1;
+}
@@ -0,0 +1,300 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+// A long recording on a nearly full (or fragmented) drive gets slow while
+// the file system searches for free clusters, and it may run out of space.
+// If "options.ini" asks for it, the ReserveThread puts a placeholder of
+// some GB ("PathTweaker.raw.reserve" etc.) into the external path of a
+// node, while this path is the current one. Each node has its own, two
+// nodes may share a folder. The space is allocated in one piece, so the
+// file system hands out a contiguous run where it can.
+//
+// The placeholder is deleted again, and its space is free for QIRX:
+//   - when a file is made or written in the folder of the node (QIRX
+//     starts to record there)
+//   - when something else writes to the drive at RESERVE_WRITE_RATE or
+//     more
+//   - when the free space outside of the placeholder runs low
+//   - when the path is not the current one any more, and at the end
+// After a minute without writes it is made again.
+//
+// We don't keep the placeholder open, an open file would block the safe
+// removal of the drive. NTFS, exFAT and ReFS extend a file without writing
+// zeros (valid data length), FAT would write them, so we skip FAT drives.
+
+#define RESERVE_POLL_MS     2000
+#define RESERVE_MIN_FREE    (1024ull * 1024 * 1024) // released below this
+#define RESERVE_WRITE_RATE  100'000.0   // bytes/s of writes elsewhere on the drive
+#define RESERVE_QUIET_S     60          // no writes this long, make it again
+#define RESERVE_GB          (1024ull * 1024 * 1024)
+
+extern DWORD SeqRead(volatile LONG* pSequence, const void* pShared, void* pData, DWORD size);
+
+struct RESERVATION {
+    char szFolder[MAX_PATH_BUFFER_SIZE]; // the current path we look after
+    char szFileName[MAX_PATH_BUFFER_SIZE];
+    volatile ULONGLONG bytes; // 0: none, read by DiskSpaceTick()
+    ULONGLONG lastFree;
+    FILETIME ftNewest;        // of the files in szFolder
+    int quietSeconds;
+};
+
+static RESERVATION reservations[STATION_MAX][4]; // per station and node
+static const char* nodeNames[4] = { "raw", "aud", "tii", "eti" };
+
+
+// The placeholders and probes (prewarm.cpp) of all the nodes
+int IsPathTweakerFile(const char* szName) {
+    char szOwn[64];
+
+    if (!lstrcmpi(szName, szOldReserveFile))
+        return 1;
+    for (int node = 0; node < 4; node++) {
+        sprintf(szOwn, szReserveFile, nodeNames[node]);
+        if (!lstrcmpi(szName, szOwn))
+            return 1;
+        sprintf(szOwn, szProbeFile, nodeNames[node]);
+        if (!lstrcmpi(szName, szOwn))
+            return 1;
+    }
+    return 0;
+}
+
+// Returns 1 if a file other than ours was made or written in the folder
+// since the last call. An audio recording writes too slowly to show up in
+// the free space, but its file shows up here at once.
+int FolderWritten(RESERVATION* pRes) {
+    char szPattern[MAX_PATH_BUFFER_SIZE + 8];
+    WIN32_FIND_DATA fd;
+    HANDLE hFind;
+    FILETIME ftNewest = pRes->ftNewest;
+    int ret = 0;
+
+    sprintf(szPattern, "%s%s*", pRes->szFolder, pRes->szFolder[lstrlen(pRes->szFolder) - 1] == '\\' ? "" : "\\");
+    hFind = FindFirstFile(szPattern, &fd);
+    if (INVALID_HANDLE_VALUE == hFind)
+        return ret;
+    do {
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY || IsPathTweakerFile(fd.cFileName))
+            continue;
+        if (CompareFileTime(&fd.ftCreationTime, &ftNewest) > 0)
+            ftNewest = fd.ftCreationTime;
+        if (CompareFileTime(&fd.ftLastWriteTime, &ftNewest) > 0)
+            ftNewest = fd.ftLastWriteTime;
+    } while (FindNextFile(hFind, &fd));
+    FindClose(hFind);
+
+    if (CompareFileTime(&ftNewest, &pRes->ftNewest) > 0) {
+        pRes->ftNewest = ftNewest;
+        ret++;
+    }
+    return ret;
+}
+
+// Bytes we hold on the drive of szPath, DiskSpaceTick() adds them to
+// the free space. The placeholders of the other stations count, too.
+ULONGLONG GetReservedBytes(const char* szPath) {
+    const RESERVATION* pRes;
+    ULONGLONG sum = 0;
+
+    for (int i = 0; i < STATION_MAX * 4; i++) {
+        pRes = &reservations[i / 4][i % 4];
+        if (pRes->bytes && (pRes->szFileName[0] | 0x20) == (szPath[0] | 0x20))
+            sum += pRes->bytes;
+    }
+    return sum;
+}
+
+// The placeholder goes into the current path, if this is our external path
+// (or its dated subfolder) on a drive which is online. Returns the folder
+// in the snapshot or NULL.
+const char* GetReserveFolder(const SPACESNAPSHOT* pSnap, int node) {
+    if (NODE_TII == node) // the TII logs are small
+        return NULL;
+    return pSnap->online[node] && pSnap->external[node] ? pSnap->szPaths[node] : NULL;
+}
+
+int GetReserveGB(int node) {
+    return NODE_RAW == node ? pPTM->opt.reserveRawGB : NODE_AUD == node ? pPTM->opt.reserveAudGB :
+        NODE_ETI == node ? pPTM->opt.reserveEtiGB : 0;
+}
+
+ULONGLONG GetFreeBytes(const char* szPath) {
+    ULARGE_INTEGER ullFreeToCaller, ullDisk, ullFree;
+
+    if (!GetDiskFreeSpaceEx(szPath, &ullFreeToCaller, &ullDisk, &ullFree))
+        return 0;
+    return ullFreeToCaller.QuadPart;
+}
+
+// NTFS, exFAT and ReFS know a valid data length, see above
+int CanReserve(const char* szFolder) {
+    char szRoot[MAX_PATH_BUFFER_SIZE], szFs[16];
+
+    if (!GetVolumePathName(szFolder, szRoot, MAX_PATH_BUFFER_SIZE) ||
+        !GetVolumeInformation(szRoot, NULL, 0, NULL, NULL, NULL, szFs, sizeof(szFs)))
+        return 0;
+    return !lstrcmpi(szFs, "NTFS") || !lstrcmpi(szFs, "exFAT") || !lstrcmpi(szFs, "ReFS");
+}
+
+void ReleaseReservation(RESERVATION* pRes) {
+    if (pRes->szFileName[0]) {
+        DeleteFile(pRes->szFileName);
+        pRes->bytes = 0;
+        pRes->szFileName[0] = 0;
+    }
+    pRes->quietSeconds = 0;
+}
+
+// Allocates the whole size at once, then sets the end of the file there,
+// so the space stays taken without an open handle
+int MakeReservation(RESERVATION* pRes, int node, const char* szFolder, ULONGLONG bytes) {
+    FILE_ALLOCATION_INFO alloc;
+    FILE_END_OF_FILE_INFO eof;
+    LARGE_INTEGER liSize;
+    HANDLE hFile;
+    int ret = 0;
+
+    // the shared placeholder of older versions goes, nobody counts it
+    sprintf(pRes->szFileName, "%s%s%s", szFolder, szFolder[lstrlen(szFolder) - 1] == '\\' ? "" : "\\",
+        szOldReserveFile);
+    DeleteFile(pRes->szFileName);
+
+    sprintf(pRes->szFileName, "%s%s", szFolder, szFolder[lstrlen(szFolder) - 1] == '\\' ? "" : "\\");
+    sprintf(pRes->szFileName + lstrlen(pRes->szFileName), szReserveFile, nodeNames[node]);
+
+    // one left from the last run (or a removed drive) is taken over
+    hFile = CreateFile(pRes->szFileName, GENERIC_WRITE, 0, 0, OPEN_ALWAYS,
+        FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_NOT_CONTENT_INDEXED, 0);
+    if (INVALID_HANDLE_VALUE == hFile) {
+        pRes->szFileName[0] = 0;
+        return ret;
+    }
+
+    GetFileSizeEx(hFile, &liSize);
+    if ((ULONGLONG)liSize.QuadPart == bytes)
+        ret++;
+    else if (GetFreeBytes(szFolder) + liSize.QuadPart >= bytes + RESERVE_MIN_FREE) {
+        pRes->bytes = bytes; // before the space is gone, see GetReservedBytes()
+        alloc.AllocationSize.QuadPart = bytes;
+        eof.EndOfFile.QuadPart = bytes;
+        if (SetFileInformationByHandle(hFile, FileAllocationInfo, &alloc, sizeof(alloc)) &&
+            SetFileInformationByHandle(hFile, FileEndOfFileInfo, &eof, sizeof(eof)))
+            ret++;
+    }
+    CloseHandle(hFile);
+
+    if (ret)
+        pRes->bytes = bytes;
+    else {
+        DeleteFile(pRes->szFileName);
+        pRes->bytes = 0;
+        pRes->szFileName[0] = 0;
+    }
+    return ret;
+}
+
+
+DWORD WINAPI ReserveThread(LPVOID param) {
+    SPACESNAPSHOT snap;
+    RESERVATION* pRes;
+    const char* pFolder;
+    ULONGLONG freeBytes, bytes;
+    int changed, written;
+
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+
+    while (!pPTM->finishThread) {
+        Sleep(RESERVE_POLL_MS);
+        changed = 0;
+        SeqRead(&pPTM->spaceSnap.sequence, &pPTM->spaceSnap.snap, &snap, sizeof(snap));
+
+        for (int node = 0; node < 4; node++) {
+            pRes = &reservations[pPTM->station][node];
+            pFolder = GetReserveFolder(&snap, node);
+            bytes = GetReserveGB(node) * RESERVE_GB;
+
+            if (!pFolder || !bytes) {
+                if (pRes->szFileName[0]) {
+                    ReleaseReservation(pRes);
+                    changed++;
+                }
+                pRes->szFolder[0] = 0;
+                continue;
+            }
+
+            // a new current path gets its placeholder at once
+            if (lstrcmpi(pRes->szFolder, pFolder)) {
+                if (pRes->szFileName[0]) {
+                    ReleaseReservation(pRes);
+                    changed++;
+                }
+                lstrcpyn(pRes->szFolder, pFolder, MAX_PATH_BUFFER_SIZE);
+                pRes->quietSeconds = RESERVE_QUIET_S;
+                pRes->lastFree = GetFreeBytes(pFolder);
+                memset(&pRes->ftNewest, 0, sizeof(FILETIME));
+                FolderWritten(pRes); // what is there already
+            }
+
+            freeBytes = GetFreeBytes(pFolder);
+            written = FolderWritten(pRes) ||
+                pRes->lastFree > freeBytes + RESERVE_WRITE_RATE * RESERVE_POLL_MS / 1000;
+            if (pRes->szFileName[0]) {
+                // somebody writes or the space runs out: make room
+                if (written || freeBytes < RESERVE_MIN_FREE) {
+                    ReleaseReservation(pRes);
+                    changed++;
+                }
+            }
+            else {
+                if (written)
+                    pRes->quietSeconds = 0;
+                else if (pRes->quietSeconds < RESERVE_QUIET_S)
+                    pRes->quietSeconds += RESERVE_POLL_MS / 1000;
+
+                if (pRes->quietSeconds >= RESERVE_QUIET_S && CanReserve(pFolder) &&
+                    MakeReservation(pRes, node, pFolder, bytes))
+                    changed++;
+            }
+            pRes->lastFree = freeBytes;
+        }
+
+        // our own changes are no writes of somebody else
+        if (changed) {
+            for (int node = 0; node < 4; node++) {
+                pRes = &reservations[pPTM->station][node];
+                if (pRes->szFolder[0])
+                    pRes->lastFree = GetFreeBytes(pRes->szFolder);
+            }
+        }
+    }
+
+    for (int node = 0; node < 4; node++)
+        ReleaseReservation(&reservations[pPTM->station][node]);
+    return 0;
+}
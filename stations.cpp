@@ -0,0 +1,316 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+// "-stations" runs all the QIRX versions of the user in one process. Each
+// QIRX found in "%LOCALAPPDATA%" (a folder "qirxN" with "qirxN.config" in
+// it) is a station with its own paths, drives, plans and options: its own
+// PATHTWEAKERMEM and its own slot in the state of the modules, by
+// pPTM->station. A station runs the window of the daemon (daemon.cpp) on
+// a thread of its own, with its own message loop. The timer wheel
+// (scheduler.cpp) and the drive letters are shared. A station which ends
+// is started again, but not more than once per STATION_RESTART_MS, and
+// not before all the threads of its last run have ended: a thread stuck on
+// a hung drive still uses the memory and the slots of the station. A
+// station with its dialog open is left alone.
+//
+// The drive letters are looked at here, once for all stations. A change
+// goes to all stations at the same time, and each one takes it for its own
+// config. "-stations stop" ends the stations. What happens goes to
+// "stations.txt" in "%LOCALAPPDATA%\PathTweaker", what a station does goes
+// to its "daemon.txt".
+
+#define STATION_SCAN_MS    2000
+#define STATION_STOP_MS    10000
+#define STATION_RESTART_MS 60000
+
+extern int IsQirxVersionArg(const char* szArg);
+extern void DaemonLog(const char* szFormat, ...);
+extern void DaemonStartError(const char* szMsg);
+extern HWND CreateDaemonWindow(HINSTANCE hInstance);
+extern void CollectPaths();
+extern void ReadOptionsFile();
+extern int  ReadDlgConfigFile();
+extern int StartScheduler();
+extern void StopScheduler();
+extern void StopEngine();
+
+struct STATION {
+    char szVersion[8];        // "qirx4"
+    char szTitle[32];         // of its dialog and its daemon window
+    PATHTWEAKERMEM* pMem;     // its pPTM
+    HANDLE hThread;           // running the station
+    ULONGLONG lastStart;
+    int dialogOpen;
+    int threadsLeft;          // of the last run, logged
+};
+
+static STATION stations[STATION_MAX];
+static int numStations;
+static HANDLE hStopEvent;
+
+
+// Each "qirxN" folder with a config-file
+int FindStations() {
+    char szPattern[MAX_PATH_BUFFER_SIZE], szConfig[MAX_PATH_BUFFER_SIZE + 32], szVersion[8];
+    WIN32_FIND_DATA fd;
+    HANDLE hFind;
+    STATION* pSt;
+
+    sprintf(szPattern, "%s\\qirx?", pPTM->szLocalAppDataBasePath);
+    hFind = FindFirstFile(szPattern, &fd);
+    if (INVALID_HANDLE_VALUE == hFind)
+        return numStations;
+    do {
+        if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !IsQirxVersionArg(fd.cFileName))
+            continue;
+        sprintf(szConfig, "%s\\%s\\%s%s", pPTM->szLocalAppDataBasePath, fd.cFileName, fd.cFileName,
+            szQirxConfigExt);
+        if (INVALID_FILE_ATTRIBUTES == GetFileAttributes(szConfig))
+            continue;
+
+        pSt = &stations[numStations++];
+        lstrcpyn(pSt->szVersion, fd.cFileName, sizeof(pSt->szVersion));
+        lstrcpyn(szVersion, fd.cFileName, sizeof(szVersion));
+        _strupr_s(szVersion, sizeof(szVersion));
+        sprintf(pSt->szTitle, "%s (%s)", szAppName, szVersion); // as in WinMain
+    } while (numStations < STATION_MAX && FindNextFile(hFind, &fd));
+    FindClose(hFind);
+    return numStations;
+}
+
+// WinMain for one station, without the dialog
+DWORD WINAPI StationThread(LPVOID param) {
+    STATION* pSt = (STATION*)param;
+    MSG msg;
+    HWND hWnd;
+    BOOL retval;
+    DWORD ret = 0;
+
+    pPTM = pSt->pMem;
+    CollectPaths();
+    ReadOptionsFile();
+    if (!pPTM->haveQirxConfig) {
+        DaemonStartError(szMsgNotFound);
+        return 3;
+    }
+    _strupr_s(pPTM->szQirxVersion, 16);
+    sprintf(pPTM->szMyWindowTitle, "%s (%s)", szAppName, pPTM->szQirxVersion);
+
+    pPTM->mDlgSet.transparency = 255;
+    pPTM->mDlgSet.topMost = 1;
+    ReadDlgConfigFile();
+    CopyFile(pPTM->szQirxFullConfigFileName, pPTM->szQirxFullConfigBackupFileName, 0);
+
+    hWnd = CreateDaemonWindow(GetModuleHandle(NULL));
+    if (!hWnd)
+        ret = 1;
+    else {
+        // "-stations stop" may have missed the window being created
+        if (WAIT_OBJECT_0 == WaitForSingleObject(hStopEvent, 0))
+            PostMessage(hWnd, WM_CLOSE, 0, 0);
+        while ((retval = GetMessage(&msg, 0, 0, 0)) != 0) {
+            if (retval == -1) {
+                ret = 2;
+                break;
+            }
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+    }
+    StopEngine();
+    return ret;
+}
+
+int StartStation(STATION* pSt, int station) {
+    int ret = 0;
+
+    if (!pSt->pMem)
+        pSt->pMem = (PATHTWEAKERMEM*)VCALLOC(sizeof(PATHTWEAKERMEM));
+    if (!pSt->pMem)
+        return ret;
+    memset(pSt->pMem, 0, sizeof(PATHTWEAKERMEM)); // a restart starts over
+    pSt->pMem->station = station;
+    pSt->pMem->headless = HEADLESS_STATION;
+    lstrcpyn(pSt->pMem->szQirxVersion, pSt->szVersion, 16);
+    pSt->hThread = CreateThread(NULL, 0, StationThread, pSt, 0, NULL);
+    if (pSt->hThread)
+        ret++;
+    return ret;
+}
+
+// Once per STATION_SCAN_MS
+void LookAfterStation(int station, DWORD driveMask, int drivesChanged) {
+    STATION* pSt = &stations[station];
+    DWORD exitCode;
+
+    if (pSt->hThread) {
+        if (WAIT_TIMEOUT == WaitForSingleObject(pSt->hThread, 0)) {
+            if (drivesChanged && pSt->pMem->hWndDialog)
+                PostMessage(pSt->pMem->hWndDialog, PTMSG_DRIVES_CHANGED, driveMask, 0);
+            return;
+        }
+        GetExitCodeThread(pSt->hThread, &exitCode);
+        DaemonLog("%s  the station ended (%lu)", pSt->szVersion, exitCode);
+        CloseHandle(pSt->hThread);
+        pSt->hThread = NULL;
+    }
+
+    if (pSt->pMem && pSt->pMem->numEngineThreads) {
+        if (!pSt->threadsLeft)
+            DaemonLog("%s  %ld thread(s) of the station still running, no restart", pSt->szVersion,
+                pSt->pMem->numEngineThreads);
+        pSt->threadsLeft = 1;
+        return;
+    }
+    pSt->threadsLeft = 0;
+
+    if (FindWindow(NULL, pSt->szTitle)) {
+        if (!pSt->dialogOpen)
+            DaemonLog("%s  the dialog or a daemon is open, the station waits", pSt->szVersion);
+        pSt->dialogOpen = 1;
+        return;
+    }
+    pSt->dialogOpen = 0;
+
+    if (pSt->lastStart && GetTickCount64() - pSt->lastStart < STATION_RESTART_MS)
+        return;
+    pSt->lastStart = GetTickCount64();
+    if (StartStation(pSt, station))
+        DaemonLog("%s  station started", pSt->szVersion);
+    else
+        DaemonLog("%s  the station didn't start (%lu)", pSt->szVersion, GetLastError());
+}
+
+// Closes the windows of the stations and waits for their threads. The
+// memory of a station which doesn't end in time, or whose engine threads
+// don't, stays.
+void StopStations() {
+    HANDLE hThreads[STATION_MAX];
+    DWORD numThreads = 0;
+
+    for (int i = 0; i < numStations; i++) {
+        if (!stations[i].hThread)
+            continue;
+        if (stations[i].pMem->hWndDialog)
+            PostMessage(stations[i].pMem->hWndDialog, WM_CLOSE, 0, 0);
+        hThreads[numThreads++] = stations[i].hThread;
+    }
+    if (numThreads)
+        WaitForMultipleObjects(numThreads, hThreads, TRUE, STATION_STOP_MS);
+
+    for (int i = 0; i < numStations; i++) {
+        if (stations[i].hThread) {
+            if (WAIT_TIMEOUT == WaitForSingleObject(stations[i].hThread, 0)) {
+                DaemonLog("%s  the station doesn't end", stations[i].szVersion);
+                CloseHandle(stations[i].hThread);
+                continue;
+            }
+            CloseHandle(stations[i].hThread);
+        }
+        if (stations[i].pMem && stations[i].pMem->numEngineThreads) {
+            DaemonLog("%s  %ld thread(s) of the station don't end", stations[i].szVersion,
+                stations[i].pMem->numEngineThreads);
+            continue;
+        }
+        if (stations[i].pMem)
+            VFREE(stations[i].pMem);
+    }
+}
+
+// -stations [stop]
+void CmdStations(const char* szArg) {
+    char szFolder[MAX_PATH_BUFFER_SIZE];
+    DWORD driveMask, mask;
+    HANDLE hStop;
+
+    if (szArg && !lstrcmpi(szArg, "stop")) {
+        hStop = OpenEvent(EVENT_MODIFY_STATE, FALSE, szStationsEvent);
+        if (!hStop) {
+            printf("No stations are running.\n");
+            return;
+        }
+        SetEvent(hStop);
+        CloseHandle(hStop);
+        printf("The stations stop, the recording paths are set back to QIRX's own ones.\n");
+        return;
+    }
+    if (szArg) {
+        printf("%s", szMsgUsage);
+        return;
+    }
+    if (!pPTM->haveAppDataBasePath) {
+        printf("LOCALAPPDATA not found.\n");
+        return;
+    }
+
+    hStop = CreateEvent(NULL, TRUE, FALSE, szStationsEvent);
+    if (!hStop)
+        return;
+    if (ERROR_ALREADY_EXISTS == GetLastError()) {
+        printf("The stations are running already.\n");
+        CloseHandle(hStop);
+        return;
+    }
+
+    sprintf(szFolder, "%s\\%s", pPTM->szLocalAppDataBasePath, szAppName);
+    CreateDirectory(szFolder, NULL);
+    sprintf(pPTM->szDaemonLogFileName, "%s\\%s", szFolder, szStationsLogFile);
+
+    if (!FindStations()) {
+        printf("No config-file of QIRX found in %s.\n", pPTM->szLocalAppDataBasePath);
+        CloseHandle(hStop);
+        return;
+    }
+    if (!StartScheduler()) {
+        CloseHandle(hStop);
+        return;
+    }
+    hStopEvent = hStop;
+    DaemonLog("started");
+    for (int i = 0; i < numStations; i++) {
+        printf("%s\n", stations[i].szVersion);
+        DaemonLog("%s  found", stations[i].szVersion);
+    }
+    printf("%d station(s). \"PathTweaker -stations stop\" ends them.\n", numStations);
+    fflush(stdout);
+
+    driveMask = GetLogicalDrives();
+    for (int i = 0; i < numStations; i++)
+        LookAfterStation(i, driveMask, 0);
+    while (WAIT_TIMEOUT == WaitForSingleObject(hStop, STATION_SCAN_MS)) {
+        mask = GetLogicalDrives();
+        for (int i = 0; i < numStations; i++)
+            LookAfterStation(i, mask, mask != driveMask);
+        driveMask = mask;
+    }
+
+    StopStations();
+    StopScheduler();
+    DaemonLog("stopped");
+    CloseHandle(hStop);
+}
@@ -0,0 +1,1124 @@
+/*
+* This file is part of
+*
+* PathTweaker, a small tool for tweaking the recording paths of QIRX-SDR
+*
+*
+* This program is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2 of the License, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+* Place - Suite 330, Boston, MA 02111-1307, USA and it is distributed under the
+* GNU General Public License (GPL).
+*
+*
+* (c) 2024-25 Heiko Vogel <hevog@gmx.de>
+*
+*/
+
+#include "PathTweaker.h"
+
+// The TII-Logger writes text files, one line per transmitter seen. We
+// collect these lines in one columnar store, "tii.tcs" next to "dlg.dat",
+// and answer range and group-by queries from there.
+//
+// The text lines are split in place, nothing is allocated per line. The
+// columns are found by the names in the header line of a log file (date,
+// time, frequency or channel, EId, main, sub or TII, level), separated by
+// ';', tab or ','. Without a header line we expect
+//     date time; frequency; EId; main; sub; level
+//
+// For each log file, "tii.tcs.src" keeps how far we have read it. Only
+// complete lines are taken, so the file currently written by QIRX can be
+// read again and again ("tailed") without parsing a line twice.
+//
+// The store is a TIISTOREHEADER followed by blocks of up to 4096 rows.
+// Each block starts with a TIIBLOCKHEADER (row count, time and frequency
+// range), followed by the columns one after another. Queries skip blocks
+// outside the wanted time and frequency range without reading the columns.
+
+#define TII_BLOCK_ROWS      4096
+#define TII_STORE_VERSION   1
+#define TII_READ_BUFFER     (1024 * 1024)
+#define TII_MAX_FIELDS      32
+#define TII_NO_LEVEL        -32768    // the log has no level column
+#define TII_MAX_SOURCES     4096
+#define TII_HEAD_MAX        256       // of the first line, tells a new log
+
+#define TII_COL_DATE        0
+#define TII_COL_TIME        1
+#define TII_COL_FREQ        2
+#define TII_COL_CHANNEL     3
+#define TII_COL_EID         4
+#define TII_COL_MAIN        5
+#define TII_COL_SUB         6
+#define TII_COL_TII         7         // main and sub in one field
+#define TII_COL_LEVEL       8
+#define TII_NUM_COLS        9
+
+#define TII_GROUP_NONE      0
+#define TII_GROUP_TX        1         // EId, main and sub
+#define TII_GROUP_EID       2
+#define TII_GROUP_FREQ      3
+#define TII_GROUP_DAY       4
+
+extern int ForEachRecording(const char* szFolder, const char* szExt, PFNRECORDINGPROC pfnRecording,
+    volatile int* pCancel);
+
+
+struct TIISTOREHEADER {
+    char magic[4];            // "TIIC"
+    DWORD version;
+    DWORD numBlocks;
+    DWORD reserved;
+    ULONGLONG numRows;
+    ULONGLONG lastBlockOffset; // 0: no blocks yet
+};
+
+struct TIIBLOCKHEADER {
+    DWORD numRows;
+    DWORD minTime;            // seconds since 1970, local time of the logger
+    DWORD maxTime;
+    DWORD minFreq;            // kHz
+    DWORD maxFreq;
+    DWORD reserved;
+};
+
+// One block in memory. On disk only numRows entries of each column.
+struct TIIBLOCK {
+    TIIBLOCKHEADER hdr;
+    DWORD time[TII_BLOCK_ROWS];
+    DWORD freq[TII_BLOCK_ROWS];
+    WORD eid[TII_BLOCK_ROWS];
+    BYTE mainId[TII_BLOCK_ROWS];
+    BYTE subId[TII_BLOCK_ROWS];
+    short level[TII_BLOCK_ROWS]; // 0.1 dB
+};
+
+// How far a log file was read, and its column layout
+struct TIISOURCE {
+    char szFileName[MAX_PATH_BUFFER_SIZE];
+    ULONGLONG offset;         // behind the last complete line taken
+    DWORD headHash;           // of the first line, a new file with the same name starts over
+    signed char col[TII_NUM_COLS]; // field index or -1
+    char separator;
+    BYTE haveLayout;
+    BYTE z_reserved[5];
+};
+
+struct TIIFIELD {
+    const char* p;
+    int len;
+};
+
+struct TIIINGEST {
+    HANDLE hStore;
+    TIISTOREHEADER hdr;
+    TIIBLOCK* pBlock;
+    ULONGLONG blockOffset;    // where pBlock goes
+    TIISOURCE* pSources;
+    DWORD numSources;
+    char* pReadBuf;
+    DWORD newRows;
+    int failed;
+};
+
+struct TIIQUERY {
+    DWORD fromTime, toTime;
+    DWORD freq;               // 0: any
+    int eid, mainId, subId;   // -1: any
+    int groupBy;
+    int limit;
+};
+
+struct TIIGROUP {
+    ULONGLONG key;            // 0: empty slot, so the keys start at 1
+    DWORD count;
+    DWORD first, last;
+    int sumLevel;             // 0.1 dB, for the average
+    DWORD numLevels;
+    short minLevel, maxLevel;
+};
+
+
+// Band III channels in kHz, for logs with channel names instead of frequencies
+static const struct { char name[4]; DWORD kHz; } tiiChannels[] = {
+    {"5A", 174928}, {"5B", 176640}, {"5C", 178352}, {"5D", 180064},
+    {"6A", 181936}, {"6B", 183648}, {"6C", 185360}, {"6D", 187072},
+    {"7A", 188928}, {"7B", 190640}, {"7C", 192352}, {"7D", 194064},
+    {"8A", 195936}, {"8B", 197648}, {"8C", 199360}, {"8D", 201072},
+    {"9A", 202928}, {"9B", 204640}, {"9C", 206352}, {"9D", 208064},
+    {"10A", 209936}, {"10N", 210096}, {"10B", 211648}, {"10C", 213360}, {"10D", 215072},
+    {"11A", 216928}, {"11N", 217088}, {"11B", 218640}, {"11C", 220352}, {"11D", 222064},
+    {"12A", 223936}, {"12N", 224096}, {"12B", 225648}, {"12C", 227360}, {"12D", 229072},
+    {"13A", 230784}, {"13B", 232496}, {"13C", 234208}, {"13D", 235776}, {"13E", 237488},
+    {"13F", 239200} };
+
+
+// Days since 1970-01-01 of a date (proleptic Gregorian) and the way back
+int DaysFromCivil(int y, int m, int d) {
+    int era, yoe, doy, doe;
+
+    y -= m <= 2;
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = y - era * 400;
+    doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+void CivilFromDays(int z, int* pY, int* pM, int* pD) {
+    int era, doe, yoe, doy, mp;
+
+    z += 719468;
+    era = (z >= 0 ? z : z - 146096) / 146097;
+    doe = z - era * 146097;
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp = (5 * doy + 2) / 153;
+    *pD = doy - (153 * mp + 2) / 5 + 1;
+    *pM = mp < 10 ? mp + 3 : mp - 9;
+    *pY = yoe + era * 400 + (*pM <= 2);
+}
+
+void FormatTiiTime(DWORD t, char* buff) {
+    int y, m, d;
+
+    CivilFromDays(t / 86400, &y, &m, &d);
+    t %= 86400;
+    sprintf(buff, "%04d-%02d-%02d %02lu:%02lu:%02lu", y, m, d, t / 3600, t / 60 % 60, t % 60);
+}
+
+
+// The small parsers work on a field (pointer and length), without copying
+inline int ParseUInt(const char** pp, const char* pEnd, int maxDigits, int* pVal) {
+    const char* p = *pp;
+    int v = 0, n = 0;
+
+    while (p < pEnd && *p >= '0' && *p <= '9' && n < maxDigits) {
+        v = v * 10 + (*p++ - '0');
+        n++;
+    }
+    *pp = p;
+    *pVal = v;
+    return n;
+}
+
+// "2024-05-17", "2024/05/17" or "17.05.2024", optionally followed by the time
+int ParseTiiDate(const char* p, int len, DWORD* pTime) {
+    const char* pEnd = p + len;
+    int a, b, c, n;
+
+    while (p < pEnd && *p == ' ')
+        p++;
+    n = ParseUInt(&p, pEnd, 4, &a);
+    if (!n || p >= pEnd || (*p != '-' && *p != '/' && *p != '.'))
+        return 0;
+    p++;
+    if (!ParseUInt(&p, pEnd, 2, &b) || p >= pEnd || (*p != '-' && *p != '/' && *p != '.'))
+        return 0;
+    p++;
+    if (!ParseUInt(&p, pEnd, 4, &c))
+        return 0;
+    if (n != 4) { // day first
+        n = a;
+        a = c;
+        c = n;
+    }
+    if (b < 1 || b > 12 || c < 1 || c > 31 || a < 1970)
+        return 0;
+    *pTime = (DWORD)DaysFromCivil(a, b, c) * 86400;
+    return (int)(p - (pEnd - len));
+}
+
+// "13:45" or "13:45:07", fractions are ignored
+int ParseTiiClock(const char* p, int len, DWORD* pSeconds) {
+    const char* pEnd = p + len;
+    int h, m, s = 0;
+
+    while (p < pEnd && (*p == ' ' || *p == 'T'))
+        p++;
+    if (!ParseUInt(&p, pEnd, 2, &h) || p >= pEnd || *p++ != ':' || !ParseUInt(&p, pEnd, 2, &m))
+        return 0;
+    if (p < pEnd && *p == ':') {
+        p++;
+        ParseUInt(&p, pEnd, 2, &s);
+    }
+    if (h > 23 || m > 59 || s > 60)
+        return 0;
+    *pSeconds = h * 3600 + m * 60 + s;
+    return 1;
+}
+
+// A decimal number with '.' or ',', scaled by 10^decimals and rounded
+int ParseFixed(const char* p, int len, int decimals, long long* pVal) {
+    const char* pEnd = p + len;
+    long long v = 0;
+    int neg = 0, digits = 0, frac = -1;
+
+    while (p < pEnd && *p == ' ')
+        p++;
+    if (p < pEnd && (*p == '-' || *p == '+'))
+        neg = *p++ == '-';
+    for (; p < pEnd; p++) {
+        if (*p >= '0' && *p <= '9') {
+            if (frac < 0 || frac < decimals + 1) {
+                v = v * 10 + (*p - '0');
+                if (frac >= 0)
+                    frac++;
+            }
+            digits++;
+        }
+        else if ((*p == '.' || *p == ',') && frac < 0)
+            frac = 0;
+        else
+            break;
+    }
+    if (!digits || v > 0x7FFFFFFFFFFLL)
+        return 0;
+    if (frac < 0)
+        frac = 0;
+    for (; frac < decimals + 1; frac++)
+        v *= 10;
+    for (; frac > decimals + 1; frac--)
+        v /= 10;
+    v = (v + 5) / 10;
+    *pVal = neg ? -v : v;
+    return 1;
+}
+
+// kHz, MHz or Hz, whatever the logger uses. The unit is picked on the
+// value scaled by 1000, "227360000" (Hz) is 2.2736e11 there.
+int ParseTiiFreq(const char* p, int len, DWORD* pKHz) {
+    long long v;
+
+    if (!ParseFixed(p, len, 3, &v) || v <= 0)
+        return 0;
+    if (v < 1'000'000)            // MHz with 3 decimals
+        *pKHz = (DWORD)v;
+    else if (v < 1'000'000'000)   // kHz
+        *pKHz = (DWORD)(v / 1000);
+    else                          // Hz
+        *pKHz = (DWORD)(v / 1'000'000);
+    return 1;
+}
+
+int ParseTiiChannel(const char* p, int len, DWORD* pKHz) {
+    while (len && *p == ' ') {
+        p++;
+        len--;
+    }
+    while (len && p[len - 1] == ' ')
+        len--;
+    for (int i = 0; i < (int)(sizeof(tiiChannels) / sizeof(tiiChannels[0])); i++) {
+        if (lstrlen(tiiChannels[i].name) == len && !_strnicmp(tiiChannels[i].name, p, len)) {
+            *pKHz = tiiChannels[i].kHz;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Main or sub ID, nothing else in the field
+int ParseTiiId(const char* p, int len, int* pVal) {
+    const char* pEnd = p + len;
+
+    while (p < pEnd && *p == ' ')
+        p++;
+    if (!ParseUInt(&p, pEnd, 3, pVal))
+        return 0;
+    while (p < pEnd && *p == ' ')
+        p++;
+    return p == pEnd;
+}
+
+int ParseHex(const char* p, int len, int* pVal) {
+    const char* pEnd = p + len;
+    int v = 0, n = 0, d;
+
+    while (p < pEnd && *p == ' ')
+        p++;
+    if (pEnd - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+        p += 2;
+    for (; p < pEnd && n < 8; p++, n++) {
+        if (*p >= '0' && *p <= '9')
+            d = *p - '0';
+        else if ((*p | 0x20) >= 'a' && (*p | 0x20) <= 'f')
+            d = (*p | 0x20) - 'a' + 10;
+        else
+            break;
+        v = v * 16 + d;
+    }
+    *pVal = v;
+    return n > 0;
+}
+
+// "12 03", "12-03", "12/3" or "1203"
+int ParseTiiCode(const char* p, int len, int* pMain, int* pSub) {
+    const char* pEnd = p + len;
+    int n;
+
+    while (p < pEnd && *p == ' ')
+        p++;
+    n = ParseUInt(&p, pEnd, 2, pMain);
+    if (!n)
+        return 0;
+    while (p < pEnd && (*p == ' ' || *p == '-' || *p == '/' || *p == ':'))
+        p++;
+    return ParseUInt(&p, pEnd, 2, pSub) > 0;
+}
+
+
+// Splits a line in place. Returns the number of fields.
+int SplitTiiLine(const char* p, int len, char separator, TIIFIELD* pFields) {
+    int num = 0, start = 0;
+
+    for (int i = 0; i <= len && num < TII_MAX_FIELDS; i++) {
+        if (i == len || p[i] == separator) {
+            pFields[num].p = p + start;
+            pFields[num].len = i - start;
+            if (pFields[num].len >= 2 && p[start] == '"' && p[i - 1] == '"') {
+                pFields[num].p++;
+                pFields[num].len -= 2;
+            }
+            num++;
+            start = i + 1;
+        }
+    }
+    return num;
+}
+
+inline int FieldHas(const TIIFIELD* pField, const char* szWord) {
+    int n = lstrlen(szWord);
+
+    for (int i = 0; i + n <= pField->len; i++)
+        if (!_strnicmp(pField->p + i, szWord, n))
+            return 1;
+    return 0;
+}
+
+// Finds the columns by their names. Returns 0 if this is no header line.
+int ReadTiiHeader(TIISOURCE* pSrc, const char* p, int len) {
+    TIIFIELD fields[TII_MAX_FIELDS];
+    signed char* col = pSrc->col;
+    int num, found = 0;
+
+    while (len && (*p == ' ' || *p == '#' || (BYTE)*p == 0xEF || (BYTE)*p == 0xBB || (BYTE)*p == 0xBF)) {
+        p++; // comment mark or UTF-8 BOM
+        len--;
+    }
+    if (!len || (*p >= '0' && *p <= '9'))
+        return 0;
+
+    pSrc->separator = memchr(p, ';', len) ? ';' : memchr(p, '\t', len) ? '\t' : ',';
+    num = SplitTiiLine(p, len, pSrc->separator, fields);
+    memset(col, -1, TII_NUM_COLS);
+
+    for (int i = num - 1; i >= 0; i--) { // the first one wins
+        if (FieldHas(&fields[i], "date"))
+            col[TII_COL_DATE] = (signed char)i;
+        if (FieldHas(&fields[i], "time") && !FieldHas(&fields[i], "date"))
+            col[TII_COL_TIME] = (signed char)i;
+        if (FieldHas(&fields[i], "freq"))
+            col[TII_COL_FREQ] = (signed char)i;
+        if (FieldHas(&fields[i], "chan") || FieldHas(&fields[i], "block"))
+            col[TII_COL_CHANNEL] = (signed char)i;
+        if (FieldHas(&fields[i], "eid") || (FieldHas(&fields[i], "ens") && FieldHas(&fields[i], "id")))
+            col[TII_COL_EID] = (signed char)i;
+        if (FieldHas(&fields[i], "main"))
+            col[TII_COL_MAIN] = (signed char)i;
+        if (FieldHas(&fields[i], "sub"))
+            col[TII_COL_SUB] = (signed char)i;
+        if (FieldHas(&fields[i], "tii") && !FieldHas(&fields[i], "main") && !FieldHas(&fields[i], "sub"))
+            col[TII_COL_TII] = (signed char)i;
+        if (FieldHas(&fields[i], "level") || FieldHas(&fields[i], "strength") || FieldHas(&fields[i], "db"))
+            col[TII_COL_LEVEL] = (signed char)i;
+    }
+    if (col[TII_COL_DATE] < 0 && col[TII_COL_TIME] >= 0) { // "Time" with the date in it
+        col[TII_COL_DATE] = col[TII_COL_TIME];
+        col[TII_COL_TIME] = -1;
+    }
+
+    found = col[TII_COL_DATE] >= 0 && (col[TII_COL_FREQ] >= 0 || col[TII_COL_CHANNEL] >= 0) &&
+        col[TII_COL_EID] >= 0 && (col[TII_COL_TII] >= 0 || (col[TII_COL_MAIN] >= 0 && col[TII_COL_SUB] >= 0));
+    pSrc->haveLayout = (BYTE)found;
+    return 1;
+}
+
+void SetDefaultTiiLayout(TIISOURCE* pSrc, const char* p, int len) {
+    static const signed char defaults[TII_NUM_COLS] = { 0, -1, 1, -1, 2, 3, 4, -1, 5 };
+
+    memcpy(pSrc->col, defaults, TII_NUM_COLS);
+    pSrc->separator = memchr(p, ';', len) ? ';' : memchr(p, '\t', len) ? '\t' : ',';
+    pSrc->haveLayout = 1;
+}
+
+
+// Turns one data line into a row of the block. Returns 0 for lines we
+// can't use (empty, broken, unknown layout).
+int ParseTiiLine(const TIISOURCE* pSrc, const char* p, int len, TIIBLOCK* pBlock) {
+    TIIFIELD fields[TII_MAX_FIELDS];
+    const signed char* col = pSrc->col;
+    DWORD t, secs, freq;
+    int num, eid, mainId, subId, n;
+    long long level;
+
+    num = SplitTiiLine(p, len, pSrc->separator, fields);
+    for (int c = 0; c < TII_NUM_COLS; c++)
+        if (col[c] >= num)
+            return 0;
+
+#define FIELD(c) fields[col[c]].p, fields[col[c]].len
+    n = ParseTiiDate(FIELD(TII_COL_DATE), &t);
+    if (!n)
+        return 0;
+    if (col[TII_COL_TIME] >= 0) {
+        if (ParseTiiClock(FIELD(TII_COL_TIME), &secs))
+            t += secs;
+    }
+    else if (ParseTiiClock(fields[col[TII_COL_DATE]].p + n, fields[col[TII_COL_DATE]].len - n, &secs))
+        t += secs;
+
+    if (!(col[TII_COL_FREQ] >= 0 && ParseTiiFreq(FIELD(TII_COL_FREQ), &freq)) &&
+        !(col[TII_COL_CHANNEL] >= 0 && ParseTiiChannel(FIELD(TII_COL_CHANNEL), &freq)))
+        return 0;
+
+    if (!ParseHex(FIELD(TII_COL_EID), &eid) || eid > 0xFFFF)
+        return 0;
+
+    if (col[TII_COL_TII] >= 0) {
+        if (!ParseTiiCode(FIELD(TII_COL_TII), &mainId, &subId))
+            return 0;
+    }
+    else if (!ParseTiiId(FIELD(TII_COL_MAIN), &mainId) || !ParseTiiId(FIELD(TII_COL_SUB), &subId))
+        return 0;
+    if (mainId < 0 || mainId > 255 || subId < 0 || subId > 255)
+        return 0;
+
+    if (col[TII_COL_LEVEL] < 0 || !ParseFixed(FIELD(TII_COL_LEVEL), 1, &level) ||
+        level <= TII_NO_LEVEL || level > 32767)
+        level = TII_NO_LEVEL;
+#undef FIELD
+
+    n = pBlock->hdr.numRows++;
+    pBlock->time[n] = t;
+    pBlock->freq[n] = freq;
+    pBlock->eid[n] = (WORD)eid;
+    pBlock->mainId[n] = (BYTE)mainId;
+    pBlock->subId[n] = (BYTE)subId;
+    pBlock->level[n] = (short)level;
+
+    if (!n || t < pBlock->hdr.minTime)
+        pBlock->hdr.minTime = t;
+    if (!n || t > pBlock->hdr.maxTime)
+        pBlock->hdr.maxTime = t;
+    if (!n || freq < pBlock->hdr.minFreq)
+        pBlock->hdr.minFreq = freq;
+    if (!n || freq > pBlock->hdr.maxFreq)
+        pBlock->hdr.maxFreq = freq;
+    return 1;
+}
+
+
+int WriteAt(HANDLE hFile, ULONGLONG offset, const void* p, DWORD len) {
+    LARGE_INTEGER li;
+    DWORD dNumBytesWritten = 0;
+
+    li.QuadPart = offset;
+    return SetFilePointerEx(hFile, li, NULL, FILE_BEGIN) &&
+        WriteFile(hFile, p, len, &dNumBytesWritten, NULL) && dNumBytesWritten == len;
+}
+
+int ReadAt(HANDLE hFile, ULONGLONG offset, void* p, DWORD len) {
+    LARGE_INTEGER li;
+    DWORD dNumBytesRead = 0;
+
+    li.QuadPart = offset;
+    return SetFilePointerEx(hFile, li, NULL, FILE_BEGIN) &&
+        ReadFile(hFile, p, len, &dNumBytesRead, NULL) && dNumBytesRead == len;
+}
+
+inline DWORD TiiBlockSize(DWORD numRows) {
+    return sizeof(TIIBLOCKHEADER) + numRows * (2 * sizeof(DWORD) + sizeof(WORD) + 2 + sizeof(short));
+}
+
+// Writes the block at its place and the store header
+int FlushTiiBlock(TIIINGEST* pIng) {
+    TIIBLOCK* pB = pIng->pBlock;
+    ULONGLONG off = pIng->blockOffset;
+    DWORD n = pB->hdr.numRows;
+    int isNew = off != pIng->hdr.lastBlockOffset || !pIng->hdr.numBlocks;
+
+    if (!n)
+        return 1;
+    if (!(WriteAt(pIng->hStore, off, &pB->hdr, sizeof(TIIBLOCKHEADER)) &&
+        WriteAt(pIng->hStore, off += sizeof(TIIBLOCKHEADER), pB->time, n * sizeof(DWORD)) &&
+        WriteAt(pIng->hStore, off += n * sizeof(DWORD), pB->freq, n * sizeof(DWORD)) &&
+        WriteAt(pIng->hStore, off += n * sizeof(DWORD), pB->eid, n * sizeof(WORD)) &&
+        WriteAt(pIng->hStore, off += n * sizeof(WORD), pB->mainId, n) &&
+        WriteAt(pIng->hStore, off += n, pB->subId, n) &&
+        WriteAt(pIng->hStore, off += n, pB->level, n * sizeof(short)))) {
+        pIng->failed = 1;
+        return 0;
+    }
+    if (isNew) {
+        pIng->hdr.numBlocks++;
+        pIng->hdr.lastBlockOffset = pIng->blockOffset;
+    }
+    return WriteAt(pIng->hStore, 0, &pIng->hdr, sizeof(TIISTOREHEADER));
+}
+
+// Reads the block at offset. With hdrOnly, only the block header.
+int ReadTiiBlock(HANDLE hStore, ULONGLONG off, TIIBLOCK* pB, int hdrOnly) {
+    DWORD n;
+
+    if (!ReadAt(hStore, off, &pB->hdr, sizeof(TIIBLOCKHEADER)) || pB->hdr.numRows > TII_BLOCK_ROWS)
+        return 0;
+    if (hdrOnly)
+        return 1;
+    n = pB->hdr.numRows;
+    return ReadAt(hStore, off += sizeof(TIIBLOCKHEADER), pB->time, n * sizeof(DWORD)) &&
+        ReadAt(hStore, off += n * sizeof(DWORD), pB->freq, n * sizeof(DWORD)) &&
+        ReadAt(hStore, off += n * sizeof(DWORD), pB->eid, n * sizeof(WORD)) &&
+        ReadAt(hStore, off += n * sizeof(WORD), pB->mainId, n) &&
+        ReadAt(hStore, off += n, pB->subId, n) &&
+        ReadAt(hStore, off += n, pB->level, n * sizeof(short));
+}
+
+// Appends a row to the store, a full block goes to the disk
+inline void CommitTiiRow(TIIINGEST* pIng) {
+    pIng->hdr.numRows++;
+    pIng->newRows++;
+    if (pIng->pBlock->hdr.numRows == TII_BLOCK_ROWS) {
+        FlushTiiBlock(pIng);
+        pIng->blockOffset += TiiBlockSize(TII_BLOCK_ROWS);
+        memset(&pIng->pBlock->hdr, 0, sizeof(TIIBLOCKHEADER));
+    }
+}
+
+
+DWORD HashTiiHead(const char* p, int len) {
+    DWORD h = 2166136261u; // FNV-1a
+
+    for (int i = 0; i < len; i++)
+        h = (h ^ (BYTE)p[i]) * 16777619u;
+    return h;
+}
+
+TIISOURCE* FindTiiSource(TIIINGEST* pIng, const char* szFileName) {
+    TIISOURCE* pSrc;
+    void* pNew;
+
+    for (DWORD i = 0; i < pIng->numSources; i++)
+        if (!lstrcmpi(pIng->pSources[i].szFileName, szFileName))
+            return &pIng->pSources[i];
+
+    if (pIng->numSources >= TII_MAX_SOURCES)
+        return NULL;
+    pNew = realloc(pIng->pSources, (pIng->numSources + 1) * sizeof(TIISOURCE));
+    if (!pNew)
+        return NULL;
+    pIng->pSources = (TIISOURCE*)pNew;
+    pSrc = &pIng->pSources[pIng->numSources++];
+    memset(pSrc, 0, sizeof(TIISOURCE));
+    lstrcpyn(pSrc->szFileName, szFileName, MAX_PATH_BUFFER_SIZE);
+    return pSrc;
+}
+
+// Reads the new complete lines of a log file. Returns the number of rows.
+int IngestTiiFile(TIIINGEST* pIng, const char* szFileName, volatile int* pCancel) {
+    TIISOURCE* pSrc;
+    HANDLE hLog;
+    LARGE_INTEGER liSize, li;
+    DWORD dNumBytesRead, have = 0, pos, lineStart, head;
+    char* buf = pIng->pReadBuf;
+    int lineLen, isHeader, ret = 0;
+
+    pSrc = FindTiiSource(pIng, szFileName);
+    if (!pSrc)
+        return ret;
+
+    // QIRX may still write into it
+    hLog = CreateFile(szFileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (INVALID_HANDLE_VALUE == hLog)
+        return ret;
+    GetFileSizeEx(hLog, &liSize);
+
+    // A shorter file or another first line: a new log with the same name.
+    // Only the first TII_HEAD_MAX bytes of the line count.
+    if (pSrc->offset) {
+        ReadFile(hLog, buf, TII_HEAD_MAX, &dNumBytesRead, NULL);
+        for (head = 0; head < dNumBytesRead && buf[head] != '\n'; head++)
+            ;
+        if ((ULONGLONG)liSize.QuadPart < pSrc->offset || HashTiiHead(buf, head) != pSrc->headHash) {
+            pSrc->offset = 0;
+            pSrc->haveLayout = 0;
+        }
+    }
+    if ((ULONGLONG)liSize.QuadPart == pSrc->offset) {
+        CloseHandle(hLog);
+        return ret;
+    }
+
+    li.QuadPart = pSrc->offset;
+    SetFilePointerEx(hLog, li, NULL, FILE_BEGIN);
+
+    while (!*pCancel && !pIng->failed &&
+        ReadFile(hLog, buf + have, TII_READ_BUFFER - have, &dNumBytesRead, NULL) && dNumBytesRead) {
+        have += dNumBytesRead;
+        lineStart = 0;
+
+        for (pos = 0; pos < have; pos++) {
+            if (buf[pos] != '\n')
+                continue;
+            lineLen = pos - lineStart;
+            if (lineLen && buf[lineStart + lineLen - 1] == '\r')
+                lineLen--;
+
+            if (!pSrc->offset && !lineStart)
+                pSrc->headHash = HashTiiHead(buf, pos < TII_HEAD_MAX ? pos : TII_HEAD_MAX);
+
+            if (lineLen) {
+                // a log without a header starts with a row
+                isHeader = 0;
+                if (!pSrc->haveLayout) {
+                    isHeader = ReadTiiHeader(pSrc, buf + lineStart, lineLen);
+                    if (!isHeader)
+                        SetDefaultTiiLayout(pSrc, buf + lineStart, lineLen);
+                }
+                if (!isHeader && ParseTiiLine(pSrc, buf + lineStart, lineLen, pIng->pBlock)) {
+                    CommitTiiRow(pIng);
+                    ret++;
+                }
+            }
+            pSrc->offset += pos + 1 - lineStart;
+            lineStart = pos + 1;
+        }
+
+        // keep the incomplete line, a longer one than the buffer is dropped
+        if (lineStart)
+            memmove(buf, buf + lineStart, have - lineStart);
+        else if (have == TII_READ_BUFFER) {
+            pSrc->offset += have;
+            have = 0;
+            continue;
+        }
+        have -= lineStart;
+    }
+    CloseHandle(hLog);
+    return ret;
+}
+
+
+int LoadTiiSources(TIIINGEST* pIng, const char* szSrcFile) {
+    HANDLE hSrc;
+    LARGE_INTEGER liSize;
+    DWORD dNumBytesRead = 0;
+
+    hSrc = CreateFile(szSrcFile, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
+    if (INVALID_HANDLE_VALUE == hSrc)
+        return 1; // nothing read so far
+
+    GetFileSizeEx(hSrc, &liSize);
+    if (liSize.QuadPart && !(liSize.QuadPart % sizeof(TIISOURCE)) &&
+        liSize.QuadPart <= TII_MAX_SOURCES * sizeof(TIISOURCE)) {
+        pIng->pSources = (TIISOURCE*)malloc((SIZE_T)liSize.QuadPart);
+        if (pIng->pSources) {
+            ReadFile(hSrc, pIng->pSources, liSize.LowPart, &dNumBytesRead, NULL);
+            pIng->numSources = dNumBytesRead / sizeof(TIISOURCE);
+        }
+    }
+    CloseHandle(hSrc);
+    return 1;
+}
+
+void SaveTiiSources(TIIINGEST* pIng, const char* szSrcFile) {
+    HANDLE hSrc;
+    DWORD dNumBytesWritten;
+
+    hSrc = CreateFile(szSrcFile, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
+    if (INVALID_HANDLE_VALUE != hSrc) {
+        WriteFile(hSrc, pIng->pSources, pIng->numSources * sizeof(TIISOURCE), &dNumBytesWritten, NULL);
+        CloseHandle(hSrc);
+    }
+}
+
+// Opens (or creates) the store and loads the last block, if it is not full
+int OpenTiiStore(TIIINGEST* pIng, const char* szStore) {
+    DWORD dNumBytesRead = 0;
+    LARGE_INTEGER liSize;
+
+    pIng->hStore = CreateFile(szStore, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, 0, OPEN_ALWAYS, 0, 0);
+    if (INVALID_HANDLE_VALUE == pIng->hStore)
+        return 0;
+
+    GetFileSizeEx(pIng->hStore, &liSize);
+    ReadFile(pIng->hStore, &pIng->hdr, sizeof(TIISTOREHEADER), &dNumBytesRead, NULL);
+
+    if (dNumBytesRead != sizeof(TIISTOREHEADER) || memcmp(pIng->hdr.magic, "TIIC", 4) ||
+        TII_STORE_VERSION != pIng->hdr.version) {
+        memset(&pIng->hdr, 0, sizeof(TIISTOREHEADER)); // new or unknown, start over
+        memcpy(pIng->hdr.magic, "TIIC", 4);
+        pIng->hdr.version = TII_STORE_VERSION;
+        pIng->blockOffset = sizeof(TIISTOREHEADER);
+        SetEndOfFile(pIng->hStore);
+        return WriteAt(pIng->hStore, 0, &pIng->hdr, sizeof(TIISTOREHEADER));
+    }
+
+    pIng->blockOffset = pIng->hdr.lastBlockOffset;
+    if (!pIng->hdr.numBlocks)
+        pIng->blockOffset = sizeof(TIISTOREHEADER);
+    else if (!ReadTiiBlock(pIng->hStore, pIng->blockOffset, pIng->pBlock, 0))
+        return 0;
+    else if (pIng->pBlock->hdr.numRows == TII_BLOCK_ROWS) {
+        pIng->blockOffset += TiiBlockSize(TII_BLOCK_ROWS);
+        memset(&pIng->pBlock->hdr, 0, sizeof(TIIBLOCKHEADER));
+    }
+    return 1;
+}
+
+struct TIIFOLDERINGEST {
+    TIIINGEST* pIng;
+    int rows;
+};
+static TIIFOLDERINGEST* pFolderIngests[STATION_MAX]; // for the callback, one ingest at a time
+
+int IngestTiiCallback(const char* szFileName, ULONGLONG fileSize, volatile int* pCancel) {
+    TIIFOLDERINGEST* pFolderIngest;
+    int len = lstrlen(szFileName);
+
+    // our own reports may be in the same folder
+    if (len > 8 && (!lstrcmpi(szFileName + len - 8, ".eti.txt") || !lstrcmpi(szFileName + len - 8, ".raw.txt")))
+        return 0;
+    pFolderIngest = pFolderIngests[pPTM->station];
+    pFolderIngest->rows += IngestTiiFile(pFolderIngest->pIng, szFileName, pCancel);
+    return 1;
+}
+
+// Takes the new lines of all logs ("*.txt", "*.csv") in the folders into
+// the store. Returns the number of new rows or -1 if the store failed.
+int TiiIngestFolders(const char (*szFolders)[MAX_PATH_BUFFER_SIZE], int numFolders, volatile int* pCancel) {
+    static volatile long busy[STATION_MAX];
+    char szSrc[MAX_PATH_BUFFER_SIZE + 8];
+    TIIINGEST ing{};
+    TIIFOLDERINGEST folderIngest{};
+    int ret = -1;
+
+    if (!pPTM->haveDlgConfig || InterlockedExchange(&busy[pPTM->station], 1))
+        return ret;
+
+    ing.pBlock = (TIIBLOCK*)VCALLOC(sizeof(TIIBLOCK) + TII_READ_BUFFER);
+    if (ing.pBlock) {
+        ing.pReadBuf = (char*)(ing.pBlock + 1);
+        sprintf(szSrc, "%s.src", pPTM->szTiiStoreFileName);
+
+        if (LoadTiiSources(&ing, szSrc) && OpenTiiStore(&ing, pPTM->szTiiStoreFileName)) {
+            folderIngest.pIng = &ing;
+            pFolderIngests[pPTM->station] = &folderIngest;
+            for (int i = 0; i < numFolders && !*pCancel; i++) {
+                ForEachRecording(szFolders[i], ".txt", IngestTiiCallback, pCancel);
+                ForEachRecording(szFolders[i], ".csv", IngestTiiCallback, pCancel);
+            }
+            FlushTiiBlock(&ing);
+            // The sources last, so an aborted run reads the lines again
+            // instead of losing them.
+            if (!ing.failed) {
+                SaveTiiSources(&ing, szSrc);
+                ret = folderIngest.rows;
+            }
+        }
+        if (ing.hStore && INVALID_HANDLE_VALUE != ing.hStore)
+            CloseHandle(ing.hStore);
+        free(ing.pSources);
+        VFREE(ing.pBlock);
+    }
+    InterlockedExchange(&busy[pPTM->station], 0);
+    return ret;
+}
+
+
+// Group-by with open addressing, the table grows at 50 % load
+struct TIIGROUPTABLE {
+    TIIGROUP* pGroups;
+    DWORD size;               // a power of 2
+    DWORD used;
+};
+
+TIIGROUP* GetTiiGroup(TIIGROUPTABLE* pTab, ULONGLONG key) {
+    TIIGROUP* pOld, *pG;
+    DWORD oldSize, i;
+
+    if (pTab->used * 2 >= pTab->size) {
+        pOld = pTab->pGroups;
+        oldSize = pTab->size;
+        pTab->size = oldSize ? oldSize * 2 : 1024;
+        pTab->pGroups = (TIIGROUP*)calloc(pTab->size, sizeof(TIIGROUP));
+        if (!pTab->pGroups) {
+            pTab->pGroups = pOld;
+            pTab->size = oldSize;
+            if (pTab->used + 1 >= pTab->size)
+                return NULL;
+        }
+        else {
+            for (DWORD k = 0; k < oldSize; k++) {
+                if (!pOld[k].key)
+                    continue;
+                for (i = (DWORD)(pOld[k].key * 0x9E3779B97F4A7C15ull >> 32) & (pTab->size - 1);
+                    pTab->pGroups[i].key; i = (i + 1) & (pTab->size - 1))
+                    ;
+                pTab->pGroups[i] = pOld[k];
+            }
+            free(pOld);
+        }
+    }
+
+    for (i = (DWORD)(key * 0x9E3779B97F4A7C15ull >> 32) & (pTab->size - 1);; i = (i + 1) & (pTab->size - 1)) {
+        pG = &pTab->pGroups[i];
+        if (pG->key == key)
+            return pG;
+        if (!pG->key) {
+            pG->key = key;
+            pG->minLevel = 32767;
+            pG->maxLevel = TII_NO_LEVEL;
+            pTab->used++;
+            return pG;
+        }
+    }
+}
+
+int CompareTiiGroups(const void* a, const void* b) {
+    const TIIGROUP* pa = (const TIIGROUP*)a, *pb = (const TIIGROUP*)b;
+
+    if (pa->count != pb->count)
+        return pa->count < pb->count ? 1 : -1;
+    return pa->key < pb->key ? -1 : pa->key > pb->key;
+}
+
+void PrintTiiGroup(const TIIGROUP* pG, int groupBy) {
+    char szFirst[24], szLast[24], szKey[40];
+    DWORD k = (DWORD)(pG->key - 1);
+
+    switch (groupBy) {
+    case TII_GROUP_TX:
+        sprintf(szKey, "%04lX %3lu %3lu", k >> 16, (k >> 8) & 0xFF, k & 0xFF);
+        break;
+    case TII_GROUP_EID:
+        sprintf(szKey, "%04lX", k);
+        break;
+    case TII_GROUP_FREQ:
+        sprintf(szKey, "%lu.%03lu MHz", k / 1000, k % 1000);
+        break;
+    default:
+        FormatTiiTime(k * 86400, szKey);
+        szKey[10] = 0;
+        break;
+    }
+    FormatTiiTime(pG->first, szFirst);
+    FormatTiiTime(pG->last, szLast);
+    if (pG->numLevels)
+        printf("%-16s %9lu  %s  %s  %6.1f %6.1f %6.1f\n", szKey, pG->count, szFirst, szLast,
+            pG->minLevel / 10.0, (double)pG->sumLevel / pG->numLevels / 10.0, pG->maxLevel / 10.0);
+    else
+        printf("%-16s %9lu  %s  %s\n", szKey, pG->count, szFirst, szLast);
+}
+
+// Runs a query over the store and prints the rows or the groups
+int TiiQuery(const TIIQUERY* pQ) {
+    HANDLE hStore;
+    TIISTOREHEADER hdr;
+    TIIBLOCK* pB;
+    TIIGROUPTABLE tab{};
+    TIIGROUP* pG;
+    ULONGLONG off, key = 0, numMatches = 0;
+    DWORD dNumBytesRead = 0, blocksRead = 0, t;
+    LARGE_INTEGER qpf, liStart, liEnd;
+    char szTime[24];
+    int printed = 0, ret = 0;
+
+    hStore = CreateFile(pPTM->szTiiStoreFileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (INVALID_HANDLE_VALUE == hStore)
+        return ret;
+    ReadFile(hStore, &hdr, sizeof(TIISTOREHEADER), &dNumBytesRead, NULL);
+    pB = (TIIBLOCK*)VCALLOC(sizeof(TIIBLOCK));
+
+    if (pB && dNumBytesRead == sizeof(TIISTOREHEADER) && !memcmp(hdr.magic, "TIIC", 4)) {
+        QueryPerformanceFrequency(&qpf);
+        QueryPerformanceCounter(&liStart);
+        off = sizeof(TIISTOREHEADER);
+
+        for (DWORD b = 0; b < hdr.numBlocks; b++) {
+            if (!ReadTiiBlock(hStore, off, pB, 1))
+                break;
+            // the zone map first, the columns only if needed
+            if (pB->hdr.maxTime < pQ->fromTime || pB->hdr.minTime > pQ->toTime ||
+                (pQ->freq && (pQ->freq < pB->hdr.minFreq || pQ->freq > pB->hdr.maxFreq))) {
+                off += TiiBlockSize(pB->hdr.numRows);
+                continue;
+            }
+            if (!ReadTiiBlock(hStore, off, pB, 0))
+                break;
+            off += TiiBlockSize(pB->hdr.numRows);
+            blocksRead++;
+
+            for (DWORD r = 0; r < pB->hdr.numRows; r++) {
+                t = pB->time[r];
+                if (t < pQ->fromTime || t > pQ->toTime || (pQ->freq && pB->freq[r] != pQ->freq) ||
+                    (pQ->eid >= 0 && pB->eid[r] != pQ->eid) ||
+                    (pQ->mainId >= 0 && pB->mainId[r] != pQ->mainId) ||
+                    (pQ->subId >= 0 && pB->subId[r] != pQ->subId))
+                    continue;
+                numMatches++;
+
+                switch (pQ->groupBy) {
+                case TII_GROUP_NONE:
+                    if (printed < pQ->limit) {
+                        FormatTiiTime(t, szTime);
+                        printf("%s  %7lu.%03lu  %04X %3u %3u", szTime, pB->freq[r] / 1000,
+                            pB->freq[r] % 1000, pB->eid[r], pB->mainId[r], pB->subId[r]);
+                        if (pB->level[r] != TII_NO_LEVEL)
+                            printf("  %6.1f", pB->level[r] / 10.0);
+                        printf("\n");
+                        printed++;
+                    }
+                    continue;
+                case TII_GROUP_TX:
+                    key = ((ULONGLONG)pB->eid[r] << 16) | (pB->mainId[r] << 8) | pB->subId[r];
+                    break;
+                case TII_GROUP_EID:
+                    key = pB->eid[r];
+                    break;
+                case TII_GROUP_FREQ:
+                    key = pB->freq[r];
+                    break;
+                default:
+                    key = t / 86400;
+                    break;
+                }
+                pG = GetTiiGroup(&tab, key + 1);
+                if (!pG)
+                    continue;
+                if (!pG->count || t < pG->first)
+                    pG->first = t;
+                if (t > pG->last)
+                    pG->last = t;
+                pG->count++;
+                if (pB->level[r] != TII_NO_LEVEL) {
+                    pG->sumLevel += pB->level[r];
+                    pG->numLevels++;
+                    if (pB->level[r] < pG->minLevel)
+                        pG->minLevel = pB->level[r];
+                    if (pB->level[r] > pG->maxLevel)
+                        pG->maxLevel = pB->level[r];
+                }
+            }
+        }
+        QueryPerformanceCounter(&liEnd);
+
+        if (tab.used) {
+            // pack the groups to the front and sort them by count
+            DWORD n = 0;
+            for (DWORD i = 0; i < tab.size; i++)
+                if (tab.pGroups[i].key)
+                    tab.pGroups[n++] = tab.pGroups[i];
+            qsort(tab.pGroups, n, sizeof(TIIGROUP), CompareTiiGroups);
+            printf("%-16s %9s  %-19s  %-19s  %6s %6s %6s\n", pQ->groupBy == TII_GROUP_TX ? "EId  main sub" :
+                pQ->groupBy == TII_GROUP_EID ? "EId" : pQ->groupBy == TII_GROUP_FREQ ? "frequency" : "day",
+                "count", "first seen", "last seen", "min", "avg", "max");
+            for (DWORD i = 0; i < n && (int)i < pQ->limit; i++)
+                PrintTiiGroup(&tab.pGroups[i], pQ->groupBy);
+        }
+        printf("%llu of %llu rows match, %lu of %lu blocks read, %.1f ms\n", numMatches, hdr.numRows,
+            blocksRead, hdr.numBlocks, (liEnd.QuadPart - liStart.QuadPart) * 1000.0 / qpf.QuadPart);
+        ret++;
+    }
+    free(tab.pGroups);
+    if (pB)
+        VFREE(pB);
+    CloseHandle(hStore);
+    return ret;
+}
+
+
+// Command line: key=value pairs, e.g.
+//   from=2025-05-01 to=2025-05-31T18:00 freq=12C eid=10F1 group=tx limit=50
+int ParseTiiQuery(int argc, char** argv, TIIQUERY* pQ) {
+    const char* v;
+    DWORD secs;
+    int len, n, x;
+
+    memset(pQ, 0, sizeof(TIIQUERY));
+    pQ->toTime = 0xFFFFFFFF;
+    pQ->eid = pQ->mainId = pQ->subId = -1;
+    pQ->limit = 100;
+
+    for (int i = 0; i < argc; i++) {
+        v = strchr(argv[i], '=');
+        if (!v)
+            return 0;
+        v++;
+        len = lstrlen(v);
+
+        if (!_strnicmp(argv[i], "from=", 5) || !_strnicmp(argv[i], "to=", 3)) {
+            n = ParseTiiDate(v, len, &secs);
+            if (!n)
+                return 0;
+            if (ParseTiiClock(v + n, len - n, (DWORD*)&x))
+                secs += x;
+            else if (argv[i][0] == 't' || argv[i][0] == 'T')
+                secs += 86399; // the whole day
+            if (argv[i][0] == 'f' || argv[i][0] == 'F')
+                pQ->fromTime = secs;
+            else
+                pQ->toTime = secs;
+        }
+        else if (!_strnicmp(argv[i], "freq=", 5)) {
+            if (!ParseTiiChannel(v, len, &pQ->freq) && !ParseTiiFreq(v, len, &pQ->freq))
+                return 0;
+        }
+        else if (!_strnicmp(argv[i], "eid=", 4)) {
+            if (!ParseHex(v, len, &pQ->eid))
+                return 0;
+        }
+        else if (!_strnicmp(argv[i], "main=", 5))
+            pQ->mainId = atoi(v);
+        else if (!_strnicmp(argv[i], "sub=", 4))
+            pQ->subId = atoi(v);
+        else if (!_strnicmp(argv[i], "limit=", 6))
+            pQ->limit = atoi(v);
+        else if (!_strnicmp(argv[i], "group=", 6)) {
+            if (!lstrcmpi(v, "tx"))
+                pQ->groupBy = TII_GROUP_TX;
+            else if (!lstrcmpi(v, "eid"))
+                pQ->groupBy = TII_GROUP_EID;
+            else if (!lstrcmpi(v, "freq"))
+                pQ->groupBy = TII_GROUP_FREQ;
+            else if (!lstrcmpi(v, "day"))
+                pQ->groupBy = TII_GROUP_DAY;
+            else if (lstrcmpi(v, "none"))
+                return 0;
+        }
+        else
+            return 0;
+    }
+    return 1;
+}
+
+int CmdTiiQuery(int argc, char** argv) {
+    TIIQUERY q;
+
+    if (!ParseTiiQuery(argc, argv, &q))
+        return 0;
+    if (!TiiQuery(&q))
+        printf("No TII store yet, run \"-tiiingest\" first.\n");
+    return 1;
+}